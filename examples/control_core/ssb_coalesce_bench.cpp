@@ -0,0 +1,183 @@
+// ssb_coalesce_bench.cpp
+// One datagram per control command against per-tick FRAME_BATCH frames
+// (ssb/coalescer.h) at 1..1024 agents. Every agent produces one 24-byte
+// command per sim tick; a receiver thread decodes whatever arrives. CPU
+// is thread CPU time, so sleeping between ticks is not counted.
+//
+// usage: ssb_coalesce_bench [seconds_per_run] [tick_hz] [max_batch_bytes]
+#include <time.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "ssb/clock.h"
+#include "ssb/coalescer.h"
+#include "ssb/control_packet.h"
+#include "ssb/frame.h"
+#include "ssb/udp.h"
+
+namespace
+{
+
+constexpr size_t UDP_IP_OVERHEAD = 28; // IPv4 + UDP headers per datagram
+
+uint64_t thread_cpu_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+struct Result
+{
+    uint64_t commands = 0;     // sent
+    uint64_t datagrams = 0;
+    uint64_t wire_bytes = 0;
+    uint64_t tx_cpu_ns = 0;
+    uint64_t rx_cpu_ns = 0;
+    uint64_t delivered = 0;    // commands decoded by the receiver
+    double seconds = 0;
+};
+
+Result run(uint32_t agents, bool batched, double seconds, double tick_hz, size_t max_bytes)
+{
+    Result res;
+    int rx_fd = ssb::bind_udp("127.0.0.1", 0);
+    int tx_fd = ssb::udp_socket();
+    sockaddr_in to;
+    if (rx_fd < 0 || tx_fd < 0 || !ssb::make_addr("127.0.0.1", ssb::bound_port(rx_fd), to))
+        return res;
+    ssb::set_socket_buffers(rx_fd, 64 << 20, 0);
+    ssb::set_socket_buffers(tx_fd, 0, 64 << 20);
+
+    std::atomic<bool> done{ false };
+    std::atomic<uint64_t> delivered{ 0 }, rx_cpu{ 0 };
+    std::thread receiver([&]()
+        {
+            const unsigned batch = 64;
+            std::vector<uint8_t> bufs(batch * 2048);
+            std::vector<iovec> iov(batch);
+            std::vector<mmsghdr> msgs(batch);
+            timeval tv{ 0, 100000 };
+            setsockopt(rx_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+            uint64_t n = 0, cpu0 = thread_cpu_ns();
+            while (!done)
+            {
+                for (unsigned i = 0; i < batch; ++i)
+                {
+                    iov[i] = iovec{ bufs.data() + i * 2048, 2048 };
+                    msgs[i].msg_hdr = msghdr{};
+                    msgs[i].msg_hdr.msg_iov = &iov[i];
+                    msgs[i].msg_hdr.msg_iovlen = 1;
+                }
+                int r = recvmmsg(rx_fd, msgs.data(), batch, MSG_WAITFORONE, nullptr);
+                for (int i = 0; i < r; ++i)
+                {
+                    const uint8_t* p = (const uint8_t*)iov[i].iov_base;
+                    ssb::FrameHeader h;
+                    if (msgs[i].msg_len < ssb::FRAME_HEADER_SIZE) continue;
+                    memcpy(&h, p, ssb::FRAME_HEADER_SIZE);
+                    if (!ssb::header_valid(h)) continue;
+
+                    ssb::ControlPacket pkt;
+                    if (h.type == ssb::FRAME_CONTROL)
+                        n += ssb::decode_control(p + ssb::FRAME_HEADER_SIZE, h.payload_len, pkt);
+                    else if (h.type == ssb::FRAME_BATCH)
+                        ssb::for_each_batched(p + ssb::FRAME_HEADER_SIZE, h.payload_len,
+                            [&](uint32_t, const uint8_t* rec, size_t len) { n += ssb::decode_control(rec, len, pkt); });
+                }
+            }
+            delivered = n;
+            rx_cpu = thread_cpu_ns() - cpu0;
+        });
+
+    ssb::Coalescer co(agents, ssb::CONTROL_PACKET_SIZE, max_bytes);
+    auto emit = [&](const uint8_t* frame, size_t len)
+    {
+        if (sendto(tx_fd, frame, len, 0, (sockaddr*)&to, sizeof(to)) > 0)
+        {
+            res.datagrams++;
+            res.wire_bytes += len + UDP_IP_OVERHEAD;
+        }
+    };
+
+    std::vector<ssb::ControlPacket> pkts(agents, ssb::ControlPacket{ 0, 0.6f, 0.0f, 0.0f, 0 });
+    uint8_t single[ssb::FRAME_HEADER_SIZE + ssb::CONTROL_PACKET_SIZE];
+
+    uint64_t period = (uint64_t)(1e9 / tick_hz);
+    uint64_t ticks = (uint64_t)(seconds * tick_hz);
+    uint64_t start = ssb::mono_ns(), next = start + period;
+    uint64_t cpu0 = thread_cpu_ns();
+    for (uint64_t t = 0; t < ticks; ++t, next += period)
+    {
+        timespec ts{ (time_t)(next / 1000000000ull), (long)(next % 1000000000ull) };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+
+        uint64_t now = ssb::mono_ns();
+        for (uint32_t a = 0; a < agents; ++a)
+        {
+            ssb::ControlPacket& p = pkts[a];
+            p.seq++;
+            p.send_ns = now;
+            if (batched)
+            {
+                co.add(a, &p, now, emit);
+            }
+            else
+            {
+                ssb::FrameHeader h = ssb::make_header(ssb::FRAME_CONTROL, a, p.seq, ssb::CONTROL_PACKET_SIZE, now);
+                memcpy(single, &h, ssb::FRAME_HEADER_SIZE);
+                ssb::encode_control(p, single + ssb::FRAME_HEADER_SIZE);
+                emit(single, sizeof(single));
+            }
+        }
+        if (batched) co.tick(emit);
+        res.commands += agents;
+    }
+    res.tx_cpu_ns = thread_cpu_ns() - cpu0;
+    res.seconds = (ssb::mono_ns() - start) / 1e9;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200)); // drain
+    done = true;
+    receiver.join();
+    res.delivered = delivered;
+    res.rx_cpu_ns = rx_cpu;
+
+    close(tx_fd);
+    close(rx_fd);
+    return res;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    double seconds = (argc > 1) ? atof(argv[1]) : 3.0;
+    double tick_hz = (argc > 2) ? atof(argv[2]) : 100.0;
+    size_t max_bytes = (argc > 3) ? (size_t)atoll(argv[3]) : ssb::COALESCE_MAX_BYTES;
+    const uint32_t agent_counts[] = { 1, 16, 128, 1024 };
+
+    printf("%u-byte commands | %.0f Hz ticks | batches up to %zu B\n",
+        (unsigned)ssb::CONTROL_PACKET_SIZE, tick_hz, max_bytes);
+    printf("%7s %7s %12s %12s %9s %10s %10s %10s\n",
+        "agents", "mode", "cmds/s", "pkts/s", "wire_B/c", "tx_ns/c", "rx_ns/c", "delivered");
+
+    for (uint32_t agents : agent_counts)
+    {
+        for (bool batched : { false, true })
+        {
+            Result r = run(agents, batched, seconds, tick_hz, max_bytes);
+            if (!r.commands) return 1;
+            printf("%7u %7s %12.0f %12.0f %9.1f %10.0f %10.0f %9.2f%%\n",
+                agents, batched ? "batch" : "single",
+                r.commands / r.seconds, r.datagrams / r.seconds,
+                (double)r.wire_bytes / r.commands,
+                (double)r.tx_cpu_ns / r.commands, (double)r.rx_cpu_ns / r.commands,
+                100.0 * r.delivered / r.commands);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,125 @@
+// ssb_control_core.cpp
+// Native latest-only forwarder: UDP 5060 -> UDP 5061, same <IfffQ packets
+// as examples/single_agent_v1/ssb_control_core.py.
+//
+// usage: ssb_control_core [ingress_port] [egress_port] [agents] [tick_hz] [mtu] [coalesce] [capture_prefix]
+// agents > 0 switches to the batched multi-agent mode (SSB frames keyed by
+// stream_id, recvmmsg ingress, one sendmmsg per tick). mtu > 0 fragments
+// larger frames on egress, with UDP GSO/GRO where the kernel has them.
+// coalesce = 1 sends each tick's control commands as FRAME_BATCH frames.
+// capture_prefix logs everything received and sent (<prefix>.rx / .tx) for
+// ws_replay.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <csignal>
+#include <thread>
+
+#include "ssb/control_core.h"
+#include "ssb/multi_agent_core.h"
+
+static volatile sig_atomic_t g_stop = 0;
+
+static int run_multi_agent(const ssb::ControlCoreConfig& base, uint32_t agents, double tick_hz, size_t mtu,
+    bool coalesce, const char* capture)
+{
+    ssb::MultiAgentConfig cfg;
+    cfg.host = base.host;
+    cfg.ingress_port = base.ingress_port;
+    cfg.egress_host = base.egress_host;
+    cfg.egress_port = base.egress_port;
+    cfg.agents = agents;
+    cfg.tick_hz = tick_hz;
+    cfg.mtu = mtu;
+    cfg.gso = cfg.gro = mtu > 0;
+    cfg.coalesce = coalesce;
+    cfg.capture = capture;
+
+    ssb::MultiAgentCore core;
+    if (!core.start(cfg))
+    {
+        printf("[SSB CORE] Failed to bind UDP %s:%d%s\n", cfg.host, cfg.ingress_port,
+            capture ? " or to create the capture files" : "");
+        return 1;
+    }
+
+    printf("[SSB CORE] %u agents @ %.1f Hz | UDP %s:%d -> %s:%d\n",
+        agents, tick_hz, cfg.host, cfg.ingress_port, cfg.egress_host, cfg.egress_port);
+    if (mtu)
+        printf("[SSB CORE] fragmenting above %zu B | gso %d | gro %d\n",
+            mtu, core.config().gso, core.config().gro);
+    if (coalesce)
+        printf("[SSB CORE] coalescing control commands per tick\n");
+    if (capture)
+        printf("[SSB CORE] capturing to %s.rx.* / %s.tx.*\n", capture, capture);
+
+    const ssb::MultiAgentStats& st = core.stats();
+    uint64_t last_ticks = 0, last_rx = 0, last_fwd = 0, last_rc = 0, last_sc = 0, last_co = 0;
+    for (int tick = 1; !g_stop; ++tick)
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        if (tick % 5) continue;
+
+        uint64_t ticks = st.ticks.load(), rx = st.datagrams.load(), fwd = st.forwarded.load();
+        uint64_t rc = st.recv_calls.load(), sc = st.send_calls.load(), co = st.coalesced.load();
+        double dt = (double)(ticks - last_ticks);
+        if (dt > 0)
+            printf("[SSB CORE] rx %llu (%.1f recvmmsg/tick) | fwd %llu (%.2f sendmmsg/tick) | batched cmds %llu | rejected %llu | abandoned %llu\n",
+                (unsigned long long)(rx - last_rx), (rc - last_rc) / dt,
+                (unsigned long long)(fwd - last_fwd), (sc - last_sc) / dt,
+                (unsigned long long)(co - last_co),
+                (unsigned long long)st.rejected.load(), (unsigned long long)st.abandoned.load());
+        last_ticks = ticks; last_rx = rx; last_fwd = fwd; last_rc = rc; last_sc = sc; last_co = co;
+    }
+
+    core.stop();
+    if (capture)
+        printf("[SSB CORE] captured %llu records\n", (unsigned long long)st.captured.load());
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    ssb::ControlCoreConfig cfg;
+    if (argc > 1) cfg.ingress_port = atoi(argv[1]);
+    if (argc > 2) cfg.egress_port = atoi(argv[2]);
+
+    signal(SIGINT, [](int) { g_stop = 1; });
+
+    uint32_t agents = (argc > 3) ? (uint32_t)atoi(argv[3]) : 0;
+    double tick_hz = (argc > 4) ? atof(argv[4]) : 20.0;
+    size_t mtu = (argc > 5) ? (size_t)atoll(argv[5]) : 0;
+    bool coalesce = (argc > 6) && atoi(argv[6]) != 0;
+    const char* capture = (argc > 7) ? argv[7] : nullptr;
+    if (agents > 0)
+        return run_multi_agent(cfg, agents, tick_hz, mtu, coalesce, capture);
+
+    ssb::ControlCore core;
+    if (!core.start(cfg))
+    {
+        printf("[SSB CORE] Failed to bind UDP %s:%d\n", cfg.host, cfg.ingress_port);
+        return 1;
+    }
+
+    printf("[SSB CORE] Ingress listening on UDP %s:%d\n", cfg.host, cfg.ingress_port);
+    printf("[SSB CORE] Forwarding -> %s:%d\n", cfg.egress_host, cfg.egress_port);
+    printf("[SSB CORE] Running (Ctrl+C to stop)\n");
+
+    uint64_t last_rx = 0, last_tx = 0;
+    for (int tick = 1; !g_stop; ++tick)
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        if (tick % 5) continue;
+
+        uint64_t rx = core.received(), tx = core.forwarded();
+        printf("[SSB CORE] rx %llu | fwd %llu | coalesced %llu\n",
+            (unsigned long long)(rx - last_rx),
+            (unsigned long long)(tx - last_tx),
+            (unsigned long long)((rx - last_rx) > (tx - last_tx) ? (rx - last_rx) - (tx - last_tx) : 0));
+        last_rx = rx;
+        last_tx = tx;
+    }
+
+    core.stop();
+    return 0;
+}
@@ -0,0 +1,93 @@
+// ssb_control_core_bench.cpp
+// Ingress->egress forwarding latency of the native control core.
+// A tick-paced sender stamps send_ns, the core forwards latest-only, and a
+// receiver on the egress port records recv_ns - send_ns. miss99_us is the
+// sender's p99 wake-up miss against its tick.
+//
+// usage: ssb_control_core_bench [seconds_per_rate]
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "ssb/clock.h"
+#include "ssb/control_core.h"
+#include "ssb/histogram.h"
+#include "ssb/tick_scheduler.h"
+
+int main(int argc, char** argv)
+{
+    double seconds = (argc > 1) ? atof(argv[1]) : 5.0;
+    const int rates[] = { 100, 1000, 5000, 10000 };
+
+    // one calibration for all rates: how late clock_nanosleep wakes here
+    uint64_t spin = ssb::TickScheduler(1000000).calibrate();
+
+    printf("%8s %9s %9s %9s %9s %9s %9s %9s %9s\n",
+        "rate_hz", "sent", "fwd", "p50_us", "p90_us", "p99_us", "p99.9_us", "max_us", "miss99_us");
+
+    for (int hz : rates)
+    {
+        int rx_fd = ssb::bind_udp("127.0.0.1", 0);
+        if (rx_fd < 0) return 1;
+
+        ssb::ControlCoreConfig cfg;
+        cfg.ingress_port = 0;
+        cfg.egress_port = ssb::bound_port(rx_fd);
+
+        ssb::ControlCore core;
+        if (!core.start(cfg)) return 1;
+
+        sockaddr_in ingress;
+        ssb::make_addr("127.0.0.1", core.ingress_port(), ingress);
+
+        ssb::Histogram lat;
+
+        std::atomic<bool> done{ false };
+        std::thread receiver([&]()
+            {
+                ssb::ControlPacket pkt;
+                uint8_t buf[ssb::CONTROL_PACKET_SIZE];
+                timeval tv{ 0, 100000 };
+                setsockopt(rx_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+                while (!done)
+                {
+                    ssize_t n = recv(rx_fd, buf, sizeof(buf), 0);
+                    uint64_t now = ssb::mono_ns();
+                    if (n > 0 && ssb::decode_control(buf, (size_t)n, pkt))
+                        lat.record(now - pkt.send_ns);
+                }
+            });
+
+        // ---- paced sender (absolute deadlines + calibrated spin) ----
+        int tx_fd = ssb::udp_socket();
+        uint64_t count = (uint64_t)(hz * seconds);
+        ssb::TickScheduler ticks(1000000000ull / hz, spin);
+        ssb::ControlPacket pkt{ 0, 0.6f, 0.0f, 0.0f, 0 };
+        uint8_t buf[ssb::CONTROL_PACKET_SIZE];
+
+        ticks.start();
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            ticks.wait();
+
+            pkt.seq++;
+            pkt.send_ns = ssb::mono_ns();
+            ssb::encode_control(pkt, buf);
+            sendto(tx_fd, buf, sizeof(buf), 0, (sockaddr*)&ingress, sizeof(ingress));
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        done = true;
+        receiver.join();
+        core.stop();
+        close(tx_fd);
+        close(rx_fd);
+
+        printf("%8d %9llu %9llu %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+            hz, (unsigned long long)count, (unsigned long long)lat.count(),
+            lat.percentile(50) / 1e3, lat.percentile(90) / 1e3, lat.percentile(99) / 1e3,
+            lat.percentile(99.9) / 1e3, lat.max() / 1e3, ticks.misses().percentile(99) / 1e3);
+    }
+    return 0;
+}
@@ -0,0 +1,277 @@
+// ssb_fragment_loss_test.cpp
+// Loss-injection harness for SSB fragmentation (include/ssb/fragment.h).
+// Large frames are split at the MTU; fragments are dropped, duplicated and
+// reordered at random before reassembly. Every delivered payload is checked
+// against the pattern of its own seq, and delivered seqs must strictly
+// increase per agent: a frame is only handed out if it is complete and
+// newer than everything handed out before it.
+//
+//   1. in-process: Fragmenter -> lossy reorder window -> Reassembler
+//   2. end to end: lossy sender -> MultiAgentCore (reassemble, publish,
+//      fragment again on egress) -> receiver Reassembler
+//
+// usage: ssb_fragment_loss_test [loss_pct] [payload_bytes] [gso 0|1] [gro 0|1]
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "ssb/fragment.h"
+#include "ssb/multi_agent_core.h"
+
+namespace
+{
+
+uint8_t pattern(uint32_t agent, uint64_t seq, size_t i)
+{
+    return (uint8_t)(seq * 131 + agent * 7 + i);
+}
+
+void fill(std::vector<uint8_t>& frame, uint32_t agent, uint64_t seq, size_t payload)
+{
+    ssb::FrameHeader h = ssb::make_header(ssb::FRAME_DATA, agent, seq, (uint32_t)payload);
+    frame.resize(ssb::FRAME_HEADER_SIZE + payload);
+    memcpy(frame.data(), &h, ssb::FRAME_HEADER_SIZE);
+    for (size_t i = 0; i < payload; ++i)
+        frame[ssb::FRAME_HEADER_SIZE + i] = pattern(agent, seq, i);
+}
+
+// Checks one delivered frame; tracks the newest seq per agent.
+struct Checker
+{
+    explicit Checker(uint32_t agents) : last(agents, -1) {}
+
+    void operator()(uint32_t agent, const uint8_t* frame, size_t len)
+    {
+        ssb::FrameHeader h;
+        memcpy(&h, frame, ssb::FRAME_HEADER_SIZE);
+        bool ok = agent == h.stream_id && !(h.flags & ssb::FRAME_FLAG_FRAGMENT) &&
+            len == ssb::FRAME_HEADER_SIZE + h.payload_len && (int64_t)h.seq > last[agent];
+        for (size_t i = 0; ok && i < h.payload_len; ++i)
+            ok = frame[ssb::FRAME_HEADER_SIZE + i] == pattern(agent, h.seq, i);
+        if (!ok) ++bad;
+        last[agent] = (int64_t)h.seq;
+        ++delivered;
+    }
+
+    std::vector<int64_t> last;
+    uint64_t delivered = 0;
+    uint64_t bad = 0;
+};
+
+// Flattens built messages into datagrams (what the wire would carry).
+void flatten(const std::vector<mmsghdr>& msgs, std::vector<std::vector<uint8_t>>& out)
+{
+    for (const mmsghdr& m : msgs)
+    {
+        std::vector<uint8_t> d;
+        for (size_t i = 0; i < m.msg_hdr.msg_iovlen; ++i)
+        {
+            const uint8_t* b = (const uint8_t*)m.msg_hdr.msg_iov[i].iov_base;
+            d.insert(d.end(), b, b + m.msg_hdr.msg_iov[i].iov_len);
+        }
+        out.push_back(std::move(d));
+    }
+}
+
+bool in_process(double loss, size_t payload)
+{
+    const uint32_t agents = 4;
+    const uint64_t frames = 4000;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> u(0.0, 1.0);
+
+    ssb::Fragmenter frag;
+    ssb::Reassembler reasm(agents, ssb::FRAME_HEADER_SIZE + payload);
+    Checker check(agents);
+
+    std::vector<uint8_t> frame;
+    std::vector<std::vector<uint8_t>> wire;
+    std::vector<mmsghdr> msgs;
+    uint64_t sent = 0, dropped = 0, intact = 0;
+
+    for (uint64_t seq = 0; seq < frames; ++seq)
+    {
+        uint32_t agent = (uint32_t)(seq % agents);
+        fill(frame, agent, seq, payload);
+
+        frag.reset();
+        msgs.clear();
+        frag.add(frame.data(), frame.size());
+        frag.build(msgs, nullptr, false);
+
+        std::vector<std::vector<uint8_t>> dgrams;
+        flatten(msgs, dgrams);
+        bool lost = false;
+        for (auto& d : dgrams)
+        {
+            ++sent;
+            if (u(rng) < loss) { ++dropped; lost = true; continue; }
+            wire.push_back(d);
+            if (u(rng) < 0.01) wire.push_back(d); // duplicate
+        }
+        intact += !lost;
+
+        // deliver in bursts, shuffled across neighbouring frames
+        if (seq % 3 == 2 || seq + 1 == frames)
+        {
+            for (size_t i = 0; i + 1 < wire.size(); ++i)
+                if (u(rng) < 0.2) std::swap(wire[i], wire[i + 1 + rng() % std::min<size_t>(8, wire.size() - i - 1)]);
+            for (auto& d : wire)
+                reasm.feed(d.data(), d.size(), check);
+            wire.clear();
+        }
+    }
+
+    printf("in-process: %llu frames, %u fragments each, %llu/%llu datagrams dropped\n",
+        (unsigned long long)frames, frag.datagrams(), (unsigned long long)dropped, (unsigned long long)sent);
+    printf("  intact %llu | delivered %llu | abandoned %llu | stale %llu | invalid %llu | corrupt/out-of-order %llu\n",
+        (unsigned long long)intact, (unsigned long long)check.delivered,
+        (unsigned long long)reasm.abandoned(), (unsigned long long)reasm.stale(),
+        (unsigned long long)reasm.invalid(), (unsigned long long)check.bad);
+    return check.bad == 0 && reasm.invalid() == 0 && check.delivered > 0 && check.delivered <= intact;
+}
+
+bool end_to_end(double loss, size_t payload, bool gso, bool gro)
+{
+    const uint32_t agents = 16;
+    const double tick_hz = 100.0;
+    const uint64_t ticks = 300;
+    const size_t max_frame = ssb::FRAME_HEADER_SIZE + payload;
+
+    int rx_fd = ssb::bind_udp("127.0.0.1", 0);
+    if (rx_fd < 0) return false;
+    ssb::set_socket_buffers(rx_fd, 64 << 20, 0);
+    bool rx_gro = gro && ssb::enable_gro(rx_fd);
+
+    ssb::MultiAgentConfig cfg;
+    cfg.ingress_port = 0;
+    cfg.egress_port = ssb::bound_port(rx_fd);
+    cfg.agents = agents;
+    cfg.max_datagram = max_frame;
+    cfg.tick_hz = tick_hz;
+    cfg.mtu = ssb::FRAGMENT_DEFAULT_MTU;
+    cfg.gso = gso;
+    cfg.gro = gro;
+
+    ssb::MultiAgentCore core;
+    if (!core.start(cfg)) return false;
+
+    sockaddr_in ingress;
+    ssb::make_addr("127.0.0.1", core.ingress_port(), ingress);
+
+    std::atomic<bool> done{ false };
+    Checker check(agents);
+    ssb::Reassembler reasm(agents, max_frame);
+    std::thread receiver([&]()
+        {
+            std::vector<uint8_t> buf(65535);
+            alignas(cmsghdr) char ctl[CMSG_SPACE(sizeof(int))];
+            timeval tv{ 0, 100000 };
+            setsockopt(rx_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            while (!done)
+            {
+                iovec iov{ buf.data(), buf.size() };
+                msghdr msg{};
+                msg.msg_iov = &iov;
+                msg.msg_iovlen = 1;
+                msg.msg_control = ctl;
+                msg.msg_controllen = sizeof(ctl);
+                ssize_t r = recvmsg(rx_fd, &msg, 0);
+                if (r <= 0) continue;
+
+                size_t gro_size = 0;
+                for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+                    if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO)
+                    {
+                        int seg;
+                        memcpy(&seg, CMSG_DATA(cm), sizeof(seg));
+                        gro_size = (size_t)seg;
+                    }
+                reasm.feed(buf.data(), (size_t)r, check, gro_size);
+            }
+        });
+
+    // ---- lossy sender: every agent once per tick ----
+    int tx_fd = ssb::udp_socket();
+    ssb::set_socket_buffers(tx_fd, 0, 64 << 20);
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<double> u(0.0, 1.0);
+
+    std::vector<std::vector<uint8_t>> frames(agents);
+    ssb::Fragmenter frag;
+    std::vector<mmsghdr> msgs, keep;
+    uint64_t sent = 0, dropped = 0;
+
+    uint64_t period = (uint64_t)(1e9 / tick_hz);
+    uint64_t next = ssb::mono_ns() + period;
+    for (uint64_t t = 0; t < ticks; ++t)
+    {
+        timespec ts{ (time_t)(next / 1000000000ull), (long)(next % 1000000000ull) };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+        next += period;
+
+        frag.reset();
+        msgs.clear();
+        for (uint32_t a = 0; a < agents; ++a)
+        {
+            fill(frames[a], a, t, payload);
+            frag.add(frames[a].data(), frames[a].size());
+        }
+        frag.build(msgs, &ingress, false);
+
+        keep.clear();
+        for (const mmsghdr& m : msgs)
+        {
+            ++sent;
+            if (u(rng) < loss) ++dropped;
+            else keep.push_back(m);
+        }
+        for (size_t off = 0; off < keep.size();)
+        {
+            int r = sendmmsg(tx_fd, keep.data() + off, (unsigned)(keep.size() - off), 0);
+            if (r <= 0) break;
+            off += (size_t)r;
+        }
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    done = true;
+    receiver.join();
+    core.stop();
+    close(tx_fd);
+    close(rx_fd);
+
+    const ssb::MultiAgentStats& st = core.stats();
+    const ssb::MultiAgentConfig& eff = core.config();
+    printf("end-to-end: %u agents x %llu ticks, %llu/%llu datagrams dropped (gso %d, gro %d/%d)\n",
+        agents, (unsigned long long)ticks, (unsigned long long)dropped, (unsigned long long)sent,
+        eff.gso, eff.gro, rx_gro);
+    printf("  core: fragments %llu | reassembled %llu | abandoned %llu | stale %llu | rejected %llu | sendmmsg %llu\n",
+        (unsigned long long)st.fragments.load(), (unsigned long long)st.reassembled.load(),
+        (unsigned long long)st.abandoned.load(), (unsigned long long)st.stale.load(),
+        (unsigned long long)st.rejected.load(), (unsigned long long)st.send_calls.load());
+    printf("  receiver: delivered %llu | abandoned %llu | invalid %llu | corrupt/out-of-order %llu\n",
+        (unsigned long long)check.delivered, (unsigned long long)reasm.abandoned(),
+        (unsigned long long)reasm.invalid(), (unsigned long long)check.bad);
+    return check.bad == 0 && reasm.invalid() == 0 && st.rejected.load() == 0 && check.delivered > 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    double loss = ((argc > 1) ? atof(argv[1]) : 2.0) / 100.0;
+    size_t payload = (argc > 2) ? (size_t)atoll(argv[2]) : 32768;
+    bool gso = (argc > 3) && atoi(argv[3]) != 0;
+    bool gro = (argc > 4) && atoi(argv[4]) != 0;
+
+    bool a = in_process(loss, payload);
+    bool b = end_to_end(loss, payload, gso, gro);
+    printf("%s\n", a && b ? "PASS" : "FAIL");
+    return a && b ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+// ssb_multi_agent_bench.cpp
+// Syscalls per tick of the batched multi-agent core at 1..1024 agents.
+// A sender emits one SSB frame per agent per sim tick (one sendmmsg), the
+// core forwards latest-only, and a receiver counts what arrives.
+//
+// usage: ssb_multi_agent_bench [seconds_per_run] [payload_bytes] [tick_hz]
+#include <time.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "ssb/clock.h"
+#include "ssb/multi_agent_core.h"
+
+int main(int argc, char** argv)
+{
+    double seconds = (argc > 1) ? atof(argv[1]) : 5.0;
+    size_t payload = (argc > 2) ? (size_t)atoll(argv[2]) : 32768;
+    double tick_hz = (argc > 3) ? atof(argv[3]) : 20.0;
+    const uint32_t agent_counts[] = { 1, 16, 128, 1024 };
+
+    if (ssb::FRAME_HEADER_SIZE + payload > 65507)
+    {
+        printf("payload too large for one UDP datagram\n");
+        return 1;
+    }
+
+    printf("payload %zu B | %.0f Hz\n", payload, tick_hz);
+    printf("%7s %10s %10s %12s %12s %12s %10s\n",
+        "agents", "rx/tick", "fwd/tick", "recvmmsg/t", "sendmmsg/t", "naive_sc/t", "delivered");
+
+    for (uint32_t agents : agent_counts)
+    {
+        int rx_fd = ssb::bind_udp("127.0.0.1", 0);
+        if (rx_fd < 0) return 1;
+        ssb::set_socket_buffers(rx_fd, 256 << 20, 0);
+
+        ssb::MultiAgentConfig cfg;
+        cfg.ingress_port = 0;
+        cfg.egress_port = ssb::bound_port(rx_fd);
+        cfg.agents = agents;
+        cfg.max_datagram = ssb::FRAME_HEADER_SIZE + payload;
+        cfg.tick_hz = tick_hz;
+        cfg.socket_buffer = 256 << 20;
+
+        ssb::MultiAgentCore core;
+        if (!core.start(cfg)) return 1;
+
+        sockaddr_in ingress;
+        ssb::make_addr("127.0.0.1", core.ingress_port(), ingress);
+
+        std::atomic<bool> done{ false };
+        std::atomic<uint64_t> delivered{ 0 };
+        std::thread receiver([&]()
+            {
+                std::vector<uint8_t> buf(cfg.max_datagram);
+                timeval tv{ 0, 100000 };
+                setsockopt(rx_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+                while (!done)
+                    if (recv(rx_fd, buf.data(), buf.size(), 0) > 0)
+                        delivered.fetch_add(1, std::memory_order_relaxed);
+            });
+
+        // ---- sender: every agent once per tick, one sendmmsg ----
+        int tx_fd = ssb::udp_socket();
+        ssb::set_socket_buffers(tx_fd, 0, 256 << 20);
+
+        std::vector<ssb::FrameHeader> hdrs(agents);
+        std::vector<uint8_t> body(payload, 0x5a);
+        std::vector<iovec> iov(agents * 2);
+        std::vector<mmsghdr> msgs(agents);
+
+        uint64_t period = (uint64_t)(1e9 / tick_hz);
+        uint64_t ticks = (uint64_t)(seconds * tick_hz);
+        uint64_t next = ssb::mono_ns() + period;
+        for (uint64_t t = 0; t < ticks; ++t)
+        {
+            timespec ts{ (time_t)(next / 1000000000ull), (long)(next % 1000000000ull) };
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+            next += period;
+
+            for (uint32_t a = 0; a < agents; ++a)
+            {
+                hdrs[a] = ssb::make_header(ssb::FRAME_CONTROL, a, t, (uint32_t)payload);
+                iov[a * 2] = { &hdrs[a], ssb::FRAME_HEADER_SIZE };
+                iov[a * 2 + 1] = { body.data(), payload };
+                msgs[a].msg_hdr = msghdr{};
+                msgs[a].msg_hdr.msg_name = &ingress;
+                msgs[a].msg_hdr.msg_namelen = sizeof(ingress);
+                msgs[a].msg_hdr.msg_iov = &iov[a * 2];
+                msgs[a].msg_hdr.msg_iovlen = 2;
+            }
+            for (uint32_t sent = 0; sent < agents;)
+            {
+                int r = sendmmsg(tx_fd, msgs.data() + sent, agents - sent, 0);
+                if (r <= 0) break;
+                sent += (uint32_t)r;
+            }
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds((int)(2000 / tick_hz) + 100));
+        done = true;
+        receiver.join();
+        core.stop();
+        close(tx_fd);
+        close(rx_fd);
+
+        const ssb::MultiAgentStats& st = core.stats();
+        double nt = st.ticks.load() ? (double)st.ticks.load() : 1.0;
+        printf("%7u %10.1f %10.1f %12.2f %12.2f %12.1f %10llu\n",
+            agents,
+            st.datagrams.load() / nt,
+            st.forwarded.load() / nt,
+            st.recv_calls.load() / nt,
+            st.send_calls.load() / nt,
+            (st.datagrams.load() + st.forwarded.load()) / nt,
+            (unsigned long long)delivered.load());
+    }
+    return 0;
+}
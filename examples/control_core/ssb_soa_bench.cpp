@@ -0,0 +1,243 @@
+// ssb_soa_bench.cpp
+// One controller tick over N agents' commands, as received: FRAME_BATCH
+// frames (ssb/coalescer.h) of 24-byte ControlSchema records. The tick
+// finds the oldest command, counts seq gaps and moves each agent's
+// throttle/steer/brake toward its clamped command, at most MAX_STEP per
+// tick (actuator slew limiting).
+//
+//   aos      for_each_batched + decode_control, one struct at a time
+//   soa      ControlColumns (ssb/schema.h) filled per frame, then one loop
+//            per column; once with the portable gather, once with AVX2.
+//            When the agents arrive in order (every agent sent this tick)
+//            the columns line up with the agent state and the loops are
+//            plain array loops the compiler vectorizes.
+//
+// All modes must produce the same result; the bench checks that.
+//
+// usage: ssb_soa_bench [ticks] [max_batch_bytes]
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "ssb/clock.h"
+#include "ssb/coalescer.h"
+#include "ssb/control_packet.h"
+
+namespace
+{
+
+// What the controller keeps per agent.
+struct AgentState
+{
+    std::vector<uint32_t> last_seq;
+    std::vector<float> throttle, steer, brake;
+
+    explicit AgentState(uint32_t agents) : last_seq(agents, 0), throttle(agents), steer(agents), brake(agents) {}
+};
+
+struct TickResult
+{
+    uint64_t oldest_ns = 0;
+    uint64_t gaps = 0;
+    double checksum = 0;
+
+    bool operator==(const TickResult& o) const
+    {
+        return oldest_ns == o.oldest_ns && gaps == o.gaps && checksum == o.checksum;
+    }
+};
+
+constexpr float MAX_STEP = 0.05f;
+
+float clampf(float v, float lo, float hi) { return std::min(std::max(v, lo), hi); }
+
+// Moves `cur` toward the clamped command by at most MAX_STEP.
+float slew(float cur, float cmd, float lo, float hi)
+{
+    return cur + clampf(clampf(cmd, lo, hi) - cur, -MAX_STEP, MAX_STEP);
+}
+
+TickResult tick_aos(const std::vector<std::vector<uint8_t>>& frames, AgentState& st)
+{
+    TickResult r;
+    uint64_t oldest = UINT64_MAX;
+    for (const auto& f : frames)
+    {
+        ssb::for_each_batched(f.data() + ssb::FRAME_HEADER_SIZE, f.size() - ssb::FRAME_HEADER_SIZE,
+            [&](uint32_t agent, const uint8_t* rec, size_t len)
+            {
+                ssb::ControlPacket p;
+                if (!ssb::decode_control(rec, len, p)) return;
+                oldest = std::min(oldest, p.send_ns);
+                r.gaps += (p.seq - st.last_seq[agent]) > 1;
+                st.last_seq[agent] = p.seq;
+                st.throttle[agent] = slew(st.throttle[agent], p.throttle, 0.0f, 1.0f);
+                st.steer[agent] = slew(st.steer[agent], p.steer, -1.0f, 1.0f);
+                st.brake[agent] = slew(st.brake[agent], p.brake, 0.0f, 1.0f);
+            });
+    }
+    r.oldest_ns = oldest;
+    return r;
+}
+
+// index[i] == i: what a batch looks like when its agents arrived in order
+const std::vector<uint16_t>& identity_index()
+{
+    static std::vector<uint16_t> iota = []()
+    {
+        std::vector<uint16_t> v(0x10000);
+        for (size_t i = 0; i < v.size(); ++i) v[i] = (uint16_t)i;
+        return v;
+    }();
+    return iota;
+}
+
+TickResult tick_soa(const std::vector<std::vector<uint8_t>>& frames, AgentState& st, ssb::ControlColumns& c,
+    std::vector<uint32_t>& agent)
+{
+    TickResult r;
+    c.clear();
+    bool dense = true; // agents arrived in order with no holes
+    uint32_t first = 0;
+    for (const auto& f : frames)
+    {
+        ssb::BatchView v;
+        if (!ssb::parse_batch(f.data() + ssb::FRAME_HEADER_SIZE, f.size() - ssb::FRAME_HEADER_SIZE, v) ||
+            v.record_size != ssb::CONTROL_PACKET_SIZE)
+            continue;
+        size_t at = c.size();
+        size_t n = c.decode(v.records, v.record_size, v.count);
+        if (!at) first = v.agent(0);
+        if (dense && v.agent(0) == first + at && !memcmp(v.index, identity_index().data(), n * sizeof(uint16_t)))
+            continue;
+        if (dense)
+        {
+            for (size_t i = 0; i < at; ++i) agent[i] = first + (uint32_t)i;
+            dense = false;
+        }
+        for (uint32_t i = 0; i < n; ++i) agent[at + i] = v.agent(i);
+    }
+
+    const size_t n = c.size();
+    const float* __restrict thr = c.col<ssb::CTRL_THROTTLE>();
+    const float* __restrict steer = c.col<ssb::CTRL_STEER>();
+    const float* __restrict brake = c.col<ssb::CTRL_BRAKE>();
+    const uint64_t* __restrict send_ns = c.col<ssb::CTRL_SEND_NS>();
+    const uint32_t* __restrict seq = c.col<ssb::CTRL_SEQ>();
+
+    uint64_t oldest = UINT64_MAX;
+    for (size_t i = 0; i < n; ++i) oldest = std::min(oldest, send_ns[i]);
+    r.oldest_ns = oldest;
+
+    if (dense && n)
+    {
+        // the columns line up with a contiguous run of agents
+        const size_t a0 = first;
+        uint32_t* __restrict last = st.last_seq.data() + a0;
+        float* __restrict t = st.throttle.data() + a0;
+        float* __restrict s = st.steer.data() + a0;
+        float* __restrict b = st.brake.data() + a0;
+        uint64_t gaps = 0;
+        for (size_t i = 0; i < n; ++i) gaps += (seq[i] - last[i]) > 1;
+        r.gaps = gaps;
+        memcpy(last, seq, n * sizeof(uint32_t));
+        for (size_t i = 0; i < n; ++i) t[i] = slew(t[i], thr[i], 0.0f, 1.0f);
+        for (size_t i = 0; i < n; ++i) s[i] = slew(s[i], steer[i], -1.0f, 1.0f);
+        for (size_t i = 0; i < n; ++i) b[i] = slew(b[i], brake[i], 0.0f, 1.0f);
+        return r;
+    }
+    for (size_t i = 0; i < n; ++i)
+    {
+        uint32_t a = agent[i];
+        r.gaps += (seq[i] - st.last_seq[a]) > 1;
+        st.last_seq[a] = seq[i];
+        st.throttle[a] = slew(st.throttle[a], thr[i], 0.0f, 1.0f);
+        st.steer[a] = slew(st.steer[a], steer[i], -1.0f, 1.0f);
+        st.brake[a] = slew(st.brake[a], brake[i], 0.0f, 1.0f);
+    }
+    return r;
+}
+
+double checksum(const AgentState& st)
+{
+    double s = 0;
+    for (size_t a = 0; a < st.last_seq.size(); ++a)
+        s += st.last_seq[a] + st.throttle[a] * 3.0 + st.steer[a] * 5.0 + st.brake[a] * 7.0;
+    return s;
+}
+
+// The frames a controller receives for one tick of `agents` commands.
+std::vector<std::vector<uint8_t>> make_tick(uint32_t agents, size_t max_bytes, uint32_t tick)
+{
+    std::vector<std::vector<uint8_t>> frames;
+    ssb::Coalescer co(agents, ssb::CONTROL_PACKET_SIZE, max_bytes);
+    auto emit = [&](const uint8_t* f, size_t len) { frames.emplace_back(f, f + len); };
+    uint64_t now = ssb::mono_ns();
+    for (uint32_t a = 0; a < agents; ++a)
+    {
+        // every 7th agent skipped a command; values run slightly out of range
+        ssb::ControlPacket p{ tick * 2 + (a % 7 == 0), 1.2f - (a % 13) * 0.1f, (a % 21) * 0.1f - 1.05f,
+            (a % 5) * 0.3f, now - (a * 37u) % 5000u };
+        uint8_t rec[ssb::CONTROL_PACKET_SIZE];
+        ssb::encode_control(p, rec);
+        co.add(a, rec, now, emit);
+    }
+    co.tick(emit);
+    return frames;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    uint32_t ticks = (argc > 1) ? (uint32_t)atoi(argv[1]) : 20000;
+    size_t max_bytes = (argc > 2) ? (size_t)atoll(argv[2]) : ssb::COALESCE_MAX_BYTES;
+    const uint32_t agent_counts[] = { 128, 1024 };
+
+    printf("ControlSchema %s, %zu B | batches up to %zu B | %u ticks\n",
+        ssb::ControlSchema::FORMAT.data(), ssb::CONTROL_PACKET_SIZE, max_bytes, ticks);
+    printf("%7s %7s %7s %10s %10s %8s\n", "agents", "frames", "mode", "ns/tick", "ns/cmd", "same");
+
+    bool all_ok = true;
+    for (uint32_t agents : agent_counts)
+    {
+        // two alternating ticks, so every tick sees fresh seqs
+        std::vector<std::vector<uint8_t>> tick[2] = { make_tick(agents, max_bytes, 1), make_tick(agents, max_bytes, 2) };
+
+        struct Mode { const char* name; bool soa; ssb::Isa isa; };
+        std::vector<Mode> modes = { { "aos", false, ssb::Isa::Scalar }, { "soa", true, ssb::Isa::Scalar } };
+        if (ssb::isa_supported(ssb::Isa::Avx2)) modes.push_back({ "soa-avx2", true, ssb::Isa::Avx2 });
+
+        TickResult ref;
+        double ref_sum = 0;
+        for (size_t m = 0; m < modes.size(); ++m)
+        {
+            AgentState st(agents);
+            ssb::ControlColumns cols(agents);
+            cols.set_isa(modes[m].isa);
+            std::vector<uint32_t> agent(agents);
+
+            TickResult first;
+            uint64_t t0 = ssb::mono_ns();
+            for (uint32_t t = 0; t < ticks; ++t)
+            {
+                TickResult r = modes[m].soa ? tick_soa(tick[t & 1], st, cols, agent) : tick_aos(tick[t & 1], st);
+                if (t == 1) first = r;
+            }
+            uint64_t ns = ssb::mono_ns() - t0;
+            first.checksum = checksum(st);
+
+            if (m == 0)
+            {
+                ref = first;
+                ref_sum = first.checksum;
+            }
+            bool same = first == ref && first.checksum == ref_sum;
+            all_ok &= same;
+            printf("%7u %7zu %8s %9.0f %10.2f %8s\n", agents, tick[0].size(), modes[m].name,
+                (double)ns / ticks, (double)ns / ticks / agents, same ? "yes" : "NO");
+        }
+    }
+    return all_ok ? 0 : 1;
+}
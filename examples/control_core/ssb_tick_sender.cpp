@@ -0,0 +1,65 @@
+// ssb_tick_sender.cpp
+// Native counterpart of single_agent_v1/ssb_core_test_sender.py (which
+// stays frozen): sends the 24-byte control packet at a fixed rate, paced
+// by ssb::TickScheduler instead of time.sleep(period), and reports how far
+// each send missed its tick.
+//
+// usage: ssb_tick_sender [hz] [seconds] [host] [port]
+#include <cstdio>
+#include <cstdlib>
+
+#include "ssb/control_packet.h"
+#include "ssb/tick_scheduler.h"
+#include "ssb/udp.h"
+
+int main(int argc, char** argv)
+{
+    int hz = (argc > 1) ? atoi(argv[1]) : 100;
+    double seconds = (argc > 2) ? atof(argv[2]) : 0.0;     // 0 = until killed
+    const char* host = (argc > 3) ? argv[3] : "127.0.0.1";
+    int port = (argc > 4) ? atoi(argv[4]) : 5060;
+    if (hz <= 0) hz = 100;
+
+    sockaddr_in target;
+    int fd = ssb::udp_socket();
+    if (fd < 0 || !ssb::make_addr(host, port, target))
+    {
+        printf("[SENDER] bad target %s:%d\n", host, port);
+        return 1;
+    }
+
+    ssb::TickScheduler ticks(1000000000ull / hz);
+    uint64_t spin = ticks.calibrate();
+    printf("[SENDER] Sending @ %d Hz -> %s:%d (spin %.1f us)\n", hz, host, port, spin / 1e3);
+
+    ssb::ControlPacket pkt{ 0, 0.6f, 0.0f, 0.0f, 0 };
+    uint8_t buf[ssb::CONTROL_PACKET_SIZE];
+
+    uint64_t skipped = 0;
+    const uint64_t report_every = (uint64_t)hz * 5;
+    const uint64_t count = seconds > 0 ? (uint64_t)(hz * seconds) : UINT64_MAX;
+
+    ticks.start();
+    for (uint64_t i = 1; i <= count; ++i)
+    {
+        ticks.wait();
+
+        pkt.seq++;
+        pkt.send_ns = ssb::TickScheduler::now();
+        ssb::encode_control(pkt, buf);
+        sendto(fd, buf, sizeof(buf), 0, (sockaddr*)&target, sizeof(target));
+
+        if (i % report_every == 0)
+        {
+            char pct[160];
+            ticks.misses().format(pct, sizeof(pct), 1e3);
+            printf("[SENDER] seq %u | miss us %s | skipped %llu\n",
+                pkt.seq, pct, (unsigned long long)(ticks.skipped() - skipped));
+            skipped = ticks.skipped();
+            ticks.misses().reset();
+        }
+    }
+
+    close(fd);
+    return 0;
+}
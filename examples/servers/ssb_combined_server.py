@@ -4,6 +4,13 @@ HOST = "127.0.0.1"
 CMD, DATA = 5050, 5051
 duration = float(sys.argv[1]) if len(sys.argv) > 1 else 3600.0  # seconds
 
+# SSB frame header (include/ssb/frame.h):
+# magic, version, type, flags, stream_id, payload_len, seq, timestamp_ns
+SSB_HDR_FMT = "<IBBHIIQQ"
+SSB_HDR_SIZE = struct.calcsize(SSB_HDR_FMT)
+SSB_MAGIC = 0x31425353
+SSB_FRAME_RESUME = 6  # client reconnected; seq is the next one it sends (include/ssb/resume.h)
+
 def listen(port):
     s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
     s.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
@@ -32,32 +39,69 @@ while True:
         total_bytes = 0
         last_id = -1
         lost = 0
-        pings = 0
+        units = 0
+
+        def count_frame(pkt):
+            global last_id, lost
+            if last_id >= 0 and pkt != last_id + 1:
+                lost += (pkt - last_id - 1)
+            last_id = pkt
 
         def data_loop():
-            global total_bytes, last_id, lost, stop
+            global total_bytes, stop, last_id
             data.settimeout(0.5)
-            buf = b""
+            # one receive buffer for the whole session: headers are parsed in
+            # place with unpack_from and payloads are skipped, never copied
+            buf = bytearray(1 << 20)
+            view = memoryview(buf)
+            have = 0   # unparsed bytes at the front of buf
+            skip = 0   # payload bytes of the current frame still to come
             PACKET_SIZE = 65536
             HEADER_SIZE = 4
+            framed = None  # decided from the first 4 bytes
 
             while not stop:
                 try:
-                    chunk = data.recv(65536)
-                    if not chunk:
+                    n = data.recv_into(view[have:])
+                    if not n:
                         break
-                    buf += chunk
-
-                    while len(buf) >= PACKET_SIZE:
-                        frame = buf[:PACKET_SIZE]
-                        buf = buf[PACKET_SIZE:]
-                        total_bytes += len(frame)
-
-                        if len(frame) >= HEADER_SIZE:
-                            pkt = struct.unpack('<I', frame[:HEADER_SIZE])[0]
-                            if last_id >= 0 and pkt != last_id + 1:
-                                lost += (pkt - last_id - 1)
-                            last_id = pkt
+                    end = have + n
+                    pos = min(skip, end)
+                    skip -= pos
+                    total_bytes += pos
+
+                    if framed is None and end - pos >= 4:
+                        framed = struct.unpack_from('<I', buf, pos)[0] == SSB_MAGIC
+
+                    if framed:
+                        # SSB frame: 32-byte header + payload_len bytes
+                        while not skip and end - pos >= SSB_HDR_SIZE:
+                            magic, ver, ftype, flags, stream, plen, seq, ts = \
+                                struct.unpack_from(SSB_HDR_FMT, buf, pos)
+                            if magic != SSB_MAGIC:
+                                raise ValueError("bad frame magic")
+                            take = min(plen, end - pos - SSB_HDR_SIZE)
+                            pos += SSB_HDR_SIZE + take
+                            skip = plen - take
+                            total_bytes += SSB_HDR_SIZE + take
+                            if ftype == SSB_FRAME_RESUME:
+                                # a resumed stream: the jump is a reconnect, not loss
+                                last_id = seq - 1
+                            else:
+                                count_frame(seq)
+                    elif framed is not None:
+                        # legacy: fixed 64 KB buffers with a 4-byte counter
+                        while not skip and end - pos >= HEADER_SIZE:
+                            count_frame(struct.unpack_from('<I', buf, pos)[0])
+                            take = min(PACKET_SIZE - HEADER_SIZE, end - pos - HEADER_SIZE)
+                            pos += HEADER_SIZE + take
+                            skip = PACKET_SIZE - HEADER_SIZE - take
+                            total_bytes += HEADER_SIZE + take
+
+                    # keep a header that straddles two reads (< 32 bytes)
+                    have = end - pos
+                    if have:
+                        buf[:have] = view[pos:end]
 
                 except socket.timeout:
                     pass
@@ -71,16 +115,19 @@ while True:
         t.start()
 
         cmd.settimeout(0.5)
+        ping = bytearray(4096)
+        echoed = 0
         start = time.time()
         last_print = start
         fast_until = start + 60.0
 
         while time.time() - start < duration:
             try:
-                d = cmd.recv(8)
-                if not d: break
-                cmd.sendall(d)
-                pings += 1
+                n = cmd.recv_into(ping)
+                if not n: break
+                cmd.sendall(memoryview(ping)[:n])
+                echoed += n
+                units = echoed // 8  # 8-byte units echoed: pings, probes (two each), sync frames
             except socket.timeout:
                 pass
             except Exception as e:
@@ -93,12 +140,12 @@ while True:
             if elapsed < 60 and now - last_print >= 5.0:
                 rate = (total_bytes / 1e9) / elapsed if elapsed > 0 else 0.0
                 print(f"[Combined] {elapsed/60:5.1f} min | {total_bytes/1e9:8.2f} GB | "
-                    f"{rate:5.2f} GB/s | pings {pings} | lost {lost}")
+                    f"{rate:5.2f} GB/s | echoed {units} x 8 B | lost {lost}")
                 last_print = now
             elif minutes > 0 and minutes != int((last_print - start) // 60):
                 rate = (total_bytes / 1e9) / elapsed if elapsed > 0 else 0.0
                 print(f"[Combined] {minutes:2d}.0 min | {total_bytes/1e9:8.2f} GB | "
-                    f"{rate:5.2f} GB/s | pings {pings} | lost {lost}")
+                    f"{rate:5.2f} GB/s | echoed {units} x 8 B | lost {lost}")
                 last_print = now
 
         stop = True
@@ -108,7 +155,7 @@ while True:
         finally:
             total_pkts = (last_id + 1) if last_id >= 0 else 0
             loss_pct = (lost / total_pkts * 100.0) if total_pkts else 0.0
-            print(f"[Combined] done {total_bytes/1e9:.2f} GB, pings {pings}, lost {lost} pkts ({loss_pct:.6f}%)")
+            print(f"[Combined] done {total_bytes/1e9:.2f} GB, echoed {units} x 8 B, lost {lost} pkts ({loss_pct:.6f}%)")
 
             one_shot = True
             if one_shot:
@@ -16,19 +16,22 @@ print("[Latency] skip data socket (5051)")
 cmd.sendall(b"L")
 
 cmd.settimeout(0.5)
-start = time.time(); last = start; n = 0
+ping = bytearray(4096)
+view = memoryview(ping)
+start = time.time(); last = start; n = 0; echoed = 0
 while time.time() - start < 30:
     try:
-        d = cmd.recv(8)
-        if not d:
+        got = cmd.recv_into(ping)
+        if not got:
             break
-        cmd.sendall(d)
-        n += 1
+        cmd.sendall(view[:got])
+        echoed += got
+        n = echoed // 8  # 8-byte units echoed: a 16-byte probe is two
         if time.time() - last > 5:
-            print(f"[Latency] {n} pings")
+            print(f"[Latency] echoed {n} x 8 B")
             last = time.time()
     except socket.timeout:
         pass
 
 cmd.close()
-print("[Latency] done", n, "pings")
+print(f"[Latency] done, echoed {n} x 8 B")
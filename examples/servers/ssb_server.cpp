@@ -0,0 +1,566 @@
+// ssb_server.cpp
+// Native reference server for the 'L' / 'T' / 'E' / 'C' / 'S' command protocol
+// on 5050/5051, so client benchmarks measure SSB rather than CPython.
+// Each accepted connection gets its own worker thread: the cmd worker
+// echoes 8-byte pings and answers clock sync requests (ssb/clock_sync.h)
+// with its own timestamps, the data worker parses the stream in place out of
+// one reusable receive buffer (no per-frame copies or reallocation) and
+// does the same loss accounting as ssb_combined_server.py: SSB frame seq
+// when the stream starts with the frame magic, otherwise the 4-byte
+// counter at the front of every fixed-size legacy packet. A framed stream
+// that opens with FRAME_RESUME (ssb/resume.h) is a client coming back:
+// accounting carries on at the resumed seq, and the frames that died with
+// the old connection are reported as a reconnect gap, not as loss. Frames
+// that carry a CRC32C trailer (ssb/checksum.h) are verified on the way
+// through; the checksum policy says whether a mismatch is only counted or
+// closes the data connection. Frames stamped in this server's clock
+// (FRAME_FLAG_PEER_TIME, a client running clock sync on cmd) have their
+// one-way age recorded in the data block's latency histogram. 'S' is the
+// striped bulk mode (ssb/stripe.h): K data connections, one pinned
+// receiver thread each, messages reassembled in place.
+// Counters live in per-thread blocks of /dev/shm/ssb-stats.server
+// (ssb/metrics.h); watch them live with ssb_stats server.
+//
+// usage: ssb_server [L|T|E|C|S] [duration_s] [legacy_packet_bytes] [loop|once] [cmd_port]
+//                   [off|count|fail|require]
+// (data is cmd_port + 1; checksum policy defaults to count)
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ssb/checksum.h"
+#include "ssb/clock_sync.h"
+#include "ssb/frame.h"
+#include "ssb/metrics.h"
+#include "ssb/resume.h"
+#include "ssb/session.h"
+#include "ssb/stripe.h"
+
+namespace
+{
+
+// One session's view of the stats page: each worker claims its own block
+// and publishes the pointer here for the reporter. With the page full (or
+// absent) a worker counts in this session's private block instead; only
+// ssb_stats loses sight of it.
+struct Stats
+{
+    Stats(ssb::StatsPage& p, const ssb::ResumeTable& r) : page(p), resumes(r) {}
+
+    ssb::StatsPage& page;
+    const ssb::ResumeTable& resumes;   // previous sessions, read-only while one runs
+    std::atomic<ssb::ThreadMetrics*> data{ nullptr };
+    std::atomic<ssb::ThreadMetrics*> cmd{ nullptr };
+    std::atomic<const ssb::StripeReceiver*> stripes{ nullptr };
+    std::atomic<int64_t> last_id{ -1 };
+    // set by the data worker from the stream's FRAME_RESUME
+    std::atomic<uint64_t> token{ 0 };
+    std::atomic<uint32_t> stream{ 0 };
+    std::atomic<uint32_t> reconnects{ 0 };
+    std::atomic<int64_t> resume_gap{ -1 };  // frames lost in the break, -1 if unknown
+    std::atomic<uint64_t> rewinds{ 0 };     // seq went back or repeated; not loss
+    ssb::ThreadMetrics own_data{};
+    ssb::ThreadMetrics own_cmd{};
+
+    ssb::ThreadMetrics* claim(const char* name, ssb::ThreadMetrics& own)
+    {
+        ssb::ThreadMetrics* m = page.register_thread(name);
+        return m ? m : &own;
+    }
+    void release(ssb::ThreadMetrics* m)
+    {
+        if (m != &own_data && m != &own_cmd) page.release(m);
+    }
+
+    static uint64_t get(const std::atomic<ssb::ThreadMetrics*>& t, ssb::Metric m)
+    {
+        const ssb::ThreadMetrics* p = t.load(std::memory_order_acquire);
+        return p ? p->get(m) : 0;
+    }
+    uint64_t bytes() const
+    {
+        const ssb::StripeReceiver* s = stripes.load(std::memory_order_acquire);
+        return get(data, ssb::METRIC_BYTES_RX) + (s ? s->bytes() : 0);
+    }
+    uint64_t lost() const { return get(data, ssb::METRIC_DROPS); }
+    // one-way age of peer-stamped data frames, ns
+    const ssb::Histogram* age() const
+    {
+        const ssb::ThreadMetrics* p = data.load(std::memory_order_acquire);
+        return p && p->latency.count() ? &p->latency : nullptr;
+    }
+    // 8-byte units echoed on cmd; clients send 8-byte pings, 16-byte
+    // probes or sync frames, and the server cannot tell which
+    uint64_t echo_units() const { return get(cmd, ssb::METRIC_FRAMES_RX); }
+};
+
+// Streaming parser: consumes whatever recv() returned, keeps only the few
+// header/counter bytes that straddle two reads, and never buffers
+// payloads, so frames of any size cost one pass over the bytes. Framed
+// streams are parsed whenever checksums are on, in every mode; `account`
+// only decides whether seq gaps and resumes are counted.
+class StreamParser
+{
+public:
+    StreamParser(Stats& st, ssb::ThreadMetrics& m, bool account, size_t legacy_packet, ssb::ChecksumPolicy policy)
+        : st_(st), m_(m), account_(account), legacy_packet_(legacy_packet), checker_(policy)
+    {
+    }
+
+    // false on a corrupt frame header, or a frame the checksum policy
+    // rejects (checksum_failed()); recv_ns is when the bytes were read
+    bool feed(const uint8_t* p, size_t n, uint64_t recv_ns)
+    {
+        m_.add(ssb::METRIC_BYTES_RX, n);
+        recv_ns_ = recv_ns;
+        if (!account_ && checker_.policy() == ssb::ChecksumPolicy::Off) return true;
+
+        while (n)
+        {
+            if (mode_ == Mode::Unknown)
+            {
+                size_t take = std::min(n, (size_t)4 - probe_got_);
+                memcpy(probe_ + probe_got_, p, take);
+                probe_got_ += take;
+                p += take;
+                n -= take;
+                if (probe_got_ < 4) return true;
+
+                uint32_t magic;
+                memcpy(&magic, probe_, 4);
+                mode_ = (magic == ssb::FRAME_MAGIC) ? Mode::Framed : Mode::Legacy;
+                if (mode_ == Mode::Legacy && checker_.policy() == ssb::ChecksumPolicy::Require)
+                {
+                    checksum_failed_ = true;
+                    return false;
+                }
+                // replay the probed bytes through the chosen parser
+                if (!consume(probe_, 4)) return false;
+                continue;
+            }
+            return consume(p, n);
+        }
+        return true;
+    }
+
+    bool checksum_failed() const { return checksum_failed_; }
+    uint64_t failed_seq() const { return failed_seq_; }
+    const ssb::FrameChecker& checker() const { return checker_; }
+
+private:
+    enum class Mode { Unknown, Framed, Legacy };
+
+    bool consume(const uint8_t* p, size_t n)
+    {
+        if (mode_ == Mode::Framed) return consume_framed(p, n);
+        return account_ ? consume_legacy(p, n) : true;  // nothing to verify
+    }
+
+    bool consume_framed(const uint8_t* p, size_t n)
+    {
+        while (n)
+        {
+            if (resume_got_ < resume_need_)
+            {
+                size_t take = std::min(n, resume_need_ - resume_got_);
+                memcpy(resume_ + resume_got_, p, take);
+                resume_got_ += take;
+                p += take;
+                n -= take;
+                if (resume_got_ == resume_need_) resumed();
+                continue;
+            }
+            if (skip_)
+            {
+                size_t take = std::min<uint64_t>(n, skip_);
+                checker_.update(p, take);
+                skip_ -= take;
+                p += take;
+                n -= take;
+                if (!skip_ && !frame_done()) return false;
+                continue;
+            }
+
+            size_t take = std::min(n, ssb::FRAME_HEADER_SIZE - hdr_got_);
+            memcpy(hdr_ + hdr_got_, p, take);
+            hdr_got_ += take;
+            p += take;
+            n -= take;
+            if (hdr_got_ < ssb::FRAME_HEADER_SIZE) break;
+
+            ssb::FrameHeader h;
+            memcpy(&h, hdr_, ssb::FRAME_HEADER_SIZE);
+            hdr_got_ = 0;
+            if (!ssb::header_valid(h)) return false;
+            if (h.type == ssb::FRAME_RESUME && h.payload_len == sizeof(ssb::ResumeRecord))
+            {
+                resume_hdr_ = h;
+                resume_got_ = 0;
+                resume_need_ = sizeof(ssb::ResumeRecord);
+                continue;
+            }
+            checker_.begin(h);
+            seq_ = h.seq;
+            age_ns_ = !(h.flags & ssb::FRAME_FLAG_PEER_TIME) ? -1
+                : recv_ns_ > h.timestamp_ns ? (int64_t)(recv_ns_ - h.timestamp_ns) : 0;
+            skip_ = h.payload_len;
+            if (!skip_ && !frame_done()) return false;
+        }
+        return true;
+    }
+
+    // The whole payload has gone past: settle the checksum, then count the
+    // frame. A frame that failed its checksum is not counted even where the
+    // policy goes on, so a corrupt seq or timestamp never moves the loss
+    // count or the age histogram.
+    bool frame_done()
+    {
+        ssb::ChecksumResult r = checker_.finish();
+        if (r == ssb::ChecksumResult::Bad)
+            m_.add(ssb::METRIC_CHECKSUM_BAD);
+        else
+        {
+            count(seq_);
+            if (age_ns_ >= 0) m_.latency.record((uint64_t)age_ns_);
+        }
+        if (checker_.accept(r)) return true;
+        checksum_failed_ = true;
+        failed_seq_ = seq_;
+        return false;
+    }
+
+    bool consume_legacy(const uint8_t* p, size_t n)
+    {
+        while (n)
+        {
+            if (pkt_off_ < 4)
+            {
+                size_t take = std::min(n, (size_t)4 - pkt_off_);
+                memcpy(ctr_ + pkt_off_, p, take);
+                pkt_off_ += take;
+                p += take;
+                n -= take;
+                if (pkt_off_ == 4)
+                {
+                    uint32_t c;
+                    memcpy(&c, ctr_, 4);
+                    count(c);
+                }
+                continue;
+            }
+            size_t take = std::min(n, legacy_packet_ - pkt_off_);
+            pkt_off_ += take;
+            p += take;
+            n -= take;
+            if (pkt_off_ == legacy_packet_) pkt_off_ = 0;
+        }
+        return true;
+    }
+
+    // The client came back: continue accounting at the resumed seq. Frames
+    // between the last one this server saw of the token (previous session)
+    // and the resumed seq died with the old connection.
+    void resumed()
+    {
+        resume_need_ = 0;
+        if (!account_) return;
+        ssb::ResumeRecord r;
+        memcpy(&r, resume_, sizeof(r));
+        const uint64_t next = resume_hdr_.seq;
+        st_.token.store(r.token, std::memory_order_relaxed);
+        st_.stream.store(resume_hdr_.stream_id, std::memory_order_relaxed);
+        st_.reconnects.store(r.reconnects, std::memory_order_relaxed);
+        if (r.reconnects)
+        {
+            m_.add(ssb::METRIC_RECONNECTS);
+            int64_t prev = st_.resumes.last_seq(r.token, resume_hdr_.stream_id);
+            if (prev >= 0 && (int64_t)next > prev)
+                st_.resume_gap.store((int64_t)next - prev - 1, std::memory_order_relaxed);
+        }
+        st_.last_id.store((int64_t)next - 1, std::memory_order_relaxed);
+    }
+
+    // A forward jump is loss; a backward one (or a repeat) is not, the
+    // count just carries on from the new seq.
+    void count(uint64_t id)
+    {
+        if (!account_) return;
+        int64_t prev = st_.last_id.load(std::memory_order_relaxed);
+        if (prev >= 0 && (int64_t)id > prev + 1)
+            m_.add(ssb::METRIC_DROPS, (uint64_t)((int64_t)id - prev - 1));
+        else if (prev >= 0 && (int64_t)id <= prev)
+            st_.rewinds.fetch_add(1, std::memory_order_relaxed);
+        m_.add(ssb::METRIC_FRAMES_RX);
+        st_.last_id.store((int64_t)id, std::memory_order_relaxed);
+    }
+
+    Stats& st_;
+    ssb::ThreadMetrics& m_;
+    bool account_;
+    size_t legacy_packet_;
+    Mode mode_ = Mode::Unknown;
+
+    ssb::FrameHeader resume_hdr_;
+    uint8_t resume_[sizeof(ssb::ResumeRecord)];
+    size_t resume_got_ = 0;
+    size_t resume_need_ = 0;
+
+    uint8_t probe_[4];
+    size_t probe_got_ = 0;
+
+    uint8_t hdr_[ssb::FRAME_HEADER_SIZE];
+    size_t hdr_got_ = 0;
+    uint64_t skip_ = 0;
+    uint64_t seq_ = 0;
+    int64_t age_ns_ = -1;  // one-way age of a peer-stamped frame, ns; -1 if unstamped
+    uint64_t recv_ns_ = 0;
+
+    ssb::FrameChecker checker_;
+    bool checksum_failed_ = false;
+    uint64_t failed_seq_ = 0;
+
+    uint8_t ctr_[4];
+    size_t pkt_off_ = 0;
+};
+
+void data_worker(int fd, int cmd, Stats& st, bool account, size_t legacy_packet, ssb::ChecksumPolicy policy)
+{
+    ssb::ThreadMetrics* m = st.claim("data", st.own_data);
+    st.data.store(m, std::memory_order_release);
+
+    StreamParser parser(st, *m, account, legacy_packet, policy);
+    std::vector<uint8_t> buf(4 << 20);
+    for (;;)
+    {
+        ssize_t r = recv(fd, buf.data(), buf.size(), 0);
+        m->add(ssb::METRIC_SYSCALLS);
+        if (r <= 0)
+        {
+            if (r < 0 && errno == EINTR) continue;
+            break;
+        }
+        if (!parser.feed(buf.data(), (size_t)r, ssb::mono_ns()))
+        {
+            if (!parser.checksum_failed())
+                printf("[Server] data error: bad frame header\n");
+            else if (parser.checker().bad())
+                printf("[Server] data error: checksum mismatch at seq %llu, closing\n",
+                    (unsigned long long)parser.failed_seq());
+            else
+                printf("[Server] data error: frame without checksum, closing\n");
+            // fail closed: end the session, so both connections are closed
+            // under the client instead of the data stream stalling
+            if (parser.checksum_failed()) shutdown(cmd, SHUT_RDWR);
+            break;
+        }
+    }
+    const ssb::FrameChecker& c = parser.checker();
+    if (c.ok() || c.bad())
+        printf("[Server] checksum (%s): %llu ok, %llu bad, %llu unchecked\n", ssb::crc32c_impl(),
+            (unsigned long long)c.ok(), (unsigned long long)c.bad(), (unsigned long long)c.unchecked());
+    st.release(m);
+}
+
+void cmd_worker(int fd, Stats& st)
+{
+    // pings and probes are echoed as they come, clock sync requests are
+    // answered with this host's times; all are counted in 8-byte units
+    constexpr uint64_t SYNC_UNITS = ssb::SYNC_FRAME_SIZE / 8;
+    ssb::ThreadMetrics* m = st.claim("cmd", st.own_cmd);
+    st.cmd.store(m, std::memory_order_release);
+
+    char buf[4096];
+    std::vector<uint8_t> out;
+    ssb::CmdResponder responder;
+    for (;;)
+    {
+        ssize_t r = recv(fd, buf, sizeof(buf), 0);
+        if (r <= 0)
+        {
+            if (r < 0 && errno == EINTR) continue;
+            break;
+        }
+        uint64_t recv_ns = ssb::mono_ns();
+        uint64_t before = responder.units() + responder.syncs() * SYNC_UNITS;
+        out.clear();
+        responder.feed((const uint8_t*)buf, (size_t)r, recv_ns, out);
+        if (!out.empty() && send(fd, out.data(), out.size(), MSG_NOSIGNAL) != (ssize_t)out.size()) break;
+        uint64_t units = responder.units() + responder.syncs() * SYNC_UNITS - before;
+        m->add(ssb::METRIC_SYSCALLS, out.empty() ? 1 : 2);
+        m->add(ssb::METRIC_BYTES_RX, (uint64_t)r);
+        m->add(ssb::METRIC_BYTES_TX, out.size());
+        m->add(ssb::METRIC_FRAMES_RX, units);
+        m->add(ssb::METRIC_FRAMES_TX, units);
+    }
+    st.release(m);
+}
+
+void report(const char* tag, double elapsed, const Stats& st)
+{
+    uint64_t bytes = st.bytes();
+    char age[96] = "";
+    if (const ssb::Histogram* a = st.age())
+        snprintf(age, sizeof(age), " | data age p50 %.1f us p99 %.1f us", a->percentile(50) / 1e3,
+            a->percentile(99) / 1e3);
+    printf("[Server] %s%5.1f min | %8.2f GB | %5.2f GB/s | echoed %llu x 8 B | lost %llu%s\n",
+        tag, elapsed / 60.0, bytes / 1e9, elapsed > 0 ? bytes / 1e9 / elapsed : 0.0,
+        (unsigned long long)st.echo_units(), (unsigned long long)st.lost(), age);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    char code = (argc > 1) ? argv[1][0] : 'C';
+    double duration = (argc > 2) ? atof(argv[2]) : 3600.0;
+    size_t legacy_packet = (argc > 3) ? (size_t)atoll(argv[3]) : 65536;
+    bool loop = (argc > 4) && strcmp(argv[4], "loop") == 0;
+    ssb::Endpoint ep;
+    if (argc > 5)
+    {
+        ep.cmd_port = atoi(argv[5]);
+        ep.data_port = ep.cmd_port + 1;
+    }
+    ssb::ChecksumPolicy checksum = ssb::ChecksumPolicy::Count;
+    bool policy_ok = (argc <= 6) || ssb::parse_checksum_policy(argv[6], checksum);
+
+    if ((code != 'L' && code != 'T' && code != 'E' && code != 'C' && code != 'S') || legacy_packet < 4 || !policy_ok)
+    {
+        printf("usage: ssb_server [L|T|E|C|S] [duration_s] [legacy_packet_bytes>=4] [loop|once] [cmd_port]\n"
+               "                  [off|count|fail|require]\n");
+        return 1;
+    }
+
+    int lc = ssb::listen_tcp(ep.host, ep.cmd_port, 1);
+    int ld = ssb::needs_data_port(code) ? ssb::listen_tcp(ep.host, ep.data_port, (int)ssb::STRIPE_MAX) : -1;
+    if (lc < 0 || (ssb::needs_data_port(code) && ld < 0))
+    {
+        printf("[Server] cannot listen on %s:%d/%d\n", ep.host, ep.cmd_port, ep.data_port);
+        return 1;
+    }
+
+    ssb::StatsPage page;
+    if (!page.create("server")) page.create(nullptr);
+    ssb::ResumeTable resumes;
+
+    do
+    {
+        printf("[Server] wait %s:%d (test '%c')\n", ep.host, ep.cmd_port, code);
+        int cmd = accept(lc, nullptr, nullptr);
+        if (cmd < 0 || send(cmd, &code, 1, MSG_NOSIGNAL) != 1)
+        {
+            printf("[Server] cmd handshake failed\n");
+            if (cmd >= 0) close(cmd);
+            continue;
+        }
+        int data = -1;
+        int stripe_fds[ssb::STRIPE_MAX];
+        uint32_t stripes = 0;
+        if (code == 'S')
+        {
+            if ((stripes = ssb::accept_stripes(cmd, ld, stripe_fds)) == 0)
+            {
+                printf("[Server] stripe handshake failed\n");
+                close(cmd);
+                continue;
+            }
+        }
+        else if (ld >= 0 && (data = accept(ld, nullptr, nullptr)) < 0)
+        {
+            printf("[Server] data accept failed\n");
+            close(cmd);
+            continue;
+        }
+        if (stripes)
+            printf("[Server] session start (%u stripes)\n", stripes);
+        else
+            printf("[Server] session start\n");
+
+        Stats st(page, resumes);
+        std::atomic<int> running{ (data >= 0 || stripes) ? 2 : 1 };
+        std::thread cmd_thread([&]() { cmd_worker(cmd, st); running--; });
+        std::thread data_thread;
+        std::unique_ptr<ssb::StripeReceiver> receiver;
+        if (stripes)
+        {
+            ssb::StripeConfig cfg;
+            cfg.first_cpu = 0;
+            cfg.stats = &page;
+            receiver.reset(new ssb::StripeReceiver(stripe_fds, stripes, ssb::FRAME_MAX_PAYLOAD,
+                [](uint32_t, uint64_t, const uint8_t*, size_t) {}, cfg));
+            st.stripes.store(receiver.get(), std::memory_order_release);
+            data_thread = std::thread([&]() { receiver->join(); running--; });
+        }
+        else if (data >= 0)
+        {
+            // loss accounting only where the client stamps packets ('C');
+            // checksums are verified in every mode
+            bool account = (code == 'C');
+            data_thread = std::thread([&]() { data_worker(data, cmd, st, account, legacy_packet, checksum); running--; });
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        auto last = start;
+        double elapsed = 0;
+        while (running.load() > 0 && elapsed < duration)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            auto now = std::chrono::steady_clock::now();
+            elapsed = std::chrono::duration<double>(now - start).count();
+            if (std::chrono::duration<double>(now - last).count() >= 5.0)
+            {
+                report("", elapsed, st);
+                last = now;
+            }
+        }
+
+        // unblock the workers
+        shutdown(cmd, SHUT_RDWR);
+        if (data >= 0) shutdown(data, SHUT_RDWR);
+        for (uint32_t i = 0; i < stripes; ++i) shutdown(stripe_fds[i], SHUT_RDWR);
+        if (receiver) receiver->stop();
+        cmd_thread.join();
+        if (data_thread.joinable()) data_thread.join();
+        close(cmd);
+        if (data >= 0) close(data);
+        if (receiver && receiver->errors())
+            printf("[Server] stripe error: bad chunk header\n");
+
+        int64_t last_id = st.last_id.load();
+        uint64_t total_pkts = last_id >= 0 ? (uint64_t)last_id + 1 : 0;
+        report("done ", elapsed, st);
+        printf("[Server] lost %llu pkts (%.6f%%)\n", (unsigned long long)st.lost(),
+            total_pkts ? st.lost() * 100.0 / total_pkts : 0.0);
+        if (uint64_t n = st.rewinds.load())
+            printf("[Server] seq went back %llu times (not counted as loss)\n", (unsigned long long)n);
+        if (uint64_t token = st.token.load())
+        {
+            if (st.reconnects.load())
+            {
+                int64_t gap = st.resume_gap.load();
+                char lost_in_break[48] = "unknown (new server)";
+                if (gap >= 0) snprintf(lost_in_break, sizeof(lost_in_break), "%lld frames", (long long)gap);
+                printf("[Server] resumed session %016llx (reconnect %u), lost in the break: %s\n",
+                    (unsigned long long)token, st.reconnects.load(), lost_in_break);
+            }
+            if (last_id >= 0) resumes.store(token, st.stream.load(), last_id);
+        }
+        st.stripes.store(nullptr, std::memory_order_release);
+        receiver.reset();
+        for (uint32_t i = 0; i < stripes; ++i) close(stripe_fds[i]);
+    } while (loop);
+
+    close(lc);
+    if (ld >= 0) close(ld);
+    return 0;
+}
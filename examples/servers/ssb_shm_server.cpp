@@ -0,0 +1,152 @@
+// ssb_shm_server.cpp
+// Same-host reference server for the shared-memory transport. Serves the
+// 'L', 'T' and 'C' tests over memfd SPSC rings instead of 5050/5051:
+// pings on the cmd ring are echoed as pongs, data frames are counted with
+// the same seq-gap loss accounting as ssb_combined_server.py.
+//
+// usage: ssb_shm_server [L|T|C] [duration_s] [name]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <thread>
+
+#include "ssb/reactor.h"
+#include "ssb/shm_transport.h"
+
+using ssb::ShmRing;
+
+int main(int argc, char** argv)
+{
+    char code = (argc > 1) ? argv[1][0] : 'C';
+    double duration = (argc > 2) ? atof(argv[2]) : 3600.0;
+    const char* name = (argc > 3) ? argv[3] : ssb::SHM_DEFAULT_NAME;
+
+    if (code != 'L' && code != 'T' && code != 'C')
+    {
+        printf("[Shm] unknown test code '%c'\n", code);
+        return 1;
+    }
+
+    int lfd = ssb::shm_listen(name);
+    if (lfd < 0)
+    {
+        printf("[Shm] cannot listen on @%s\n", name);
+        return 1;
+    }
+    printf("[Shm] wait @%s (test '%c')\n", name, code);
+
+    ssb::ShmSession s;
+    if (!ssb::shm_accept(lfd, code, s))
+    {
+        printf("[Shm] accept/setup failed\n");
+        return 1;
+    }
+    close(lfd);
+    printf("[Shm] client attached\n");
+
+    std::atomic<uint64_t> total_bytes{ 0 };
+    std::atomic<uint64_t> lost{ 0 };
+    std::atomic<int64_t> last_id{ -1 };
+    uint64_t pings = 0;
+
+    ssb::Reactor cmd_reactor;
+    ssb::Reactor data_reactor;
+
+    // ---- DATA THREAD: consume data_up in place ----
+    std::thread data_thread;
+    if (code != 'L')
+    {
+        data_thread = std::thread([&]()
+            {
+                ShmRing& ring = s.ring[ssb::SHM_DATA_UP];
+                data_reactor.add(ring.data_fd(), EPOLLIN, [&](uint32_t)
+                    {
+                        ShmRing::clear(ring.data_fd());
+                        ssb::FrameHeader h;
+                        const uint8_t* payload;
+                        for (int i = 0; i < 256; ++i)
+                        {
+                            if (!ring.peek(h, payload))
+                            {
+                                if (ring.arm_reader()) return false;
+                                continue;
+                            }
+                            total_bytes.fetch_add(ssb::FRAME_HEADER_SIZE + h.payload_len, std::memory_order_relaxed);
+                            int64_t prev = last_id.load(std::memory_order_relaxed);
+                            if (prev >= 0 && (int64_t)h.seq != prev + 1)
+                                lost.fetch_add(h.seq - prev - 1, std::memory_order_relaxed);
+                            last_id.store((int64_t)h.seq, std::memory_order_relaxed);
+                            ring.release();
+                        }
+                        return true;
+                    });
+                uint64_t one = 1;
+                ssize_t r = write(ring.data_fd(), &one, sizeof(one)); // first drain
+                (void)r;
+                data_reactor.run();
+            });
+    }
+
+    // ---- CMD: echo pings as pongs ----
+    ShmRing& cmd_in = s.ring[ssb::SHM_CMD_UP];
+    ShmRing& cmd_out = s.ring[ssb::SHM_CMD_DOWN];
+    cmd_reactor.add(cmd_in.data_fd(), EPOLLIN, [&](uint32_t)
+        {
+            ShmRing::clear(cmd_in.data_fd());
+            ssb::FrameHeader h;
+            const uint8_t* payload;
+            for (;;)
+            {
+                if (!cmd_in.peek(h, payload))
+                {
+                    if (cmd_in.arm_reader()) return false;
+                    continue;
+                }
+                if (h.type == ssb::FRAME_PING)
+                {
+                    h.type = ssb::FRAME_PONG;
+                    // the client keeps at most a few pings in flight
+                    while (!cmd_out.try_write(h, payload)) {}
+                    pings++;
+                }
+                cmd_in.release();
+            }
+        });
+    uint64_t one = 1;
+    ssize_t wr = write(cmd_in.data_fd(), &one, sizeof(one));
+    (void)wr;
+
+    cmd_reactor.add(s.sock, EPOLLIN, [&](uint32_t ev)
+        {
+            if (ev & (EPOLLHUP | EPOLLRDHUP | EPOLLERR))
+            {
+                printf("[Shm] client detached\n");
+                cmd_reactor.stop();
+            }
+            return false;
+        });
+
+    auto start = std::chrono::steady_clock::now();
+    cmd_reactor.add_timer(5000000000ull, 5000000000ull, [&](uint64_t)
+        {
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            uint64_t bytes = total_bytes.load();
+            printf("[Shm] %5.1f min | %8.2f GB | %5.2f GB/s | pings %llu | lost %llu\n",
+                elapsed / 60.0, bytes / 1e9, elapsed > 0 ? bytes / 1e9 / elapsed : 0.0,
+                (unsigned long long)pings, (unsigned long long)lost.load());
+        });
+    cmd_reactor.add_timer((uint64_t)(duration * 1e9), 0, [&](uint64_t) { cmd_reactor.stop(); });
+
+    cmd_reactor.run();
+
+    data_reactor.stop();
+    if (data_thread.joinable()) data_thread.join();
+
+    int64_t last = last_id.load();
+    uint64_t total_pkts = last >= 0 ? (uint64_t)last + 1 : 0;
+    printf("[Shm] done %.2f GB, pings %llu, lost %llu pkts (%.6f%%)\n",
+        total_bytes.load() / 1e9, (unsigned long long)pings, (unsigned long long)lost.load(),
+        total_pkts ? lost.load() * 100.0 / total_pkts : 0.0);
+    return 0;
+}
@@ -22,12 +22,13 @@ data, _ = sd.accept()
 print("[Throughput] data conn")
 
 data.settimeout(0.5)
+buf = bytearray(1 << 20)  # reused for every read
 start = time.time(); last = start; total = 0
 while time.time() - start < 30:
     try:
-        chunk = data.recv(65536)
-        if not chunk: break
-        total += len(chunk)
+        n = data.recv_into(buf)
+        if not n: break
+        total += n
         if time.time() - last > 5:
             print(f"[Throughput] {total/1e9:.2f} GB")
             last = time.time()
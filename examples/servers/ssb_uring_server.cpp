@@ -0,0 +1,156 @@
+// ssb_uring_server.cpp
+// io_uring receive side for the throughput test ('T' on 5050/5051). The
+// data socket is drained by a single multishot RECV that picks its
+// buffers from a provided-buffer ring (or legacy provided buffers where
+// the ring is unavailable), so the steady state is one
+// io_uring_enter() per batch of completions and no per-recv submission.
+// Reports GB/s and syscalls per GB like ws_throughput_client.
+//
+// usage: ssb_uring_server [duration_s] [sqpoll 0|1]
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "ssb/clock.h"
+#include "ssb/session.h"
+#include "ssb/uring.h"
+
+namespace
+{
+
+constexpr unsigned RECV_BUFS = 64;      // power of two
+constexpr unsigned RECV_BUF_SIZE = 65536;
+constexpr uint16_t RECV_GROUP = 0;
+constexpr uint64_t TAG_RECV = 1;
+constexpr uint64_t TAG_TICK = 2;
+
+void queue_recv(ssb::Uring& ring)
+{
+    io_uring_sqe* sqe = ring.get_sqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+    sqe->fd = 0;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->buf_group = RECV_GROUP;
+    sqe->user_data = TAG_RECV;
+}
+
+// 1 s timeout so the loop still reports and honours the deadline when
+// the sender stalls
+void queue_tick(ssb::Uring& ring, __kernel_timespec* ts)
+{
+    io_uring_sqe* sqe = ring.get_sqe();
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->addr = (uint64_t)(uintptr_t)ts;
+    sqe->len = 1;
+    sqe->user_data = TAG_TICK;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    double duration = (argc > 1) ? atof(argv[1]) : 30.0;
+    bool sqpoll = (argc > 2) && atoi(argv[2]) != 0;
+
+    ssb::Endpoint ep;
+    int lc = ssb::listen_tcp(ep.host, ep.cmd_port, 1);
+    int ld = ssb::listen_tcp(ep.host, ep.data_port, 1);
+    if (lc < 0 || ld < 0)
+    {
+        printf("[Uring] cannot listen on %s:%d/%d\n", ep.host, ep.cmd_port, ep.data_port);
+        return 1;
+    }
+    printf("[Uring] wait %s:%d\n", ep.host, ep.cmd_port);
+
+    int cmd = accept(lc, nullptr, nullptr);
+    if (cmd < 0 || send(cmd, "T", 1, MSG_NOSIGNAL) != 1)
+    {
+        printf("[Uring] cmd handshake failed\n");
+        return 1;
+    }
+    int data = accept(ld, nullptr, nullptr);
+    if (data < 0)
+    {
+        printf("[Uring] data accept failed\n");
+        return 1;
+    }
+    close(lc);
+    close(ld);
+    printf("[Uring] data conn%s\n", sqpoll ? " (sqpoll)" : "");
+
+    ssb::Uring ring;
+    std::vector<uint8_t> pool((size_t)RECV_BUFS * RECV_BUF_SIZE);
+    // SQ sized so every buffer can be recycled in one batch in fallback mode
+    if (!ring.init(2 * RECV_BUFS, sqpoll) ||
+        !ring.register_files(&data, 1) ||
+        !ring.provide_buffers(RECV_GROUP, RECV_BUFS, pool.data(), RECV_BUF_SIZE))
+    {
+        printf("[Uring] io_uring setup failed (%s)\n", strerror(errno));
+        return 1;
+    }
+    printf("[Uring] %s provided buffers\n", ring.buffer_ring() ? "ring-mapped" : "legacy");
+
+    __kernel_timespec tick{ 1, 0 };
+    queue_recv(ring);
+    queue_tick(ring, &tick);
+
+    const uint64_t t0 = ssb::mono_ns();
+    const uint64_t deadline = t0 + (uint64_t)(duration * 1e9);
+    uint64_t next_report = t0 + 5000000000ull;
+    uint64_t total = 0;
+    uint64_t rearms = 0;
+    bool done = false;
+
+    while (!done)
+    {
+        if (ring.submit(1) < 0)
+            break;
+
+        ring.drain([&](const io_uring_cqe& c)
+            {
+                if (c.user_data == UINT64_MAX)
+                    return;     // failed buffer recycle; buffer is lost
+                if (c.user_data == TAG_TICK)
+                {
+                    queue_tick(ring, &tick);
+                    return;
+                }
+                if (c.res > 0)
+                    total += c.res;
+                if (c.flags & IORING_CQE_F_BUFFER)
+                    ring.recycle_buf((uint16_t)(c.flags >> IORING_CQE_BUFFER_SHIFT));
+
+                if (c.res == 0 || (c.res < 0 && c.res != -ENOBUFS))
+                    done = true;    // EOF or error
+                else if (!(c.flags & IORING_CQE_F_MORE))
+                {
+                    // ran out of provided buffers (or the kernel dropped
+                    // multishot); buffers are back in the ring, re-arm
+                    queue_recv(ring);
+                    rearms++;
+                }
+            });
+
+        uint64_t now = ssb::mono_ns();
+        if (now >= next_report)
+        {
+            double elapsed = (now - t0) / 1e9;
+            printf("[Uring] %.2f GB | %.2f GB/s | %.0f syscalls/GB | rearms %llu\n",
+                total / 1e9, total / 1e9 / elapsed,
+                total ? ring.enters() / (total / 1e9) : 0.0, (unsigned long long)rearms);
+            next_report += 5000000000ull;
+        }
+        if (now >= deadline)
+            break;
+    }
+
+    double elapsed = (ssb::mono_ns() - t0) / 1e9;
+    printf("[Uring] done %.2f GB | %.2f GB/s | %.0f syscalls/GB\n",
+        total / 1e9, total / 1e9 / elapsed, total ? ring.enters() / (total / 1e9) : 0.0);
+
+    close(data);
+    close(cmd);
+    return 0;
+}
@@ -0,0 +1,784 @@
+// ssb_bench.cpp
+// Benchmark runner: starts ssb_server locally for every run, sweeps the
+// latency, throughput, combined and endurance scenarios over payload
+// sizes, connection counts and message rates, and writes one JSON result
+// per run. With a baseline file it compares and flags regressions.
+//
+//   latency     stop-and-wait echoes of `payload` bytes on cmd at `rate` Hz
+//               ('L'); RTT percentiles, corrected for coordinated omission
+//   throughput  back-to-back SSB frames of `payload` bytes; one connection
+//               is 'T', more are striped lanes ('S', ssb/stripe.h)
+//   combined    the throughput stream plus 8-byte pings at ping_hz ('C');
+//               GB/s, RTT under load and frames the server counted lost
+//   endurance   one frame per tick at `rate` Hz ('E'); send-miss percentiles
+//               and skipped ticks
+//
+// Every run warms up for `warmup` s and then measures for `duration` s.
+// Client and server CPU time and context switches are taken over the
+// measured part only (getrusage for this process, /proc for the server).
+//
+// usage: ssb_bench [key=value ...]
+//   scenarios=latency,throughput,combined,endurance
+//   payloads=64,4096,65536,1048576,4194304     bytes
+//   connections=1                              throughput lanes, 1-8
+//   rates=1000                                 Hz, latency and endurance
+//   ping_hz=100  warmup=1  duration=3
+//   server=../servers/ssb_server  port=5050    (data is port + 1)
+//   out=ssb_bench.json  baseline=<file>  tolerance=10 (%)
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ssb/clock.h"
+#include "ssb/frame.h"
+#include "ssb/histogram.h"
+#include "ssb/metrics.h"
+#include "ssb/session.h"
+#include "ssb/stripe.h"
+#include "ssb/tick_scheduler.h"
+
+namespace
+{
+
+struct Options
+{
+    std::vector<std::string> scenarios{ "latency", "throughput", "combined", "endurance" };
+    std::vector<double> payloads{ 64, 4096, 65536, 1048576, 4194304 };
+    std::vector<double> connections{ 1 };
+    std::vector<double> rates{ 1000 };
+    double ping_hz = 100;
+    double warmup = 1;
+    double duration = 3;
+    std::string server = "../servers/ssb_server";
+    int port = 5050;
+    std::string out = "ssb_bench.json";
+    std::string baseline;
+    double tolerance = 10;
+};
+
+struct Result
+{
+    std::string scenario;
+    size_t payload = 0;
+    uint32_t connections = 1;
+    double rate = 0;
+    double gbps = 0;
+    double msgs_per_s = 0;
+    double p50_us = 0, p99_us = 0, p999_us = 0, max_us = 0;  // RTT, or send miss
+    uint64_t lost = 0;
+    uint64_t skipped = 0;
+    double client_cpu_s = 0, server_cpu_s = 0;
+    uint64_t client_vcsw = 0, client_ivcsw = 0, server_vcsw = 0, server_ivcsw = 0;
+    bool ok = false;
+
+    std::string key() const
+    {
+        char k[96];
+        snprintf(k, sizeof(k), "%s/%zu/%u/%g", scenario.c_str(), payload, connections, rate);
+        return k;
+    }
+};
+
+// ---- CPU and context switches ----
+
+struct Usage
+{
+    double cpu_s = 0;
+    uint64_t vcsw = 0;
+    uint64_t ivcsw = 0;
+};
+
+Usage self_usage()
+{
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    Usage u;
+    u.cpu_s = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+    u.vcsw = (uint64_t)ru.ru_nvcsw;
+    u.ivcsw = (uint64_t)ru.ru_nivcsw;
+    return u;
+}
+
+// utime + stime of all threads from /proc/<pid>/stat, switches summed
+// over the live threads in /proc/<pid>/task.
+Usage proc_usage(pid_t pid)
+{
+    Usage u;
+    char path[64], line[1024];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    if (FILE* f = fopen(path, "r"))
+    {
+        if (fgets(line, sizeof(line), f))
+        {
+            // fields after the ")" of the command name; utime, stime are 14, 15
+            const char* p = strrchr(line, ')');
+            unsigned long ut = 0, st = 0;
+            if (p && sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &ut, &st) == 2)
+                u.cpu_s = (double)(ut + st) / sysconf(_SC_CLK_TCK);
+        }
+        fclose(f);
+    }
+    snprintf(path, sizeof(path), "/proc/%d/task", (int)pid);
+    if (DIR* d = opendir(path))
+    {
+        while (dirent* e = readdir(d))
+        {
+            if (e->d_name[0] == '.') continue;
+            char status[320];
+            snprintf(status, sizeof(status), "/proc/%d/task/%s/status", (int)pid, e->d_name);
+            FILE* f = fopen(status, "r");
+            if (!f) continue;
+            while (fgets(line, sizeof(line), f))
+            {
+                unsigned long long v;
+                if (sscanf(line, "voluntary_ctxt_switches: %llu", &v) == 1) u.vcsw += v;
+                else if (sscanf(line, "nonvoluntary_ctxt_switches: %llu", &v) == 1) u.ivcsw += v;
+            }
+            fclose(f);
+        }
+        closedir(d);
+    }
+    return u;
+}
+
+// ---- server ----
+
+class Server
+{
+public:
+    Server(const Options& o, char code) : o_(o)
+    {
+        char c[2] = { code, 0 }, dur[32], port[16];
+        snprintf(dur, sizeof(dur), "%.0f", o.warmup + o.duration + 30);
+        snprintf(port, sizeof(port), "%d", o.port);
+        pid_ = fork();
+        if (pid_ == 0)
+        {
+            int null = open("/dev/null", O_WRONLY);
+            if (null >= 0)
+            {
+                dup2(null, STDOUT_FILENO);
+                dup2(null, STDERR_FILENO);
+            }
+            execl(o.server.c_str(), o.server.c_str(), c, dur, "65536", "once", port, (char*)nullptr);
+            _exit(127);
+        }
+    }
+
+    ~Server()
+    {
+        if (pid_ > 0)
+        {
+            kill(pid_, SIGKILL);
+            waitpid(pid_, nullptr, 0);
+        }
+    }
+
+    pid_t pid() const { return pid_; }
+
+    ssb::Endpoint endpoint() const
+    {
+        ssb::Endpoint ep;
+        ep.cmd_port = o_.port;
+        ep.data_port = o_.port + 1;
+        return ep;
+    }
+
+    // Retries until the freshly started server listens.
+    template <typename Open>
+    bool connect(Open&& open)
+    {
+        for (int i = 0; i < 300; ++i)
+        {
+            if (open()) return true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return false;
+    }
+
+    // Frames the server counted lost (0 if its page is not readable).
+    uint64_t lost() const
+    {
+        ssb::StatsPage page;
+        if (!page.open("server") || page.header()->pid != (uint64_t)pid_) return 0;
+        return page.total(ssb::METRIC_DROPS);
+    }
+
+private:
+    const Options& o_;
+    pid_t pid_ = -1;
+};
+
+// Measurement window bookkeeping shared by the scenarios.
+struct Window
+{
+    Window(const Options& o, pid_t server) : server_(server)
+    {
+        start = ssb::mono_ns();
+        measure = start + (uint64_t)(o.warmup * 1e9);
+        end = measure + (uint64_t)(o.duration * 1e9);
+    }
+
+    bool measuring(uint64_t now) const { return now >= measure; }
+
+    // call once when measuring starts, and once at the end
+    void begin()
+    {
+        c0 = self_usage();
+        s0 = proc_usage(server_);
+    }
+    // begin() at the start of the measured part from a thread of its own,
+    // so the snapshot is on time even when the measuring loop blocks
+    void begin_on_time(const std::atomic<bool>& stop)
+    {
+        while (!stop && ssb::mono_ns() < measure) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        if (!stop)
+        {
+            begin();
+            began = true;
+        }
+    }
+    void finish(Result& r) const
+    {
+        Usage c1 = self_usage(), s1 = proc_usage(server_);
+        r.client_cpu_s = c1.cpu_s - c0.cpu_s;
+        r.server_cpu_s = s1.cpu_s - s0.cpu_s;
+        r.client_vcsw = c1.vcsw - c0.vcsw;
+        r.client_ivcsw = c1.ivcsw - c0.ivcsw;
+        r.server_vcsw = s1.vcsw - s0.vcsw;
+        r.server_ivcsw = s1.ivcsw - s0.ivcsw;
+    }
+
+    uint64_t start, measure, end;
+    pid_t server_;
+    Usage c0, s0;
+    bool began = false;
+};
+
+void fill_percentiles(Result& r, const ssb::Histogram& h)
+{
+    r.p50_us = h.percentile(50.0) / 1e3;
+    r.p99_us = h.percentile(99.0) / 1e3;
+    r.p999_us = h.percentile(99.9) / 1e3;
+    r.max_us = h.max() / 1e3;
+}
+
+bool wait_fd(int fd, short ev)
+{
+    pollfd pfd{ fd, ev, 0 };
+    return poll(&pfd, 1, 2000) == 1 && !(pfd.revents & (POLLERR | POLLHUP | POLLNVAL));
+}
+
+bool send_all(int fd, const uint8_t* p, size_t len)
+{
+    while (len)
+    {
+        ssize_t r = ssb::send_nb(fd, p, len);
+        if (r < 0) return false;
+        if (r == 0 && !wait_fd(fd, POLLOUT)) return false;
+        p += r;
+        len -= (size_t)r;
+    }
+    return true;
+}
+
+bool recv_all(int fd, uint8_t* p, size_t len)
+{
+    while (len)
+    {
+        ssize_t r = ssb::recv_nb(fd, p, len);
+        if (r < 0) return false;
+        if (r == 0 && !wait_fd(fd, POLLIN)) return false;
+        p += r;
+        len -= (size_t)r;
+    }
+    return true;
+}
+
+// Stop-and-wait echoes on `fd` paced at `rate` until `stop` or w.end.
+bool ping_loop(int fd, size_t size, double rate, Window& w, ssb::Histogram& h, uint64_t& count,
+    const std::atomic<bool>* stop = nullptr)
+{
+    std::vector<uint8_t> out(size, 0), in(size);
+    const uint64_t interval = (uint64_t)(1e9 / rate);
+    uint64_t next = ssb::mono_ns();
+    while (!(stop && stop->load()))
+    {
+        next += interval;
+        uint64_t now = ssb::mono_ns();
+        if (now >= w.end) return true;
+        if (next > now) std::this_thread::sleep_for(std::chrono::nanoseconds(next - now));
+
+        uint64_t t0 = ssb::mono_ns();
+        if (!send_all(fd, out.data(), size) || !recv_all(fd, in.data(), size)) return false;
+        if (w.measuring(t0))
+        {
+            h.record_corrected(ssb::mono_ns() - t0, interval);
+            ++count;
+        }
+    }
+    return true;
+}
+
+// ---- scenarios ----
+
+Result run_latency(const Options& o, size_t payload, double rate)
+{
+    Result r;
+    r.scenario = "latency";
+    r.payload = payload;
+    r.rate = rate;
+    const size_t size = std::max<size_t>((payload + 7) & ~(size_t)7, 8); // echoed in 8-byte units
+
+    Server srv(o, 'L');
+    ssb::Session s;
+    if (!srv.connect([&]() { return ssb::open_session(srv.endpoint(), s, 200) && s.code == 'L'; })) return r;
+
+    Window w(o, srv.pid());
+    ssb::Histogram h;
+    uint64_t count = 0;
+    std::atomic<bool> stop{ false };
+    std::thread sampler([&]() { w.begin_on_time(stop); });
+    r.ok = ping_loop(s.cmd, size, rate, w, h, count);
+    stop = true;
+    sampler.join();
+    if (w.began) w.finish(r);
+
+    r.msgs_per_s = count / o.duration;
+    r.gbps = count * size * 2 / o.duration / 1e9;
+    fill_percentiles(r, h);
+    return r;
+}
+
+// Sends frames back to back on one connection until w.end or `stop`;
+// bytes sent while measuring go to `measured`. Without `stop` this is the
+// only loop of the run and it takes the usage snapshot itself.
+bool frame_stream(int fd, size_t payload, Window& w, uint64_t& measured, uint64_t& frames,
+    const std::atomic<bool>* stop = nullptr)
+{
+    std::vector<uint8_t> buf(payload, 0x5A);
+    ssb::FrameWriter writer;
+    uint64_t seq = 0;
+    for (;;)
+    {
+        uint64_t now = ssb::mono_ns();
+        if (now >= w.end || (stop && stop->load())) return true;
+        if (!stop && !w.began && w.measuring(now))
+        {
+            w.begin();
+            w.began = true;
+        }
+        writer.begin(ssb::make_header(ssb::FRAME_DATA, 0, seq++, (uint32_t)payload), buf.data());
+        for (;;)
+        {
+            ssb::WriteResult res = writer.flush(fd);
+            if (res == ssb::WriteResult::Done) break;
+            if (res == ssb::WriteResult::Failed || !wait_fd(fd, POLLOUT)) return false;
+        }
+        if (w.measuring(now))
+        {
+            measured += writer.frame_size();
+            ++frames;
+        }
+    }
+}
+
+Result run_throughput(const Options& o, size_t payload, uint32_t lanes)
+{
+    Result r;
+    r.scenario = "throughput";
+    r.payload = payload;
+    r.connections = lanes;
+    uint64_t bytes = 0, frames = 0;
+
+    if (lanes <= 1)
+    {
+        Server srv(o, 'T');
+        ssb::Session s;
+        if (!srv.connect([&]() { return ssb::open_session(srv.endpoint(), s, 200) && s.code == 'T'; })) return r;
+        Window w(o, srv.pid());
+        r.ok = frame_stream(s.data, payload, w, bytes, frames) && w.began;
+        if (w.began) w.finish(r);
+    }
+    else
+    {
+        Server srv(o, 'S');
+        ssb::StripedSession s;
+        if (!srv.connect([&]() { return ssb::open_striped_session(srv.endpoint(), lanes, s, 200); })) return r;
+        r.connections = s.count;
+        Window w(o, srv.pid());
+
+        // persistent buffers, reused once the lanes let go of them
+        const uint32_t nbuf = 2 * s.count + 2;
+        ssb::FramePool pool({ { payload, nbuf } });
+        std::vector<ssb::FrameRef> bufs;
+        for (uint32_t i = 0; i < nbuf; ++i) bufs.push_back(pool.acquire(payload));
+
+        ssb::StripeConfig cfg;
+        cfg.first_cpu = 0;
+        ssb::StripeSender tx(s.data, s.count, cfg);
+        uint64_t at_measure = 0, msgs_at_measure = 0;
+        bool began = false;
+        for (uint64_t seq = 0;; ++seq)
+        {
+            uint64_t now = ssb::mono_ns();
+            if (now >= w.end) break;
+            if (!began && w.measuring(now))
+            {
+                w.begin();
+                at_measure = tx.bytes();
+                msgs_at_measure = tx.messages();
+                began = true;
+            }
+            ssb::FrameRef& b = bufs[seq % nbuf];
+            while (b.use_count() > 1) std::this_thread::yield();
+            if (!tx.send(0, b.share())) break;
+        }
+        bytes = tx.bytes() - at_measure;
+        frames = tx.messages() - msgs_at_measure;
+        r.ok = began && !tx.failed();
+        if (began) w.finish(r);
+        tx.stop();
+    }
+    r.gbps = bytes / o.duration / 1e9;
+    r.msgs_per_s = frames / o.duration;
+    return r;
+}
+
+Result run_combined(const Options& o, size_t payload)
+{
+    Result r;
+    r.scenario = "combined";
+    r.payload = payload;
+    r.rate = o.ping_hz;
+
+    Server srv(o, 'C');
+    ssb::Session s;
+    if (!srv.connect([&]() { return ssb::open_session(srv.endpoint(), s, 200) && s.code == 'C'; })) return r;
+    Window w(o, srv.pid());
+
+    uint64_t bytes = 0, frames = 0, pings = 0;
+    std::atomic<bool> stop{ false };
+    bool data_ok = true;
+    std::thread data([&]() { data_ok = frame_stream(s.data, payload, w, bytes, frames, &stop); });
+    std::thread sampler([&]() { w.begin_on_time(stop); });
+    ssb::Histogram h;
+    bool cmd_ok = ping_loop(s.cmd, 8, o.ping_hz, w, h, pings);
+    stop = true;
+    data.join();
+    sampler.join();
+    if (w.began) w.finish(r);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    r.lost = srv.lost();
+    r.ok = data_ok && cmd_ok;
+    r.gbps = bytes / o.duration / 1e9;
+    r.msgs_per_s = frames / o.duration;
+    fill_percentiles(r, h);
+    return r;
+}
+
+Result run_endurance(const Options& o, size_t payload, double rate)
+{
+    Result r;
+    r.scenario = "endurance";
+    r.payload = payload;
+    r.rate = rate;
+
+    Server srv(o, 'E');
+    ssb::Session s;
+    if (!srv.connect([&]() { return ssb::open_session(srv.endpoint(), s, 200) && s.code == 'E'; })) return r;
+    Window w(o, srv.pid());
+
+    std::vector<uint8_t> buf(payload, 0x33);
+    ssb::FrameWriter writer;
+    ssb::TickScheduler ticks((uint64_t)(1e9 / rate));
+    ticks.calibrate();
+    ticks.start();
+    uint64_t frames = 0, skipped_at_measure = 0;
+    bool began = false;
+    r.ok = true;
+    for (uint64_t seq = 0;; ++seq)
+    {
+        uint64_t tick = ticks.wait();
+        if (tick >= w.end) break;
+        if (!began && w.measuring(tick))
+        {
+            ticks.misses().reset();
+            skipped_at_measure = ticks.skipped();
+            w.begin();
+            began = true;
+        }
+        writer.begin(ssb::make_header(ssb::FRAME_DATA, 0, seq, (uint32_t)payload), buf.data());
+        ssb::WriteResult res;
+        while ((res = writer.flush(s.data)) == ssb::WriteResult::Blocked)
+            if (!wait_fd(s.data, POLLOUT)) break;
+        if (res != ssb::WriteResult::Done)
+        {
+            r.ok = false;
+            break;
+        }
+        if (began) ++frames;
+    }
+    if (began) w.finish(r);
+    r.skipped = ticks.skipped() - skipped_at_measure;
+    r.msgs_per_s = frames / o.duration;
+    r.gbps = frames * (payload + ssb::FRAME_HEADER_SIZE) / o.duration / 1e9;
+    fill_percentiles(r, ticks.misses());
+    return r;
+}
+
+// ---- JSON ----
+
+// One result per line, so a baseline can be read back without a parser.
+void write_json(FILE* f, const Result& r, bool last)
+{
+    fprintf(f,
+        "  {\"key\": \"%s\", \"scenario\": \"%s\", \"payload\": %zu, \"connections\": %u, \"rate\": %g, "
+        "\"ok\": %s, \"gbps\": %.4f, \"msgs_per_s\": %.1f, \"p50_us\": %.2f, \"p99_us\": %.2f, "
+        "\"p999_us\": %.2f, \"max_us\": %.2f, \"lost\": %llu, \"skipped\": %llu, "
+        "\"client_cpu_s\": %.4f, \"server_cpu_s\": %.4f, \"client_vcsw\": %llu, \"client_ivcsw\": %llu, "
+        "\"server_vcsw\": %llu, \"server_ivcsw\": %llu}%s\n",
+        r.key().c_str(), r.scenario.c_str(), r.payload, r.connections, r.rate, r.ok ? "true" : "false", r.gbps,
+        r.msgs_per_s, r.p50_us, r.p99_us, r.p999_us, r.max_us, (unsigned long long)r.lost,
+        (unsigned long long)r.skipped, r.client_cpu_s, r.server_cpu_s, (unsigned long long)r.client_vcsw,
+        (unsigned long long)r.client_ivcsw, (unsigned long long)r.server_vcsw,
+        (unsigned long long)r.server_ivcsw, last ? "" : ",");
+}
+
+bool json_number(const std::string& line, const char* field, double& out)
+{
+    std::string pat = std::string("\"") + field + "\": ";
+    size_t at = line.find(pat);
+    if (at == std::string::npos) return false;
+    out = atof(line.c_str() + at + pat.size());
+    return true;
+}
+
+struct Baseline
+{
+    std::string key;
+    double gbps = 0, p99_us = 0, cpu_s = 0;
+};
+
+std::vector<Baseline> read_baseline(const std::string& path)
+{
+    std::vector<Baseline> out;
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return out;
+    char line[2048];
+    while (fgets(line, sizeof(line), f))
+    {
+        std::string l = line;
+        size_t k = l.find("\"key\": \"");
+        if (k == std::string::npos) continue;
+        k += 8;
+        Baseline b;
+        b.key = l.substr(k, l.find('"', k) - k);
+        double c = 0, s = 0;
+        json_number(l, "gbps", b.gbps);
+        json_number(l, "p99_us", b.p99_us);
+        json_number(l, "client_cpu_s", c);
+        json_number(l, "server_cpu_s", s);
+        b.cpu_s = c + s;
+        out.push_back(b);
+    }
+    fclose(f);
+    return out;
+}
+
+// Flags throughput below, p99 above, or CPU per byte above the baseline by
+// more than the tolerance. Latencies within 5 us count as noise.
+int compare(const std::vector<Result>& results, const std::string& path, double tol_pct)
+{
+    std::vector<Baseline> base = read_baseline(path);
+    if (base.empty())
+    {
+        printf("[BENCH] no results in baseline %s\n", path.c_str());
+        return 1;
+    }
+    const double tol = tol_pct / 100.0;
+    int regressions = 0;
+    printf("[BENCH] vs %s (tolerance %.0f%%)\n", path.c_str(), tol_pct);
+    for (const Result& r : results)
+    {
+        const Baseline* b = nullptr;
+        for (const Baseline& x : base)
+            if (x.key == r.key()) b = &x;
+        if (!b)
+        {
+            printf("[BENCH] %-32s new\n", r.key().c_str());
+            continue;
+        }
+        char what[160] = "";
+        size_t n = 0;
+        if (b->gbps > 0 && r.gbps < b->gbps * (1 - tol))
+            n += snprintf(what + n, sizeof(what) - n, " gbps %.3f -> %.3f", b->gbps, r.gbps);
+        if (b->p99_us > 0 && r.p99_us > b->p99_us * (1 + tol) && r.p99_us - b->p99_us > 5)
+            n += snprintf(what + n, sizeof(what) - n, " p99 %.1f -> %.1f us", b->p99_us, r.p99_us);
+        double cpu = r.client_cpu_s + r.server_cpu_s;
+        if (b->gbps > 0 && r.gbps > 0 && cpu / r.gbps > (b->cpu_s / b->gbps) * (1 + tol) && cpu - b->cpu_s > 0.05)
+            n += snprintf(what + n, sizeof(what) - n, " cpu/GB %.3f -> %.3f", b->cpu_s / b->gbps, cpu / r.gbps);
+        if (!r.ok) n += snprintf(what + n, sizeof(what) - n, " run failed");
+        if (n) ++regressions;
+        printf("[BENCH] %-32s %s%s\n", r.key().c_str(), n ? "REGRESSION" : "ok", what);
+    }
+
+    // a baseline run with no result this time was skipped or dropped
+    int missing = 0;
+    for (const Baseline& b : base)
+    {
+        bool found = false;
+        for (const Result& r : results)
+            if (r.key() == b.key) found = true;
+        if (found) continue;
+        printf("[BENCH] %-32s MISSING\n", b.key.c_str());
+        ++missing;
+    }
+    printf("[BENCH] %d regression%s, %d missing\n", regressions, regressions == 1 ? "" : "s", missing);
+    return regressions || missing ? 1 : 0;
+}
+
+// ---- options ----
+
+std::vector<double> number_list(const char* s)
+{
+    std::vector<double> v;
+    for (const char* p = s; *p;)
+    {
+        v.push_back(atof(p));
+        const char* c = strchr(p, ',');
+        if (!c) break;
+        p = c + 1;
+    }
+    return v;
+}
+
+std::vector<std::string> word_list(const char* s)
+{
+    std::vector<std::string> v;
+    std::string cur;
+    for (const char* p = s;; ++p)
+    {
+        if (*p == ',' || !*p)
+        {
+            if (!cur.empty()) v.push_back(cur);
+            cur.clear();
+            if (!*p) break;
+        }
+        else
+            cur += *p;
+    }
+    return v;
+}
+
+bool parse(int argc, char** argv, Options& o)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* eq = strchr(argv[i], '=');
+        if (!eq) return false;
+        std::string k(argv[i], eq - argv[i]);
+        const char* v = eq + 1;
+        if (k == "scenarios") o.scenarios = word_list(v);
+        else if (k == "payloads") o.payloads = number_list(v);
+        else if (k == "connections") o.connections = number_list(v);
+        else if (k == "rates") o.rates = number_list(v);
+        else if (k == "ping_hz") o.ping_hz = atof(v);
+        else if (k == "warmup") o.warmup = atof(v);
+        else if (k == "duration") o.duration = atof(v);
+        else if (k == "server") o.server = v;
+        else if (k == "port") o.port = atoi(v);
+        else if (k == "out") o.out = v;
+        else if (k == "baseline") o.baseline = v;
+        else if (k == "tolerance") o.tolerance = atof(v);
+        else return false;
+    }
+    for (double p : o.payloads)
+        if (p < 1 || p > ssb::FRAME_MAX_PAYLOAD) return false;
+    return o.duration > 0 && o.warmup >= 0 && o.ping_hz > 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options o;
+    if (!parse(argc, argv, o))
+    {
+        printf("usage: ssb_bench [scenarios=latency,throughput,combined,endurance] [payloads=64,...,4194304]\n"
+               "                 [connections=1,...] [rates=1000,...] [ping_hz=100] [warmup=1] [duration=3]\n"
+               "                 [server=../servers/ssb_server] [port=5050] [out=ssb_bench.json]\n"
+               "                 [baseline=file.json] [tolerance=10]\n");
+        return 2;
+    }
+    if (access(o.server.c_str(), X_OK) != 0)
+    {
+        printf("[BENCH] cannot run %s (build examples/servers/ssb_server.cpp, or pass server=)\n", o.server.c_str());
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<Result> results;
+    printf("[BENCH] %-10s %8s %5s %7s %9s %11s %9s %9s %9s %6s %7s %7s\n", "scenario", "payload", "conn", "rate",
+        "GB/s", "msgs/s", "p50_us", "p99_us", "p99.9_us", "lost", "cli_cpu", "srv_cpu");
+    auto add = [&](const Result& r)
+        {
+            printf("[BENCH] %-10s %8zu %5u %7g %9.3f %11.0f %9.1f %9.1f %9.1f %6llu %7.2f %7.2f%s\n",
+                r.scenario.c_str(), r.payload, r.connections, r.rate, r.gbps, r.msgs_per_s, r.p50_us, r.p99_us,
+                r.p999_us, (unsigned long long)r.lost, r.client_cpu_s, r.server_cpu_s, r.ok ? "" : "  FAILED");
+            fflush(stdout);
+            results.push_back(r);
+            // let the one-shot server exit and free the ports
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        };
+
+    for (const std::string& sc : o.scenarios)
+        for (double p : o.payloads)
+        {
+            size_t payload = (size_t)p;
+            if (sc == "latency")
+                for (double rate : o.rates) add(run_latency(o, payload, rate));
+            else if (sc == "throughput")
+                for (double c : o.connections)
+                    add(run_throughput(o, payload, (uint32_t)std::min<double>(std::max(c, 1.0), ssb::STRIPE_MAX)));
+            else if (sc == "combined")
+                add(run_combined(o, payload));
+            else if (sc == "endurance")
+                for (double rate : o.rates) add(run_endurance(o, payload, rate));
+            else
+            {
+                printf("[BENCH] unknown scenario %s\n", sc.c_str());
+                return 2;
+            }
+        }
+
+    if (FILE* f = fopen(o.out.c_str(), "w"))
+    {
+        fprintf(f, "{\n \"warmup_s\": %g, \"duration_s\": %g, \"cpus\": %ld,\n \"results\": [\n", o.warmup, o.duration,
+            sysconf(_SC_NPROCESSORS_ONLN));
+        for (size_t i = 0; i < results.size(); ++i) write_json(f, results[i], i + 1 == results.size());
+        fprintf(f, " ]\n}\n");
+        fclose(f);
+        printf("[BENCH] %zu results in %s\n", results.size(), o.out.c_str());
+    }
+    else
+        printf("[BENCH] cannot write %s\n", o.out.c_str());
+
+    bool all_ok = true;
+    for (const Result& r : results) all_ok &= r.ok;
+    int rc = all_ok ? 0 : 1;
+    if (!o.baseline.empty()) rc |= compare(results, o.baseline, o.tolerance);
+    return rc;
+}
@@ -0,0 +1,128 @@
+// ssb_stats.cpp
+// Tails the shared-memory stats page (ssb/metrics.h) of a running client or
+// server: one line per thread block every interval, with counter rates and
+// the block's latency percentiles. Maps the page read-only; the process it
+// watches never notices.
+//
+// usage: ssb_stats                      list pages in /dev/shm
+//        ssb_stats <tag> [interval_ms]  tail /dev/shm/ssb-stats.<tag>
+#include <dirent.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "ssb/metrics.h"
+
+namespace
+{
+
+int list_pages()
+{
+    DIR* d = opendir("/dev/shm");
+    if (!d) return 1;
+    int n = 0;
+    while (dirent* e = readdir(d))
+    {
+        if (strncmp(e->d_name, "ssb-stats.", 10) != 0) continue;
+        printf("%s\n", e->d_name + 10);
+        ++n;
+    }
+    closedir(d);
+    if (!n) printf("no stats pages in /dev/shm\n");
+    return n ? 0 : 1;
+}
+
+bool page_exists(const char* tag)
+{
+    char path[96];
+    ssb::StatsPage::path_for(tag, path, sizeof(path));
+    char full[128];
+    snprintf(full, sizeof(full), "/dev/shm%s", path);
+    return access(full, F_OK) == 0;
+}
+
+// 1234567 -> "1.23M"
+const char* human(double v, char* out, size_t len)
+{
+    const char* units = " kMGT";
+    int u = 0;
+    while (v >= 1000.0 && u < 4) { v /= 1000.0; ++u; }
+    if (u) snprintf(out, len, "%.2f%c", v, units[u]);
+    else snprintf(out, len, "%.0f", v);
+    return out;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) return list_pages();
+    const char* tag = argv[1];
+    int interval_ms = (argc > 2) ? atoi(argv[2]) : 1000;
+    if (interval_ms <= 0) interval_ms = 1000;
+
+    ssb::StatsPage page;
+    if (!page.open(tag))
+    {
+        printf("cannot open stats page '%s' (missing or different layout version)\n", tag);
+        return 1;
+    }
+    printf("[STATS] %s | pid %llu | layout v%u\n", tag,
+        (unsigned long long)page.header()->pid, page.header()->version);
+
+    uint64_t prev[ssb::StatsPage::MAX_THREADS][ssb::METRIC_COUNT] = {};
+    uint32_t generation = page.generation() + 1; // force a header on the first round
+    auto last = std::chrono::steady_clock::now();
+
+    while (page_exists(tag))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+        auto now = std::chrono::steady_clock::now();
+        double dt = std::chrono::duration<double>(now - last).count();
+        last = now;
+
+        uint32_t g = page.generation();
+        if (g != generation)
+        {
+            // blocks were claimed or released: rates restart from here
+            generation = g;
+            for (uint32_t i = 0; i < ssb::StatsPage::MAX_THREADS; ++i)
+                for (uint32_t m = 0; m < ssb::METRIC_COUNT; ++m)
+                    prev[i][m] = page.slot(i)->get((ssb::Metric)m);
+            printf("%-12s %7s %9s %9s %9s %9s %9s %9s %7s %7s %5s %5s %10s %10s\n",
+                "thread", "state", "tx B/s", "rx B/s", "tx fr/s", "rx fr/s", "sysc/s", "eagain/s",
+                "drops", "stale", "reco", "crc", "p50 us", "p99 us");
+            fflush(stdout);
+            continue;
+        }
+
+        for (uint32_t i = 0; i < ssb::StatsPage::MAX_THREADS; ++i)
+        {
+            const ssb::ThreadMetrics* t = page.slot(i);
+            uint32_t state = t->state.load(std::memory_order_acquire);
+            if (state == ssb::ThreadMetrics::FREE) continue;
+
+            uint64_t cur[ssb::METRIC_COUNT];
+            for (uint32_t m = 0; m < ssb::METRIC_COUNT; ++m)
+                cur[m] = t->get((ssb::Metric)m);
+            auto rate = [&](ssb::Metric m) { return (double)(cur[m] - prev[i][m]) / dt; };
+
+            char b[6][16];
+            printf("%-12.12s %7s %9s %9s %9s %9s %9s %9s %7llu %7llu %5llu %5llu %10.1f %10.1f\n",
+                t->name, state == ssb::ThreadMetrics::LIVE ? "live" : "exited",
+                human(rate(ssb::METRIC_BYTES_TX), b[0], 16), human(rate(ssb::METRIC_BYTES_RX), b[1], 16),
+                human(rate(ssb::METRIC_FRAMES_TX), b[2], 16), human(rate(ssb::METRIC_FRAMES_RX), b[3], 16),
+                human(rate(ssb::METRIC_SYSCALLS), b[4], 16), human(rate(ssb::METRIC_EAGAIN), b[5], 16),
+                (unsigned long long)cur[ssb::METRIC_DROPS], (unsigned long long)cur[ssb::METRIC_STALE],
+                (unsigned long long)cur[ssb::METRIC_RECONNECTS], (unsigned long long)cur[ssb::METRIC_CHECKSUM_BAD],
+                t->latency.percentile(50.0) / 1e3, t->latency.percentile(99.0) / 1e3);
+            memcpy(prev[i], cur, sizeof(cur));
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+    printf("[STATS] %s is gone\n", tag);
+    return 0;
+}
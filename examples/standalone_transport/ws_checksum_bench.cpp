@@ -0,0 +1,224 @@
+// ws_checksum_bench.cpp
+// Cost of the per-frame CRC32C (ssb/checksum.h), and a check that a
+// corrupted frame is caught.
+//
+//   crc        raw crc32c() speed over one payload, hardware path and the
+//              scalar fallback
+//   loopback   frames over loopback TCP, sender (FrameWriter) and receiver
+//              (FrameReader) in this process, checksums off vs on. The
+//              receiver verifies every checked frame, so both ends pay.
+//              Rounds alternate off/on and the best of each is kept, which
+//              takes most of the scheduler noise out of the comparison.
+//   corrupt    one payload byte flipped after its checksum was taken: with
+//              `count` the receiver must report one bad frame and carry
+//              on, with `fail` it must stop at that frame
+//
+// The goal is under 5% loss of loopback GB/s at 64 KB and 4 MB frames;
+// the run exits 1 if a corrupted frame goes unnoticed.
+//
+// usage: ws_checksum_bench [seconds_per_round] [rounds] [payload_bytes ...]
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "ssb/checksum.h"
+#include "ssb/clock.h"
+#include "ssb/frame.h"
+#include "ssb/session.h"
+
+namespace
+{
+
+// Loopback TCP pair; the send side non-blocking, the receive side blocking.
+bool make_pair(int& tx, int& rx)
+{
+    int l = ssb::listen_tcp("127.0.0.1", 0, 1);
+    if (l < 0) return false;
+    sockaddr_in a{};
+    socklen_t len = sizeof(a);
+    getsockname(l, (sockaddr*)&a, &len);
+    tx = ssb::connect_tcp("127.0.0.1", ntohs(a.sin_port), 1000);
+    rx = tx >= 0 ? accept(l, nullptr, nullptr) : -1;
+    close(l);
+    return tx >= 0 && rx >= 0;
+}
+
+double cpu_seconds()
+{
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+double crc_gbps(bool hardware, const std::vector<uint8_t>& buf, double seconds)
+{
+    uint64_t bytes = 0;
+    uint32_t sink = 0;
+    const uint64_t t0 = ssb::mono_ns(), end = t0 + (uint64_t)(seconds * 1e9);
+    uint64_t now = t0;
+    while (now < end)
+    {
+        sink ^= hardware ? ssb::crc32c(buf.data(), buf.size()) : ssb::crc32c_scalar(buf.data(), buf.size());
+        bytes += buf.size();
+        now = ssb::mono_ns();
+    }
+    if (sink == 0x12345678) printf(" ");  // keep the loop
+    return bytes / ((now - t0) / 1e9) / 1e9;
+}
+
+struct Run
+{
+    double gbps = 0;
+    double cpu_per_gb = 0;
+    uint64_t frames = 0;
+    uint64_t ok = 0;
+    uint64_t bad = 0;
+    bool stopped = false;     // the receiver rejected a frame
+    uint64_t stopped_at = 0;  // seq of that frame
+};
+
+// Streams `payload`-byte frames for `seconds`. With `corrupt_seq` >= 0 that
+// frame's payload is flipped after its checksum was taken.
+Run stream(size_t payload, bool checksum, double seconds, ssb::ChecksumPolicy policy, int64_t corrupt_seq = -1)
+{
+    Run run;
+    int tx = -1, rx = -1;
+    if (!make_pair(tx, rx)) return run;
+
+    std::atomic<uint64_t> received{ 0 };
+    std::atomic<bool> closed{ false };
+    std::thread receiver([&]()
+        {
+            ssb::FrameReader reader(ssb::FRAME_HEADER_SIZE + payload + ssb::CHECKSUM_SIZE);
+            ssb::FrameChecker checker(policy);
+            const ssb::FrameHeader* h;
+            const uint8_t* p;
+            for (;;)
+            {
+                pollfd pfd{ rx, POLLIN, 0 };
+                if (poll(&pfd, 1, 1000) <= 0 || reader.fill(rx) < 0) break;
+                bool go = true;
+                while (go && reader.next(h, p))
+                {
+                    ssb::ChecksumResult r = ssb::ChecksumResult::Unchecked;
+                    if (policy != ssb::ChecksumPolicy::Off) r = ssb::verify_frame(*h, p);
+                    if (r == ssb::ChecksumResult::Ok) ++run.ok;
+                    if (r == ssb::ChecksumResult::Bad) ++run.bad;
+                    if (!checker.accept(r))
+                    {
+                        run.stopped = true;
+                        run.stopped_at = h->seq;
+                        go = false;
+                    }
+                    received.fetch_add(1, std::memory_order_relaxed);
+                }
+                if (!go || reader.bad()) break;
+            }
+            closed = true;  // fail closed: the sender gives up
+        });
+
+    std::vector<uint8_t> buf(payload, 0xA5);
+    ssb::FrameWriter writer;
+    const double cpu0 = cpu_seconds();
+    const uint64_t t0 = ssb::mono_ns(), end = t0 + (uint64_t)(seconds * 1e9);
+    uint64_t seq = 0, bytes = 0;
+    for (; ssb::mono_ns() < end; ++seq)
+    {
+        ssb::FrameHeader h = ssb::make_header(ssb::FRAME_DATA, 0, seq, (uint32_t)payload);
+        if (checksum)
+            ssb::begin_checked(writer, h, buf.data());
+        else
+            writer.begin(h, buf.data());
+        if ((int64_t)seq == corrupt_seq) buf[payload / 2] ^= 0x01;
+
+        ssb::WriteResult r;
+        while ((r = writer.flush(tx)) == ssb::WriteResult::Blocked && !closed)
+        {
+            pollfd pfd{ tx, POLLOUT, 0 };
+            poll(&pfd, 1, 100);
+        }
+        if ((int64_t)seq == corrupt_seq) buf[payload / 2] ^= 0x01;
+        if (r != ssb::WriteResult::Done) break;
+        bytes += writer.frame_size();
+    }
+    const double elapsed = (ssb::mono_ns() - t0) / 1e9;
+    shutdown(tx, SHUT_WR);
+    receiver.join();
+    const double cpu = cpu_seconds() - cpu0;
+    close(tx);
+    close(rx);
+
+    run.frames = received.load();
+    run.gbps = bytes / elapsed / 1e9;
+    run.cpu_per_gb = bytes ? cpu / (bytes / 1e9) : 0;
+    return run;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    double seconds = (argc > 1) ? atof(argv[1]) : 2.0;
+    int rounds = (argc > 2) ? atoi(argv[2]) : 3;
+    std::vector<size_t> payloads;
+    for (int i = 3; i < argc; ++i) payloads.push_back((size_t)atoll(argv[i]));
+    if (payloads.empty()) payloads = { 65536, 4u << 20 };
+    if (seconds <= 0 || rounds < 1)
+    {
+        printf("usage: ws_checksum_bench [seconds_per_round] [rounds] [payload_bytes ...]\n");
+        return 1;
+    }
+    for (size_t p : payloads)
+        if (p < 2 || p + ssb::CHECKSUM_SIZE > ssb::FRAME_MAX_PAYLOAD)
+        {
+            printf("[CRC] payload %zu out of range\n", p);
+            return 1;
+        }
+    printf("[CRC] crc32c: %s\n", ssb::crc32c_impl());
+
+    for (size_t p : payloads)
+    {
+        std::vector<uint8_t> buf(p, 0x5A);
+        printf("[CRC] %8zu B  crc %s %6.2f GB/s | scalar %5.2f GB/s\n", p, ssb::crc32c_impl(),
+            crc_gbps(true, buf, seconds / 2), crc_gbps(false, buf, seconds / 2));
+    }
+
+    for (size_t p : payloads)
+    {
+        Run off, on;
+        for (int r = 0; r < rounds; ++r)
+        {
+            Run a = stream(p, false, seconds, ssb::ChecksumPolicy::Off);
+            Run b = stream(p, true, seconds, ssb::ChecksumPolicy::FailClosed);
+            if (a.gbps > off.gbps) off = a;
+            if (b.gbps > on.gbps) on = b;
+        }
+        double cost = off.gbps > 0 ? (1 - on.gbps / off.gbps) * 100 : 0;
+        printf("[CRC] %8zu B  loopback off %6.3f GB/s (%.3f cpu s/GB) | on %6.3f GB/s (%.3f cpu s/GB, %llu ok, %llu bad)"
+               " | cost %+.1f%%%s\n",
+            p, off.gbps, off.cpu_per_gb, on.gbps, on.cpu_per_gb, (unsigned long long)on.ok,
+            (unsigned long long)on.bad, cost, cost < 5 ? "" : "  (over the 5% goal)");
+    }
+
+    // corruption: frame 10 of a short run of the smallest payload
+    bool caught = true;
+    const size_t p = payloads.front();
+    Run counted = stream(p, true, 0.3, ssb::ChecksumPolicy::Count, 10);
+    Run closed = stream(p, true, 0.3, ssb::ChecksumPolicy::FailClosed, 10);
+    bool count_ok = counted.bad == 1 && !counted.stopped && counted.frames > 11;
+    bool fail_ok = closed.bad == 1 && closed.stopped && closed.stopped_at == 10 && closed.frames == 11;
+    printf("[CRC] corrupt frame 10, count: %llu bad of %llu frames, %s\n", (unsigned long long)counted.bad,
+        (unsigned long long)counted.frames, count_ok ? "carried on" : "WRONG");
+    printf("[CRC] corrupt frame 10, fail:  %llu bad, %s\n", (unsigned long long)closed.bad,
+        fail_ok ? "closed at frame 10" : "WRONG");
+    caught = count_ok && fail_ok;
+    return caught ? 0 : 1;
+}
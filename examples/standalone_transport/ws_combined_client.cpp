@@ -1,184 +1,471 @@
-﻿#define WIN32_LEAN_AND_MEAN
-#define NOMINMAX
-
-#include <winsock2.h>
-#include <ws2tcpip.h>
 #include <chrono>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <thread>
 #include <atomic>
 #include <vector>
 #include <algorithm>
 #include <cstdint>
-
-#pragma comment(lib, "ws2_32.lib")
-
-static SOCKET connect_tcp(int port)
-{
-    SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (s == INVALID_SOCKET) return INVALID_SOCKET;
-
-    int flag = 1;
-    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (char*)&flag, sizeof(flag));
-
-    sockaddr_in addr{};
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(port);
-    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
-
-    if (connect(s, (sockaddr*)&addr, sizeof(addr)) != 0)
-    {
-        closesocket(s);
-        return INVALID_SOCKET;
-    }
-    return s;
-}
+#include <functional>
+#include <memory>
+
+#include "ssb/capture.h"
+#include "ssb/checksum.h"
+#include "ssb/clock_sync.h"
+#include "ssb/frame.h"
+#include "ssb/histogram.h"
+#include "ssb/lowlat.h"
+#include "ssb/metrics.h"
+#include "ssb/probe_client.h"
+#include "ssb/session.h"
+#include "ssb/zerocopy.h"
 
 int main(int argc, char** argv)
 {
     double duration = (argc > 1) ? atof(argv[1]) : 86400.0; // default 24h
-
-    WSADATA wsa;
-    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
-        return 1;
-
-    SOCKET cmd = connect_tcp(5050);
-    if (cmd == INVALID_SOCKET)
-        return 1;
-
-    char code = 0;
-    if (recv(cmd, &code, 1, MSG_WAITALL) != 1 || code != 'C')
+    size_t payload_size = (argc > 2) ? (size_t)atoll(argv[2]) : 65536;
+    // bulk mode: frames >= this many bytes go out with MSG_ZEROCOPY (0 = off)
+    size_t zc_threshold = (argc > 3) ? (size_t)atoll(argv[3]) : 0;
+    // latency under load: pipelined probes per second on cmd (0 = one ping per 100 ms)
+    double probe_rate = (argc > 4) ? atof(argv[4]) : 0.0;
+    uint32_t probe_in_flight = (argc > 5) ? (uint32_t)atoi(argv[5]) : 64;
+    // "default" or "lowlat[:options]", see ssb/lowlat.h
+    ssb::LatencyProfile profile;
+    if (!ssb::parse_profile((argc > 6) ? argv[6] : "default", profile))
+    {
+        printf("[COMBINED] bad profile '%s'\n", argv[6]);
         return 1;
-
-    SOCKET data = connect_tcp(5051);
-    if (data == INVALID_SOCKET)
+    }
+    // capture prefix: every data frame sent goes to <prefix>.*.ssbcap (copy mode)
+    const char* capture_prefix = (argc > 7 && argv[7][0]) ? argv[7] : nullptr;
+    // options, comma-separated:
+    //   crc     every data frame carries a CRC32C trailer (copy mode), see ssb/checksum.h
+    //   sync    pings are clock sync requests, and data frames are stamped in the
+    //           server's clock so it can report their one-way age (ssb/clock_sync.h)
+    //   resume  a lost connection is reopened with backoff and the stream
+    //           carries on at its seq (ResumableSession, ssb/resume.h)
+    auto option = [&](const char* name)
+        {
+            if (argc <= 8) return false;
+            size_t n = strlen(name);
+            for (const char* o = argv[8]; *o; o += strcspn(o, ","), o += (*o == ','))
+                if (strncmp(o, name, n) == 0 && (o[n] == ',' || o[n] == 0)) return true;
+            return false;
+        };
+    bool checksum = option("crc");
+    bool sync_clock = option("sync");
+    bool resume = option("resume");
+    if (checksum && zc_threshold)
+        printf("[COMBINED] checksums need copy mode, sending without\n");
+    else if (checksum)
+        printf("[COMBINED] CRC32C per frame (%s)\n", ssb::crc32c_impl());
+
+    // Every data connection opens with FRAME_RESUME, so the server can
+    // tell a reconnect from loss; the data seq lives in the session.
+    ssb::ResumableSession rs;
+    if (!rs.connect(0, 5000) || rs.session().code != 'C')
         return 1;
+    ssb::Session& s = rs.session();
 
-    std::atomic<bool> stop{ false };
+    // Low-latency profile: cmd (this thread) is I/O thread 0, data is 1.
+    auto log_tuning = [&](const char* name, const ssb::ThreadTuning& th, const ssb::SocketTuning& so)
+        {
+            char line[256];
+            ssb::format_tuning(th, so, line, sizeof(line));
+            printf("[COMBINED] %s lowlat: %s\n", name, line);
+        };
+    if (profile.low_latency)
+    {
+        log_tuning("cmd", ssb::apply_thread(profile, 0), ssb::apply_socket(s.cmd, profile));
+        printf("[COMBINED] cmd loop %s\n", profile.spin ? "spins on epoll" : "blocks in epoll");
+    }
+    if (resume)
+        printf("[COMBINED] session %016llx, reconnects resume the stream\n", (unsigned long long)rs.token());
 
     // ---- throughput ----
-    std::atomic<uint64_t> total_bytes{ 0 };
-    uint64_t window_bytes = 0;
+    // Per-thread counters in /dev/shm/ssb-stats.combined_client (tail it
+    // with ssb_stats); a private page if shared memory is unavailable.
+    ssb::StatsPage stats;
+    if (!stats.create("combined_client")) stats.create(nullptr);
     uint64_t last_bytes_snapshot = 0;
 
-    // ---- latency ----
-    double window_lat_sum = 0.0;
-    uint64_t window_lat_count = 0;
-
-    double total_lat_sum = 0.0;
-    uint64_t total_lat_count = 0;
-
-    // ---- DATA THREAD ----
-    std::thread data_thread([&]()
+    // ---- latency (ns, corrected for coordinated omission) ----
+    constexpr uint64_t PING_INTERVAL_NS = 100000000;
+    ssb::Histogram window_lat;
+    ssb::Histogram total_lat;
+
+    // ---- clock sync (cmd thread) ----
+    // The data thread only needs the current offset to the server's clock.
+    ssb::ClockSync clock;
+    std::atomic<int64_t> peer_offset{ 0 };
+    std::atomic<bool> peer_time{ false };
+    ssb::Histogram window_up, window_down;  // cmd one-way times, ns
+    auto stamp = [&](ssb::FrameHeader& h)
         {
-            const size_t PACKET_SIZE = 65536;
-            std::vector<uint8_t> buf(PACKET_SIZE);
-            uint32_t counter = 0;
+            if (!peer_time.load(std::memory_order_relaxed)) return;
+            h.timestamp_ns += (uint64_t)peer_offset.load(std::memory_order_relaxed);
+            h.flags |= ssb::FRAME_FLAG_PEER_TIME;
+        };
 
-            while (!stop)
-            {
-                memcpy(buf.data(), &counter, sizeof(counter));
-                int sent = send(data, (char*)buf.data(), (int)buf.size(), 0);
-                if (sent != (int)buf.size())
-                    break;
+    // one capture for the whole run, across reconnects (copy mode)
+    ssb::CaptureWriter capture;
+    if (capture_prefix && !zc_threshold && !capture.open(capture_prefix))
+        printf("[COMBINED] cannot create capture %s, not capturing\n", capture_prefix);
 
-                total_bytes += sent;
-                counter++;
-            }
-        });
+    ssb::ScopedThreadMetrics cm(stats, "cmd");
 
     auto start_time = std::chrono::steady_clock::now();
-    auto last_ping = start_time;
     auto last_report = start_time;
-
-    while (true)
+    auto send_time = start_time;
+    const uint64_t end_ns = ssb::mono_ns() + (uint64_t)(duration * 1e9);
+
+    // a ping is an 8-byte double, or a sync request with "sync"
+    uint8_t echo[ssb::SYNC_FRAME_SIZE];
+    size_t echo_got = 0;
+    size_t echo_size = sync_clock ? ssb::SYNC_FRAME_SIZE : sizeof(double);
+    uint64_t sync_id = 0;
+    bool in_flight = false;
+
+    // A sync reply: one more sample for the estimate, and the one-way times
+    // of this exchange. A server that only echoes gets plain pings from here on.
+    auto sync_reply = [&](uint64_t t4)
+        {
+            uint64_t id = 0;
+            ssb::SyncSample smp;
+            ssb::SyncReply rep = ssb::parse_sync_reply(echo, t4, id, smp);
+            if (rep == ssb::SyncReply::Unanswered)
+            {
+                printf("[COMBINED] server does not answer clock sync, plain pings\n");
+                echo_size = sizeof(double);
+                return;
+            }
+            if (rep != ssb::SyncReply::Ok || id != sync_id || !clock.add(smp)) return;
+            peer_offset.store((int64_t)(clock.to_remote(t4) - t4), std::memory_order_relaxed);
+            peer_time.store(true, std::memory_order_relaxed);
+            window_up.record((uint64_t)std::max<int64_t>(0, clock.uplink_ns(smp)));
+            window_down.record((uint64_t)std::max<int64_t>(0, clock.downlink_ns(smp)));
+        };
+    if (sync_clock && probe_rate > 0)
+        printf("[COMBINED] sync needs the stop-and-wait ping (probe rate 0), not syncing\n");
+    else if (sync_clock)
+        printf("[COMBINED] clock sync on cmd; data frames stamped in the server's clock\n");
+
+    // One pass per connection. Reactors, the probe client and the data
+    // thread are bound to the sockets, so a reconnect builds them again;
+    // counters, histograms and the seq carry over.
+    int rc = 0;
+    bool done = false;
+    for (;;)
     {
-        auto now = std::chrono::steady_clock::now();
-        double elapsed = std::chrono::duration<double>(now - start_time).count();
-        if (elapsed >= duration)
-            break;
-
-        // ---- latency ping every 100 ms ----
-        if (std::chrono::duration<double>(now - last_ping).count() >= 0.1)
+        ssb::Reactor data_reactor;
+        ssb::Reactor cmd_reactor;
+        // a socket failed: stop both sides, the run may resume
+        auto lost = [&]()
+            {
+                data_reactor.stop();
+                cmd_reactor.stop();
+            };
+
+        // ---- DATA THREAD ----
+        // Each payload goes out as one SSB frame (header + caller-owned payload
+        // in a single sendmsg); the frame seq replaces the memcpy'd counter.
+        // A frame cut off by a lost connection keeps its seq: the server
+        // counts it as lost in the break.
+        auto copy_sender = [&]()
+            {
+                std::vector<uint8_t> payload(payload_size);
+                ssb::FrameWriter writer;
+                ssb::ScopedThreadMetrics m(stats, "data");
+                if (profile.low_latency)
+                    log_tuning("data", ssb::apply_thread(profile, 1), ssb::apply_socket(s.data, profile));
+
+                data_reactor.add(s.data, EPOLLOUT, [&](uint32_t ev)
+                    {
+                        if (ev & (EPOLLERR | EPOLLHUP))
+                        {
+                            lost();
+                            return false;
+                        }
+                        for (int i = 0; i < 64; ++i)
+                        {
+                            if (!writer.busy())
+                            {
+                                ssb::FrameHeader h = ssb::make_header(ssb::FRAME_DATA, 0, rs.take_seq(), (uint32_t)payload.size());
+                                stamp(h);
+                                if (checksum)
+                                    ssb::begin_checked(writer, h, payload.data());
+                                else
+                                    writer.begin(h, payload.data());
+                            }
+
+                            ssb::WriteResult r = writer.flush(s.data);
+                            m->add(ssb::METRIC_SYSCALLS);
+                            if (r == ssb::WriteResult::Failed)
+                            {
+                                lost();
+                                return false;
+                            }
+                            if (r == ssb::WriteResult::Blocked)
+                            {
+                                m->add(ssb::METRIC_EAGAIN);
+                                return false;
+                            }
+
+                            if (capture.is_open())
+                                capture.append_frame(ssb::CAPTURE_TX, writer.header(), payload.data(), ssb::mono_ns(),
+                                    writer.trailer(), writer.trailer_len());
+                            m->add(ssb::METRIC_BYTES_TX, writer.frame_size());
+                            m->add(ssb::METRIC_FRAMES_TX);
+                        }
+                        return true;
+                    });
+
+                data_reactor.run();
+            };
+
+        // Zero-copy bulk mode: frames are built in pooled buffers that stay
+        // pinned until their completion is reaped from the error queue, which
+        // the kernel signals as EPOLLERR.
+        auto zerocopy_sender = [&]()
+            {
+                ssb::ZeroCopySender tx(32, payload_size, zc_threshold);
+                if (!tx.attach(s.data))
+                    printf("[COMBINED] SO_ZEROCOPY unavailable, copying\n");
+                ssb::ScopedThreadMetrics m(stats, "data");
+                if (profile.low_latency)
+                    log_tuning("data", ssb::apply_thread(profile, 1), ssb::apply_socket(s.data, profile));
+
+                data_reactor.add(s.data, EPOLLOUT, [&](uint32_t ev)
+                    {
+                        if (ev & EPOLLHUP)
+                        {
+                            lost();
+                            return false;
+                        }
+                        if (ev & EPOLLERR)
+                            tx.reap(s.data);
+
+                        for (int i = 0; i < 64; ++i)
+                        {
+                            if (!tx.busy())
+                            {
+                                int b = tx.acquire();
+                                if (b < 0)
+                                    return false;   // pool pinned; resume on completion
+                                ssb::FrameHeader h = ssb::make_header(ssb::FRAME_DATA, 0, rs.take_seq(), (uint32_t)payload_size);
+                                stamp(h);
+                                tx.commit(b, h);
+                            }
+
+                            ssb::WriteResult r = tx.flush(s.data);
+                            m->add(ssb::METRIC_SYSCALLS);
+                            if (r == ssb::WriteResult::Failed)
+                            {
+                                lost();
+                                return false;
+                            }
+                            if (r == ssb::WriteResult::Blocked)
+                            {
+                                m->add(ssb::METRIC_EAGAIN);
+                                return false;
+                            }
+
+                            m->add(ssb::METRIC_BYTES_TX, ssb::FRAME_HEADER_SIZE + payload_size);
+                            m->add(ssb::METRIC_FRAMES_TX);
+                        }
+                        return true;
+                    });
+
+                data_reactor.run();
+            };
+
+        // With a probe rate the cmd socket carries pipelined probes instead of
+        // the stop-and-wait ping; latency is then counted from each probe's
+        // intended send time.
+        std::unique_ptr<ssb::ProbeClient> probe;
+        if (probe_rate > 0)
         {
-            last_ping = now;
-
-            double t = elapsed;
-            auto send_time = std::chrono::steady_clock::now();
-
-            if (send(cmd, (char*)&t, sizeof(double), 0) != sizeof(double))
+            probe.reset(new ssb::ProbeClient(cmd_reactor, s.cmd, probe_in_flight));
+            if (!probe->start())
+            {
+                rc = 1;
                 break;
+            }
+            probe->set_rate(probe_rate);
+            printf("[COMBINED] probing cmd at %.0f/s, %u in flight\n", probe_rate, probe_in_flight);
+        }
+        ssb::Histogram& window = probe ? probe->latency() : window_lat;
 
-            double echo = 0.0;
-            if (recv(cmd, (char*)&echo, sizeof(double), MSG_WAITALL) == sizeof(double))
-            {
-                double rtt_ms =
-                    std::chrono::duration<double>(
-                        std::chrono::steady_clock::now() - send_time
-                    ).count() * 1000.0;
+        std::thread data_thread(zc_threshold ? std::function<void()>(zerocopy_sender) : std::function<void()>(copy_sender));
 
-                window_lat_sum += rtt_ms;
-                window_lat_count++;
+        echo_got = 0;
+        in_flight = false;
+        if (!probe)
+            cmd_reactor.add(s.cmd, EPOLLIN, [&](uint32_t ev)
+            {
+                for (;;)
+                {
+                    ssize_t r = ssb::recv_nb(s.cmd, echo + echo_got, echo_size - echo_got);
+                    if (r < 0)
+                    {
+                        lost();
+                        return false;
+                    }
+                    if (r == 0)
+                        break;
+
+                    echo_got += r;
+                    if (echo_got == echo_size)
+                    {
+                        echo_got = 0;
+                        in_flight = false;
+
+                        uint64_t rtt_ns = (uint64_t)
+                            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::steady_clock::now() - send_time
+                            ).count();
+                        if (echo_size == ssb::SYNC_FRAME_SIZE)
+                            sync_reply(ssb::mono_ns());
+
+                        window_lat.record_corrected(rtt_ns, PING_INTERVAL_NS);
+                        cm->latency.record(rtt_ns);
+                        cm->add(ssb::METRIC_FRAMES_RX);
+                    }
+                }
+                if (ev & (EPOLLERR | EPOLLHUP))
+                    lost();
+                return false;
+            });
 
-                total_lat_sum += rtt_ms;
-                total_lat_count++;
-            }
-        }
+        // ---- latency ping every 100 ms ----
+        if (!probe)
+            cmd_reactor.add_timer(PING_INTERVAL_NS, PING_INTERVAL_NS, [&](uint64_t)
+            {
+                if (in_flight)
+                    return;
+
+                send_time = std::chrono::steady_clock::now();
+                uint8_t msg[ssb::SYNC_FRAME_SIZE];
+                double t = std::chrono::duration<double>(send_time - start_time).count();
+                if (echo_size == ssb::SYNC_FRAME_SIZE)
+                    ssb::make_sync_request(msg, ++sync_id, ssb::mono_ns());
+                else
+                    memcpy(msg, &t, sizeof(double));
+                if (ssb::send_nb(s.cmd, msg, echo_size) != (ssize_t)echo_size)
+                {
+                    lost();
+                    return;
+                }
+                cm->add(ssb::METRIC_FRAMES_TX);
+                in_flight = true;
+            });
 
         // ---- report every 5 seconds ----
-        if (std::chrono::duration<double>(now - last_report).count() >= 5.0)
+        cmd_reactor.add_timer(5000000000ull, 5000000000ull, [&](uint64_t)
+            {
+                auto now = std::chrono::steady_clock::now();
+                double elapsed = std::chrono::duration<double>(now - start_time).count();
+                double dt = std::chrono::duration<double>(now - last_report).count();
+                uint64_t cur_bytes = stats.total(ssb::METRIC_BYTES_TX);
+
+                uint64_t delta_bytes = cur_bytes - last_bytes_snapshot;
+                last_bytes_snapshot = cur_bytes;
+
+                double gbps_5s = (double)delta_bytes / 1e9 / dt;
+                double gbps_total = (double)cur_bytes / 1e9 / elapsed;
+
+                total_lat.merge(window);
+
+                char pct_5s[160], pct_all[160];
+                window.format(pct_5s, sizeof(pct_5s));
+                total_lat.format(pct_all, sizeof(pct_all));
+
+                printf(
+                    "[COMBINED][5s]  %.1f min | %.2f GB/s | lat %.3f ms | %s | pings %llu\n"
+                    "[COMBINED][ALL] %.1f min | %.2f GB/s | lat %.3f ms | %s | pings %llu\n\n",
+                    elapsed / 60.0,
+                    gbps_5s,
+                    window.mean() / 1e6,
+                    pct_5s,
+                    (unsigned long long)window.count(),
+                    elapsed / 60.0,
+                    gbps_total,
+                    total_lat.mean() / 1e6,
+                    pct_all,
+                    (unsigned long long)total_lat.count()
+                );
+                if (clock.ready())
+                    printf("[COMBINED][SYNC] offset %+.3f us +-%.3f | drift %+.3f ppm | cmd up p50 %.1f us, down p50 %.1f us\n\n",
+                        clock.offset_ns() / 1e3, clock.uncertainty_ns() / 1e3, clock.drift_ppm(),
+                        window_up.percentile(50) / 1e3, window_down.percentile(50) / 1e3);
+                window_up.reset();
+                window_down.reset();
+
+                // reset window stats
+                if (probe) probe->reset_stats();
+                else window_lat.reset();
+                last_report = now;
+            });
+
+        uint64_t now_ns = ssb::mono_ns();
+        cmd_reactor.add_timer(end_ns > now_ns ? end_ns - now_ns : 1, 0, [&](uint64_t)
+            {
+                done = true;
+                cmd_reactor.stop();
+            });
+
+        if (profile.low_latency && profile.spin)
+            cmd_reactor.run_spin();
+        else
+            cmd_reactor.run();
+
+        data_reactor.stop();
+        data_thread.join();
+        total_lat.merge(window);
+        if (probe) probe->reset_stats();
+        else window_lat.reset();
+
+        if (done || !resume)
+            break;
+
+        // ---- reconnect ----
+        printf("[COMBINED] connection lost, reconnecting\n");
+        rs.close();
+        now_ns = ssb::mono_ns();
+        if (now_ns >= end_ns || !rs.connect((end_ns - now_ns) / 1000000, 1000) || s.code != 'C')
         {
-            double dt = std::chrono::duration<double>(now - last_report).count();
-            uint64_t cur_bytes = total_bytes.load();
-
-            uint64_t delta_bytes = cur_bytes - last_bytes_snapshot;
-            last_bytes_snapshot = cur_bytes;
-
-            double gbps_5s = (double)delta_bytes / 1e9 / dt;
-            double gbps_total = (double)cur_bytes / 1e9 / elapsed;
-
-            double lat_5s = window_lat_count ? window_lat_sum / window_lat_count : 0.0;
-            double lat_total = total_lat_count ? total_lat_sum / total_lat_count : 0.0;
-
-            printf(
-                "[COMBINED][5s]  %.1f min | %.2f GB/s | lat %.3f ms | pings %llu\n"
-                "[COMBINED][ALL] %.1f min | %.2f GB/s | lat %.3f ms | pings %llu\n\n",
-                elapsed / 60.0,
-                gbps_5s,
-                lat_5s,
-                window_lat_count,
-                elapsed / 60.0,
-                gbps_total,
-                lat_total,
-                total_lat_count
-            );
-
-            // reset window stats
-            window_lat_sum = 0.0;
-            window_lat_count = 0;
-            last_report = now;
+            printf("[COMBINED] no session before the end of the run, giving up\n");
+            break;
         }
-
-        Sleep(1);
+        printf("[COMBINED] resumed (reconnect %u, %llu failed attempts)\n", rs.reconnects(),
+            (unsigned long long)rs.failed_attempts());
+        if (profile.low_latency)
+            log_tuning("cmd", ssb::ThreadTuning{}, ssb::apply_socket(s.cmd, profile));
     }
 
-    stop = true;
-    data_thread.join();
+    if (capture.is_open())
+        printf("[COMBINED] captured %llu frames in %u segments (%llu dropped)\n",
+            (unsigned long long)capture.records(), capture.segments(),
+            (unsigned long long)capture.dropped());
 
-    closesocket(cmd);
-    closesocket(data);
-    WSACleanup();
+    char pct[160];
+    total_lat.format(pct, sizeof(pct));
 
+    uint64_t total_bytes = stats.total(ssb::METRIC_BYTES_TX);
     printf(
-        "[COMBINED][FINAL] %.2f GB | avg %.2f GB/s | lat %.3f ms | pings %llu\n",
-        total_bytes.load() / 1e9,
-        (total_bytes.load() / 1e9) /
+        "[COMBINED][FINAL] %.2f GB | avg %.2f GB/s | lat %.3f ms | %s | pings %llu\n",
+        total_bytes / 1e9,
+        (total_bytes / 1e9) /
         std::chrono::duration<double>(
             std::chrono::steady_clock::now() - start_time
         ).count(),
-        total_lat_count ? total_lat_sum / total_lat_count : 0.0,
-        total_lat_count
+        total_lat.mean() / 1e6,
+        pct,
+        (unsigned long long)total_lat.count()
     );
+    if (rs.reconnects())
+        printf("[COMBINED] session %016llx survived %u reconnects\n", (unsigned long long)rs.token(), rs.reconnects());
 
-    return 0;
+    return rc;
 }
@@ -0,0 +1,333 @@
+// ws_conflate_test.cpp
+// Slow-consumer test for the latest-only send queue (ssb/conflate.h).
+// A producer emits one frame per stream per tick over loopback TCP to a
+// consumer that reads at a fixed byte rate below the producer's. Each
+// frame is stamped with its intended tick time; the consumer records how
+// old every frame is when it has been read.
+//
+//   blocking    FrameWriter, waiting for room (what the bulk paths do):
+//               the producer falls behind its schedule and the age of
+//               what arrives grows for as long as the overload lasts
+//   conflating  ConflatingSender: the producer never waits, a stream's
+//               unsent frame is replaced by its newer one, and the age
+//               stays bounded by the socket buffers
+//
+// Socket buffers are fixed small (sock_kb each side) so the backlog the
+// kernel can hide is known. The run fails if the conflating age is not
+// bounded: its max must stay under 4x the drain time of the buffers plus
+// two ticks, and its last second must be no older than its first.
+//
+// A third run pauses an otherwise fast consumer for half a second. While
+// the socket is full every stream gets newer frames; once it drains, no
+// frame may go out that its stream had already superseded when its first
+// byte reached the socket (checked on the write path), and every stream's
+// seqs must arrive in order.
+//
+// usage: ws_conflate_test [seconds] [streams] [tick_hz] [payload_bytes] [consumer_kBps] [sock_kb]
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "ssb/clock.h"
+#include "ssb/conflate.h"
+#include "ssb/frame.h"
+#include "ssb/histogram.h"
+#include "ssb/session.h"
+
+namespace
+{
+
+struct Options
+{
+    double seconds = 3.0;
+    uint32_t streams = 16;
+    double tick_hz = 100.0;
+    size_t payload = 4096;
+    double consumer_kbps = 2000.0;
+    int sock_kb = 32;
+};
+
+struct Result
+{
+    uint64_t produced = 0;
+    uint64_t delivered = 0;
+    uint64_t conflated = 0;
+    uint64_t late_ticks = 0;   // ticks the producer started behind schedule
+    uint64_t first_second_max_ns = 0;
+    uint64_t last_second_max_ns = 0;
+    uint64_t queued_max_ns = 0;
+    char pct[160] = "";
+    uint64_t max_ns = 0;
+};
+
+// Loopback TCP pair with fixed, small buffers; the send side non-blocking.
+bool make_pair(int sock_kb, int& tx, int& rx)
+{
+    int l = ssb::listen_tcp("127.0.0.1", 0, 1);
+    if (l < 0) return false;
+    sockaddr_in a{};
+    socklen_t len = sizeof(a);
+    getsockname(l, (sockaddr*)&a, &len);
+
+    int bytes = sock_kb << 10;
+    tx = ssb::connect_tcp("127.0.0.1", ntohs(a.sin_port), 1000);
+    rx = tx >= 0 ? accept(l, nullptr, nullptr) : -1;
+    close(l);
+    if (tx < 0 || rx < 0) return false;
+    setsockopt(tx, SOL_SOCKET, SO_SNDBUF, &bytes, sizeof(bytes));
+    setsockopt(rx, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes));
+    return true;
+}
+
+// Reads whole frames at `kbps`, recording each frame's age at the moment
+// it has been read completely.
+void consume(int fd, const Options& o, ssb::Histogram& age, Result& res, uint64_t t0)
+{
+    std::vector<uint8_t> buf(ssb::FRAME_HEADER_SIZE + o.payload);
+    const double ns_per_byte = 1e6 / o.consumer_kbps;
+    const uint64_t end = t0 + (uint64_t)(o.seconds * 1e9);
+    size_t have = 0;
+    uint64_t budget_t = ssb::mono_ns();
+    for (;;)
+    {
+        ssize_t r = recv(fd, buf.data() + have, buf.size() - have, 0);
+        if (r <= 0) break;
+        have += (size_t)r;
+
+        // pace: this many bytes may only be read after this much time
+        budget_t += (uint64_t)(r * ns_per_byte);
+        uint64_t now = ssb::mono_ns();
+        if (budget_t > now) std::this_thread::sleep_for(std::chrono::nanoseconds(budget_t - now));
+        else budget_t = now;
+
+        if (have < buf.size()) continue;
+        have = 0;
+        ssb::FrameHeader h;
+        memcpy(&h, buf.data(), sizeof(h));
+        if (!ssb::header_valid(h)) break;
+
+        now = ssb::mono_ns();
+        uint64_t a = now > h.timestamp_ns ? now - h.timestamp_ns : 0;
+        age.record(a);
+        ++res.delivered;
+        if (now < t0 + 1000000000ull && a > res.first_second_max_ns) res.first_second_max_ns = a;
+        if (now + 1000000000ull >= end && now < end && a > res.last_second_max_ns) res.last_second_max_ns = a;
+    }
+}
+
+Result run(const Options& o, bool conflating)
+{
+    Result res;
+    int tx = -1, rx = -1;
+    if (!make_pair(o.sock_kb, tx, rx)) return res;
+
+    ssb::Histogram age;
+    const uint64_t t0 = ssb::mono_ns();
+    std::thread consumer([&]() { consume(rx, o, age, res, t0); });
+
+    std::vector<uint8_t> payload(o.payload, 0x3C);
+    ssb::FrameWriter writer;
+    ssb::ConflatingSender queue(o.streams, ssb::FRAME_HEADER_SIZE + o.payload);
+    const uint64_t period = (uint64_t)(1e9 / o.tick_hz);
+    const uint64_t end = t0 + (uint64_t)(o.seconds * 1e9);
+    uint64_t seq = 0;
+
+    for (uint64_t tick = t0; tick < end; tick += period)
+    {
+        uint64_t now = ssb::mono_ns();
+        if (tick > now) std::this_thread::sleep_for(std::chrono::nanoseconds(tick - now));
+        else if (now - tick > period) ++res.late_ticks;
+
+        for (uint32_t s = 0; s < o.streams; ++s)
+        {
+            // stamped with the tick it belongs to, not when it got out
+            ssb::FrameHeader h = ssb::make_header(ssb::FRAME_DATA, s, seq, (uint32_t)o.payload, tick);
+            ++res.produced;
+            if (conflating)
+            {
+                queue.offer(h, payload.data());
+                continue;
+            }
+            writer.begin(h, payload.data());
+            while (writer.flush(tx) == ssb::WriteResult::Blocked)
+            {
+                pollfd pfd{ tx, POLLOUT, 0 };
+                poll(&pfd, 1, 100);
+            }
+        }
+        ++seq;
+        if (conflating && queue.flush(tx) == ssb::WriteResult::Failed) break;
+    }
+
+    shutdown(tx, SHUT_RDWR);
+    consumer.join();
+    close(tx);
+    close(rx);
+
+    res.conflated = queue.conflated();
+    res.queued_max_ns = queue.max_queued_ns();
+    res.max_ns = age.max();
+    age.format(res.pct, sizeof(res.pct));
+    return res;
+}
+
+struct StallResult
+{
+    uint64_t delivered = 0;
+    uint64_t conflated = 0;
+    uint64_t superseded = 0;  // frames written after a newer one was offered
+    uint64_t reordered = 0;   // seq not above the stream's previous one
+};
+
+// Conflating producer against a consumer that reads flat out except for
+// a pause of `stall_s` in the middle of the run.
+StallResult run_stall(const Options& o, double stall_s)
+{
+    StallResult res;
+    int tx = -1, rx = -1;
+    if (!make_pair(o.sock_kb, tx, rx)) return res;
+
+    const uint64_t t0 = ssb::mono_ns();
+    const uint64_t end = t0 + (uint64_t)(o.seconds * 1e9);
+    const uint64_t stall_from = t0 + (uint64_t)((o.seconds - stall_s) / 2 * 1e9);
+    const uint64_t stall_to = stall_from + (uint64_t)(stall_s * 1e9);
+    std::thread consumer([&]()
+        {
+            std::vector<uint8_t> buf(ssb::FRAME_HEADER_SIZE + o.payload);
+            std::vector<int64_t> last(o.streams, -1);
+            size_t have = 0;
+            for (;;)
+            {
+                uint64_t now = ssb::mono_ns();
+                if (now >= stall_from && now < stall_to)
+                    std::this_thread::sleep_for(std::chrono::nanoseconds(stall_to - now));
+                ssize_t r = recv(rx, buf.data() + have, buf.size() - have, 0);
+                if (r <= 0) break;
+                have += (size_t)r;
+                if (have < buf.size()) continue;
+                have = 0;
+                ssb::FrameHeader h;
+                memcpy(&h, buf.data(), sizeof(h));
+                if (!ssb::header_valid(h) || h.stream_id >= o.streams) break;
+                if ((int64_t)h.seq <= last[h.stream_id]) ++res.reordered;
+                last[h.stream_id] = (int64_t)h.seq;
+                ++res.delivered;
+            }
+        });
+
+    std::vector<uint8_t> payload(o.payload, 0x3C);
+    std::vector<uint64_t> latest(o.streams, 0);  // newest seq offered per stream
+    ssb::ConflatingSender queue(o.streams, ssb::FRAME_HEADER_SIZE + o.payload);
+    // sendmsg, noting every frame whose first byte the socket takes
+    auto write = [&](const ssb::ConstBuffer* b, uint32_t n) -> ssize_t
+        {
+            iovec iov[ssb::ConflatingSender::MAX_BATCH];
+            for (uint32_t i = 0; i < n; ++i)
+            {
+                iov[i].iov_base = (void*)b[i].data;
+                iov[i].iov_len = b[i].len;
+            }
+            msghdr msg{};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = n;
+            ssize_t r = sendmsg(tx, &msg, MSG_NOSIGNAL);
+            if (r < 0) return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+            size_t left = (size_t)r;
+            for (uint32_t i = 0; i < n && left; ++i)
+            {
+                ssb::FrameHeader h;
+                memcpy(&h, b[i].data, std::min(b[i].len, sizeof(h)));
+                // the head of a batch may be the rest of a frame already started
+                bool starts = b[i].len >= sizeof(h) && h.magic == ssb::FRAME_MAGIC;
+                if (starts && h.stream_id < o.streams && h.seq < latest[h.stream_id]) ++res.superseded;
+                left -= std::min(left, b[i].len);
+            }
+            return r;
+        };
+
+    const uint64_t period = (uint64_t)(1e9 / o.tick_hz);
+    uint64_t seq = 0;
+    for (uint64_t tick = t0; tick < end; tick += period, ++seq)
+    {
+        uint64_t now = ssb::mono_ns();
+        if (tick > now) std::this_thread::sleep_for(std::chrono::nanoseconds(tick - now));
+        for (uint32_t s = 0; s < o.streams; ++s)
+        {
+            queue.offer(ssb::make_header(ssb::FRAME_DATA, s, seq, (uint32_t)o.payload, tick), payload.data());
+            latest[s] = seq;
+        }
+        if (queue.flush_with(write) == ssb::WriteResult::Failed) break;
+    }
+
+    shutdown(tx, SHUT_RDWR);
+    consumer.join();
+    close(tx);
+    close(rx);
+    res.conflated = queue.conflated();
+    return res;
+}
+
+void report(const char* name, const Result& r)
+{
+    printf("[CONFLATE] %-10s produced %7llu | delivered %6llu | conflated %7llu | late ticks %5llu\n", name,
+        (unsigned long long)r.produced, (unsigned long long)r.delivered, (unsigned long long)r.conflated,
+        (unsigned long long)r.late_ticks);
+    printf("[CONFLATE] %-10s age ms: %s\n", name, r.pct);
+    printf("[CONFLATE] %-10s max age first second %.1f ms, last second %.1f ms\n", name,
+        r.first_second_max_ns / 1e6, r.last_second_max_ns / 1e6);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options o;
+    if (argc > 1) o.seconds = atof(argv[1]);
+    if (argc > 2) o.streams = (uint32_t)atoi(argv[2]);
+    if (argc > 3) o.tick_hz = atof(argv[3]);
+    if (argc > 4) o.payload = (size_t)atoll(argv[4]);
+    if (argc > 5) o.consumer_kbps = atof(argv[5]);
+    if (argc > 6) o.sock_kb = atoi(argv[6]);
+    if (o.seconds < 2) o.seconds = 2;
+
+    const double offered_kbps = o.streams * o.tick_hz * (ssb::FRAME_HEADER_SIZE + o.payload) / 1e3;
+    printf("[CONFLATE] %u streams x %.0f Hz x %zu B = %.0f kB/s offered | consumer %.0f kB/s | socket buffers %d KB\n",
+        o.streams, o.tick_hz, o.payload, offered_kbps, o.consumer_kbps, o.sock_kb);
+
+    Result blocking = run(o, false);
+    Result conflating = run(o, true);
+    if (!blocking.delivered || !conflating.delivered)
+    {
+        printf("[CONFLATE] loopback pair failed\n");
+        return 1;
+    }
+    report("blocking", blocking);
+    report("conflating", conflating);
+    printf("[CONFLATE] conflating queue: longest wait in the queue %.1f ms\n", conflating.queued_max_ns / 1e6);
+
+    // both kernel buffers (doubled by the kernel) drained at the consumer rate
+    const double drain_ms = 2.0 * 2 * o.sock_kb / o.consumer_kbps * 1e3;
+    const double bound_ms = 4 * drain_ms + 2 * 1e3 / o.tick_hz;
+    bool bounded = conflating.max_ns / 1e6 < bound_ms &&
+                   conflating.last_second_max_ns <= conflating.first_second_max_ns + (uint64_t)(drain_ms * 1e6);
+    printf("[CONFLATE] conflating max age %.1f ms vs bound %.1f ms: %s\n", conflating.max_ns / 1e6, bound_ms,
+        bounded ? "bounded" : "NOT bounded");
+
+    StallResult stall = run_stall(o, 0.5);
+    bool latest_only = stall.delivered && stall.conflated && !stall.superseded && !stall.reordered;
+    printf("[CONFLATE] consumer paused 500 ms: delivered %llu | conflated %llu | superseded sent %llu | "
+           "out of order %llu: %s\n",
+        (unsigned long long)stall.delivered, (unsigned long long)stall.conflated,
+        (unsigned long long)stall.superseded, (unsigned long long)stall.reordered,
+        latest_only ? "latest only" : "STALE FRAMES SENT");
+    return bounded && latest_only ? 0 : 1;
+}
@@ -0,0 +1,261 @@
+// ws_delta_bench.cpp
+// Keyframe + XOR delta codec (ssb/delta.h) on a CARLA-like data stream:
+// one ~32 KB payload per tick in which a fraction of the bytes change,
+// in runs of 8 (a field at a time). For each change rate and ISA it
+// reports the compression ratio and encode/decode GB/s, then how fast a
+// frame gets across compared to sending it raw, on loopback TCP (measured
+// here) and on 10 GbE (1.25 GB/s). That estimate is serial, as on one
+// host: encode + wire time of the encoded bytes + decode. Codec rates are
+// the best of 3 runs over the same stream.
+//
+// A second pass drops frames (keyframes included) the way latest-only UDP
+// does and checks every decoded payload byte for byte. Without acks a frame
+// may only fail to decode because its keyframe was lost, so each lost
+// keyframe costs at most key_interval - 1 frames.
+//
+// usage: ws_delta_bench [payload_bytes] [key_interval] [loss_percent]
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "ssb/clock.h"
+#include "ssb/delta.h"
+#include "ssb/session.h"
+#include "ssb/udp.h"
+
+namespace
+{
+
+constexpr size_t TICKS = 400;
+constexpr double LINK_10GBE = 1.25e9;
+
+struct Rng
+{
+    uint64_t s;
+    uint64_t next()
+    {
+        s ^= s << 13;
+        s ^= s >> 7;
+        s ^= s << 17;
+        return s;
+    }
+};
+
+// TICKS payloads, each `rate` of its bytes changed from the previous one.
+std::vector<std::vector<uint8_t>> make_stream(size_t len, double rate, uint64_t seed)
+{
+    Rng rng{ seed };
+    std::vector<std::vector<uint8_t>> frames(TICKS, std::vector<uint8_t>(len));
+    for (auto& b : frames[0]) b = (uint8_t)rng.next();
+    size_t runs = (size_t)(len * rate / 8.0 + 0.5);
+    for (size_t t = 1; t < TICKS; ++t)
+    {
+        frames[t] = frames[t - 1];
+        for (size_t r = 0; r < runs; ++r)
+        {
+            size_t at = rng.next() % (len - 8);
+            uint64_t v = rng.next();
+            memcpy(frames[t].data() + at, &v, 8);
+        }
+    }
+    return frames;
+}
+
+// Raw loopback TCP rate for `len`-byte frames, measured against a sink.
+double loopback_rate(size_t len, double seconds)
+{
+    int lfd = ssb::listen_tcp("127.0.0.1", 0, 1);
+    if (lfd < 0) return 0;
+    std::thread sink([&]()
+        {
+            int fd = accept(lfd, nullptr, nullptr);
+            std::vector<uint8_t> buf(1 << 20);
+            while (recv(fd, buf.data(), buf.size(), 0) > 0) {}
+            close(fd);
+        });
+    int fd = ssb::connect_tcp("127.0.0.1", ssb::bound_port(lfd));
+    uint64_t bytes = 0, t0 = ssb::mono_ns();
+    uint64_t t_end = t0 + (uint64_t)(seconds * 1e9);
+    if (fd >= 0)
+    {
+        std::vector<uint8_t> frame(ssb::FRAME_HEADER_SIZE + len, 0x5A);
+        while (ssb::mono_ns() < t_end)
+        {
+            ssize_t r = send(fd, frame.data(), frame.size(), MSG_NOSIGNAL);
+            if (r <= 0) break;
+            bytes += (uint64_t)r;
+        }
+        shutdown(fd, SHUT_WR);
+        close(fd);
+    }
+    sink.join();
+    close(lfd);
+    return bytes / ((ssb::mono_ns() - t0) / 1e9);
+}
+
+struct Result
+{
+    double ratio = 0;       // raw bytes / encoded bytes
+    double enc_gbps = 0;    // raw bytes per second of encode time
+    double dec_gbps = 0;
+    uint64_t keyframes = 0;
+    bool ok = true;
+};
+
+// Encodes the whole stream (timed), then decodes it (timed) and checks
+// every frame against the original.
+Result run_codec(const std::vector<std::vector<uint8_t>>& frames, ssb::Isa isa, uint32_t key_interval)
+{
+    Result res;
+    const size_t len = frames[0].size();
+    const size_t cap = std::max(len, ssb::delta_max_encoded(len));
+    std::vector<std::vector<uint8_t>> enc(frames.size(), std::vector<uint8_t>(cap));
+    std::vector<size_t> enc_len(frames.size());
+    std::vector<uint16_t> flags(frames.size());
+
+    ssb::DeltaEncoder encoder(key_interval);
+    encoder.set_isa(isa);
+    uint64_t t0 = ssb::mono_ns();
+    for (size_t t = 0; t < frames.size(); ++t)
+        enc_len[t] = encoder.encode(frames[t].data(), len, t, enc[t].data(), flags[t]);
+    uint64_t t_enc = ssb::mono_ns() - t0;
+
+    ssb::DeltaDecoder decoder;
+    std::vector<uint8_t> out(len);
+    uint64_t t_dec = 0;
+    for (size_t t = 0; t < frames.size(); ++t)
+    {
+        uint64_t d0 = ssb::mono_ns();
+        long n = decoder.decode(enc[t].data(), enc_len[t], flags[t], t, out.data(), out.size());
+        t_dec += ssb::mono_ns() - d0;
+        if (n != (long)len || memcmp(out.data(), frames[t].data(), len) != 0) res.ok = false;
+    }
+
+    double raw = (double)len * frames.size();
+    res.ratio = raw / encoder.bytes_out();
+    res.enc_gbps = raw / t_enc;
+    res.dec_gbps = raw / t_dec;
+    res.keyframes = encoder.keyframes();
+    return res;
+}
+
+// How much faster a frame gets across than raw at `link` bytes/s.
+double speedup(const Result& r, double link)
+{
+    double raw = 1.0 / link;
+    double delta = 1.0 / (r.enc_gbps * 1e9) + 1.0 / (r.ratio * link) + 1.0 / (r.dec_gbps * 1e9);
+    return raw / delta;
+}
+
+struct LossResult
+{
+    uint64_t delivered = 0;
+    uint64_t decoded = 0;
+    uint64_t undecodable = 0;
+    uint64_t unexplained = 0;  // undecodable although their keyframe arrived (acks only)
+    uint64_t longest_gap = 0;  // consecutive delivered frames that would not decode
+    bool ok = true;
+};
+
+// Drops `loss` of the frames at random. With `acks`, every delivered frame
+// acks the receiver's newest keyframe, an undecodable one NACKs (forces a
+// keyframe), and acks and NACKs are lost at the same rate.
+LossResult run_loss(const std::vector<std::vector<uint8_t>>& frames, uint32_t key_interval, double loss, bool acks)
+{
+    LossResult res;
+    const size_t len = frames[0].size();
+    std::vector<uint8_t> enc(std::max(len, ssb::delta_max_encoded(len))), out(len);
+    std::vector<bool> key_arrived(frames.size(), false);
+    ssb::DeltaEncoder encoder(key_interval, acks);
+    ssb::DeltaDecoder decoder;
+    Rng rng{ 0x9E3779B97F4A7C15ull };
+    auto lost = [&]() { return (rng.next() % 1000000) < (uint64_t)(loss * 1e6); };
+
+    uint64_t gap = 0;
+    for (size_t t = 0; t < frames.size(); ++t)
+    {
+        uint16_t flags = 0;
+        size_t n = encoder.encode(frames[t].data(), len, t, enc.data(), flags);
+        if (lost()) continue;
+        ++res.delivered;
+        if (flags & ssb::FRAME_FLAG_KEYFRAME) key_arrived[t] = true;
+
+        long got = decoder.decode(enc.data(), n, flags, t, out.data(), out.size());
+        if (got < 0)
+        {
+            ssb::DeltaHeader h;
+            memcpy(&h, enc.data(), sizeof(h));
+            if (h.base_seq >= frames.size() || key_arrived[h.base_seq]) ++res.unexplained;
+            ++res.undecodable;
+            res.longest_gap = std::max(res.longest_gap, ++gap);
+            if (acks && !lost()) encoder.force_keyframe();
+            continue;
+        }
+        gap = 0;
+        ++res.decoded;
+        if ((size_t)got != len || memcmp(out.data(), frames[t].data(), len) != 0) res.ok = false;
+        if (acks && !lost()) encoder.ack(decoder.last_keyframe());
+    }
+    return res;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    size_t len = (argc > 1) ? (size_t)atoll(argv[1]) : 32768;
+    uint32_t key_interval = (argc > 2) ? (uint32_t)atoi(argv[2]) : 20;
+    double loss = (argc > 3) ? atof(argv[3]) / 100.0 : 0.05;
+    if (len < 64 || !key_interval) return 1;
+    const double rates[] = { 0.0, 0.001, 0.01, 0.1, 0.5 };
+
+    std::vector<ssb::Isa> isas;
+    for (ssb::Isa isa : { ssb::Isa::Scalar, ssb::Isa::Sse41, ssb::Isa::Avx2 })
+        if (ssb::isa_supported(isa)) isas.push_back(isa);
+
+    double loopback = loopback_rate(len, 1.0);
+    printf("%zu B payload | key every %u | %zu ticks | loopback raw %.2f GB/s | 10GbE %.2f GB/s\n",
+        len, key_interval, TICKS, loopback / 1e9, LINK_10GBE / 1e9);
+    printf("%8s %7s %8s %9s %9s %6s %10s %8s %5s\n",
+        "changed", "isa", "ratio", "enc GB/s", "dec GB/s", "keys", "loopback", "10GbE", "ok");
+
+    bool all_ok = true;
+    for (double rate : rates)
+    {
+        auto frames = make_stream(len, rate, 0xC0FFEEull + (uint64_t)(rate * 1e6));
+        for (ssb::Isa isa : isas)
+        {
+            Result r = run_codec(frames, isa, key_interval);
+            for (int rep = 0; rep < 2; ++rep) // best of 3
+            {
+                Result again = run_codec(frames, isa, key_interval);
+                r.enc_gbps = std::max(r.enc_gbps, again.enc_gbps);
+                r.dec_gbps = std::max(r.dec_gbps, again.dec_gbps);
+                r.ok &= again.ok;
+            }
+            all_ok &= r.ok;
+            printf("%7.1f%% %7s %7.1fx %9.2f %9.2f %6llu %9.2fx %7.2fx %5s\n",
+                rate * 100.0, ssb::isa_name(isa), r.ratio, r.enc_gbps, r.dec_gbps,
+                (unsigned long long)r.keyframes, speedup(r, loopback), speedup(r, LINK_10GBE),
+                r.ok ? "yes" : "NO");
+        }
+    }
+
+    printf("\n%.1f%% loss, latest-only (1%% of bytes change per tick)\n", loss * 100.0);
+    printf("%6s %10s %10s %12s %12s %12s %5s\n",
+        "acks", "delivered", "decoded", "undecodable", "unexplained", "longest_gap", "ok");
+    auto frames = make_stream(len, 0.01, 7);
+    for (bool acks : { false, true })
+    {
+        LossResult r = run_loss(frames, key_interval, loss, acks);
+        bool good = r.ok && (acks || !r.unexplained);
+        all_ok &= good;
+        printf("%6s %10llu %10llu %12llu %12llu %12llu %5s\n", acks ? "on" : "off",
+            (unsigned long long)r.delivered, (unsigned long long)r.decoded,
+            (unsigned long long)r.undecodable, (unsigned long long)r.unexplained,
+            (unsigned long long)r.longest_gap, good ? "yes" : "NO");
+    }
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+// ws_frame_pool_bench.cpp
+// Heap allocations per frame on the send path: a fresh std::vector per
+// frame (what the old clients and BridgeSender did) against frames built
+// in place in ssb::FramePool buffers and written with FrameSendQueue.
+// Frames go over loopback TCP to a sink thread that discards them; the
+// allocation counter (ssb/alloc_counter.h) is sampled after a warm-up.
+//
+// usage: ws_frame_pool_bench [seconds_per_run]
+#define SSB_ALLOC_COUNTER_IMPL
+#include <poll.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "ssb/alloc_counter.h"
+#include "ssb/frame.h"
+#include "ssb/frame_pool.h"
+#include "ssb/session.h"
+#include "ssb/udp.h"
+
+namespace
+{
+
+bool wait_writable(int fd)
+{
+    pollfd p{ fd, POLLOUT, 0 };
+    return poll(&p, 1, 1000) >= 0;
+}
+
+struct Result
+{
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    uint64_t allocs = 0;
+    double seconds = 0;
+};
+
+// One std::vector per frame, header memcpy'd in front of the payload.
+Result run_vector(int fd, size_t payload, double seconds, double warmup)
+{
+    Result res;
+    uint64_t seq = 0;
+    uint64_t t0 = ssb::mono_ns(), t_measure = t0 + (uint64_t)(warmup * 1e9);
+    uint64_t t_end = t_measure + (uint64_t)(seconds * 1e9);
+    bool measuring = false;
+    uint64_t allocs0 = 0;
+
+    for (uint64_t now = t0; now < t_end; now = ssb::mono_ns())
+    {
+        if (!measuring && now >= t_measure)
+        {
+            measuring = true;
+            allocs0 = ssb::alloc_count();
+        }
+        for (int i = 0; i < 64; ++i)
+        {
+            std::vector<uint8_t> frame(ssb::FRAME_HEADER_SIZE + payload);
+            ssb::FrameHeader h = ssb::make_header(ssb::FRAME_DATA, 0, seq, (uint32_t)payload);
+            memcpy(frame.data(), &h, ssb::FRAME_HEADER_SIZE);
+            memcpy(frame.data() + ssb::FRAME_HEADER_SIZE, &seq, sizeof(seq));
+
+            size_t off = 0;
+            while (off < frame.size())
+            {
+                ssize_t r = ssb::send_nb(fd, frame.data() + off, frame.size() - off);
+                if (r < 0) return res;
+                if (r == 0) wait_writable(fd);
+                off += (size_t)r;
+            }
+            ++seq;
+            if (measuring)
+            {
+                res.frames++;
+                res.bytes += frame.size();
+            }
+        }
+    }
+    res.allocs = ssb::alloc_count() - allocs0;
+    res.seconds = seconds;
+    return res;
+}
+
+// Frames built in place in pooled buffers, written 64 at a time.
+Result run_pool(int fd, ssb::FramePool& pool, size_t payload, double seconds, double warmup)
+{
+    Result res;
+    ssb::FrameSendQueue queue(64);
+    uint64_t seq = 0, done = 0;
+    uint64_t t0 = ssb::mono_ns(), t_measure = t0 + (uint64_t)(warmup * 1e9);
+    uint64_t t_end = t_measure + (uint64_t)(seconds * 1e9);
+    bool measuring = false;
+    uint64_t allocs0 = 0, done0 = 0;
+    const size_t frame_size = ssb::FRAME_HEADER_SIZE + payload;
+
+    for (uint64_t now = t0; now < t_end; now = ssb::mono_ns())
+    {
+        if (!measuring && now >= t_measure)
+        {
+            measuring = true;
+            allocs0 = ssb::alloc_count();
+            done0 = done;
+        }
+        while (!queue.full())
+        {
+            ssb::FrameRef f = pool.acquire(frame_size);
+            if (!f) break; // everything is queued or in flight
+            ssb::FrameHeader h = ssb::make_header(ssb::FRAME_DATA, 0, seq++, (uint32_t)payload);
+            memcpy(f.data(), &h, ssb::FRAME_HEADER_SIZE);
+            memcpy(f.data() + ssb::FRAME_HEADER_SIZE, &seq, sizeof(seq));
+            queue.push(std::move(f));
+        }
+        ssb::WriteResult r = queue.flush(fd, &done);
+        if (r == ssb::WriteResult::Failed) return res;
+        if (r == ssb::WriteResult::Blocked) wait_writable(fd);
+    }
+    res.frames = done - done0;
+    res.bytes = res.frames * frame_size;
+    res.allocs = ssb::alloc_count() - allocs0;
+    res.seconds = seconds;
+    return res;
+}
+
+void print(const char* mode, size_t payload, const Result& r)
+{
+    printf("%-7s %9zu %12llu %8.2f %10llu %12.4f\n", mode, payload,
+        (unsigned long long)r.frames, r.bytes / 1e9 / r.seconds,
+        (unsigned long long)r.allocs, r.frames ? (double)r.allocs / r.frames : 0.0);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    double seconds = (argc > 1) ? atof(argv[1]) : 3.0;
+    const double warmup = 0.5;
+    const size_t payloads[] = { 256, 4096, 65536 };
+
+    int lfd = ssb::listen_tcp("127.0.0.1", 0, 1);
+    if (lfd < 0) return 1;
+    int port = ssb::bound_port(lfd);
+
+    std::thread sink([&]()
+        {
+            int fd = accept(lfd, nullptr, nullptr);
+            std::vector<uint8_t> buf(1 << 20);
+            while (recv(fd, buf.data(), buf.size(), 0) > 0) {}
+            close(fd);
+        });
+
+    int fd = ssb::connect_tcp("127.0.0.1", port);
+    if (fd < 0) return 1;
+
+    // 64 in the queue + a thread cache worth of slack per class
+    ssb::FramePool pool({ { 512, 128 }, { 8192, 128 }, { 65536 + 64, 128 } });
+
+    printf("%-7s %9s %12s %8s %10s %12s\n", "mode", "payload", "frames", "GB/s", "mallocs", "mallocs/frm");
+    for (size_t payload : payloads)
+    {
+        print("vector", payload, run_vector(fd, payload, seconds, warmup));
+        print("pool", payload, run_pool(fd, pool, payload, seconds, warmup));
+    }
+    printf("pool exhausted %llu\n", (unsigned long long)pool.exhausted());
+
+    shutdown(fd, SHUT_WR);
+    close(fd);
+    sink.join();
+    close(lfd);
+    return 0;
+}
@@ -1,86 +1,355 @@
-﻿// runtime/ws_latency_client.cpp
-#define WIN32_LEAN_AND_MEAN
-#define NOMINMAX
-
-#include <winsock2.h>
-#include <ws2tcpip.h>
+// runtime/ws_latency_client.cpp
+//
+// usage: ws_latency_client                     stop-and-wait ping every 100 ms
+//        ws_latency_client probe [in_flight] [step_s] [rate_hz ...]
+//        ws_latency_client profile [pings] [rate_hz] [lowlat[:options]]
+//        ws_latency_client sync [seconds] [rate_hz]
+//
+// probe mode sweeps offered load with pipelined 16-byte probes
+// (include/ssb/probe_client.h) and prints one latency-vs-load line per rate.
+//
+// profile mode sends the same paced pings twice, first with the default
+// profile (wait in poll, then recv) and then with the low-latency one
+// (include/ssb/lowlat.h: pinned thread, socket options, spin receive),
+// and prints both distributions and the p99.9 difference.
+//
+// sync mode exchanges clock sync requests with the server
+// (include/ssb/clock_sync.h), prints the offset / drift estimate every
+// second and, at the end, the one-way latency of each direction next to
+// the RTT. Needs ssb_server; the Python servers do not answer them.
+#include <poll.h>
 #include <chrono>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
 #include <vector>
-#include <algorithm>
 
-#pragma comment(lib, "ws2_32.lib")
+#include "ssb/clock_sync.h"
+#include "ssb/histogram.h"
+#include "ssb/lowlat.h"
+#include "ssb/probe_client.h"
+#include "ssb/session.h"
+
+static int run_probe(ssb::Session& s, uint32_t in_flight, double step_s, const std::vector<double>& rates)
+{
+    ssb::Reactor reactor;
+    ssb::ProbeClient probe(reactor, s.cmd, in_flight);
+    if (!probe.start())
+        return 1;
+
+    printf("[PROBE] in-flight limit %u | %.1f s per step | latency from intended send, us\n", in_flight, step_s);
+    printf("[PROBE] %10s %10s %8s %8s %8s %8s %8s %8s %6s %8s\n",
+        "offered/s", "echoed/s", "p50", "p99", "p99.9", "max", "rtt_p50", "rtt_p99", "inflt", "backlog");
+
+    for (double rate : rates)
+    {
+        probe.reset_stats();
+        uint64_t done0 = probe.window().completed();
+        uint64_t t0 = ssb::mono_ns();
+        probe.set_rate(rate);
+        while (!reactor.stopped() && ssb::mono_ns() - t0 < (uint64_t)(step_s * 1e9))
+            reactor.run_once(10);
+
+        // stop offering load, let the tail come home (counted in this step)
+        probe.set_rate(0);
+        uint64_t t1 = ssb::mono_ns();
+        while (!reactor.stopped() && probe.in_flight() > 0 && ssb::mono_ns() - t1 < 1000000000ull)
+            reactor.run_once(10);
+        if (reactor.stopped())
+            break;
+
+        ssb::Histogram& lat = probe.latency();
+        ssb::Histogram& rtt = probe.rtt();
+        printf("[PROBE] %10.0f %10.0f %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f %6u %8llu\n",
+            rate, (probe.window().completed() - done0) / step_s,
+            lat.percentile(50.0) / 1e3, lat.percentile(99.0) / 1e3, lat.percentile(99.9) / 1e3, lat.max() / 1e3,
+            rtt.percentile(50.0) / 1e3, rtt.percentile(99.0) / 1e3,
+            probe.max_in_flight(), (unsigned long long)probe.backlog_ticks());
+    }
+    return probe.failed() ? 1 : 0;
+}
+
+// `pings` stop-and-wait pings at `rate` Hz; false if the echo stalls.
+static bool ping_run(int fd, uint32_t pings, double rate, const ssb::LatencyProfile& prof, ssb::Histogram& h)
+{
+    const uint64_t interval = (uint64_t)(1e9 / rate);
+    uint64_t next = ssb::mono_ns();
+    for (uint32_t i = 0; i < pings; ++i)
+    {
+        next += interval;
+        uint64_t now = ssb::mono_ns();
+        if (next > now) std::this_thread::sleep_for(std::chrono::nanoseconds(next - now));
+
+        uint64_t t0 = ssb::mono_ns();
+        double t = (double)t0;
+        if (ssb::send_nb(fd, &t, sizeof(t)) != sizeof(t)) return false;
+
+        double echo;
+        if (prof.low_latency && prof.spin)
+        {
+            // an 8-byte ping/pong is where a delayed ACK hurts: re-arm quickack
+            if (ssb::spin_recv(fd, &echo, sizeof(echo), 1000000000ull, true) != (ssize_t)sizeof(echo)) return false;
+        }
+        else
+        {
+            size_t got = 0;
+            while (got < sizeof(echo))
+            {
+                pollfd pfd{ fd, POLLIN, 0 };
+                if (poll(&pfd, 1, 1000) != 1) return false;
+                ssize_t r = ssb::recv_nb(fd, (char*)&echo + got, sizeof(echo) - got);
+                if (r < 0) return false;
+                got += (size_t)r;
+            }
+        }
+        h.record_corrected(ssb::mono_ns() - t0, interval);
+    }
+    return true;
+}
+
+static void print_profile(const char* name, const ssb::Histogram& h)
+{
+    printf("[PROFILE] %-8s %8.1f %8.1f %8.1f %8.1f %8.1f\n", name, h.percentile(50.0) / 1e3,
+        h.percentile(99.0) / 1e3, h.percentile(99.9) / 1e3, h.percentile(99.99) / 1e3, h.max() / 1e3);
+}
+
+static int run_profile(ssb::Session& s, uint32_t pings, double rate, const ssb::LatencyProfile& low)
+{
+    ssb::LatencyProfile def;
+    ssb::Histogram h_def, h_low;
+    if (!ping_run(s.cmd, pings, rate, def, h_def))
+    {
+        printf("[PROFILE] echo stalled\n");
+        return 1;
+    }
+
+    // socket options stick, so the low-latency run goes second
+    ssb::ThreadTuning th = ssb::apply_thread(low, 0);
+    ssb::SocketTuning so = ssb::apply_socket(s.cmd, low);
+    char line[256];
+    ssb::format_tuning(th, so, line, sizeof(line));
+    printf("[PROFILE] lowlat applied: %s | %s receive\n", line, low.spin ? "spin" : "poll");
+    if (low.spin && ssb::online_cpus() < 2)
+        printf("[PROFILE] warning: one CPU; the spinning client competes with the server for it\n");
+    if (!ping_run(s.cmd, pings, rate, low, h_low))
+    {
+        printf("[PROFILE] echo stalled\n");
+        return 1;
+    }
+
+    printf("[PROFILE] %u pings at %.0f Hz, RTT us\n", pings, rate);
+    printf("[PROFILE] %-8s %8s %8s %8s %8s %8s\n", "profile", "p50", "p99", "p99.9", "p99.99", "max");
+    print_profile("default", h_def);
+    print_profile("lowlat", h_low);
+    double d = h_def.percentile(99.9), l = h_low.percentile(99.9);
+    printf("[PROFILE] p99.9 %+.1f us (%+.0f%%) with lowlat\n", (l - d) / 1e3, d > 0 ? (l - d) * 100.0 / d : 0.0);
+    return 0;
+}
 
-int main()
+// Stop-and-wait clock sync exchanges at `rate` Hz for `seconds`.
+static int run_sync(ssb::Session& s, double seconds, double rate)
+{
+    ssb::ClockSync sync;
+    std::vector<ssb::SyncSample> all;
+    const uint64_t interval = (uint64_t)(1e9 / rate);
+    const uint64_t t0 = ssb::mono_ns(), end = t0 + (uint64_t)(seconds * 1e9);
+    uint64_t next = t0, last_print = t0;
+    printf("[SYNC] %8s %12s %10s %12s %12s\n", "t_s", "offset_us", "drift_ppm", "min_rtt_us", "+-_us");
+
+    for (uint64_t id = 0; next < end; ++id)
+    {
+        next += interval;
+        uint64_t now = ssb::mono_ns();
+        if (next > now) std::this_thread::sleep_for(std::chrono::nanoseconds(next - now));
+
+        uint8_t msg[ssb::SYNC_FRAME_SIZE];
+        ssb::make_sync_request(msg, id, ssb::mono_ns());
+        if (ssb::send_nb(s.cmd, msg, sizeof(msg)) != (ssize_t)sizeof(msg)) return 1;
+        size_t got = 0;
+        while (got < sizeof(msg))
+        {
+            pollfd pfd{ s.cmd, POLLIN, 0 };
+            if (poll(&pfd, 1, 1000) != 1) { printf("[SYNC] reply stalled\n"); return 1; }
+            ssize_t r = ssb::recv_nb(s.cmd, msg + got, sizeof(msg) - got);
+            if (r < 0) return 1;
+            got += (size_t)r;
+        }
+        uint64_t t4 = ssb::mono_ns();
+
+        uint64_t reply_id;
+        ssb::SyncSample smp;
+        ssb::SyncReply rep = ssb::parse_sync_reply(msg, t4, reply_id, smp);
+        if (rep == ssb::SyncReply::Unanswered)
+        {
+            printf("[SYNC] the server echoed the request unanswered; run ssb_server\n");
+            return 1;
+        }
+        if (rep != ssb::SyncReply::Ok || reply_id != id || !sync.add(smp)) continue;
+        all.push_back(smp);
+
+        if (t4 - last_print >= 1000000000ull)
+        {
+            printf("[SYNC] %8.1f %12.3f %10.3f %12.3f %12.3f\n", (t4 - t0) / 1e9, sync.offset_ns() / 1e3,
+                sync.drift_ppm(), sync.min_rtt_ns() / 1e3, sync.uncertainty_ns() / 1e3);
+            last_print = t4;
+        }
+    }
+    if (all.empty()) return 1;
+
+    // one-way times under the final estimate; a negative one means the
+    // estimate is off by more than that sample's queueing
+    ssb::Histogram rtt, up, down;
+    uint64_t negative = 0;
+    for (const ssb::SyncSample& x : all)
+    {
+        int64_t u = sync.uplink_ns(x), d = sync.downlink_ns(x);
+        negative += (u < 0) + (d < 0);
+        rtt.record((uint64_t)x.rtt());
+        up.record(u > 0 ? (uint64_t)u : 0);
+        down.record(d > 0 ? (uint64_t)d : 0);
+    }
+    printf("[SYNC] %zu exchanges | offset %.3f us +- %.3f us | drift %.3f ppm\n", all.size(),
+        sync.offset_ns() / 1e3, sync.uncertainty_ns() / 1e3, sync.drift_ppm());
+    printf("[SYNC] %-9s %9s %9s %9s %9s   (us)\n", "", "p50", "p99", "p99.9", "max");
+    auto line = [](const char* name, const ssb::Histogram& h)
+        {
+            printf("[SYNC] %-9s %9.1f %9.1f %9.1f %9.1f\n", name, h.percentile(50.0) / 1e3,
+                h.percentile(99.0) / 1e3, h.percentile(99.9) / 1e3, h.max() / 1e3);
+        };
+    line("rtt", rtt);
+    line("up", up);
+    line("down", down);
+    if (negative)
+        printf("[SYNC] %llu one-way samples below zero (clamped)\n", (unsigned long long)negative);
+    return 0;
+}
+
+int main(int argc, char** argv)
 {
     constexpr double DURATION = 30.0;
-    constexpr double INTERVAL = 0.1; // 100 ms
+    constexpr uint64_t INTERVAL_NS = 100000000; // 100 ms
 
-    WSADATA wsa;
-    WSAStartup(MAKEWORD(2, 2), &wsa);
+    ssb::Session s;
+    if (!ssb::open_session(ssb::Endpoint{}, s) || s.code != 'L')
+    {
+        printf("Did not receive 'L' from server\n");
+        return 1;
+    }
 
-    SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    int flag = 1;
-    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (char*)&flag, sizeof(flag));
+    if (argc > 1 && strcmp(argv[1], "probe") == 0)
+    {
+        uint32_t in_flight = (argc > 2) ? (uint32_t)atoi(argv[2]) : 64;
+        double step_s = (argc > 3) ? atof(argv[3]) : 2.0;
+        std::vector<double> rates;
+        for (int i = 4; i < argc; ++i) rates.push_back(atof(argv[i]));
+        if (rates.empty()) rates = { 1e3, 1e4, 5e4, 1e5, 2e5, 5e5 };
+        return run_probe(s, in_flight, step_s, rates);
+    }
+    if (argc > 1 && strcmp(argv[1], "profile") == 0)
+    {
+        uint32_t pings = (argc > 2) ? (uint32_t)atoi(argv[2]) : 20000;
+        double rate = (argc > 3) ? atof(argv[3]) : 1000.0;
+        ssb::LatencyProfile low;
+        if (!ssb::parse_profile((argc > 4) ? argv[4] : "lowlat", low) || !low.low_latency || rate <= 0)
+        {
+            printf("usage: ws_latency_client profile [pings] [rate_hz] [lowlat[:options]]\n");
+            return 1;
+        }
+        return run_profile(s, pings ? pings : 1, rate, low);
+    }
 
-    sockaddr_in addr{};
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(5050);
-    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (argc > 1 && strcmp(argv[1], "sync") == 0)
+    {
+        double seconds = (argc > 2) ? atof(argv[2]) : 10.0;
+        double rate = (argc > 3) ? atof(argv[3]) : 100.0;
+        if (seconds <= 0 || rate <= 0)
+        {
+            printf("usage: ws_latency_client sync [seconds] [rate_hz]\n");
+            return 1;
+        }
+        return run_sync(s, seconds, rate);
+    }
 
-    connect(s, (sockaddr*)&addr, sizeof(addr));
+    ssb::Reactor reactor;
 
     auto start = std::chrono::steady_clock::now();
     auto last_send = start;
-    auto last_report = start;
 
-    double sum = 0, min = 1e9, max = 0;
-    double last_sum = 0;
-    int count = 0, last_count = 0;
+    // window + cumulative, ns, corrected for coordinated omission
+    ssb::Histogram window;
+    ssb::Histogram total;
 
-    while (true)
-    {
-        auto now = std::chrono::steady_clock::now();
-        double elapsed = std::chrono::duration<double>(now - start).count();
-        if (elapsed >= DURATION) break;
+    double echo = 0;
+    size_t echo_got = 0;
+    bool in_flight = false;
 
-        if (std::chrono::duration<double>(now - last_send).count() >= INTERVAL)
+    // ---- ping on timer, echo on readiness ----
+    reactor.add(s.cmd, EPOLLIN, [&](uint32_t ev)
         {
-            last_send = now;
-            double t = elapsed;
-            send(s, (char*)&t, sizeof(double), 0);
+            for (;;)
+            {
+                ssize_t r = ssb::recv_nb(s.cmd, (char*)&echo + echo_got, sizeof(double) - echo_got);
+                if (r < 0)
+                {
+                    reactor.stop();
+                    return false;
+                }
+                if (r == 0)
+                    break;
 
-            double echo = 0;
-            int r = recv(s, (char*)&echo, sizeof(double), MSG_WAITALL);
-            if (r == sizeof(double))
+                echo_got += r;
+                if (echo_got == sizeof(double))
+                {
+                    echo_got = 0;
+                    in_flight = false;
+
+                    uint64_t rtt = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - last_send).count();
+                    window.record_corrected(rtt, INTERVAL_NS);
+                }
+            }
+            if (ev & (EPOLLERR | EPOLLHUP))
+                reactor.stop();
+            return false;
+        });
+
+    reactor.add_timer(INTERVAL_NS, INTERVAL_NS, [&](uint64_t)
+        {
+            if (in_flight)
+                return;
+
+            last_send = std::chrono::steady_clock::now();
+            double t = std::chrono::duration<double>(last_send - start).count();
+            if (ssb::send_nb(s.cmd, &t, sizeof(double)) != sizeof(double))
             {
-                double rtt = (std::chrono::duration<double>(
-                    std::chrono::steady_clock::now() - last_send).count()) * 1000.0;
-                sum += rtt;
-                min = std::min(min, rtt);
-                max = std::max(max, rtt);
-                count++;
+                reactor.stop();
+                return;
             }
-        }
+            in_flight = true;
+        });
 
-        if (std::chrono::duration<double>(now - last_report).count() >= 5.0 && count > last_count)
+    reactor.add_timer(5000000000ull, 5000000000ull, [&](uint64_t)
         {
-            double ds = sum - last_sum;
-            int dn = count - last_count;
-            printf("[LATENCY] Avg %.3f ms | Min %.3f | Max %.3f | Samples=%d\n",
-                ds / dn, min, max, dn);
-            last_sum = sum;
-            last_count = count;
-            min = 1e9; max = 0;
-            last_report = now;
-        }
+            if (window.count() == 0)
+                return;
 
-        Sleep(1);
-    }
+            char pct[160];
+            window.format(pct, sizeof(pct));
+            printf("[LATENCY] Avg %.3f ms | Min %.3f | %s | Samples=%llu\n",
+                window.mean() / 1e6, window.min() / 1e6, pct, (unsigned long long)window.count());
+            total.merge(window);
+            window.reset();
+        });
+
+    reactor.add_timer((uint64_t)(DURATION * 1e9), 0, [&](uint64_t) { reactor.stop(); });
 
-    printf("[LATENCY][FINAL] Avg %.3f ms | Samples=%d\n", sum / count, count);
+    reactor.run();
 
-    closesocket(s);
-    WSACleanup();
+    total.merge(window);
+    char pct[160];
+    total.format(pct, sizeof(pct));
+    printf("[LATENCY][FINAL] Avg %.3f ms | %s | Samples=%llu\n",
+        total.mean() / 1e6, pct, (unsigned long long)total.count());
     return 0;
 }
@@ -0,0 +1,219 @@
+// ws_reconnect_test.cpp
+// Fault injection for fast reconnect (ssb/resume.h, ResumableSession in
+// ssb/session.h). Runs ssb_server C as a child process and streams small
+// SSB frames at it, then SIGKILLs the server, optionally keeps it down
+// for `down_ms`, and starts it again, `rounds` times. For each round it
+// measures:
+//
+//   detect   kill -> the sender sees the connection fail
+//   session  restart -> CMD/DATA are back and the streams resumed
+//   fresh    restart -> the new server has counted the first new frame
+//            (read from its stats page, /dev/shm/ssb-stats.server)
+//
+// and checks that the new server counted no lost frames: the resumed seq
+// jump is a reconnect, not loss. Build ../servers/ssb_server.cpp first.
+//
+// usage: ws_reconnect_test [path/to/ssb_server] [rounds] [down_ms]
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "ssb/clock.h"
+#include "ssb/frame.h"
+#include "ssb/metrics.h"
+#include "ssb/session.h"
+
+namespace
+{
+
+constexpr size_t PAYLOAD = 1024;
+constexpr uint64_t FRAME_INTERVAL_NS = 100000; // 10 kHz
+
+pid_t spawn_server(const char* path)
+{
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        int null = open("/dev/null", O_WRONLY);
+        if (null >= 0)
+        {
+            dup2(null, STDOUT_FILENO);
+            dup2(null, STDERR_FILENO);
+        }
+        execl(path, path, "C", "3600", "65536", "loop", (char*)nullptr);
+        _exit(127);
+    }
+    return pid;
+}
+
+// Frame writes on the non-blocking DATA socket, waiting for room; false
+// once the connection is gone.
+bool send_all(int fd, const uint8_t* p, size_t len)
+{
+    while (len)
+    {
+        ssize_t r = ssb::send_nb(fd, p, len);
+        if (r < 0) return false;
+        if (r == 0)
+        {
+            pollfd pfd{ fd, POLLOUT, 0 };
+            if (poll(&pfd, 1, 100) < 0) return false;
+            continue;
+        }
+        p += r;
+        len -= (size_t)r;
+    }
+    return true;
+}
+
+struct Sender
+{
+    ssb::ResumableSession rs;
+    std::atomic<bool> stop{ false };
+    std::atomic<uint64_t> failed_ns{ 0 };    // when the last connection broke
+    std::atomic<uint64_t> resumed_ns{ 0 };   // when the session was back
+    std::atomic<uint64_t> sent{ 0 };
+
+    void run()
+    {
+        std::vector<uint8_t> frame(ssb::FRAME_HEADER_SIZE + PAYLOAD, 0xA5);
+        while (!stop)
+        {
+            if (!rs.connect(60000, 200))
+            {
+                printf("[RECONNECT] gave up\n");
+                return;
+            }
+            resumed_ns = ssb::mono_ns();
+            const int fd = rs.session().data;
+            uint64_t next = ssb::mono_ns();
+            while (!stop)
+            {
+                ssb::FrameHeader h = ssb::make_header(ssb::FRAME_DATA, 0, rs.take_seq(), PAYLOAD);
+                memcpy(frame.data(), &h, sizeof(h));
+                if (!send_all(fd, frame.data(), frame.size()))
+                {
+                    failed_ns = ssb::mono_ns();
+                    break;
+                }
+                ++sent;
+                next += FRAME_INTERVAL_NS;
+                uint64_t now = ssb::mono_ns();
+                if (next > now) std::this_thread::sleep_for(std::chrono::nanoseconds(next - now));
+                else next = now;
+            }
+            rs.close();
+        }
+    }
+};
+
+// Frames the server process `pid` has counted, or -1 while its page is
+// not up yet.
+int64_t server_frames(pid_t pid, uint64_t& drops, uint64_t& reconnects)
+{
+    ssb::StatsPage page;
+    if (!page.open("server") || page.header()->pid != (uint64_t)pid) return -1;
+    drops = page.total(ssb::METRIC_DROPS);
+    reconnects = page.total(ssb::METRIC_RECONNECTS);
+    return (int64_t)page.total(ssb::METRIC_FRAMES_RX);
+}
+
+double ms(uint64_t ns) { return ns / 1e6; }
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const char* server = (argc > 1) ? argv[1] : "./ssb_server";
+    int rounds = (argc > 2) ? atoi(argv[2]) : 5;
+    int down_ms = (argc > 3) ? atoi(argv[3]) : 0;
+    signal(SIGPIPE, SIG_IGN);
+
+    pid_t pid = spawn_server(server);
+    if (pid < 0)
+    {
+        printf("[RECONNECT] cannot start %s\n", server);
+        return 1;
+    }
+
+    Sender tx;
+    std::thread t([&]() { tx.run(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    if (!tx.sent.load())
+    {
+        printf("[RECONNECT] no session with %s (built? port 5050 free?)\n", server);
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+        tx.stop = true;
+        t.join();
+        return 1;
+    }
+
+    printf("[RECONNECT] token %016llx | %zu B frames at %.0f Hz | server down %d ms per round\n",
+        (unsigned long long)tx.rs.token(), PAYLOAD, 1e9 / FRAME_INTERVAL_NS, down_ms);
+    printf("[RECONNECT] %5s %10s %10s %10s %8s %8s\n", "round", "detect_ms", "session_ms", "fresh_ms", "lost", "resumed");
+
+    bool ok = true;
+    std::vector<double> fresh;
+    for (int r = 1; r <= rounds; ++r)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+        uint64_t t_kill = ssb::mono_ns();
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+        if (down_ms > 0) std::this_thread::sleep_for(std::chrono::milliseconds(down_ms));
+
+        uint64_t t_up = ssb::mono_ns();
+        pid = spawn_server(server);
+
+        // first fresh frame: the new server's data thread counted one
+        uint64_t drops = 0, reconnects = 0, t_fresh = 0;
+        while (ssb::mono_ns() - t_up < 10000000000ull)
+        {
+            if (server_frames(pid, drops, reconnects) > 0)
+            {
+                t_fresh = ssb::mono_ns();
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        if (!t_fresh)
+        {
+            printf("[RECONNECT] %5d no fresh frame within 10 s\n", r);
+            ok = false;
+            break;
+        }
+        // let the new session run a moment before reading its loss count
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        server_frames(pid, drops, reconnects);
+
+        uint64_t failed = tx.failed_ns.load(), resumed = tx.resumed_ns.load();
+        printf("[RECONNECT] %5d %10.2f %10.2f %10.2f %8llu %8s\n", r,
+            failed > t_kill ? ms(failed - t_kill) : 0.0, resumed > t_up ? ms(resumed - t_up) : 0.0,
+            ms(t_fresh - t_up), (unsigned long long)drops, reconnects ? "yes" : "NO");
+        fresh.push_back(ms(t_fresh - t_up));
+        ok &= drops == 0 && reconnects > 0;
+    }
+
+    tx.stop = true;
+    t.join();
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+
+    if (!fresh.empty())
+    {
+        std::sort(fresh.begin(), fresh.end());
+        printf("[RECONNECT] time to first fresh frame after restart: median %.2f ms | max %.2f ms | %llu reconnects, %llu failed attempts\n",
+            fresh[fresh.size() / 2], fresh.back(), (unsigned long long)tx.rs.reconnects(),
+            (unsigned long long)tx.rs.failed_attempts());
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,206 @@
+// ws_replay.cpp
+// Feeds a capture (ssb/capture.h) back through the transport, either at
+// the original timing or as fast as the socket takes it.
+//
+//   info   segments, records, span and the index of a capture
+//   tcp    every record as it was sent, over a session's DATA connection
+//          (captures of ws_combined_client against ssb_server C)
+//   udp    every record as a datagram to host:port (captures of
+//          ssb_control_core, e.g. its .rx side back into a core); GRO
+//          records are split back into their original datagrams
+//
+// `timed` sends each record at first + (capture_ns - capture_start),
+// sleeping for the gaps and spinning the last stretch, and reports how
+// late each send was; `fast` sends back to back and reports throughput.
+// from_s / to_s pick a window of the capture, found through its index.
+//
+// usage: ws_replay <prefix> info
+//        ws_replay <prefix> tcp [timed|fast] [from_s] [to_s]
+//        ws_replay <prefix> udp [host:port] [timed|fast] [from_s] [to_s]
+#include <poll.h>
+#include <signal.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "ssb/capture.h"
+#include "ssb/clock.h"
+#include "ssb/histogram.h"
+#include "ssb/session.h"
+#include "ssb/udp.h"
+
+namespace
+{
+
+constexpr uint64_t SPIN_NS = 200000; // sleep until this close, then spin
+
+// Blocks (in poll) until the whole record is on the non-blocking socket.
+bool send_all(int fd, const uint8_t* p, size_t len)
+{
+    while (len)
+    {
+        ssize_t r = ssb::send_nb(fd, p, len);
+        if (r < 0) return false;
+        if (r == 0)
+        {
+            pollfd pfd{ fd, POLLOUT, 0 };
+            if (poll(&pfd, 1, 1000) < 0) return false;
+            continue;
+        }
+        p += r;
+        len -= (size_t)r;
+    }
+    return true;
+}
+
+void wait_until(uint64_t t)
+{
+    uint64_t now = ssb::mono_ns();
+    if (t > now + SPIN_NS) std::this_thread::sleep_for(std::chrono::nanoseconds(t - now - SPIN_NS));
+    while (ssb::mono_ns() < t) {}
+}
+
+int info(ssb::CaptureReader& cap)
+{
+    uint64_t rx = 0, tx = 0, bytes = 0, largest = 0;
+    ssb::CaptureView v;
+    while (cap.next(v))
+    {
+        (v.dir == ssb::CAPTURE_RX ? rx : tx)++;
+        bytes += v.size;
+        if (v.size > largest) largest = v.size;
+    }
+    double span = (cap.last_ns() - cap.first_ns()) / 1e9;
+    printf("[REPLAY] %zu segments | %llu records (%llu rx, %llu tx) | %.2f MB | largest %llu B\n",
+        cap.segments(), (unsigned long long)(rx + tx), (unsigned long long)rx, (unsigned long long)tx,
+        bytes / 1e6, (unsigned long long)largest);
+    printf("[REPLAY] span %.3f s | %llu index entries | %.1f records/s\n", span,
+        (unsigned long long)cap.index_entries(), span > 0 ? (rx + tx) / span : 0.0);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        printf("usage: ws_replay <prefix> info\n"
+               "       ws_replay <prefix> tcp [timed|fast] [from_s] [to_s]\n"
+               "       ws_replay <prefix> udp [host:port] [timed|fast] [from_s] [to_s]\n");
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    ssb::CaptureReader cap;
+    if (!cap.open(argv[1]))
+    {
+        printf("[REPLAY] no capture at %s.*.ssbcap\n", argv[1]);
+        return 1;
+    }
+    const std::string mode = argv[2];
+    if (mode == "info") return info(cap);
+
+    const bool udp = mode == "udp";
+    if (!udp && mode != "tcp")
+    {
+        printf("[REPLAY] unknown mode '%s'\n", argv[2]);
+        return 2;
+    }
+    int arg = 3;
+    std::string target = "127.0.0.1:5060";
+    if (udp && argc > arg) target = argv[arg++];
+    const bool timed = !(argc > arg && !strcmp(argv[arg], "fast"));
+    ++arg;
+    double from_s = (argc > arg) ? atof(argv[arg]) : 0.0;
+    ++arg;
+    double to_s = (argc > arg) ? atof(argv[arg]) : 0.0;
+
+    // ---- transport ----
+    ssb::Session s;
+    int fd = -1;
+    sockaddr_in to{};
+    if (udp)
+    {
+        size_t colon = target.rfind(':');
+        std::string host = colon == std::string::npos ? target : target.substr(0, colon);
+        int port = colon == std::string::npos ? 5060 : atoi(target.c_str() + colon + 1);
+        fd = ssb::udp_socket();
+        if (fd < 0 || !ssb::make_addr(host.c_str(), port, to))
+        {
+            printf("[REPLAY] bad UDP target %s\n", target.c_str());
+            return 1;
+        }
+        ssb::set_socket_buffers(fd, 0, 8 << 20);
+    }
+    else
+    {
+        if (!ssb::open_session(ssb::Endpoint{}, s) || s.data < 0)
+        {
+            printf("[REPLAY] no session with a DATA connection (ssb_server C running?)\n");
+            return 1;
+        }
+        fd = s.data;
+    }
+
+    // ---- replay ----
+    const uint64_t start = cap.first_ns() + (uint64_t)(from_s * 1e9);
+    const uint64_t end = to_s > 0 ? cap.first_ns() + (uint64_t)(to_s * 1e9) : UINT64_MAX;
+    cap.seek(start);
+
+    ssb::Histogram late;
+    uint64_t records = 0, datagrams = 0, bytes = 0, failed = 0;
+    uint64_t capture_t0 = 0, t0 = 0;
+    ssb::CaptureView v;
+    while (cap.next(v) && v.ns <= end)
+    {
+        if (!t0)
+        {
+            capture_t0 = v.ns;
+            t0 = ssb::mono_ns();
+        }
+        if (timed)
+        {
+            uint64_t due = t0 + (v.ns - capture_t0);
+            wait_until(due);
+            late.record(ssb::mono_ns() - due);
+        }
+
+        if (udp)
+        {
+            // a GRO record holds several datagrams of `segment` bytes
+            size_t seg = v.segment ? v.segment : v.size;
+            for (size_t off = 0; off < v.size; off += seg)
+            {
+                size_t len = std::min(seg, v.size - off);
+                if (sendto(fd, v.data + off, len, 0, (sockaddr*)&to, sizeof(to)) != (ssize_t)len) ++failed;
+                ++datagrams;
+            }
+        }
+        else if (!send_all(fd, v.data, v.size))
+        {
+            printf("[REPLAY] DATA connection closed after %llu records\n", (unsigned long long)records);
+            return 1;
+        }
+        ++records;
+        bytes += v.size;
+    }
+    uint64_t ns = t0 ? ssb::mono_ns() - t0 : 0;
+
+    printf("[REPLAY] %s %s | %llu records | %.2f MB in %.3f s | %.3f GB/s | %.0f records/s\n",
+        udp ? target.c_str() : "tcp", timed ? "timed" : "fast", (unsigned long long)records, bytes / 1e6,
+        ns / 1e9, ns ? (double)bytes / ns : 0.0, ns ? records * 1e9 / ns : 0.0);
+    if (udp)
+        printf("[REPLAY] %llu datagrams, %llu failed sends\n", (unsigned long long)datagrams,
+            (unsigned long long)failed);
+    if (timed && late.count())
+    {
+        char pct[160];
+        late.format(pct, sizeof(pct), 1e3);
+        printf("[REPLAY] lateness (us): %s\n", pct);
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,190 @@
+// runtime/ws_shm_client.cpp
+// Shared-memory counterpart of the latency / throughput / combined
+// clients. Runs whichever test the server asks for ('L', 'T', 'C') over
+// memfd SPSC rings and prints the same report lines as the socket clients,
+// so both paths can be compared head to head.
+//
+// usage: ws_shm_client [duration_s] [payload_bytes] [name]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+#include "ssb/histogram.h"
+#include "ssb/reactor.h"
+#include "ssb/shm_transport.h"
+
+using ssb::ShmRing;
+
+int main(int argc, char** argv)
+{
+    const char* name = (argc > 3) ? argv[3] : ssb::SHM_DEFAULT_NAME;
+    size_t payload_size = (argc > 2) ? (size_t)atoll(argv[2]) : 65536;
+
+    ssb::ShmSession s;
+    if (!ssb::shm_connect(s, name))
+    {
+        printf("Failed to attach to @%s\n", name);
+        return 1;
+    }
+
+    const char code = s.code;
+    double duration = (argc > 1) ? atof(argv[1]) : (code == 'C' ? 86400.0 : 30.0);
+    const bool do_ping = (code == 'L' || code == 'C');
+    const bool do_data = (code == 'T' || code == 'C');
+
+    ShmRing& data_ring = s.ring[ssb::SHM_DATA_UP];
+    if (do_data && payload_size > data_ring.max_payload())
+    {
+        printf("payload too large for the data ring (max %zu)\n", data_ring.max_payload());
+        return 1;
+    }
+
+    std::atomic<uint64_t> total_bytes{ 0 };
+    ssb::Reactor cmd_reactor;
+    ssb::Reactor data_reactor;
+
+    // ---- DATA THREAD: produce frames, sleep on space_fd when full ----
+    std::thread data_thread;
+    if (do_data)
+    {
+        data_thread = std::thread([&]()
+            {
+                std::vector<uint8_t> payload(payload_size);
+                uint64_t seq = 0;
+
+                data_reactor.add(data_ring.space_fd(), EPOLLIN, [&](uint32_t)
+                    {
+                        ShmRing::clear(data_ring.space_fd());
+                        for (int i = 0; i < 256; ++i)
+                        {
+                            ssb::FrameHeader h = ssb::make_header(ssb::FRAME_DATA, 0, seq, (uint32_t)payload.size());
+                            if (!data_ring.try_write(h, payload.data()))
+                            {
+                                if (data_ring.arm_writer(h.payload_len)) return false;
+                                continue;
+                            }
+                            total_bytes.fetch_add(ssb::FRAME_HEADER_SIZE + h.payload_len, std::memory_order_relaxed);
+                            seq++;
+                        }
+                        return true;
+                    });
+                uint64_t one = 1;
+                ssize_t r = write(data_ring.space_fd(), &one, sizeof(one)); // start producing
+                (void)r;
+                data_reactor.run();
+            });
+    }
+
+    // ---- CMD: ping every 100 ms, pong on cmd_down ----
+    ShmRing& cmd_out = s.ring[ssb::SHM_CMD_UP];
+    ShmRing& cmd_in = s.ring[ssb::SHM_CMD_DOWN];
+
+    constexpr uint64_t PING_INTERVAL_NS = 100000000;
+    ssb::Histogram window_lat;
+    ssb::Histogram total_lat;
+    bool in_flight = false;
+    uint64_t ping_seq = 0;
+
+    if (do_ping)
+    {
+        cmd_reactor.add(cmd_in.data_fd(), EPOLLIN, [&](uint32_t)
+            {
+                ShmRing::clear(cmd_in.data_fd());
+                ssb::FrameHeader h;
+                const uint8_t* payload;
+                for (;;)
+                {
+                    if (!cmd_in.peek(h, payload))
+                    {
+                        if (cmd_in.arm_reader()) return false;
+                        continue;
+                    }
+                    if (h.type == ssb::FRAME_PONG)
+                    {
+                        window_lat.record_corrected(ssb::mono_ns() - h.timestamp_ns, PING_INTERVAL_NS);
+                        in_flight = false;
+                    }
+                    cmd_in.release();
+                }
+            });
+        cmd_in.arm_reader();
+
+        cmd_reactor.add_timer(PING_INTERVAL_NS, PING_INTERVAL_NS, [&](uint64_t)
+            {
+                if (in_flight)
+                    return;
+                ssb::FrameHeader h = ssb::make_header(ssb::FRAME_PING, 0, ping_seq++, 0);
+                in_flight = cmd_out.try_write(h, nullptr);
+            });
+    }
+
+    cmd_reactor.add(s.sock, EPOLLIN, [&](uint32_t ev)
+        {
+            if (ev & (EPOLLHUP | EPOLLRDHUP | EPOLLERR))
+                cmd_reactor.stop();
+            return false;
+        });
+
+    auto start = std::chrono::steady_clock::now();
+    auto last_report = start;
+    uint64_t last_bytes = 0;
+
+    cmd_reactor.add_timer(5000000000ull, 5000000000ull, [&](uint64_t)
+        {
+            auto now = std::chrono::steady_clock::now();
+            double elapsed = std::chrono::duration<double>(now - start).count();
+            double dt = std::chrono::duration<double>(now - last_report).count();
+            uint64_t cur = total_bytes.load(std::memory_order_relaxed);
+
+            total_lat.merge(window_lat);
+            char pct_5s[160], pct_all[160];
+            window_lat.format(pct_5s, sizeof(pct_5s));
+            total_lat.format(pct_all, sizeof(pct_all));
+
+            if (code == 'L' && window_lat.count())
+                printf("[LATENCY] Avg %.3f ms | Min %.3f | %s | Samples=%llu\n",
+                    window_lat.mean() / 1e6, window_lat.min() / 1e6, pct_5s,
+                    (unsigned long long)window_lat.count());
+            else if (code == 'T')
+                printf("[THROUGHPUT] %.2f GB/s | %.2f GB total\n",
+                    (cur - last_bytes) / 1e9 / dt, cur / 1e9);
+            else if (code == 'C')
+                printf(
+                    "[COMBINED][5s]  %.1f min | %.2f GB/s | lat %.3f ms | %s | pings %llu\n"
+                    "[COMBINED][ALL] %.1f min | %.2f GB/s | lat %.3f ms | %s | pings %llu\n\n",
+                    elapsed / 60.0, (cur - last_bytes) / 1e9 / dt,
+                    window_lat.mean() / 1e6, pct_5s, (unsigned long long)window_lat.count(),
+                    elapsed / 60.0, cur / 1e9 / elapsed,
+                    total_lat.mean() / 1e6, pct_all, (unsigned long long)total_lat.count());
+
+            window_lat.reset();
+            last_bytes = cur;
+            last_report = now;
+        });
+
+    cmd_reactor.add_timer((uint64_t)(duration * 1e9), 0, [&](uint64_t) { cmd_reactor.stop(); });
+
+    cmd_reactor.run();
+
+    data_reactor.stop();
+    if (data_thread.joinable()) data_thread.join();
+
+    double total_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t bytes = total_bytes.load();
+    total_lat.merge(window_lat);
+    char pct[160];
+    total_lat.format(pct, sizeof(pct));
+    if (code == 'L')
+        printf("[LATENCY][FINAL] Avg %.3f ms | %s | Samples=%llu\n",
+            total_lat.mean() / 1e6, pct, (unsigned long long)total_lat.count());
+    else if (code == 'T')
+        printf("[THROUGHPUT][FINAL] %.2f GB/s | %.2f GB total\n", bytes / 1e9 / total_time, bytes / 1e9);
+    else
+        printf("[COMBINED][FINAL] %.2f GB | avg %.2f GB/s | lat %.3f ms | %s | pings %llu\n",
+            bytes / 1e9, bytes / 1e9 / total_time, total_lat.mean() / 1e6, pct,
+            (unsigned long long)total_lat.count());
+    return 0;
+}
@@ -0,0 +1,178 @@
+// ws_stripe_bench.cpp
+// Striped bulk mode (ssb/stripe.h) over loopback TCP, sender and receiver
+// in one process: the full 'S' handshake, then `seconds` of back-to-back
+// messages for K = 1, 2, 4, ... up to the core count (or max_k). Each lane
+// pair is pinned to its own core, so on a box with enough cores the
+// aggregate should grow with K until the memory bus or the loopback path
+// runs out.
+//
+// Every message is stamped with seq ^ offset at each 4 KB boundary; the
+// receiver checks the stamps and the delivery order, so a chunk that
+// lands at the wrong offset or a message delivered early fails the run.
+//
+// usage: ws_stripe_bench [message_kb] [seconds] [max_k]
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "ssb/affinity.h"
+#include "ssb/clock.h"
+#include "ssb/stripe.h"
+
+namespace
+{
+
+constexpr size_t STAMP_EVERY = 4096;
+
+int local_port(int fd)
+{
+    sockaddr_in a{};
+    socklen_t len = sizeof(a);
+    return getsockname(fd, (sockaddr*)&a, &len) == 0 ? ntohs(a.sin_port) : -1;
+}
+
+void stamp(uint8_t* p, size_t len, uint64_t seq)
+{
+    for (size_t off = 0; off + sizeof(uint64_t) <= len; off += STAMP_EVERY)
+    {
+        uint64_t v = seq ^ off;
+        memcpy(p + off, &v, sizeof(v));
+    }
+}
+
+bool stamped(const uint8_t* p, size_t len, uint64_t seq)
+{
+    for (size_t off = 0; off + sizeof(uint64_t) <= len; off += STAMP_EVERY)
+    {
+        uint64_t v;
+        memcpy(&v, p + off, sizeof(v));
+        if (v != (seq ^ off)) return false;
+    }
+    return true;
+}
+
+struct Result
+{
+    uint32_t k = 0;
+    double gbps = 0;
+    uint64_t messages = 0;
+    bool ok = false;
+};
+
+Result run(uint32_t want, size_t msg_bytes, double seconds)
+{
+    Result res;
+    ssb::Endpoint ep;
+    int lc = ssb::listen_tcp(ep.host, 0, 1);
+    int ld = ssb::listen_tcp(ep.host, 0, (int)ssb::STRIPE_MAX);
+    if (lc < 0 || ld < 0) return res;
+    ep.cmd_port = local_port(lc);
+    ep.data_port = local_port(ld);
+
+    // server side of the handshake
+    int rx_fds[ssb::STRIPE_MAX];
+    uint32_t rx_count = 0;
+    int cmd = -1;
+    std::thread server([&]()
+        {
+            char code = 'S';
+            cmd = accept(lc, nullptr, nullptr);
+            if (cmd >= 0 && send(cmd, &code, 1, MSG_NOSIGNAL) == 1)
+                rx_count = ssb::accept_stripes(cmd, ld, rx_fds);
+        });
+    ssb::StripedSession s;
+    bool connected = ssb::open_striped_session(ep, want, s);
+    server.join();
+    close(lc);
+    close(ld);
+    if (!connected || rx_count != s.count)
+    {
+        if (cmd >= 0) close(cmd);
+        return res;
+    }
+    res.k = s.count;
+
+    std::atomic<uint64_t> expect{ 0 };
+    std::atomic<uint64_t> bad{ 0 };
+    ssb::StripeConfig cfg;
+    cfg.first_cpu = 0;
+    ssb::StripeReceiver rx(rx_fds, rx_count, msg_bytes,
+        [&](uint32_t, uint64_t seq, const uint8_t* data, size_t len)
+        {
+            uint64_t e = expect.load(std::memory_order_relaxed);
+            if (seq != e || len != msg_bytes || !stamped(data, len, seq)) bad.fetch_add(1);
+            expect.store(e + 1, std::memory_order_relaxed);
+        },
+        cfg);
+
+    const uint32_t nbuf = 2 * s.count + 2;
+    ssb::FramePool pool({ { msg_bytes, nbuf } });
+    std::vector<ssb::FrameRef> bufs;
+    for (uint32_t i = 0; i < nbuf; ++i)
+    {
+        bufs.push_back(pool.acquire(msg_bytes));
+        memset(bufs.back().data(), 0x5A, msg_bytes);
+    }
+
+    uint64_t t0 = ssb::mono_ns();
+    const uint64_t end = t0 + (uint64_t)(seconds * 1e9);
+    {
+        ssb::StripeSender tx(s.data, s.count, cfg);
+        for (uint64_t seq = 0; ssb::mono_ns() < end; ++seq)
+        {
+            ssb::FrameRef& b = bufs[seq % nbuf];
+            while (b.use_count() > 1) std::this_thread::yield();
+            stamp(b.data(), msg_bytes, seq);
+            if (!tx.send(0, b.share())) break;
+        }
+        tx.flush();
+        for (uint32_t i = 0; i < s.count; ++i) shutdown(s.data[i], SHUT_WR);
+        rx.join();
+        res.messages = tx.messages();
+    }
+    uint64_t ns = ssb::mono_ns() - t0;
+
+    res.gbps = (double)rx.bytes() / ns;
+    res.ok = !bad.load() && !rx.errors() && rx.messages() == res.messages;
+    for (uint32_t i = 0; i < rx_count; ++i) close(rx_fds[i]);
+    close(cmd);
+    return res;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    size_t kb = (argc > 1) ? (size_t)atoll(argv[1]) : 4096;
+    double seconds = (argc > 2) ? atof(argv[2]) : 2.0;
+    uint32_t max_k = (argc > 3) ? (uint32_t)atoi(argv[3]) : (uint32_t)ssb::online_cpus();
+    if (max_k < 1) max_k = 1;
+    if (max_k > ssb::STRIPE_MAX) max_k = ssb::STRIPE_MAX;
+    const size_t msg_bytes = (kb ? kb : 1) << 10;
+
+    printf("%zu KB messages in %zu KB chunks | %d cores | %.1f s per run\n", msg_bytes >> 10,
+        ssb::STRIPE_CHUNK >> 10, ssb::online_cpus(), seconds);
+    printf("%3s %10s %10s %9s %6s\n", "K", "GB/s", "msgs", "vs K=1", "ok");
+
+    bool all_ok = true;
+    double base = 0;
+    for (uint32_t k = 1; k <= max_k; k = (k * 2 > max_k && k != max_k) ? max_k : k * 2)
+    {
+        Result r = run(k, msg_bytes, seconds);
+        if (!r.k)
+        {
+            printf("%3u  handshake failed\n", k);
+            return 1;
+        }
+        if (!base) base = r.gbps;
+        all_ok &= r.ok;
+        printf("%3u %10.2f %10llu %8.2fx %6s\n", r.k, r.gbps, (unsigned long long)r.messages,
+            base ? r.gbps / base : 0.0, r.ok ? "yes" : "NO");
+    }
+    return all_ok ? 0 : 1;
+}
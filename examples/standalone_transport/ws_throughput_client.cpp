@@ -1,117 +1,280 @@
-﻿// runtime/ws_throughput_client.cpp
-#define WIN32_LEAN_AND_MEAN
-#define NOMINMAX
-
-#include <winsock2.h>
-#include <ws2tcpip.h>
+// runtime/ws_throughput_client.cpp
+//
+// usage: ws_throughput_client [socket|uring|uring-sqpoll] [depth]
+//        ws_throughput_client striped [connections] [message_kb]
+//
+// socket: edge-triggered reactor, one send() per buffer.
+// uring:  `depth` registered 64 KB buffers sent as one linked chain of
+//         WRITE_FIXED requests, submitted and reaped with one
+//         io_uring_enter() per chain. uring-sqpoll lets a kernel thread
+//         pick up submissions, so enter() is only needed to wait.
+// striped: needs `ssb_server S`. Messages are split over K data
+//         connections, one pinned sender thread each (ssb/stripe.h).
 #include <chrono>
+#include <csignal>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
 #include <vector>
 
-#pragma comment(lib, "ws2_32.lib")
+#include "ssb/clock.h"
+#include "ssb/session.h"
+#include "ssb/stripe.h"
+#include "ssb/uring.h"
 
-static SOCKET connect_tcp(int port)
+namespace
 {
-    SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (s == INVALID_SOCKET) return INVALID_SOCKET;
 
-    int flag = 1;
-    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (char*)&flag, sizeof(flag));
+constexpr double DURATION = 30.0;
+constexpr size_t BUF_SIZE = 65536;
 
-    sockaddr_in addr{};
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(port);
-    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+struct Progress
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point last_report = start;
+    long long total = 0;
+    long long last_total = 0;
 
-    if (connect(s, (sockaddr*)&addr, sizeof(addr)) != 0)
+    void report(uint64_t syscalls)
     {
-        closesocket(s);
-        return INVALID_SOCKET;
-    }
-    return s;
-}
+        auto now = std::chrono::steady_clock::now();
+        double dt = std::chrono::duration<double>(now - last_report).count();
+        double gbps = (total - last_total) / 1e9 / dt;
 
-int main()
-{
-    constexpr double DURATION = 30.0;
-    constexpr size_t BUF_SIZE = 65536;
+        printf("[THROUGHPUT] %.2f GB/s | %.2f GB total | %.0f syscalls/GB\n",
+            gbps, total / 1e9, total ? syscalls / (total / 1e9) : 0.0);
 
-    WSADATA wsa;
-    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
-    {
-        printf("WSAStartup failed\n");
-        return 1;
+        last_total = total;
+        last_report = now;
     }
 
-    // ---- CMD socket (handshake) ----
-    SOCKET cmd = connect_tcp(5050);
-    if (cmd == INVALID_SOCKET)
+    void final(uint64_t syscalls)
     {
-        printf("Failed to connect CMD socket\n");
-        return 1;
+        double total_time = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+
+        printf("[THROUGHPUT][FINAL] %.2f GB/s | %.2f GB total | %.0f syscalls/GB\n",
+            (total / 1e9) / total_time, total / 1e9, total ? syscalls / (total / 1e9) : 0.0);
     }
+};
+
+int run_socket(ssb::Session& s)
+{
+    ssb::Reactor reactor;
+    std::vector<char> buf(BUF_SIZE);
+    size_t offset = 0;
+    uint64_t sends = 0;
+    Progress p;
 
-    char code = 0;
-    int r = recv(cmd, &code, 1, MSG_WAITALL);
-    if (r != 1 || code != 'T')
+    // Edge-triggered: write until EAGAIN, but yield after a few buffers so
+    // the report/deadline timers still get serviced on a fast receiver.
+    reactor.add(s.data, EPOLLOUT, [&](uint32_t ev)
+        {
+            if (ev & (EPOLLERR | EPOLLHUP))
+            {
+                reactor.stop();
+                return false;
+            }
+            for (int i = 0; i < 64; ++i)
+            {
+                ssize_t sent = ssb::send_nb(s.data, buf.data() + offset, buf.size() - offset);
+                sends++;
+                if (sent < 0)
+                {
+                    reactor.stop();
+                    return false;
+                }
+                if (sent == 0)
+                    return false;
+
+                p.total += sent;
+                offset = (offset + sent) % buf.size();
+            }
+            return true;
+        });
+
+    reactor.add_timer(5000000000ull, 5000000000ull, [&](uint64_t) { p.report(sends); });
+    reactor.add_timer((uint64_t)(DURATION * 1e9), 0, [&](uint64_t) { reactor.stop(); });
+
+    reactor.run();
+
+    p.final(sends);
+    return 0;
+}
+
+int run_uring(ssb::Session& s, bool sqpoll, unsigned depth)
+{
+    ssb::Uring ring;
+    if (!ring.init(depth * 2, sqpoll))
     {
-        printf("Did not receive 'T' from server (got %d)\n", code);
-        closesocket(cmd);
+        printf("io_uring setup failed (%s)\n", strerror(errno));
         return 1;
     }
 
-    // ---- DATA socket ----
-    SOCKET data = connect_tcp(5051);
-    if (data == INVALID_SOCKET)
+    // io_uring parks blocking sends on poll instead of failing with EAGAIN;
+    // WRITE_FIXED has no MSG_NOSIGNAL, so a closed peer must not kill us
+    fcntl(s.data, F_SETFL, fcntl(s.data, F_GETFL) & ~O_NONBLOCK);
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<char> pool(BUF_SIZE * depth);
+    std::vector<iovec> iov(depth);
+    for (unsigned i = 0; i < depth; ++i)
+        iov[i] = iovec{ pool.data() + i * BUF_SIZE, BUF_SIZE };
+    if (!ring.register_buffers(iov.data(), depth) || !ring.register_files(&s.data, 1))
     {
-        printf("Failed to connect DATA socket\n");
-        closesocket(cmd);
+        printf("io_uring register failed (%s)\n", strerror(errno));
         return 1;
     }
 
-    std::vector<char> buf(BUF_SIZE);
+    // All buffers go out as one linked chain, so the kernel runs them back
+    // to back, and the next chain is only queued once every request of
+    // this one has completed: two chains in flight could interleave on the
+    // socket. A short write breaks the chain (the rest complete with
+    // -ECANCELED); buffers are re-queued in completion order, which is
+    // chain order, so the partial one resumes first and the byte stream
+    // stays in order.
+    std::vector<size_t> sent(depth, 0);
+    std::vector<unsigned> idle(depth);
+    for (unsigned i = 0; i < depth; ++i) idle[i] = i;
 
-    auto start = std::chrono::steady_clock::now();
-    auto last_report = start;
-    long long total = 0;
-    long long last_total = 0;
+    Progress p;
+    const uint64_t t0 = ssb::mono_ns();
+    const uint64_t deadline = t0 + (uint64_t)(DURATION * 1e9);
+    uint64_t next_report = t0 + 5000000000ull;
+    bool failed = false;
+    unsigned in_flight = 0;
 
-    while (true)
+    while (!failed)
     {
-        auto now = std::chrono::steady_clock::now();
-        double elapsed = std::chrono::duration<double>(now - start).count();
-        if (elapsed >= DURATION)
-            break;
+        for (size_t k = 0; !in_flight && k < idle.size(); ++k)
+        {
+            unsigned i = idle[k];
+            io_uring_sqe* sqe = ring.get_sqe();
+            sqe->opcode = IORING_OP_WRITE_FIXED;
+            sqe->flags = IOSQE_FIXED_FILE | (k + 1 < idle.size() ? IOSQE_IO_LINK : 0);
+            sqe->fd = 0;
+            sqe->addr = (uint64_t)(uintptr_t)(pool.data() + i * BUF_SIZE + sent[i]);
+            sqe->len = (unsigned)(BUF_SIZE - sent[i]);
+            sqe->buf_index = (uint16_t)i;
+            sqe->user_data = i;
+        }
+        if (!in_flight)
+        {
+            in_flight = (unsigned)idle.size();
+            idle.clear();
+        }
 
-        int sent = send(data, buf.data(), (int)buf.size(), 0);
-        if (sent <= 0)
+        if (ring.submit(in_flight) < 0)
             break;
 
-        total += sent;
+        ring.drain([&](const io_uring_cqe& c)
+            {
+                unsigned i = (unsigned)c.user_data;
+                if (c.res > 0)
+                {
+                    p.total += c.res;
+                    sent[i] = (sent[i] + c.res) % BUF_SIZE;
+                }
+                else if (c.res != -ECANCELED && c.res != -EAGAIN && c.res != -EINTR)
+                    failed = true;
+                idle.push_back(i);
+                --in_flight;
+            });
 
-        if (std::chrono::duration<double>(now - last_report).count() >= 5.0)
+        uint64_t now = ssb::mono_ns();
+        if (now >= next_report)
         {
-            double dt = std::chrono::duration<double>(now - last_report).count();
-            double gbps = (total - last_total) / 1e9 / dt;
+            p.report(ring.enters());
+            next_report += 5000000000ull;
+        }
+        if (now >= deadline)
+            break;
+    }
+
+    p.final(ring.enters());
+    return 0;
+}
+
+int run_striped(uint32_t want, size_t msg_bytes)
+{
+    ssb::StripedSession s;
+    if (!ssb::open_striped_session(ssb::Endpoint{}, want, s))
+    {
+        printf("Striped handshake failed (server sent '%c', needs 'S')\n", s.code ? s.code : '?');
+        return 1;
+    }
+    printf("[THROUGHPUT] %u stripes, %zu KB messages\n", s.count, msg_bytes >> 10);
+
+    // A few buffers reused round-robin; a buffer is free again once the
+    // lanes dropped their share of it.
+    const uint32_t nbuf = 2 * s.count + 2;
+    ssb::FramePool pool({ { msg_bytes, nbuf } });
+    std::vector<ssb::FrameRef> bufs;
+    for (uint32_t i = 0; i < nbuf; ++i)
+    {
+        bufs.push_back(pool.acquire(msg_bytes));
+        memset(bufs.back().data(), (int)i, msg_bytes);
+    }
 
-            printf("[THROUGHPUT] %.2f GB/s | %.2f GB total\n",
-                gbps, total / 1e9);
+    ssb::StripeConfig cfg;
+    cfg.first_cpu = 0;
+    ssb::StripeSender tx(s.data, s.count, cfg);
+    Progress p;
+    const uint64_t t0 = ssb::mono_ns();
+    uint64_t next_report = t0 + 5000000000ull;
+    for (uint64_t n = 0; !tx.failed(); ++n)
+    {
+        ssb::FrameRef& b = bufs[n % nbuf];
+        while (b.use_count() > 1) std::this_thread::yield();
+        if (!tx.send(0, b.share())) break;
 
-            last_total = total;
-            last_report = now;
+        uint64_t now = ssb::mono_ns();
+        p.total = (long long)tx.bytes();
+        if (now >= next_report)
+        {
+            p.report(tx.syscalls());
+            next_report += 5000000000ull;
         }
+        if (now - t0 >= (uint64_t)(DURATION * 1e9)) break;
     }
+    tx.flush();
+    tx.stop();
+    p.total = (long long)tx.bytes();
+    p.final(tx.syscalls());
+    return tx.failed() ? 1 : 0;
+}
 
-    double total_time =
-        std::chrono::duration<double>(
-            std::chrono::steady_clock::now() - start).count();
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const char* backend = (argc > 1) ? argv[1] : "socket";
+    if (strcmp(backend, "striped") == 0)
+    {
+        uint32_t k = (argc > 2) ? (uint32_t)atoi(argv[2]) : (uint32_t)ssb::online_cpus();
+        size_t kb = (argc > 3) ? (size_t)atoll(argv[3]) : 4096;
+        return run_striped(k, (kb ? kb : 1) << 10);
+    }
+    unsigned depth = (argc > 2) ? (unsigned)atoi(argv[2]) : 16;
+    if (depth == 0) depth = 1;
 
-    printf("[THROUGHPUT][FINAL] %.2f GB/s | %.2f GB total\n",
-        (total / 1e9) / total_time,
-        total / 1e9);
+    // ---- CMD socket (handshake) + DATA socket ----
+    ssb::Session s;
+    if (!ssb::open_session(ssb::Endpoint{}, s))
+    {
+        printf("Failed to connect / no command from server\n");
+        return 1;
+    }
+    if (s.code != 'T')
+    {
+        printf("Did not receive 'T' from server (got %d)\n", s.code);
+        return 1;
+    }
 
-    closesocket(data);
-    closesocket(cmd);
-    WSACleanup();
-    return 0;
+    if (strcmp(backend, "uring") == 0)
+        return run_uring(s, false, depth);
+    if (strcmp(backend, "uring-sqpoll") == 0)
+        return run_uring(s, true, depth);
+    return run_socket(s);
 }
@@ -5,6 +5,19 @@
 #include "Interfaces/IPv4/IPv4Address.h"
 #include "Async/Async.h"
 #include "HAL/PlatformProcess.h"
+#include "HAL/PlatformMisc.h"
+#include "HAL/RunnableThread.h"
+#include "ssb/histogram.h"
+#include "ssb/probe.h"
+#include "ssb/tick_scheduler.h"
+#if PLATFORM_WINDOWS
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include "Windows/WindowsHWrapper.h"
+#include "Windows/HideWindowsPlatformTypes.h"
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#endif
 
 static FSocket* MakeTcp()
 {
@@ -17,6 +30,64 @@ static FSocket* MakeTcp()
     return S;
 }
 
+static void LogLatency(const TCHAR* Tag, const ssb::Histogram& H)
+{
+    UE_LOG(LogTemp, Warning, TEXT("%s Avg %.3f ms | p50 %.3f | p90 %.3f | p99 %.3f | p99.9 %.3f | p99.99 %.3f | Max %.3f | Samples=%llu"),
+        Tag, H.mean() / 1e6, H.percentile(50.0) / 1e6, H.percentile(90.0) / 1e6, H.percentile(99.0) / 1e6,
+        H.percentile(99.9) / 1e6, H.percentile(99.99) / 1e6, H.max() / 1e6, (unsigned long long)H.count());
+}
+
+// TickScheduler sleeps on a high-resolution waitable timer on Windows,
+// which wakes within about a millisecond instead of the 1-15.6 ms of the
+// default timer. Before Windows 10 1803 that flag is unknown and it gets a
+// plain waitable timer. Elsewhere the scheduler keeps its own sleep.
+class FTickTimer
+{
+public:
+    explicit FTickTimer(ssb::TickScheduler& InTicks) : Ticks(InTicks)
+    {
+#if PLATFORM_WINDOWS
+        Timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        if (!Timer) Timer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+        if (Timer) Ticks.set_sleeper(&FTickTimer::SleepUntil, this);
+#endif
+    }
+
+    ~FTickTimer()
+    {
+        Ticks.set_sleeper(nullptr, nullptr);
+#if PLATFORM_WINDOWS
+        if (Timer) CloseHandle(Timer);
+#endif
+    }
+
+private:
+#if PLATFORM_WINDOWS
+    static void SleepUntil(void* Ctx, uint64_t T)
+    {
+        FTickTimer* Self = (FTickTimer*)Ctx;
+        const uint64_t N = ssb::TickScheduler::now();
+        if (T <= N) return;
+        LARGE_INTEGER Due;
+        Due.QuadPart = -(LONGLONG)((T - N + 99) / 100);  // relative, 100 ns units
+        if (SetWaitableTimer(Self->Timer, &Due, 0, nullptr, nullptr, 0))
+            WaitForSingleObject(Self->Timer, INFINITE);
+    }
+
+    HANDLE Timer = nullptr;
+#endif
+    ssb::TickScheduler& Ticks;
+};
+
+// How late each paced send left relative to its tick, in µs.
+static void LogSendMiss(const TCHAR* Tag, ssb::TickScheduler& Ticks)
+{
+    const ssb::Histogram& H = Ticks.misses();
+    UE_LOG(LogTemp, Warning, TEXT("%s send miss us p50 %.1f | p99 %.1f | p99.9 %.1f | Max %.1f | Skipped=%llu"),
+        Tag, H.percentile(50.0) / 1e3, H.percentile(99.0) / 1e3, H.percentile(99.9) / 1e3, H.max() / 1e3,
+        (unsigned long long)Ticks.skipped());
+}
+
 ABridgeSender::ABridgeSender()
 {
     PrimaryActorTick.bCanEverTick = false;
@@ -38,25 +109,97 @@ void ABridgeSender::EndPlay(const EEndPlayReason::Type EndPlayReason)
     Super::EndPlay(EndPlayReason);
 }
 
+// Non-blocking connect, retried with millisecond exponential backoff
+// (ssb/backoff.h) instead of a fixed 3 s sleep, so a restarted server is
+// back within a few ms of listening again.
 bool ABridgeSender::ConnectSocket(FSocket*& Out, int32 Port)
 {
-    if (Out) { Out->Close(); ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Out); Out = nullptr; }
-    Out = MakeTcp();
-    if (!Out) return false;
-
+    ISocketSubsystem* Subsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
     FIPv4Address IP;
     if (!FIPv4Address::Parse(ServerIP, IP)) return false;
 
-    TSharedRef<FInternetAddr> Addr = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->CreateInternetAddr();
+    TSharedRef<FInternetAddr> Addr = Subsystem->CreateInternetAddr();
     Addr->SetIp(IP.Value);
     Addr->SetPort(Port);
 
-    while (bRunning && !Out->Connect(*Addr))
+    ssb::Backoff Backoff((uint32)FMath::Max(ReconnectFirstMs, 1), (uint32)FMath::Max(ReconnectMaxMs, 1));
+    const double Start = FPlatformTime::Seconds();
+    while (bRunning)
     {
-        UE_LOG(LogTemp, Warning, TEXT("Retry connect to %s:%d in 3s..."), *ServerIP, Port);
-        FPlatformProcess::Sleep(3.f);
+        if (Out) { Out->Close(); Subsystem->DestroySocket(Out); Out = nullptr; }
+        Out = MakeTcp();
+        if (!Out) return false;
+
+        Out->SetNonBlocking(true);
+        Out->Connect(*Addr);
+        if (Out->Wait(ESocketWaitConditions::WaitForWrite, FTimespan::FromMilliseconds(ConnectTimeoutMs)) &&
+            Out->GetConnectionState() == SCS_Connected)
+        {
+            Out->SetNonBlocking(false);
+            if (Backoff.attempts() > 0)
+                UE_LOG(LogTemp, Warning, TEXT("Connected to %s:%d after %u retries (%.1f ms)"), *ServerIP, Port,
+                    Backoff.attempts(), (FPlatformTime::Seconds() - Start) * 1e3);
+            ApplySocketProfile(Out, Port == CmdPort ? TEXT("cmd") : TEXT("data"));
+            return true;
+        }
+
+        const uint32 DelayMs = Backoff.next();
+        if (Backoff.attempts() == 1 || DelayMs >= (uint32)ReconnectMaxMs * 3 / 4)
+            UE_LOG(LogTemp, Warning, TEXT("Retry connect to %s:%d in %u ms..."), *ServerIP, Port, DelayMs);
+        FPlatformProcess::Sleep(DelayMs / 1000.f);
     }
-    return bRunning;
+    return false;
+}
+
+// Pins the calling I/O thread (0 = cmd, 1 = sender) and raises it to
+// time-critical. Logs what took effect.
+void ABridgeSender::ApplyThreadProfile(int32 Index, const TCHAR* Name)
+{
+    if (!bLowLatencyProfile) return;
+    const int32 Cores = FPlatformMisc::NumberOfCoresIncludingHyperthreads();
+    const int32 Core = IoThreadCore >= 0 ? IoThreadCore + Index : FMath::Max(Cores - 1 - Index, 0);
+    const bool bPinned = Core < 64 && Core < Cores;
+    if (bPinned) FPlatformProcess::SetThreadAffinityMask(1ull << Core);
+
+    FRunnableThread* Thread = FRunnableThread::GetRunnableThread();
+    if (Thread) Thread->SetThreadPriority(TPri_TimeCritical);
+    UE_LOG(LogTemp, Warning, TEXT("[LOWLAT] %s thread: core %s | time-critical %s"), Name,
+        bPinned ? *FString::FromInt(Core) : TEXT("-"), Thread ? TEXT("on") : TEXT("-"));
+}
+
+void ABridgeSender::ApplySocketProfile(FSocket* Socket, const TCHAR* Name)
+{
+    if (!bLowLatencyProfile || !Socket) return;
+    int32 Snd = -1, Rcv = -1;
+    if (SocketBufferBytes > 0)
+    {
+        Socket->SetSendBufferSize(SocketBufferBytes, Snd);
+        Socket->SetReceiveBufferSize(SocketBufferBytes, Rcv);
+    }
+    // busy poll, quick ACK and SO_PRIORITY need the native handle, which
+    // FSocket does not expose; the native clients set them
+    UE_LOG(LogTemp, Warning, TEXT("[LOWLAT] %s socket: sndbuf %d | rcvbuf %d | busy_poll - | quickack - | prio -"),
+        Name, Snd, Rcv);
+}
+
+// One 8-byte echo on CMD. The low-latency profile spins on the socket
+// until the bytes are there; otherwise wait for readability, then Recv.
+bool ABridgeSender::RecvEcho(double& Echo, double TimeoutSec)
+{
+    int32 Read = 0;
+    if (bLowLatencyProfile)
+    {
+        const double Deadline = FPlatformTime::Seconds() + TimeoutSec;
+        uint32 Pending = 0;
+        while (!(CmdSocket->HasPendingData(Pending) && Pending >= sizeof(double)))
+        {
+            if (!bRunning || FPlatformTime::Seconds() > Deadline) return false;
+            FPlatformProcess::YieldCycles(100);
+        }
+        return CmdSocket->Recv((uint8*)&Echo, sizeof(double), Read) && Read == sizeof(double);
+    }
+    return CmdSocket->Wait(ESocketWaitConditions::WaitForRead, FTimespan::FromSeconds(TimeoutSec)) &&
+        CmdSocket->Recv((uint8*)&Echo, sizeof(double), Read, ESocketReceiveFlags::None);
 }
 
 void ABridgeSender::CloseAll()
@@ -67,26 +210,22 @@ void ABridgeSender::CloseAll()
 
 void ABridgeSender::ListenForCommand()
 {
+    ApplyThreadProfile(0, TEXT("cmd"));
+
 reconnect:
     if (!bRunning) return;
 
     if (!ConnectSocket(CmdSocket, CmdPort)) return;
-    UE_LOG(LogTemp, Warning, TEXT("Connected to %s:%d"), *ServerIP, CmdPort);
+    if (bEverConnected) ++Reconnects;
+    bEverConnected = true;
+    UE_LOG(LogTemp, Warning, TEXT("Connected to %s:%d (reconnects %u)"), *ServerIP, CmdPort, Reconnects);
 
     uint8 Code = 0;
     int32 Bytes = 0;
 
-    double WaitStart = FPlatformTime::Seconds();
-    bool bGotCommand = false;
-
-    while (bRunning && (FPlatformTime::Seconds() - WaitStart) < 5.0)
-    {
-        if (CmdSocket->Recv(&Code, 1, Bytes))
-        {
-            if (Bytes > 0) { bGotCommand = true; break; }
-        }
-        FPlatformProcess::Sleep(0.05f);
-    }
+    // wake on the command byte instead of polling every 50 ms
+    bool bGotCommand = CmdSocket->Wait(ESocketWaitConditions::WaitForRead, FTimespan::FromSeconds(5.0)) &&
+        CmdSocket->Recv(&Code, 1, Bytes) && Bytes > 0;
 
     if (!bGotCommand)
     {
@@ -125,47 +264,61 @@ reconnect:
 void ABridgeSender::RunLatencyTest()
 {
     const double Duration = 30.0, Interval = 0.1;
-    double Start = FPlatformTime::Seconds(), Last = 0, LastReport = Start;
-    double Sum = 0, Min = 9999, Max = 0, LastSum = 0; int32 Count = 0, LastCount = 0;
+    if (ProbeRate > 0)
+    {
+        RunProbeLoop(TEXT("[LATENCY][PROBE]"), Duration);
+        UE_LOG(LogTemp, Warning, TEXT("Latency test end"));
+        return;
+    }
+
+    double Start = FPlatformTime::Seconds(), LastReport = Start;
+    ssb::Histogram Window, Total; // ns, corrected for coordinated omission
+
+    // pings leave on absolute 100 ms ticks instead of Sleep(1) polling
+    ssb::TickScheduler Ticks((uint64)(Interval * 1e9));
+    FTickTimer Timer(Ticks);
+    Ticks.calibrate();
+    Ticks.start();
 
     while (bRunning && (FPlatformTime::Seconds() - Start) < Duration)
     {
-        double Now = FPlatformTime::Seconds();
-        if (Now - Last >= Interval)
+        Ticks.wait();
+
+        double T = FPlatformTime::Seconds(); int32 Sent = 0, Recv = 0;
+        CmdSocket->Send((uint8*)&T, sizeof(double), Sent);
+        double Echo = 0;
+        if (bLowLatencyProfile ? RecvEcho(Echo, Interval) : CmdSocket->Recv((uint8*)&Echo, sizeof(double), Recv))
         {
-            Last = Now;
-            double T = Now; int32 Sent = 0, Recv = 0;
-            CmdSocket->Send((uint8*)&T, sizeof(double), Sent);
-            double Echo = 0;
-            if (CmdSocket->Recv((uint8*)&Echo, sizeof(double), Recv))
-            {
-                double L = (FPlatformTime::Seconds() - T) * 1000.0;
-                Sum += L; Min = FMath::Min(Min, L); Max = FMath::Max(Max, L); Count++;
-            }
+            double L = FPlatformTime::Seconds() - T;
+            Window.record_corrected((uint64)(L * 1e9), (uint64)(Interval * 1e9));
         }
-        if (FPlatformTime::Seconds() - LastReport > 5.0 && Count > LastCount)
+
+        if (FPlatformTime::Seconds() - LastReport > 5.0 && Window.count() > 0)
         {
-            double ds = Sum - LastSum; int32 n = Count - LastCount;
-            UE_LOG(LogTemp, Warning, TEXT("[LATENCY] Avg %.3f ms | Min %.3f | Max %.3f | Samples=%d"),
-                ds / n, Min, Max, n);
-            LastReport = FPlatformTime::Seconds(); LastSum = Sum; LastCount = Count; Min = 9999; Max = 0;
+            LogLatency(TEXT("[LATENCY]"), Window);
+            Total.merge(Window);
+            Window.reset();
+            LastReport = FPlatformTime::Seconds();
         }
-        FPlatformProcess::Sleep(0.001f);
     }
+    Total.merge(Window);
+    LogLatency(TEXT("[LATENCY][FINAL]"), Total);
+    LogSendMiss(TEXT("[LATENCY][FINAL]"), Ticks);
     UE_LOG(LogTemp, Warning, TEXT("Latency test end"));
 }
 
 void ABridgeSender::RunThroughputTest()
 {
     const double Duration = 30.0;
-    TArray<uint8> Buf; Buf.SetNumUninitialized(65536);
+    ssb::FrameRef Buf = Pool.acquire(65536);
+    if (!Buf) { UE_LOG(LogTemp, Error, TEXT("[THROUGHPUT] no free send buffer")); return; }
     double Start = FPlatformTime::Seconds(), LastReport = Start;
     int64 Total = 0, LastTotal = 0; 
     int32 Sent = 0;
 
     while (bRunning && (FPlatformTime::Seconds() - Start) < Duration)
     {
-        DataSocket->Send(Buf.GetData(), Buf.Num(), Sent);
+        DataSocket->Send(Buf.data(), (int32)Buf.size(), Sent);
         Total += Sent;
 
         double Now = FPlatformTime::Seconds();
@@ -191,13 +344,21 @@ void ABridgeSender::RunThroughputTest()
 void ABridgeSender::RunEnduranceTest()
 {
     const double Duration = 30.0;
-    TArray<uint8> Buf; Buf.SetNumUninitialized(4096);
+    ssb::FrameRef Buf = Pool.acquire(4096);
+    if (!Buf) { UE_LOG(LogTemp, Error, TEXT("[ENDURANCE] no free send buffer")); return; }
     double Start = FPlatformTime::Seconds(), LastReport = Start;
     int64 Count = 0; int32 Sent = 0;
 
+    // 1 kHz on absolute ticks instead of Sleep(1) after each send
+    ssb::TickScheduler Ticks(1000000);
+    FTickTimer Timer(Ticks);
+    Ticks.calibrate();
+    Ticks.start();
+
     while (bRunning && (FPlatformTime::Seconds() - Start) < Duration)
     {
-        DataSocket->Send(Buf.GetData(), Buf.Num(), Sent);
+        Ticks.wait();
+        DataSocket->Send(Buf.data(), (int32)Buf.size(), Sent);
         if (Sent > 0) Count++;
 
         double Now = FPlatformTime::Seconds();
@@ -206,10 +367,10 @@ void ABridgeSender::RunEnduranceTest()
             UE_LOG(LogTemp, Warning, TEXT("[ENDURANCE] t=%.0f s packets=%lld"), Now - Start, Count);
             LastReport = Now;
         }
-        FPlatformProcess::Sleep(0.001f);
     }
     UE_LOG(LogTemp, Warning, TEXT("[ENDURANCE] FINAL t=%.0f s packets=%lld"),
         FPlatformTime::Seconds() - Start, Count);
+    LogSendMiss(TEXT("[ENDURANCE][FINAL]"), Ticks);
     UE_LOG(LogTemp, Warning, TEXT("Endurance test end"));
 }
 
@@ -218,15 +379,18 @@ void ABridgeSender::RunCombinedTest()
     const double Duration = CombinedDuration;
     bStopCombined = false;
 
-    TArray<uint8> ThrBuf;
-    ThrBuf.SetNumUninitialized(65536);
-    auto Sender = [this, Duration, ThrBuf]() mutable
+    // the sender thread owns the buffer; it goes back to the pool when
+    // the thread's lambda is destroyed
+    ssb::FrameRef ThrBuf = Pool.acquire(65536);
+    if (!ThrBuf) { UE_LOG(LogTemp, Error, TEXT("[COMBINED] no free send buffer")); return; }
+    auto Sender = [this, Duration, ThrBuf = MoveTemp(ThrBuf)]() mutable
         {
             double Start = FPlatformTime::Seconds();
             double LastReport = Start;
             int64 Total = 0; int32 Sent = 0;
 
-            uint32 Counter = 0;
+            uint32 Counter = CombinedCounter.load();
+            ApplyThreadProfile(1, TEXT("sender"));
 
             bStopCombined = false;
             UE_LOG(LogTemp, Warning, TEXT("[COMBINED] Starting new Combined test session"));
@@ -238,13 +402,13 @@ void ABridgeSender::RunCombinedTest()
                 if (DataSocket->GetConnectionState() != SCS_Connected)
                     break;
 
-                FMemory::Memcpy(ThrBuf.GetData(), &Counter, sizeof(uint32));
-                Counter++;
+                FMemory::Memcpy(ThrBuf.data(), &Counter, sizeof(uint32));
+                CombinedCounter = ++Counter;
 
                 Sent = 0;
-                bool bOK = DataSocket->Send(ThrBuf.GetData(), ThrBuf.Num(), Sent);
+                bool bOK = DataSocket->Send(ThrBuf.data(), (int32)ThrBuf.size(), Sent);
 
-                if (!bOK || Sent != ThrBuf.Num() || DataSocket->GetConnectionState() != SCS_Connected)
+                if (!bOK || Sent != (int32)ThrBuf.size() || DataSocket->GetConnectionState() != SCS_Connected)
                 {
                     UE_LOG(LogTemp, Warning, TEXT("[COMBINED][THR] Connection closed or send failed — stopping sender"));
                     break;
@@ -263,51 +427,152 @@ void ABridgeSender::RunCombinedTest()
                 }
             }
         };
-    Async(EAsyncExecution::Thread, Sender);
+    Async(EAsyncExecution::Thread, MoveTemp(Sender));
+
+    if (ProbeRate > 0)
+    {
+        // latency under load: pipelined probes while the sender saturates DATA
+        RunProbeLoop(TEXT("[COMBINED][PROBE]"), Duration);
+        bStopCombined = true;
+        FPlatformProcess::Sleep(0.5f);
+        UE_LOG(LogTemp, Warning, TEXT("Combined test end"));
+        return;
+    }
 
+    const double PingInterval = 0.1;
     double Start = FPlatformTime::Seconds();
-    double LastPing = 0.0, LastReport = Start;
-    double Sum = 0.0, Min = 9999.0, Max = 0.0;
-    int32 Count = 0;
+    double LastReport = Start;
+    ssb::Histogram Window, Total; // ns, corrected for coordinated omission
+
+    ssb::TickScheduler Ticks((uint64)(PingInterval * 1e9));
+    FTickTimer Timer(Ticks);
+    Ticks.calibrate();
+    Ticks.start();
 
     while (bRunning && (FPlatformTime::Seconds() - Start) < Duration)
     {
-        double Now = FPlatformTime::Seconds();
+        Ticks.wait();
+
+        double T = FPlatformTime::Seconds(); int32 Sent = 0;
+        if (!CmdSocket) break;
+        CmdSocket->Send((uint8*)&T, sizeof(double), Sent);
 
-        if (Now - LastPing >= 0.1)
+        // wait for the echo (50 ms cap) instead of polling
+        double Echo = 0;
+        if (RecvEcho(Echo, 0.05))
         {
-            LastPing = Now;
-            double T = Now; int32 Sent = 0, Recv = 0;
-            if (!CmdSocket) break;
-            CmdSocket->Send((uint8*)&T, sizeof(double), Sent);
-
-            double Echo = 0;
-            double WaitStart = FPlatformTime::Seconds();
-            while (bRunning && (FPlatformTime::Seconds() - WaitStart) < 0.05)
-            {
-                if (CmdSocket->Recv((uint8*)&Echo, sizeof(double), Recv, ESocketReceiveFlags::None))
-                {
-                    double L = (FPlatformTime::Seconds() - T) * 1000.0;
-                    Sum += L; Min = FMath::Min(Min, L); Max = FMath::Max(Max, L); Count++;
-                    break;
-                }
-                FPlatformProcess::Sleep(0.0005);
-            }
+            double L = FPlatformTime::Seconds() - T;
+            Window.record_corrected((uint64)(L * 1e9), (uint64)(PingInterval * 1e9));
         }
 
+        double Now = FPlatformTime::Seconds();
         if (Now - LastReport > 5.0)
         {
-            UE_LOG(LogTemp, Warning, TEXT("[COMBINED][LAT] Avg %.3f ms | Min %.3f | Max %.3f | Samples=%d"),
-                (Count > 0 ? Sum / Count : 0.0), Min, Max, Count);
+            LogLatency(TEXT("[COMBINED][LAT]"), Window);
+            Total.merge(Window);
+            Window.reset();
             LastReport = Now;
         }
-
-        FPlatformProcess::Sleep(0.0005f);
     }
 
     bStopCombined = true;
     FPlatformProcess::Sleep(0.5f);
 
+    Total.merge(Window);
+    LogLatency(TEXT("[COMBINED][LAT][FINAL]"), Total);
+    LogSendMiss(TEXT("[COMBINED][LAT][FINAL]"), Ticks);
+
     UE_LOG(LogTemp, Warning, TEXT("Combined test end"));
 
 }
+
+// Open-loop cmd probes at ProbeRate/s with up to ProbeInFlight outstanding,
+// matched by id as the echoes come back. Latency counts from each probe's
+// intended send time (beyond the 1 ms pacing tick), so a backed-up window
+// or socket shows up in the percentiles instead of being skipped.
+void ABridgeSender::RunProbeLoop(const TCHAR* Tag, double Duration)
+{
+    const uint64 TickNs = 1000000;
+    ssb::ProbeWindow Window((uint32)FMath::Max(ProbeInFlight, 1));
+    ssb::Histogram Lat, Rtt, Total;
+
+    TArray<uint8> Out;
+    TArray<uint8> In; In.SetNumUninitialized(64 * 1024);
+    int32 InGot = 0;
+
+    ssb::TickScheduler Ticks(TickNs);
+    FTickTimer Timer(Ticks);
+    Ticks.calibrate();
+    Ticks.start();
+    const uint64 T0 = ssb::TickScheduler::now();
+    uint64 Scheduled = 0;
+
+    double Start = FPlatformTime::Seconds(), LastReport = Start;
+    UE_LOG(LogTemp, Warning, TEXT("%s %.0f probes/s, %d in flight"), Tag, ProbeRate, ProbeInFlight);
+
+    while (bRunning && CmdSocket && (FPlatformTime::Seconds() - Start) < Duration)
+    {
+        Ticks.wait();
+
+        uint64 Now = ssb::TickScheduler::now();
+        uint64 Due = (uint64)((double)(Now - T0) * ProbeRate / 1e9) + 1;
+        Out.Reset();
+        while (Scheduled < Due && !Window.full())
+        {
+            uint64 Intended = T0 + (uint64)((double)Scheduled * 1e9 / ProbeRate);
+            Intended += FMath::Min<uint64>(Now > Intended ? Now - Intended : 0, TickNs);
+            ssb::Probe P = Window.issue(Intended, Now);
+            Out.Append((const uint8*)&P, sizeof(P));
+            ++Scheduled;
+        }
+
+        // at most ProbeInFlight * 16 bytes are unanswered, so this blocking
+        // send cannot deadlock against the echoes we have not read yet
+        int32 Sent = 0;
+        if (Out.Num() > 0 && !CmdSocket->Send(Out.GetData(), Out.Num(), Sent))
+            break;
+
+        // drain whatever echoes are already here, without blocking
+        uint32 Pending = 0;
+        while (CmdSocket->HasPendingData(Pending) && Pending > 0)
+        {
+            int32 Read = 0;
+            if (!CmdSocket->Recv(In.GetData() + InGot, In.Num() - InGot, Read) || Read <= 0)
+                break;
+            InGot += Read;
+
+            uint64 RecvNs = ssb::TickScheduler::now();
+            int32 Off = 0;
+            for (; InGot - Off >= (int32)ssb::PROBE_SIZE; Off += (int32)ssb::PROBE_SIZE)
+            {
+                ssb::Probe Echo;
+                FMemory::Memcpy(&Echo, In.GetData() + Off, ssb::PROBE_SIZE);
+                uint64 L = 0, R = 0;
+                if (Window.complete(Echo, RecvNs, L, R))
+                {
+                    Lat.record(L);
+                    Rtt.record(R);
+                }
+            }
+            if (Off < InGot) FMemory::Memmove(In.GetData(), In.GetData() + Off, InGot - Off);
+            InGot -= Off;
+        }
+
+        double NowS = FPlatformTime::Seconds();
+        if (NowS - LastReport > 5.0 && Lat.count() > 0)
+        {
+            LogLatency(Tag, Lat);
+            UE_LOG(LogTemp, Warning, TEXT("%s rtt p50 %.3f ms | p99 %.3f | in flight %u"),
+                Tag, Rtt.percentile(50.0) / 1e6, Rtt.percentile(99.0) / 1e6, Window.in_flight());
+            Total.merge(Lat);
+            Lat.reset();
+            Rtt.reset();
+            LastReport = NowS;
+        }
+    }
+
+    Total.merge(Lat);
+    FString FinalTag = FString(Tag) + TEXT("[FINAL]");
+    LogLatency(*FinalTag, Total);
+    LogSendMiss(*FinalTag, Ticks);
+}
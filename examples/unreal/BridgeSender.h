@@ -2,6 +2,8 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include <atomic>
+#include "ssb/frame_pool.h"
+#include "ssb/backoff.h"
 #include "BridgeSender.generated.h"
 
 class FSocket;
@@ -28,9 +30,43 @@ public:
     UPROPERTY(EditAnywhere, Category = "Socket")
     bool bConnectOnBeginPlay = true;
 
+    // Reconnect backoff: the first retry after this many ms, doubling up
+    // to ReconnectMaxMs. Each attempt's connect gives up after ConnectTimeoutMs.
+    UPROPERTY(EditAnywhere, Category = "Socket")
+    int32 ReconnectFirstMs = 1;
+
+    UPROPERTY(EditAnywhere, Category = "Socket")
+    int32 ReconnectMaxMs = 500;
+
+    UPROPERTY(EditAnywhere, Category = "Socket")
+    int32 ConnectTimeoutMs = 200;
+
     UPROPERTY(EditAnywhere, Category = "Socket")
     double CombinedDuration = 86400.0;
 
+    // Pipelined cmd probes per second for the latency and combined tests
+    // (0 = one stop-and-wait ping every 100 ms).
+    UPROPERTY(EditAnywhere, Category = "Socket")
+    double ProbeRate = 0.0;
+
+    UPROPERTY(EditAnywhere, Category = "Socket")
+    int32 ProbeInFlight = 64;
+
+    // Low-latency profile (the FSocket subset of ssb/lowlat.h): pins the
+    // cmd and sender threads, runs them time-critical, fixes the socket
+    // buffer sizes and spins for echoes instead of blocking in Recv.
+    UPROPERTY(EditAnywhere, Category = "Socket|LowLatency")
+    bool bLowLatencyProfile = false;
+
+    // Core of the cmd thread; the sender thread takes the next one
+    // (-1 = the last cores).
+    UPROPERTY(EditAnywhere, Category = "Socket|LowLatency")
+    int32 IoThreadCore = -1;
+
+    // SO_SNDBUF / SO_RCVBUF in bytes (0 = OS default).
+    UPROPERTY(EditAnywhere, Category = "Socket|LowLatency")
+    int32 SocketBufferBytes = 0;
+
 private:
     FSocket* CmdSocket = nullptr;
     FSocket* DataSocket = nullptr;
@@ -38,12 +74,27 @@ private:
     std::atomic<bool> bRunning{ false };
     std::atomic<bool> bStopCombined{ false };
 
+    // Kept across reconnects. Legacy packets carry no token, so the server
+    // still sees a reconnect as a new session (no FRAME_RESUME here).
+    std::atomic<uint32> CombinedCounter{ 0 };
+    uint32 Reconnects = 0;
+    bool bEverConnected = false;
+
+    // Send buffers for all tests; taken per test, returned when the
+    // test (or the combined sender thread) lets go of them.
+    ssb::FramePool Pool{ { 4096, 4 }, { 65536, 4 } };
+
     void ListenForCommand();
     bool ConnectSocket(FSocket*& Out, int32 Port);
     void CloseAll();
 
+    void ApplyThreadProfile(int32 Index, const TCHAR* Name);
+    void ApplySocketProfile(FSocket* Socket, const TCHAR* Name);
+    bool RecvEcho(double& Echo, double TimeoutSec);
+
     void RunLatencyTest();
     void RunThroughputTest();
     void RunEnduranceTest();
     void RunCombinedTest();
+    void RunProbeLoop(const TCHAR* Tag, double Duration);
 };
@@ -0,0 +1,42 @@
+// ssb/affinity.h
+// CPU pinning for transport threads.
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+namespace ssb
+{
+
+// CPUs this process may run on.
+inline int online_cpus()
+{
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) return CPU_COUNT(&set);
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+// The n-th CPU (wrapping) of the process affinity mask, or -1.
+inline int nth_cpu(int n)
+{
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) != 0 || CPU_COUNT(&set) == 0) return -1;
+    n %= CPU_COUNT(&set);
+    for (int c = 0; c < CPU_SETSIZE; ++c)
+        if (CPU_ISSET(c, &set) && n-- == 0) return c;
+    return -1;
+}
+
+// Pins the calling thread to one CPU. False if the CPU is not allowed.
+inline bool pin_current_thread(int cpu)
+{
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+} // namespace ssb
@@ -0,0 +1,112 @@
+// ssb/agent_table.h
+// Per-agent latest-only slots for the multi-agent control path. Each agent
+// owns a triple buffer (one writer, one reader): the writer fills its back
+// buffer and swaps it into the middle, the reader swaps the middle out when
+// it is fresh. Neither side waits and the reader gets a stable buffer it can
+// hand straight to sendmmsg() without copying. A dirty bitmap lets the
+// reader visit only agents that changed since the last tick.
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace ssb
+{
+
+class AgentTable
+{
+public:
+    AgentTable(uint32_t agents, size_t slot_capacity)
+        : agents_(agents), cap_(slot_capacity),
+          slots_(new Slot[agents]),
+          storage_(new uint8_t[(size_t)agents * 3 * slot_capacity]),
+          dirty_(new std::atomic<uint64_t>[(agents + 63) / 64])
+    {
+        for (uint32_t w = 0; w < (agents + 63) / 64; ++w)
+            dirty_[w].store(0, std::memory_order_relaxed);
+    }
+
+    uint32_t agents() const { return agents_; }
+    size_t slot_capacity() const { return cap_; }
+
+    // ---- writer (ingress thread) ----
+
+    // Copies one message into the agent's back buffer and publishes it,
+    // replacing any unread older message. False if id or size is out of range.
+    bool publish(uint32_t agent, const void* data, size_t len)
+    {
+        if (agent >= agents_ || len > cap_) return false;
+
+        Slot& s = slots_[agent];
+        memcpy(buffer(agent, s.back), data, len);
+        s.len[s.back] = (uint32_t)len;
+
+        uint8_t prev = s.middle.exchange((uint8_t)(s.back | FRESH), std::memory_order_acq_rel);
+        s.back = prev & INDEX;
+        if (prev & FRESH) s.overwrites++;
+
+        dirty_[agent / 64].fetch_or(1ull << (agent % 64), std::memory_order_release);
+        return true;
+    }
+
+    // ---- reader (egress thread) ----
+
+    // Calls fn(agent, data, len) for every agent published since the last
+    // call. The buffer stays valid until the next take for that agent.
+    template <typename Fn>
+    uint32_t take_changed(Fn&& fn)
+    {
+        uint32_t n = 0;
+        for (uint32_t w = 0; w < (agents_ + 63) / 64; ++w)
+        {
+            uint64_t bits = dirty_[w].exchange(0, std::memory_order_acquire);
+            while (bits)
+            {
+                uint32_t agent = w * 64 + (uint32_t)__builtin_ctzll(bits);
+                bits &= bits - 1;
+
+                Slot& s = slots_[agent];
+                if (!(s.middle.load(std::memory_order_relaxed) & FRESH))
+                    continue; // already taken via an earlier dirty bit
+
+                uint8_t prev = s.middle.exchange(s.front, std::memory_order_acq_rel);
+                s.front = prev & INDEX;
+                fn(agent, (const uint8_t*)buffer(agent, s.front), (size_t)s.len[s.front]);
+                ++n;
+            }
+        }
+        return n;
+    }
+
+    // Messages replaced before the reader saw them (writer-side count).
+    uint64_t overwrites(uint32_t agent) const { return slots_[agent].overwrites; }
+
+private:
+    static constexpr uint8_t INDEX = 0x3;
+    static constexpr uint8_t FRESH = 0x4;
+
+    struct alignas(64) Slot
+    {
+        std::atomic<uint8_t> middle{ 1 };
+        uint8_t back = 0;  // writer-owned
+        uint8_t front = 2; // reader-owned
+        uint32_t len[3] = { 0, 0, 0 };
+        uint64_t overwrites = 0;
+    };
+
+    uint8_t* buffer(uint32_t agent, uint8_t idx)
+    {
+        return storage_.get() + ((size_t)agent * 3 + idx) * cap_;
+    }
+
+    uint32_t agents_;
+    size_t cap_;
+    std::unique_ptr<Slot[]> slots_;
+    std::unique_ptr<uint8_t[]> storage_;
+    std::unique_ptr<std::atomic<uint64_t>[]> dirty_;
+};
+
+} // namespace ssb
@@ -0,0 +1,58 @@
+// ssb/alloc_counter.h
+// Process-wide heap allocation counter for benchmarks. Define
+// SSB_ALLOC_COUNTER_IMPL in exactly one translation unit (the bench's
+// main file) before including this header: that TU then replaces the
+// global operator new/delete with counting versions over malloc/free.
+// Everywhere else alloc_count() just reads the counter.
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace ssb
+{
+
+inline std::atomic<uint64_t>& alloc_counter()
+{
+    static std::atomic<uint64_t> n{ 0 };
+    return n;
+}
+
+// operator new calls since start (0 unless SSB_ALLOC_COUNTER_IMPL is linked in)
+inline uint64_t alloc_count() { return alloc_counter().load(std::memory_order_relaxed); }
+
+} // namespace ssb
+
+#if defined(SSB_ALLOC_COUNTER_IMPL)
+
+// GCC sees malloc/free through the inlined replacements and flags the pair
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t n)
+{
+    ssb::alloc_counter().fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t n) { return operator new(n); }
+void* operator new(std::size_t n, const std::nothrow_t&) noexcept
+{
+    ssb::alloc_counter().fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(n ? n : 1);
+}
+void* operator new[](std::size_t n, const std::nothrow_t& t) noexcept { return operator new(n, t); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
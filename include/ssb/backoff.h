@@ -0,0 +1,57 @@
+// ssb/backoff.h
+// Reconnect pacing: exponential from a millisecond up, with jitter so a
+// fleet of clients does not reconnect in lockstep. Used by
+// ResumableSession (session.h) and by the Unreal example's connect loop,
+// so it depends on the standard library only.
+#pragma once
+
+#include <cstdint>
+#include <random>
+
+namespace ssb
+{
+
+// Exponential backoff with +-25 % jitter: first_ms, 2x, 4x ... up to max_ms.
+class Backoff
+{
+public:
+    explicit Backoff(uint32_t first_ms = 1, uint32_t max_ms = 1000)
+        : first_(first_ms ? first_ms : 1), max_(max_ms < first_ms ? first_ms : max_ms), rng_(seed())
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        cur_ = first_;
+        attempts_ = 0;
+    }
+
+    // Delay before the next attempt, in ms.
+    uint32_t next()
+    {
+        uint32_t base = cur_;
+        cur_ = cur_ >= max_ / 2 ? max_ : cur_ * 2;
+        ++attempts_;
+
+        rng_ ^= rng_ << 13; rng_ ^= rng_ >> 7; rng_ ^= rng_ << 17;
+        uint32_t span = base / 2;  // jitter in [-base/4, +base/4]
+        return span ? base - span / 2 + (uint32_t)(rng_ % (span + 1)) : base;
+    }
+
+    uint32_t attempts() const { return attempts_; }
+
+private:
+    static uint64_t seed()
+    {
+        std::random_device rd;
+        uint64_t s = ((uint64_t)rd() << 32) ^ rd();
+        return s ? s : 0x9E3779B97F4A7C15ull;  // xorshift must not start at 0
+    }
+
+    uint32_t first_, max_, cur_ = 0;
+    uint32_t attempts_ = 0;
+    uint64_t rng_;
+};
+
+} // namespace ssb
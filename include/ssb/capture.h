@@ -0,0 +1,468 @@
+// ssb/capture.h
+// Frame capture: every sent or received frame (or datagram) appended to a
+// memory-mapped, segment-rotated binary log, so a run can be inspected or
+// replayed later without the simulator that produced it.
+//
+// A capture is a series of files <prefix>.000000.ssbcap, .000001, ...
+// Each segment is preallocated and mapped once; the hot path is a bounds
+// check, one memcpy of the bytes into the mapping and a release store of
+// the new end, so a live reader can follow along. Segments rotate when
+// full; with keep_segments set, the oldest ones are deleted.
+//
+//   [CaptureSegmentHeader, 4 KB][index, 64 KB][record][record]...
+//   record = [CaptureRecord 16][bytes, padded to 8]
+//
+// The sparse time index holds one (ns, offset) entry per index_interval_ns
+// of capture time, so CaptureReader::seek() finds a moment in a long run
+// with a binary search and a short scan. A segment also rotates when its
+// index is full.
+//
+// One writer per thread: give each transport thread its own prefix (the
+// control core uses <prefix>.rx and <prefix>.tx).
+#pragma once
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "frame.h"
+
+namespace ssb
+{
+
+enum CaptureDir : uint8_t
+{
+    CAPTURE_RX = 1,
+    CAPTURE_TX = 2,
+};
+
+struct CaptureRecord
+{
+    uint32_t size;      // bytes that follow, before padding
+    uint8_t dir;        // CaptureDir
+    uint8_t reserved;
+    uint16_t segment;   // UDP GRO/GSO segment size; 0 = one frame/datagram
+    uint64_t ns;        // mono_ns when sent / received
+};
+
+struct CaptureIndexEntry
+{
+    uint64_t ns;
+    uint64_t offset;    // of a record, from CAPTURE_DATA_OFFSET
+};
+
+struct CaptureSegmentHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t closed;    // 1 once the writer moved on; data_end is final
+    uint32_t segment;   // position in the series
+    std::atomic<uint32_t> index_count;
+    uint64_t first_ns;
+    std::atomic<uint64_t> last_ns;
+    std::atomic<uint64_t> data_end;  // record bytes from CAPTURE_DATA_OFFSET
+    std::atomic<uint64_t> records;
+};
+
+static_assert(sizeof(CaptureRecord) == 16, "CaptureRecord is 16 bytes");
+
+constexpr uint32_t CAPTURE_MAGIC = 0x43425353; // "SSBC"
+constexpr uint16_t CAPTURE_VERSION = 1;
+constexpr size_t CAPTURE_HEADER_BYTES = 4096;
+constexpr size_t CAPTURE_INDEX_ENTRIES = 4096;
+constexpr size_t CAPTURE_DATA_OFFSET = CAPTURE_HEADER_BYTES + CAPTURE_INDEX_ENTRIES * sizeof(CaptureIndexEntry);
+
+struct CaptureConfig
+{
+    size_t segment_bytes = 256u << 20;
+    uint64_t index_interval_ns = 10000000;  // 10 ms
+    uint32_t keep_segments = 0;             // 0 = keep all
+};
+
+namespace capture_detail
+{
+
+inline std::string segment_path(const std::string& prefix, uint32_t n)
+{
+    char num[16];
+    snprintf(num, sizeof(num), ".%06u.ssbcap", n);
+    return prefix + num;
+}
+
+inline size_t padded(size_t n) { return (n + 7) & ~(size_t)7; }
+
+// Segment numbers of <prefix> present on disk, ascending.
+inline std::vector<uint32_t> list_segments(const std::string& prefix)
+{
+    size_t slash = prefix.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : prefix.substr(0, slash ? slash : 1);
+    std::string base = slash == std::string::npos ? prefix : prefix.substr(slash + 1);
+
+    std::vector<uint32_t> numbers;
+    if (DIR* d = opendir(dir.c_str()))
+    {
+        while (dirent* e = readdir(d))
+        {
+            unsigned n;
+            char tail[8];
+            const char* name = e->d_name;
+            if (strncmp(name, base.c_str(), base.size()) != 0 || strlen(name) != base.size() + 14) continue;
+            if (sscanf(name + base.size(), ".%6u.%7s", &n, tail) == 2 && !strcmp(tail, "ssbcap"))
+                numbers.push_back(n);
+        }
+        closedir(d);
+    }
+    std::sort(numbers.begin(), numbers.end());
+    return numbers;
+}
+
+} // namespace capture_detail
+
+class CaptureWriter
+{
+public:
+    CaptureWriter() = default;
+    ~CaptureWriter() { close(); }
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+    // Starts a new series at <prefix>.000000.ssbcap, deleting the segments
+    // of an earlier capture under the same prefix.
+    bool open(const char* prefix, const CaptureConfig& cfg = CaptureConfig())
+    {
+        close();
+        if (cfg.segment_bytes < CAPTURE_DATA_OFFSET + 4096) return false;
+        prefix_ = prefix;
+        for (uint32_t n : capture_detail::list_segments(prefix_))
+            unlink(capture_detail::segment_path(prefix_, n).c_str());
+        cfg_ = cfg;
+        next_segment_ = 0;
+        return start_segment();
+    }
+
+    void close()
+    {
+        finish_segment();
+        prefix_.clear();
+    }
+
+    bool is_open() const { return base_ != nullptr; }
+
+    // Appends one record: `len` bytes captured at `ns`. False (and counted
+    // in dropped()) when the record cannot be stored.
+    bool append(uint8_t dir, const void* data, size_t len, uint64_t ns, uint16_t segment = 0)
+    {
+        uint8_t* p = reserve(len, ns);
+        if (!p) return false;
+        CaptureRecord r{ (uint32_t)len, dir, 0, segment, ns };
+        memcpy(p, &r, sizeof(r));
+        memcpy(p + sizeof(r), data, len);
+        return commit(len);
+    }
+
+    // A frame whose header and payload are not contiguous (FrameWriter).
+    bool append_frame(uint8_t dir, const FrameHeader& h, const void* payload, uint64_t ns,
+        const void* trailer = nullptr, size_t trailer_len = 0)
+    {
+        const size_t len = FRAME_HEADER_SIZE + h.payload_len;
+        uint8_t* p = reserve(len, ns);
+        if (!p) return false;
+        CaptureRecord r{ (uint32_t)len, dir, 0, 0, ns };
+        memcpy(p, &r, sizeof(r));
+        memcpy(p + sizeof(r), &h, FRAME_HEADER_SIZE);
+        memcpy(p + sizeof(r) + FRAME_HEADER_SIZE, payload, h.payload_len - trailer_len);
+        if (trailer_len) memcpy(p + sizeof(r) + len - trailer_len, trailer, trailer_len);
+        return commit(len);
+    }
+
+    uint64_t records() const { return records_; }
+    uint64_t bytes() const { return bytes_; }
+    uint64_t dropped() const { return dropped_; }
+    uint32_t segments() const { return next_segment_; }
+
+private:
+    CaptureSegmentHeader* header() { return (CaptureSegmentHeader*)base_; }
+
+    // Room for a record of `len` bytes, rotating if needed; indexes it.
+    uint8_t* reserve(size_t len, uint64_t ns)
+    {
+        const size_t need = sizeof(CaptureRecord) + capture_detail::padded(len);
+        if (!base_ || CAPTURE_DATA_OFFSET + need > cfg_.segment_bytes)
+        {
+            ++dropped_;
+            return nullptr;
+        }
+        bool want_index = !indexed_ || ns >= last_index_ns_ + cfg_.index_interval_ns;
+        if (end_ + need > cfg_.segment_bytes - CAPTURE_DATA_OFFSET ||
+            (want_index && index_count_ == CAPTURE_INDEX_ENTRIES))
+        {
+            finish_segment();
+            if (!start_segment())
+            {
+                ++dropped_;
+                return nullptr;
+            }
+            want_index = true;
+        }
+        CaptureSegmentHeader* h = header();
+        if (!h->records.load(std::memory_order_relaxed)) h->first_ns = ns;
+        if (want_index)
+        {
+            CaptureIndexEntry* idx = (CaptureIndexEntry*)(base_ + CAPTURE_HEADER_BYTES);
+            idx[index_count_] = CaptureIndexEntry{ ns, end_ };
+            h->index_count.store((uint32_t)++index_count_, std::memory_order_release);
+            last_index_ns_ = ns;
+            indexed_ = true;
+        }
+        h->last_ns.store(ns, std::memory_order_relaxed);
+        return base_ + CAPTURE_DATA_OFFSET + end_;
+    }
+
+    bool commit(size_t len)
+    {
+        end_ += sizeof(CaptureRecord) + capture_detail::padded(len);
+        header()->records.fetch_add(1, std::memory_order_relaxed);
+        header()->data_end.store(end_, std::memory_order_release);
+        ++records_;
+        bytes_ += len;
+        return true;
+    }
+
+    bool start_segment()
+    {
+        std::string path = capture_detail::segment_path(prefix_, next_segment_);
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) return false;
+        // real blocks up front: a full disk fails here, not as SIGBUS on a store
+        if (posix_fallocate(fd, 0, (off_t)cfg_.segment_bytes) != 0)
+        {
+            ::close(fd);
+            unlink(path.c_str());
+            return false;
+        }
+        void* mem = mmap(nullptr, cfg_.segment_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mem == MAP_FAILED)
+        {
+            ::close(fd);
+            unlink(path.c_str());
+            return false;
+        }
+        fd_ = fd;
+        base_ = (uint8_t*)mem;
+        end_ = 0;
+        index_count_ = 0;
+        indexed_ = false;
+
+        CaptureSegmentHeader* h = new (base_) CaptureSegmentHeader;
+        h->version = CAPTURE_VERSION;
+        h->closed = 0;
+        h->segment = next_segment_;
+        h->index_count.store(0, std::memory_order_relaxed);
+        h->first_ns = 0;
+        h->last_ns.store(0, std::memory_order_relaxed);
+        h->data_end.store(0, std::memory_order_relaxed);
+        h->records.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        h->magic = CAPTURE_MAGIC;
+
+        if (cfg_.keep_segments && next_segment_ >= cfg_.keep_segments)
+            unlink(capture_detail::segment_path(prefix_, next_segment_ - cfg_.keep_segments).c_str());
+        ++next_segment_;
+        return true;
+    }
+
+    // Marks the segment final and gives back the unused preallocation.
+    void finish_segment()
+    {
+        if (!base_) return;
+        header()->closed = 1;
+        munmap(base_, cfg_.segment_bytes);
+        base_ = nullptr;
+        if (ftruncate(fd_, (off_t)(CAPTURE_DATA_OFFSET + end_)) != 0) {}
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+    std::string prefix_;
+    CaptureConfig cfg_;
+    uint32_t next_segment_ = 0;
+    int fd_ = -1;
+    uint8_t* base_ = nullptr;
+    uint64_t end_ = 0;
+    size_t index_count_ = 0;
+    uint64_t last_index_ns_ = 0;
+    bool indexed_ = false;
+
+    uint64_t records_ = 0;
+    uint64_t bytes_ = 0;
+    uint64_t dropped_ = 0;
+};
+
+// One record as read back; `data` points into the mapping.
+struct CaptureView
+{
+    uint8_t dir;
+    uint16_t segment;
+    uint64_t ns;
+    const uint8_t* data;
+    size_t size;
+};
+
+// Reads a series in order. Segments still being written are read up to
+// the writer's last published record.
+class CaptureReader
+{
+public:
+    CaptureReader() = default;
+    ~CaptureReader() { close(); }
+    CaptureReader(const CaptureReader&) = delete;
+    CaptureReader& operator=(const CaptureReader&) = delete;
+
+    // Maps every segment of <prefix> that exists (rotated-out ones are
+    // simply missing). False if there is none or one is malformed.
+    bool open(const char* prefix)
+    {
+        close();
+        const std::string pre = prefix;
+        for (uint32_t n : capture_detail::list_segments(pre))
+        {
+            Segment s;
+            std::string path = capture_detail::segment_path(pre, n);
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            struct stat st;
+            if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < CAPTURE_DATA_OFFSET)
+            {
+                if (fd >= 0) ::close(fd);
+                close();
+                return false;
+            }
+            s.size = (size_t)st.st_size;
+            void* mem = mmap(nullptr, s.size, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (mem == MAP_FAILED)
+            {
+                close();
+                return false;
+            }
+            s.base = (const uint8_t*)mem;
+            segs_.push_back(s);
+            if (s.header()->magic != CAPTURE_MAGIC || s.header()->version != CAPTURE_VERSION)
+            {
+                close();
+                return false;
+            }
+        }
+        seg_ = 0;
+        off_ = 0;
+        return !segs_.empty();
+    }
+
+    void close()
+    {
+        for (Segment& s : segs_) munmap((void*)s.base, s.size);
+        segs_.clear();
+        seg_ = 0;
+        off_ = 0;
+    }
+
+    size_t segments() const { return segs_.size(); }
+    uint64_t first_ns() const { return segs_.empty() ? 0 : segs_.front().header()->first_ns; }
+    uint64_t last_ns() const { return segs_.empty() ? 0 : segs_.back().header()->last_ns.load(std::memory_order_relaxed); }
+    uint64_t records() const
+    {
+        uint64_t n = 0;
+        for (const Segment& s : segs_) n += s.header()->records.load(std::memory_order_relaxed);
+        return n;
+    }
+    uint64_t index_entries() const
+    {
+        uint64_t n = 0;
+        for (const Segment& s : segs_) n += s.header()->index_count.load(std::memory_order_relaxed);
+        return n;
+    }
+
+    // Next record; false at the end of what has been written so far.
+    bool next(CaptureView& out)
+    {
+        while (seg_ < segs_.size())
+        {
+            const Segment& s = segs_[seg_];
+            uint64_t end = std::min<uint64_t>(s.header()->data_end.load(std::memory_order_acquire),
+                s.size - CAPTURE_DATA_OFFSET);
+            if (off_ + sizeof(CaptureRecord) <= end)
+            {
+                const uint8_t* p = s.base + CAPTURE_DATA_OFFSET + off_;
+                CaptureRecord r;
+                memcpy(&r, p, sizeof(r));
+                size_t step = sizeof(r) + capture_detail::padded(r.size);
+                if (off_ + step > end) return false; // torn: the writer died mid-record
+                out = CaptureView{ r.dir, r.segment, r.ns, p + sizeof(r), r.size };
+                off_ += step;
+                return true;
+            }
+            if (seg_ + 1 == segs_.size()) return false;
+            ++seg_;
+            off_ = 0;
+        }
+        return false;
+    }
+
+    // Positions next() at the first record at or after `ns`.
+    void seek(uint64_t ns)
+    {
+        seg_ = 0;
+        off_ = 0;
+        for (size_t i = 0; i < segs_.size(); ++i)
+            if (segs_[i].header()->records.load(std::memory_order_relaxed) && segs_[i].header()->first_ns <= ns)
+                seg_ = i;
+        if (seg_ >= segs_.size()) return;
+
+        // last index entry at or before ns, then scan
+        const Segment& s = segs_[seg_];
+        const CaptureIndexEntry* idx = (const CaptureIndexEntry*)(s.base + CAPTURE_HEADER_BYTES);
+        uint32_t n = s.header()->index_count.load(std::memory_order_acquire);
+        const CaptureIndexEntry* it = std::upper_bound(idx, idx + n, ns,
+            [](uint64_t v, const CaptureIndexEntry& e) { return v < e.ns; });
+        if (it != idx) off_ = (it - 1)->offset;
+
+        size_t seg = seg_;
+        uint64_t off = off_;
+        CaptureView v;
+        while (next(v))
+        {
+            if (v.ns >= ns)
+            {
+                seg_ = seg;
+                off_ = off;
+                return;
+            }
+            seg = seg_;
+            off = off_;
+        }
+    }
+
+private:
+    struct Segment
+    {
+        const uint8_t* base = nullptr;
+        size_t size = 0;
+        const CaptureSegmentHeader* header() const { return (const CaptureSegmentHeader*)base; }
+    };
+
+    std::vector<Segment> segs_;
+    size_t seg_ = 0;
+    uint64_t off_ = 0;
+};
+
+} // namespace ssb
@@ -0,0 +1,396 @@
+// ssb/checksum.h
+// Optional per-frame integrity check: CRC32C (Castagnoli) over header and
+// payload, carried in a 4-byte trailer. A checked frame has
+// FRAME_FLAG_CHECKSUM set and its payload_len counts the trailer:
+//
+//   [FrameHeader flags |= CHECKSUM, payload_len = n + 4][n bytes][crc32c, LE]
+//
+// The CRC covers the 32 header bytes as sent and the n payload bytes, so a
+// flipped seq or length is caught as well as a flipped payload byte, and a
+// stream that lost bytes (a short write nobody finished) fails on the
+// first frame after the gap instead of being parsed as garbage. Receivers
+// that do not check skip payload_len bytes as before and just see four
+// extra bytes at the end of the payload.
+//
+// crc32c() uses the CRC32C instructions when cpu.h finds them (SSE4.2 on
+// x86, the CRC extension on AArch64) and slicing-by-8 tables otherwise.
+// The crc32 instruction has a latency of 3 cycles but a throughput of 1,
+// so the hardware path runs three CRCs over adjacent blocks and merges
+// them with a precomputed shift, which is what makes line rate possible.
+//
+// verify_frame() checks a contiguous frame; FrameChecker checks one whose
+// payload arrives in pieces, as in a streaming parser. What a bad or
+// missing checksum means is the receiver's ChecksumPolicy.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "cpu.h"
+#include "frame.h"
+
+#if defined(SSB_ARM64)
+#include <arm_acle.h>
+#endif
+
+namespace ssb
+{
+
+constexpr uint16_t FRAME_FLAG_CHECKSUM = 1u << 3; // CRC32C trailer at the end of the payload
+constexpr size_t CHECKSUM_SIZE = 4;
+
+namespace crc32c_detail
+{
+
+constexpr uint32_t POLY = 0x82F63B78;  // reflected Castagnoli polynomial
+constexpr size_t LONG = 8192;          // interleaved block sizes of the hardware path
+constexpr size_t SHORT = 256;
+
+struct Tables
+{
+    uint32_t slice[8][256];  // slicing-by-8, scalar path
+    uint32_t long_shift[4][256];   // appends LONG zero bytes to a CRC register
+    uint32_t short_shift[4][256];  // appends SHORT zero bytes
+
+    Tables()
+    {
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? (c >> 1) ^ POLY : c >> 1;
+            slice[0][n] = c;
+        }
+        for (uint32_t n = 0; n < 256; ++n)
+            for (int k = 1; k < 8; ++k)
+                slice[k][n] = (slice[k - 1][n] >> 8) ^ slice[0][slice[k - 1][n] & 0xFF];
+        zeros(long_shift, LONG);
+        zeros(short_shift, SHORT);
+    }
+
+    // GF(2) 32x32 matrix operators; column n is the image of bit n
+    static uint32_t times(const uint32_t* mat, uint32_t vec)
+    {
+        uint32_t sum = 0;
+        for (; vec; vec >>= 1, ++mat)
+            if (vec & 1) sum ^= *mat;
+        return sum;
+    }
+
+    static void square(uint32_t* out, const uint32_t* mat)
+    {
+        for (int n = 0; n < 32; ++n) out[n] = times(mat, mat[n]);
+    }
+
+    // Table form of the operator that feeds `len` (a power of two) zero
+    // bytes through the CRC register.
+    static void zeros(uint32_t (*table)[256], size_t len)
+    {
+        uint32_t odd[32], even[32];
+        odd[0] = POLY;  // one zero bit
+        for (int n = 1; n < 32; ++n) odd[n] = 1u << (n - 1);
+        square(even, odd);  // two bits
+        square(odd, even);  // four bits
+        const uint32_t* op = odd;
+        for (;;)
+        {
+            square(even, odd);  // eight bits, then 32, 128, ...
+            op = even;
+            if ((len >>= 1) == 0) break;
+            square(odd, even);
+            op = odd;
+            if ((len >>= 1) == 0) break;
+        }
+        for (uint32_t n = 0; n < 256; ++n)
+            for (int b = 0; b < 4; ++b) table[b][n] = times(op, n << (8 * b));
+    }
+};
+
+inline const Tables& tables()
+{
+    static const Tables t;
+    return t;
+}
+
+inline uint32_t shift(const uint32_t (*table)[256], uint32_t crc)
+{
+    return table[0][crc & 0xFF] ^ table[1][(crc >> 8) & 0xFF] ^ table[2][(crc >> 16) & 0xFF] ^ table[3][crc >> 24];
+}
+
+inline uint64_t load64(const uint8_t* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Raw register in and out (no inversion) for all of these.
+inline uint32_t update_scalar(uint32_t crc, const uint8_t* p, size_t len)
+{
+    const Tables& t = tables();
+    for (; len >= 8; p += 8, len -= 8)
+    {
+        uint64_t w = load64(p) ^ crc;
+        crc = t.slice[7][w & 0xFF] ^ t.slice[6][(w >> 8) & 0xFF] ^ t.slice[5][(w >> 16) & 0xFF] ^
+              t.slice[4][(w >> 24) & 0xFF] ^ t.slice[3][(w >> 32) & 0xFF] ^ t.slice[2][(w >> 40) & 0xFF] ^
+              t.slice[1][(w >> 48) & 0xFF] ^ t.slice[0][w >> 56];
+    }
+    for (; len; ++p, --len) crc = t.slice[0][(crc ^ *p) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+#if defined(SSB_X86)
+
+__attribute__((target("sse4.2")))
+inline uint32_t update_sse42(uint32_t crc, const uint8_t* p, size_t len)
+{
+    const Tables& t = tables();
+    uint64_t c0 = crc;
+    for (; len >= 3 * LONG; p += 3 * LONG, len -= 3 * LONG)
+    {
+        uint64_t c1 = 0, c2 = 0;
+        for (size_t i = 0; i < LONG; i += 8)
+        {
+            c0 = _mm_crc32_u64(c0, load64(p + i));
+            c1 = _mm_crc32_u64(c1, load64(p + LONG + i));
+            c2 = _mm_crc32_u64(c2, load64(p + 2 * LONG + i));
+        }
+        c0 = shift(t.long_shift, (uint32_t)c0) ^ c1;
+        c0 = shift(t.long_shift, (uint32_t)c0) ^ c2;
+    }
+    for (; len >= 3 * SHORT; p += 3 * SHORT, len -= 3 * SHORT)
+    {
+        uint64_t c1 = 0, c2 = 0;
+        for (size_t i = 0; i < SHORT; i += 8)
+        {
+            c0 = _mm_crc32_u64(c0, load64(p + i));
+            c1 = _mm_crc32_u64(c1, load64(p + SHORT + i));
+            c2 = _mm_crc32_u64(c2, load64(p + 2 * SHORT + i));
+        }
+        c0 = shift(t.short_shift, (uint32_t)c0) ^ c1;
+        c0 = shift(t.short_shift, (uint32_t)c0) ^ c2;
+    }
+    for (; len >= 8; p += 8, len -= 8) c0 = _mm_crc32_u64(c0, load64(p));
+    uint32_t c = (uint32_t)c0;
+    for (; len; ++p, --len) c = _mm_crc32_u8(c, *p);
+    return c;
+}
+
+#endif
+
+#if defined(SSB_ARM64)
+
+#if defined(__clang__)
+__attribute__((target("crc")))
+#else
+__attribute__((target("+crc")))
+#endif
+inline uint32_t update_armv8(uint32_t crc, const uint8_t* p, size_t len)
+{
+    const Tables& t = tables();
+    uint32_t c0 = crc;
+    for (; len >= 3 * LONG; p += 3 * LONG, len -= 3 * LONG)
+    {
+        uint32_t c1 = 0, c2 = 0;
+        for (size_t i = 0; i < LONG; i += 8)
+        {
+            c0 = __crc32cd(c0, load64(p + i));
+            c1 = __crc32cd(c1, load64(p + LONG + i));
+            c2 = __crc32cd(c2, load64(p + 2 * LONG + i));
+        }
+        c0 = shift(t.long_shift, c0) ^ c1;
+        c0 = shift(t.long_shift, c0) ^ c2;
+    }
+    for (; len >= 3 * SHORT; p += 3 * SHORT, len -= 3 * SHORT)
+    {
+        uint32_t c1 = 0, c2 = 0;
+        for (size_t i = 0; i < SHORT; i += 8)
+        {
+            c0 = __crc32cd(c0, load64(p + i));
+            c1 = __crc32cd(c1, load64(p + SHORT + i));
+            c2 = __crc32cd(c2, load64(p + 2 * SHORT + i));
+        }
+        c0 = shift(t.short_shift, c0) ^ c1;
+        c0 = shift(t.short_shift, c0) ^ c2;
+    }
+    for (; len >= 8; p += 8, len -= 8) c0 = __crc32cd(c0, load64(p));
+    for (; len; ++p, --len) c0 = __crc32cb(c0, *p);
+    return c0;
+}
+
+#endif
+
+} // namespace crc32c_detail
+
+// CRC32C of `len` bytes, continuing from `crc` (the CRC of everything
+// before them, 0 to start): crc32c(b, crc32c(a)) == crc32c(a followed by b).
+inline uint32_t crc32c(const void* data, size_t len, uint32_t crc = 0)
+{
+    const uint8_t* p = (const uint8_t*)data;
+#if defined(SSB_X86)
+    if (has_crc32c()) return ~crc32c_detail::update_sse42(~crc, p, len);
+#elif defined(SSB_ARM64)
+    if (has_crc32c()) return ~crc32c_detail::update_armv8(~crc, p, len);
+#endif
+    return ~crc32c_detail::update_scalar(~crc, p, len);
+}
+
+// The table-driven fallback, whatever the CPU supports.
+inline uint32_t crc32c_scalar(const void* data, size_t len, uint32_t crc = 0)
+{
+    return ~crc32c_detail::update_scalar(~crc, (const uint8_t*)data, len);
+}
+
+inline const char* crc32c_impl()
+{
+#if defined(SSB_X86)
+    if (has_crc32c()) return "sse4.2";
+#elif defined(SSB_ARM64)
+    if (has_crc32c()) return "armv8-crc";
+#endif
+    return "scalar";
+}
+
+// ---- frames ----
+
+inline bool frame_checked(const FrameHeader& h) { return (h.flags & FRAME_FLAG_CHECKSUM) != 0; }
+
+// Payload bytes in front of the trailer.
+inline uint32_t frame_data_len(const FrameHeader& h)
+{
+    return frame_checked(h) && h.payload_len >= CHECKSUM_SIZE ? h.payload_len - (uint32_t)CHECKSUM_SIZE : h.payload_len;
+}
+
+// The header of `h` as a checked frame: flag set, trailer counted.
+inline FrameHeader checked_header(FrameHeader h)
+{
+    h.flags |= FRAME_FLAG_CHECKSUM;
+    h.payload_len += (uint32_t)CHECKSUM_SIZE;
+    return h;
+}
+
+// Trailer value of a checked frame: header as sent, then the data bytes.
+inline uint32_t frame_crc(const FrameHeader& h, const void* data)
+{
+    return crc32c(data, frame_data_len(h), crc32c(&h, FRAME_HEADER_SIZE));
+}
+
+// Starts `w` on `h` + `payload` (h.payload_len data bytes) as a checked
+// frame. The payload is still referenced, not copied.
+inline void begin_checked(FrameWriter& w, const FrameHeader& h, const void* payload)
+{
+    FrameHeader c = checked_header(h);
+    w.begin(c, payload, frame_crc(c, payload));
+}
+
+enum class ChecksumResult { Unchecked, Ok, Bad };
+
+enum class ChecksumPolicy
+{
+    Off,         // never verify
+    Count,       // verify frames that carry a checksum, count failures, go on
+    FailClosed,  // a failed checksum ends the stream
+    Require,     // fail closed, and a frame without a checksum fails too
+};
+
+// True if the stream may go on after a frame with result `r`.
+inline bool checksum_accept(ChecksumPolicy p, ChecksumResult r)
+{
+    if (p == ChecksumPolicy::FailClosed) return r != ChecksumResult::Bad;
+    if (p == ChecksumPolicy::Require) return r == ChecksumResult::Ok;
+    return true;
+}
+
+// `payload` holds all h.payload_len bytes, trailer included.
+inline ChecksumResult verify_frame(const FrameHeader& h, const void* payload)
+{
+    if (!frame_checked(h)) return ChecksumResult::Unchecked;
+    if (h.payload_len < CHECKSUM_SIZE) return ChecksumResult::Bad;
+    uint32_t want;
+    memcpy(&want, (const uint8_t*)payload + h.payload_len - CHECKSUM_SIZE, sizeof(want));
+    return frame_crc(h, payload) == want ? ChecksumResult::Ok : ChecksumResult::Bad;
+}
+
+// Verifies frames whose payload is seen in pieces: begin() with the
+// header, update() with the payload bytes in order (payload_len in all),
+// then finish().
+class FrameChecker
+{
+public:
+    explicit FrameChecker(ChecksumPolicy policy = ChecksumPolicy::Count) : policy_(policy) {}
+
+    ChecksumPolicy policy() const { return policy_; }
+
+    void begin(const FrameHeader& h)
+    {
+        checking_ = policy_ != ChecksumPolicy::Off && frame_checked(h);
+        short_ = checking_ && h.payload_len < CHECKSUM_SIZE;
+        if (!checking_ || short_) return;
+        crc_ = crc32c(&h, FRAME_HEADER_SIZE);
+        data_left_ = h.payload_len - CHECKSUM_SIZE;
+        tail_got_ = 0;
+    }
+
+    void update(const uint8_t* p, size_t n)
+    {
+        if (!checking_ || short_) return;
+        size_t d = n < data_left_ ? n : data_left_;
+        if (d)
+        {
+            crc_ = crc32c(p, d, crc_);
+            data_left_ -= d;
+            p += d;
+            n -= d;
+        }
+        size_t t = n < CHECKSUM_SIZE - tail_got_ ? n : CHECKSUM_SIZE - tail_got_;
+        memcpy(tail_ + tail_got_, p, t);
+        tail_got_ += t;
+    }
+
+    // Result of the frame, counted; then checksum_accept() decides.
+    ChecksumResult finish()
+    {
+        ChecksumResult r = ChecksumResult::Unchecked;
+        if (checking_)
+        {
+            uint32_t want = 0;
+            memcpy(&want, tail_, sizeof(want));
+            r = (!short_ && tail_got_ == CHECKSUM_SIZE && want == crc_) ? ChecksumResult::Ok : ChecksumResult::Bad;
+        }
+        checking_ = false;
+        if (r == ChecksumResult::Ok) ++ok_;
+        else if (r == ChecksumResult::Bad) ++bad_;
+        else ++unchecked_;
+        return r;
+    }
+
+    bool accept(ChecksumResult r) const { return checksum_accept(policy_, r); }
+
+    uint64_t ok() const { return ok_; }
+    uint64_t bad() const { return bad_; }
+    uint64_t unchecked() const { return unchecked_; }
+
+private:
+    ChecksumPolicy policy_;
+    bool checking_ = false;
+    bool short_ = false;
+    uint32_t crc_ = 0;
+    uint64_t data_left_ = 0;
+    uint8_t tail_[CHECKSUM_SIZE];
+    size_t tail_got_ = 0;
+    uint64_t ok_ = 0;
+    uint64_t bad_ = 0;
+    uint64_t unchecked_ = 0;
+};
+
+inline bool parse_checksum_policy(const char* s, ChecksumPolicy& out)
+{
+    if (!strcmp(s, "off")) out = ChecksumPolicy::Off;
+    else if (!strcmp(s, "count")) out = ChecksumPolicy::Count;
+    else if (!strcmp(s, "fail")) out = ChecksumPolicy::FailClosed;
+    else if (!strcmp(s, "require")) out = ChecksumPolicy::Require;
+    else return false;
+    return true;
+}
+
+} // namespace ssb
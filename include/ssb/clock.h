@@ -0,0 +1,19 @@
+// ssb/clock.h
+#pragma once
+
+#include <time.h>
+#include <cstdint>
+
+namespace ssb
+{
+
+// CLOCK_MONOTONIC in ns; same timebase as Python's time.perf_counter_ns()
+// on Linux, so stamps can be compared across processes on one host.
+inline uint64_t mono_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+} // namespace ssb
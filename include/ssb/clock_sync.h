@@ -0,0 +1,285 @@
+// ssb/clock_sync.h
+// Clock offset and drift between two processes or hosts, estimated over
+// the cmd channel the NTP way, so one-way latencies can be measured per
+// direction instead of inferring them from RTT/2.
+//
+// The client sends a sync request, an SSB frame on the cmd stream:
+//
+//   [FrameHeader type=FRAME_PING, seq = id, timestamp_ns = t1][SyncTimes]
+//
+// and the server answers with the same frame as FRAME_PONG, with t2 (when
+// it read the request) and t3 (just before it wrote the reply) filled in
+// from its clock. The client reads the reply at t4. Then
+//
+//   rtt    = (t4 - t1) - (t3 - t2)
+//   offset = ((t2 - t1) + (t3 - t4)) / 2      remote clock - local clock
+//
+// and offset is exact when both directions took equally long. Queueing
+// makes them unequal, so ClockSync keeps a window of samples and trusts
+// only the lowest-RTT ones: the minimum of each slice of the window gives
+// one point, and a least-squares line through the points gives offset and
+// drift. The asymmetry of the base (unloaded) path cannot be observed from
+// inside; it stays in the estimate, bounded by min_rtt / 2.
+//
+// Sync requests share the cmd stream with 8-byte pings and 16-byte
+// probes. CmdResponder is the server side: it echoes everything verbatim
+// in 8-byte units and answers the sync frames it finds on a unit
+// boundary. Servers without it echo the request unchanged, which the
+// client sees as a PING coming back instead of a PONG.
+//
+// With an estimate in hand a sender can stamp data frames in the
+// receiver's clock (to_remote) and set FRAME_FLAG_PEER_TIME; the receiver
+// then reads each frame's one-way age straight off its own clock.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "clock.h"
+#include "frame.h"
+
+namespace ssb
+{
+
+struct SyncTimes
+{
+    uint64_t t2;  // server: request read
+    uint64_t t3;  // server: reply written
+};
+
+// FrameHeader::flags bit: timestamp_ns is in the receiver's clock
+constexpr uint16_t FRAME_FLAG_PEER_TIME = 1u << 4;
+
+constexpr size_t SYNC_FRAME_SIZE = FRAME_HEADER_SIZE + sizeof(SyncTimes);
+
+static_assert(SYNC_FRAME_SIZE % 8 == 0, "sync frames keep the cmd stream 8-byte aligned");
+
+struct SyncSample
+{
+    uint64_t t1, t2, t3, t4;
+
+    int64_t rtt() const { return (int64_t)(t4 - t1) - (int64_t)(t3 - t2); }
+    int64_t offset() const { return ((int64_t)(t2 - t1) + (int64_t)(t3 - t4)) / 2; }
+    uint64_t local_mid() const { return t1 + (t4 - t1) / 2; }
+};
+
+inline void make_sync_request(uint8_t* out, uint64_t id, uint64_t t1)
+{
+    FrameHeader h = make_header(FRAME_PING, 0, id, (uint32_t)sizeof(SyncTimes), t1);
+    SyncTimes z{ 0, 0 };
+    memcpy(out, &h, FRAME_HEADER_SIZE);
+    memcpy(out + FRAME_HEADER_SIZE, &z, sizeof(z));
+}
+
+enum class SyncReply { Ok, Unanswered, Invalid };
+
+// Reads a reply frame received at t4. Unanswered: the server echoed the
+// request unchanged (it does not speak clock sync).
+inline SyncReply parse_sync_reply(const uint8_t* p, uint64_t t4, uint64_t& id, SyncSample& out)
+{
+    FrameHeader h;
+    memcpy(&h, p, FRAME_HEADER_SIZE);
+    if (!header_valid(h) || h.payload_len != sizeof(SyncTimes)) return SyncReply::Invalid;
+    if (h.type == FRAME_PING) return SyncReply::Unanswered;
+    if (h.type != FRAME_PONG) return SyncReply::Invalid;
+
+    SyncTimes t;
+    memcpy(&t, p + FRAME_HEADER_SIZE, sizeof(t));
+    id = h.seq;
+    out = SyncSample{ h.timestamp_ns, t.t2, t.t3, t4 };
+    return (t4 >= out.t1 && out.t3 >= out.t2) ? SyncReply::Ok : SyncReply::Invalid;
+}
+
+// Offset / drift estimate from a sliding window of samples.
+class ClockSync
+{
+public:
+    // `window` samples are kept and split into `slices` for the fit.
+    explicit ClockSync(size_t window = 512, size_t slices = 16)
+        : window_(std::max<size_t>(window, 2)), slices_(std::max<size_t>(std::min(slices, window_), 1))
+    {
+        samples_.reserve(window_);
+    }
+
+    // False (and ignored) for a sample whose RTT is negative.
+    bool add(const SyncSample& s)
+    {
+        if (s.rtt() < 0 || s.t4 < s.t1) return false;
+        if (samples_.size() == window_) samples_.erase(samples_.begin());
+        samples_.push_back(s);
+        ++total_;
+        fit();
+        return true;
+    }
+
+    bool ready() const { return !samples_.empty(); }
+    uint64_t samples() const { return total_; }
+
+    // remote - local, in ns, at local time `local_ns`
+    int64_t offset_at(uint64_t local_ns) const
+    {
+        return offset_ + (int64_t)(drift_ * (double)(int64_t)(local_ns - ref_ns_));
+    }
+    int64_t offset_ns() const { return offset_at(samples_.empty() ? 0 : samples_.back().local_mid()); }
+    // remote clock rate relative to ours, parts per million
+    double drift_ppm() const { return drift_ * 1e6; }
+
+    uint64_t to_remote(uint64_t local_ns) const { return local_ns + (uint64_t)offset_at(local_ns); }
+    uint64_t to_local(uint64_t remote_ns) const { return remote_ns - (uint64_t)offset_at(remote_ns); }
+
+    // Lowest RTT in the window; half of it bounds the offset error.
+    uint64_t min_rtt_ns() const { return min_rtt_; }
+    uint64_t uncertainty_ns() const { return min_rtt_ / 2; }
+
+    // One-way times of a sample under the current estimate.
+    int64_t uplink_ns(const SyncSample& s) const { return (int64_t)(s.t2 - s.t1) - offset_at(s.t1); }
+    int64_t downlink_ns(const SyncSample& s) const { return (int64_t)(s.t4 - s.t3) + offset_at(s.t4); }
+
+private:
+    void fit()
+    {
+        // lowest-RTT sample of each slice
+        const size_t n = samples_.size();
+        const size_t per = std::max<size_t>((n + slices_ - 1) / slices_, 1);
+        best_.clear();
+        min_rtt_ = UINT64_MAX;
+        for (size_t i = 0; i < n; i += per)
+        {
+            const SyncSample* b = &samples_[i];
+            for (size_t j = i; j < std::min(i + per, n); ++j)
+                if (samples_[j].rtt() < b->rtt()) b = &samples_[j];
+            best_.push_back(b);
+            min_rtt_ = std::min(min_rtt_, (uint64_t)b->rtt());
+        }
+        // a slice whose best sample still queued (RTT well above the window
+        // minimum, e.g. behind a busy data stream) would tilt the line
+        const uint64_t limit = 2 * min_rtt_ + 1000;
+        best_.erase(std::remove_if(best_.begin(), best_.end(),
+            [&](const SyncSample* b) { return (uint64_t)b->rtt() > limit; }), best_.end());
+
+        // offset(t) = offset_ + drift_ * (t - ref_ns_), least squares; a
+        // window shorter than 1 s says nothing about drift
+        ref_ns_ = best_.back()->local_mid();
+        double sx = 0, sy = 0, sxx = 0, sxy = 0;
+        for (const SyncSample* b : best_)
+        {
+            double x = (double)(int64_t)(b->local_mid() - ref_ns_);
+            double y = (double)b->offset();
+            sx += x; sy += y; sxx += x * x; sxy += x * y;
+        }
+        const double k = (double)best_.size();
+        const double span = (double)(int64_t)(best_.back()->local_mid() - best_.front()->local_mid());
+        const double den = k * sxx - sx * sx;
+        if (best_.size() >= 2 && span >= 1e9 && den > 0)
+        {
+            drift_ = (k * sxy - sx * sy) / den;
+            offset_ = (int64_t)((sy - drift_ * sx) / k);
+        }
+        else
+        {
+            drift_ = 0;
+            const SyncSample* b = best_[0];
+            for (const SyncSample* c : best_)
+                if (c->rtt() < b->rtt()) b = c;
+            offset_ = b->offset();
+        }
+    }
+
+    size_t window_;
+    size_t slices_;
+    std::vector<SyncSample> samples_;
+    std::vector<const SyncSample*> best_;
+    uint64_t total_ = 0;
+    int64_t offset_ = 0;
+    double drift_ = 0;
+    uint64_t ref_ns_ = 0;
+    uint64_t min_rtt_ = 0;
+};
+
+// Server side of the cmd stream: echoes pings and probes verbatim and
+// answers sync requests. Everything on the stream is a multiple of 8
+// bytes, so a sync frame can only start on an 8-byte boundary; an
+// incomplete unit or frame waits for the rest.
+class CmdResponder
+{
+public:
+    // Appends the reply bytes for `len` more input bytes to `out`.
+    // `recv_ns` is when they were read (t2 of any request among them).
+    void feed(const uint8_t* p, size_t len, uint64_t recv_ns, std::vector<uint8_t>& out)
+    {
+        // finish the unit or frame left over from the last call: 8 bytes
+        // tell which it is, a sync frame then needs the rest of its bytes
+        while (carry_len_ && len)
+        {
+            size_t want = carry_len_ < 8 ? 8 : SYNC_FRAME_SIZE;
+            size_t n = std::min(want - carry_len_, len);
+            memcpy(carry_ + carry_len_, p, n);
+            carry_len_ += n;
+            p += n;
+            len -= n;
+            if (carry_len_ == want && respond(carry_, carry_len_, recv_ns, out))
+                carry_len_ = 0;
+        }
+
+        size_t pos = respond(p, len, recv_ns, out);
+        if (pos < len)
+        {
+            // less than a unit, or part of a sync frame: < SYNC_FRAME_SIZE
+            memcpy(carry_ + carry_len_, p + pos, len - pos);
+            carry_len_ += len - pos;
+        }
+    }
+
+    uint64_t units() const { return units_; }  // 8-byte units echoed
+    uint64_t syncs() const { return syncs_; }   // sync requests answered
+
+private:
+    // Replies to every complete unit and frame in `in`; returns the bytes used.
+    size_t respond(const uint8_t* in, size_t len, uint64_t recv_ns, std::vector<uint8_t>& out)
+    {
+        size_t pos = 0;
+        while (len - pos >= 8)
+        {
+            if (!is_sync(in + pos))
+            {
+                // run of plain units up to the next sync frame
+                size_t end = pos + 8;
+                while (len - end >= 8 && !is_sync(in + end)) end += 8;
+                out.insert(out.end(), in + pos, in + end);
+                units_ += (end - pos) / 8;
+                pos = end;
+                continue;
+            }
+            if (len - pos < SYNC_FRAME_SIZE) break;
+
+            size_t at = out.size();
+            out.insert(out.end(), in + pos, in + pos + SYNC_FRAME_SIZE);
+            FrameHeader h;
+            memcpy(&h, &out[at], FRAME_HEADER_SIZE);
+            h.type = FRAME_PONG;
+            memcpy(&out[at], &h, FRAME_HEADER_SIZE);
+            SyncTimes t{ recv_ns, mono_ns() };
+            memcpy(&out[at + FRAME_HEADER_SIZE], &t, sizeof(t));
+            ++syncs_;
+            pos += SYNC_FRAME_SIZE;
+        }
+        return pos;
+    }
+
+    static bool is_sync(const uint8_t* p)
+    {
+        uint32_t magic;
+        memcpy(&magic, p, sizeof(magic));
+        return magic == FRAME_MAGIC && p[offsetof(FrameHeader, version)] == FRAME_VERSION &&
+               p[offsetof(FrameHeader, type)] == FRAME_PING;
+    }
+
+    uint8_t carry_[SYNC_FRAME_SIZE];
+    size_t carry_len_ = 0;
+    uint64_t units_ = 0;
+    uint64_t syncs_ = 0;
+};
+
+} // namespace ssb
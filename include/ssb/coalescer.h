@@ -0,0 +1,224 @@
+// ssb/coalescer.h
+// Per-tick coalescing of small fixed-size commands from many agents into
+// one FRAME_BATCH frame. A 24-byte control packet sent on its own costs a
+// 32-byte SSB header plus UDP/IP (or a TCP_NODELAY segment) and a syscall;
+// batched it costs its record and a 2-byte index entry.
+//
+// Batch payload (little-endian):
+//   BatchHeader { base_agent, count, record_size }
+//   uint16_t index[count]         agent - base_agent
+//   uint8_t  records[count][record_size]
+//
+// A batch is flushed on whichever comes first: the tick boundary (tick()),
+// the size limit (the next command would not fit in max_bytes) or the
+// deadline (poll(), `deadline_ns` after the oldest command in the batch).
+// An agent that sends twice before a flush has its record replaced in
+// place (latest-only), so a batch never carries the same agent twice.
+//
+// Frames are handed to emit(frame, len) and are only valid during the
+// call. The frame seq counts batches; its timestamp is when the oldest
+// command was added, so receivers can see the coalescing delay.
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "frame.h"
+
+namespace ssb
+{
+
+#pragma pack(push, 1)
+struct BatchHeader
+{
+    uint32_t base_agent; // index entries are offsets from this
+    uint16_t count;
+    uint16_t record_size;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(BatchHeader) == 8, "BatchHeader must stay 8 bytes");
+
+constexpr size_t BATCH_HEADER_SIZE = sizeof(BatchHeader);
+constexpr size_t COALESCE_MAX_BYTES = 1472; // one unfragmented UDP datagram at 1500 MTU
+
+enum class FlushReason { Tick, Size, Deadline };
+
+class Coalescer
+{
+public:
+    Coalescer(uint32_t agents, size_t record_size, size_t max_bytes = COALESCE_MAX_BYTES, uint64_t deadline_ns = 0)
+        : agents_(agents), rec_(record_size), deadline_ns_(deadline_ns),
+          stamp_(agents, 0), pos_(agents, 0)
+    {
+        size_t room = max_bytes > FRAME_HEADER_SIZE + BATCH_HEADER_SIZE ? max_bytes - FRAME_HEADER_SIZE - BATCH_HEADER_SIZE : 0;
+        max_count_ = room / (rec_ + sizeof(uint16_t));
+        if (max_count_ < 1) max_count_ = 1;
+        if (max_count_ > 0xFFFF) max_count_ = 0xFFFF;
+        index_.resize(max_count_);
+        records_.resize(max_count_ * rec_);
+        out_.resize(FRAME_HEADER_SIZE + BATCH_HEADER_SIZE + max_count_ * (rec_ + sizeof(uint16_t)));
+    }
+
+    uint32_t agents() const { return agents_; }
+    size_t record_size() const { return rec_; }
+    size_t max_count() const { return max_count_; }   // commands per batch
+    size_t pending() const { return count_; }
+
+    // Queues one agent's command (record_size bytes). Flushes first when
+    // the batch is full or the agent is outside its 64K id window. False
+    // if the agent id is out of range.
+    template <typename Emit>
+    bool add(uint32_t agent, const void* record, uint64_t now_ns, Emit&& emit)
+    {
+        if (agent >= agents_) return false;
+
+        if (count_ && stamp_[agent] == batch_ + 1)
+        {
+            memcpy(records_.data() + (size_t)pos_[agent] * rec_, record, rec_);
+            ++replaced_;
+            return true;
+        }
+        if (count_ && (count_ == max_count_ || (agent >> 16) != (base_ >> 16)))
+            flush(FlushReason::Size, emit);
+
+        if (!count_)
+        {
+            base_ = agent & ~0xFFFFu;
+            first_ns_ = now_ns;
+        }
+        stamp_[agent] = batch_ + 1;
+        pos_[agent] = (uint16_t)count_;
+        index_[count_] = (uint16_t)(agent - base_);
+        memcpy(records_.data() + count_ * rec_, record, rec_);
+        ++count_;
+        ++commands_;
+        return true;
+    }
+
+    // Tick boundary: flushes whatever is queued.
+    template <typename Emit>
+    bool tick(Emit&& emit)
+    {
+        if (!count_) return false;
+        flush(FlushReason::Tick, emit);
+        return true;
+    }
+
+    // Flushes if the oldest queued command is `deadline_ns` old. Call it
+    // from the producer loop, or arm a timer for next_deadline().
+    template <typename Emit>
+    bool poll(uint64_t now_ns, Emit&& emit)
+    {
+        if (!count_ || !deadline_ns_ || now_ns - first_ns_ < deadline_ns_) return false;
+        flush(FlushReason::Deadline, emit);
+        return true;
+    }
+
+    // When poll() will flush next; UINT64_MAX if nothing is queued or
+    // there is no deadline.
+    uint64_t next_deadline() const
+    {
+        return (count_ && deadline_ns_) ? first_ns_ + deadline_ns_ : UINT64_MAX;
+    }
+
+    uint64_t batches() const { return batch_; }
+    uint64_t commands() const { return commands_; }
+    uint64_t replaced() const { return replaced_; }    // overwritten before a flush
+    uint64_t flushes(FlushReason r) const { return flushes_[(int)r]; }
+
+private:
+    template <typename Emit>
+    void flush(FlushReason why, Emit&& emit)
+    {
+        size_t payload = BATCH_HEADER_SIZE + count_ * (sizeof(uint16_t) + rec_);
+        FrameHeader h = make_header(FRAME_BATCH, 0, batch_, (uint32_t)payload, first_ns_);
+        BatchHeader b{ base_, (uint16_t)count_, (uint16_t)rec_ };
+
+        uint8_t* p = out_.data();
+        memcpy(p, &h, FRAME_HEADER_SIZE);
+        p += FRAME_HEADER_SIZE;
+        memcpy(p, &b, BATCH_HEADER_SIZE);
+        p += BATCH_HEADER_SIZE;
+        memcpy(p, index_.data(), count_ * sizeof(uint16_t));
+        p += count_ * sizeof(uint16_t);
+        memcpy(p, records_.data(), count_ * rec_);
+
+        emit((const uint8_t*)out_.data(), FRAME_HEADER_SIZE + payload);
+
+        ++batch_;
+        ++flushes_[(int)why];
+        count_ = 0;
+    }
+
+    uint32_t agents_;
+    size_t rec_;
+    uint64_t deadline_ns_;
+    size_t max_count_ = 1;
+
+    // stamp_[agent] == batch_ + 1 while the agent is in the open batch
+    std::vector<uint64_t> stamp_;
+    std::vector<uint16_t> pos_;
+    std::vector<uint16_t> index_;
+    std::vector<uint8_t> records_;
+    std::vector<uint8_t> out_;
+
+    size_t count_ = 0;
+    uint32_t base_ = 0;
+    uint64_t first_ns_ = 0;
+
+    uint64_t batch_ = 0;
+    uint64_t commands_ = 0;
+    uint64_t replaced_ = 0;
+    uint64_t flushes_[3] = { 0, 0, 0 };
+};
+
+// A parsed FRAME_BATCH payload. Records are contiguous, record_size apart,
+// so they can go straight into SoaBatch::decode().
+struct BatchView
+{
+    uint32_t base_agent = 0;
+    uint32_t count = 0;
+    size_t record_size = 0;
+    const uint8_t* index = nullptr;   // uint16_t[count], unaligned
+    const uint8_t* records = nullptr;
+
+    uint32_t agent(uint32_t i) const
+    {
+        uint16_t off;
+        memcpy(&off, index + (size_t)i * sizeof(uint16_t), sizeof(off));
+        return base_agent + off;
+    }
+    const uint8_t* record(uint32_t i) const { return records + (size_t)i * record_size; }
+};
+
+// False if the payload is malformed.
+inline bool parse_batch(const uint8_t* payload, size_t len, BatchView& out)
+{
+    if (len < BATCH_HEADER_SIZE) return false;
+    BatchHeader b;
+    memcpy(&b, payload, BATCH_HEADER_SIZE);
+    if (!b.record_size || len != BATCH_HEADER_SIZE + (size_t)b.count * (sizeof(uint16_t) + b.record_size))
+        return false;
+
+    out.base_agent = b.base_agent;
+    out.count = b.count;
+    out.record_size = b.record_size;
+    out.index = payload + BATCH_HEADER_SIZE;
+    out.records = out.index + (size_t)b.count * sizeof(uint16_t);
+    return true;
+}
+
+// Walks a FRAME_BATCH payload, calling fn(agent, record, record_size) for
+// every entry. False (after no calls) if the payload is malformed.
+template <typename Fn>
+bool for_each_batched(const uint8_t* payload, size_t len, Fn&& fn)
+{
+    BatchView v;
+    if (!parse_batch(payload, len, v)) return false;
+    for (uint32_t i = 0; i < v.count; ++i) fn(v.agent(i), v.record(i), v.record_size);
+    return true;
+}
+
+} // namespace ssb
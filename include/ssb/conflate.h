@@ -0,0 +1,279 @@
+// ssb/conflate.h
+// Latest-only outbound queue for a non-blocking stream socket. A sender
+// that writes state (poses, observations, commands) wants the receiver to
+// see the newest value of each stream, not every value in order: when the
+// peer falls behind, a blocking send parks the producer and every frame
+// queued behind it ages by the backlog.
+//
+// ConflatingSender keeps at most one pending frame per stream. offer()
+// copies the frame in and never blocks; if the stream already has a frame
+// waiting, the new one replaces it in place (same queue position, so a
+// busy stream cannot starve the others) and the old one is counted as
+// conflated. flush() writes pending frames, oldest stream first, up to 64
+// per sendmsg, until the socket would block. A frame that has started
+// going out is never replaced: it has its own in-flight buffer and is
+// finished on the next flush(), so the byte stream stays well framed.
+// Frames that were batched for a write but not started when the socket
+// blocked go back to waiting, where a newer offer() still replaces them.
+//
+// The age of what reaches the peer is then bounded by one frame per
+// stream plus the socket buffers, whatever the producer rate.
+//
+// One thread offers and flushes. flush_with() takes any write function,
+// for sockets that are not file descriptors (the Unreal example's FSocket).
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "clock.h"
+#include "frame.h"
+
+namespace ssb
+{
+
+// One contiguous piece of the outbound byte stream.
+struct ConstBuffer
+{
+    const uint8_t* data;
+    size_t len;
+};
+
+class ConflatingSender
+{
+public:
+    static constexpr uint32_t MAX_BATCH = 64; // frames per write call
+
+    ConflatingSender(uint32_t streams, size_t max_frame)
+        : streams_(streams), max_frame_(max_frame), slots_(streams)
+    {
+        ready_.reserve(streams);
+        requeue_.reserve(streams);
+        flight_.reserve(MAX_BATCH);
+    }
+
+    uint32_t streams() const { return streams_; }
+
+    // Queues header + payload for h.stream_id, replacing any frame of that
+    // stream still waiting. False (and counted as dropped) if the stream id
+    // or size is out of range.
+    bool offer(const FrameHeader& h, const void* payload)
+    {
+        return offer(h.stream_id, &h, FRAME_HEADER_SIZE, payload, h.payload_len);
+    }
+
+    // A frame that is already contiguous (header included).
+    bool offer_frame(uint32_t stream, const uint8_t* frame, size_t len)
+    {
+        return offer(stream, frame, len, nullptr, 0);
+    }
+
+    // Writes on a non-blocking socket until everything pending is out
+    // (Done), the socket is full (Blocked) or the connection failed.
+    WriteResult flush(int fd)
+    {
+        return flush_with([fd](const ConstBuffer* b, uint32_t n) -> ssize_t
+            {
+                iovec iov[MAX_BATCH];
+                for (uint32_t i = 0; i < n; ++i)
+                {
+                    iov[i].iov_base = (void*)b[i].data;
+                    iov[i].iov_len = b[i].len;
+                }
+                msghdr msg{};
+                msg.msg_iov = iov;
+                msg.msg_iovlen = n;
+                for (;;)
+                {
+                    ssize_t r = sendmsg(fd, &msg, MSG_NOSIGNAL);
+                    if (r >= 0) return r;
+                    if (errno == EINTR) continue;
+                    return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+                }
+            });
+    }
+
+    // `write(buffers, count)` returns the bytes taken (> 0), 0 if the
+    // socket would block or -1 on failure. It may take fewer buffers than
+    // offered, e.g. only the first.
+    template <typename Write>
+    WriteResult flush_with(Write&& write)
+    {
+        for (;;)
+        {
+            admit();
+            if (flight_.empty()) return WriteResult::Done;
+
+            ConstBuffer bufs[MAX_BATCH];
+            uint32_t n = 0;
+            for (uint32_t s : flight_)
+            {
+                const Slot& slot = slots_[s];
+                size_t off = n ? 0 : head_offset_;
+                bufs[n++] = ConstBuffer{ slot.flight.data() + off, slot.flight_len - off };
+            }
+
+            ssize_t r = write(bufs, n);
+            ++write_calls_;
+            if (r < 0) return WriteResult::Failed;
+            if (r == 0)
+            {
+                unadmit();
+                return WriteResult::Blocked;
+            }
+            advance((size_t)r);
+        }
+    }
+
+    // Frames waiting or partly written.
+    bool busy() const { return !ready_.empty() || !flight_.empty(); }
+    size_t pending() const { return ready_.size() + flight_.size(); }
+
+    uint64_t offered() const { return offered_; }
+    uint64_t sent() const { return sent_; }
+    uint64_t conflated() const { return conflated_; }   // replaced before they went out
+    uint64_t dropped() const { return dropped_; }       // rejected by offer()
+    uint64_t write_calls() const { return write_calls_; }
+    // Longest time a frame spent in this queue, offer() to its last byte
+    // handed to the socket.
+    uint64_t max_queued_ns() const { return max_queued_ns_; }
+
+private:
+    struct Slot
+    {
+        std::vector<uint8_t> pending;
+        std::vector<uint8_t> flight;
+        size_t pending_len = 0;
+        size_t flight_len = 0;
+        uint64_t pending_ns = 0;
+        uint64_t flight_ns = 0;
+        bool queued = false;     // in ready_
+        bool in_flight = false;  // in flight_
+        bool requeued = false;   // unadmit() scratch
+    };
+
+    bool offer(uint32_t stream, const void* a, size_t alen, const void* b, size_t blen)
+    {
+        ++offered_;
+        if (stream >= streams_ || alen + blen > max_frame_)
+        {
+            ++dropped_;
+            return false;
+        }
+        Slot& s = slots_[stream];
+        if (s.pending.size() < alen + blen) s.pending.resize(alen + blen);
+        memcpy(s.pending.data(), a, alen);
+        if (blen) memcpy(s.pending.data() + alen, b, blen);
+        s.pending_len = alen + blen;
+        s.pending_ns = mono_ns();
+        if (s.queued)
+            ++conflated_;
+        else
+        {
+            s.queued = true;
+            ready_.push_back(stream);
+        }
+        return true;
+    }
+
+    // Moves waiting frames into flight, oldest stream first. A stream
+    // whose previous frame is still going out keeps its place.
+    void admit()
+    {
+        size_t keep = 0;
+        for (size_t i = 0; i < ready_.size(); ++i)
+        {
+            uint32_t stream = ready_[i];
+            Slot& s = slots_[stream];
+            if (s.in_flight || flight_.size() == MAX_BATCH)
+            {
+                ready_[keep++] = stream;
+                continue;
+            }
+            s.pending.swap(s.flight);
+            s.flight_len = s.pending_len;
+            s.flight_ns = s.pending_ns;
+            s.queued = false;
+            s.in_flight = true;
+            flight_.push_back(stream);
+        }
+        ready_.resize(keep);
+    }
+
+    // The socket is full. Every flight frame past a partly written head
+    // has not started: it goes back in front of the waiting streams, or,
+    // if its stream was offered a newer frame meanwhile, it is dropped as
+    // conflated and the newer one takes its place.
+    void unadmit()
+    {
+        const size_t keep = head_offset_ ? 1 : 0;
+        if (flight_.size() <= keep) return;
+        requeue_.clear();
+        for (size_t i = keep; i < flight_.size(); ++i)
+        {
+            uint32_t stream = flight_[i];
+            Slot& s = slots_[stream];
+            s.in_flight = false;
+            if (s.queued)
+                ++conflated_;
+            else
+            {
+                s.pending.swap(s.flight);
+                s.pending_len = s.flight_len;
+                s.pending_ns = s.flight_ns;
+                s.queued = true;
+            }
+            s.requeued = true;
+            requeue_.push_back(stream);
+        }
+        flight_.resize(keep);
+        for (uint32_t stream : ready_)
+            if (!slots_[stream].requeued) requeue_.push_back(stream);
+        for (uint32_t stream : requeue_) slots_[stream].requeued = false;
+        ready_.swap(requeue_);
+    }
+
+    void advance(size_t bytes)
+    {
+        size_t done = 0;
+        while (done < flight_.size())
+        {
+            Slot& s = slots_[flight_[done]];
+            size_t left = s.flight_len - head_offset_;
+            if (bytes < left)
+            {
+                head_offset_ += bytes;
+                break;
+            }
+            bytes -= left;
+            head_offset_ = 0;
+            s.in_flight = false;
+            uint64_t queued = mono_ns() - s.flight_ns;
+            if (queued > max_queued_ns_) max_queued_ns_ = queued;
+            ++sent_;
+            ++done;
+        }
+        flight_.erase(flight_.begin(), flight_.begin() + done);
+    }
+
+    uint32_t streams_;
+    size_t max_frame_;
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> ready_;   // streams with a pending frame, oldest first
+    std::vector<uint32_t> flight_;  // streams being written, in wire order
+    std::vector<uint32_t> requeue_; // unadmit() scratch
+    size_t head_offset_ = 0;        // bytes of flight_[0] already written
+
+    uint64_t offered_ = 0;
+    uint64_t sent_ = 0;
+    uint64_t conflated_ = 0;
+    uint64_t dropped_ = 0;
+    uint64_t write_calls_ = 0;
+    uint64_t max_queued_ns_ = 0;
+};
+
+} // namespace ssb
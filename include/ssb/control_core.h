@@ -0,0 +1,114 @@
+// ssb/control_core.h
+// Native latest-only control forwarder (C++ counterpart of
+// examples/single_agent_v1/ssb_control_core.py). The ingress thread
+// publishes every valid packet into a LatestSlot; the egress thread sleeps
+// on the slot's eventfd and forwards only when the version changed.
+#pragma once
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "control_packet.h"
+#include "latest_slot.h"
+#include "udp.h"
+
+namespace ssb
+{
+
+struct ControlCoreConfig
+{
+    const char* host = "127.0.0.1";
+    int ingress_port = 5060;
+    const char* egress_host = "127.0.0.1";
+    int egress_port = 5061;
+};
+
+class ControlCore
+{
+public:
+    ~ControlCore() { stop(); }
+
+    bool start(const ControlCoreConfig& cfg)
+    {
+        if (!slot_.ok() || !make_addr(cfg.egress_host, cfg.egress_port, egress_addr_))
+            return false;
+
+        in_fd_ = bind_udp(cfg.host, cfg.ingress_port);
+        out_fd_ = udp_socket();
+        if (in_fd_ < 0 || out_fd_ < 0)
+        {
+            stop();
+            return false;
+        }
+
+        running_ = true;
+        ingress_ = std::thread([this]() { ingress_loop(); });
+        egress_ = std::thread([this]() { egress_loop(); });
+        return true;
+    }
+
+    void stop()
+    {
+        running_ = false;
+        if (in_fd_ >= 0) shutdown(in_fd_, SHUT_RDWR); // unblocks recv()
+        slot_.kick();
+        if (ingress_.joinable()) ingress_.join();
+        if (egress_.joinable()) egress_.join();
+        if (in_fd_ >= 0) { close(in_fd_); in_fd_ = -1; }
+        if (out_fd_ >= 0) { close(out_fd_); out_fd_ = -1; }
+    }
+
+    int ingress_port() const { return bound_port(in_fd_); }
+
+    uint64_t received() const { return received_.load(std::memory_order_relaxed); }
+    uint64_t forwarded() const { return forwarded_.load(std::memory_order_relaxed); }
+
+private:
+    void ingress_loop()
+    {
+        uint8_t buf[CONTROL_PACKET_SIZE + 1];
+        ControlPacket pkt;
+        while (running_)
+        {
+            ssize_t n = recv(in_fd_, buf, sizeof(buf), 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            if (!decode_control(buf, (size_t)n, pkt)) continue;
+
+            slot_.publish(pkt);
+            received_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void egress_loop()
+    {
+        uint64_t last_sent = 0;
+        ControlPacket pkt;
+        uint8_t buf[CONTROL_PACKET_SIZE];
+        while (running_)
+        {
+            if (!slot_.wait_newer(last_sent)) continue;
+
+            last_sent = slot_.read(pkt);
+            encode_control(pkt, buf);
+            sendto(out_fd_, buf, sizeof(buf), 0, (sockaddr*)&egress_addr_, sizeof(egress_addr_));
+            forwarded_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    LatestSlot<ControlPacket> slot_;
+    sockaddr_in egress_addr_{};
+    int in_fd_ = -1;
+    int out_fd_ = -1;
+    std::atomic<bool> running_{ false };
+    std::atomic<uint64_t> received_{ 0 };
+    std::atomic<uint64_t> forwarded_{ 0 };
+    std::thread ingress_;
+    std::thread egress_;
+};
+
+} // namespace ssb
@@ -0,0 +1,50 @@
+// ssb/control_packet.h
+// Single-agent control command, wire-compatible with PKT_FMT = "<IfffQ"
+// in examples/single_agent_v1 (seq, throttle, steer, brake, send_ns).
+// The wire layout is ControlSchema (ssb/schema.h); the struct is only the
+// in-memory form.
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "schema.h"
+
+namespace ssb
+{
+
+struct ControlPacket
+{
+    uint32_t seq;
+    float throttle;
+    float steer;
+    float brake;
+    uint64_t send_ns;
+};
+
+using ControlSchema = Schema<&ControlPacket::seq, &ControlPacket::throttle, &ControlPacket::steer,
+    &ControlPacket::brake, &ControlPacket::send_ns>;
+
+static_assert(ControlSchema::SIZE == 24, "ControlPacket must match <IfffQ");
+static_assert(ControlSchema::format_is("<IfffQ"), "ControlSchema must match PKT_FMT in the Python examples");
+static_assert(ControlSchema::ALIGNED, "ControlSchema fields must stay naturally aligned");
+
+constexpr size_t CONTROL_PACKET_SIZE = ControlSchema::SIZE;
+
+// Column indices of ControlColumns::col<>().
+enum ControlField : size_t { CTRL_SEQ, CTRL_THROTTLE, CTRL_STEER, CTRL_BRAKE, CTRL_SEND_NS };
+
+// One tick's commands as seq[], throttle[], steer[], brake[], send_ns[].
+using ControlColumns = SoaBatch<ControlSchema>;
+
+inline bool decode_control(const void* buf, size_t len, ControlPacket& out)
+{
+    return ControlSchema::decode(buf, len, out);
+}
+
+inline void encode_control(const ControlPacket& p, void* buf)
+{
+    ControlSchema::encode(p, buf);
+}
+
+} // namespace ssb
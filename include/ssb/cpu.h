@@ -0,0 +1,75 @@
+// ssb/cpu.h
+// Runtime CPU feature checks for the optional SIMD paths (delta.h,
+// schema.h) and the CRC32C instructions (checksum.h). Code that uses
+// them compiles the wide variant with a target attribute and picks it at
+// runtime, so one binary runs everywhere and the portable path is always
+// there as the fallback.
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define SSB_X86 1
+#endif
+
+#if defined(__aarch64__)
+#include <sys/auxv.h>
+#define SSB_ARM64 1
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
+
+namespace ssb
+{
+
+enum class Isa { Scalar, Sse41, Avx2 };
+
+inline const char* isa_name(Isa isa)
+{
+    return isa == Isa::Avx2 ? "avx2" : isa == Isa::Sse41 ? "sse4.1" : "scalar";
+}
+
+namespace cpu_detail
+{
+
+inline Isa detect()
+{
+#if defined(SSB_X86) && defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return Isa::Avx2;
+    if (__builtin_cpu_supports("sse4.1")) return Isa::Sse41;
+#endif
+    return Isa::Scalar;
+}
+
+inline bool detect_crc32c()
+{
+#if defined(SSB_X86) && defined(__GNUC__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+#elif defined(SSB_ARM64)
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#else
+    return false;
+#endif
+}
+
+} // namespace cpu_detail
+
+// Widest vector ISA the SIMD paths can use on this CPU (checked once).
+inline Isa best_isa()
+{
+    static const Isa isa = cpu_detail::detect();
+    return isa;
+}
+
+inline bool isa_supported(Isa isa) { return (int)isa <= (int)best_isa(); }
+
+// CRC32C in hardware: SSE4.2 crc32 on x86, the CRC extension on AArch64.
+inline bool has_crc32c()
+{
+    static const bool yes = cpu_detail::detect_crc32c();
+    return yes;
+}
+
+} // namespace ssb
@@ -0,0 +1,451 @@
+// ssb/delta.h
+// Optional delta codec for large per-tick payloads that change little from
+// one tick to the next (per-agent observation frames).
+//
+// Each frame is XORed against the stream's keyframe, not against the
+// previous frame, so any delta decodes on its own. That is what makes it
+// safe under latest-only UDP, where frames are routinely dropped or
+// superseded. The XOR is zero-encoded in 16-byte words with a two-level
+// bitmap:
+//
+//   DeltaHeader { base_seq, raw_len, words }
+//   uint64_t l2[ceil(l1_count / 64)]   bit i: l1[i] != 0
+//   uint64_t l1[popcount(l2)]          bit j: word 64*i + j changed
+//   uint8_t  words[popcount(l1)][16]   XOR of the changed words
+//
+// A run of 64 unchanged words (1 KB) costs one bit, so an unchanged 32 KB
+// payload encodes to 24 bytes. The scan uses AVX2 or SSE4.1 when the CPU
+// has them (runtime dispatch) and portable 64-bit code otherwise.
+//
+// Frames carry FRAME_FLAG_KEYFRAME (raw payload, becomes the new base) or
+// FRAME_FLAG_DELTA (encoded as above). A keyframe goes out every
+// `key_interval` frames, when the size changes, and when a delta would not
+// be smaller than the raw payload. So after a lost keyframe a stream is
+// undecodable for at most `key_interval` frames. With acks enabled, deltas
+// only reference keyframes the receiver confirmed (DeltaDecoder::
+// last_keyframe() is what to send back).
+//
+// Header-only; the SIMD paths are x86-64 only.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "cpu.h"
+#include "frame.h"
+
+namespace ssb
+{
+
+constexpr uint16_t FRAME_FLAG_KEYFRAME = 1u << 1; // raw payload; base for later deltas
+constexpr uint16_t FRAME_FLAG_DELTA = 1u << 2;    // XOR against a keyframe, see delta.h
+
+struct DeltaHeader
+{
+    uint64_t base_seq;  // seq of the keyframe this delta applies to
+    uint32_t raw_len;
+    uint32_t words;     // changed 16-byte words
+};
+
+static_assert(sizeof(DeltaHeader) == 16, "DeltaHeader must stay 16 bytes");
+
+constexpr size_t DELTA_WORD = 16;
+
+namespace delta_detail
+{
+
+inline size_t word_count(size_t len) { return (len + DELTA_WORD - 1) / DELTA_WORD; }
+inline size_t l1_count(size_t len) { return (word_count(len) + 63) / 64; }
+inline size_t l2_count(size_t len) { return (l1_count(len) + 63) / 64; }
+
+// XOR of `cur` and `key` over whole words [0, n); changed words are
+// appended to `lit` and flagged in `l1`. Returns the number changed.
+inline size_t scan_scalar(const uint8_t* cur, const uint8_t* key, size_t n, uint64_t* l1, uint8_t* lit)
+{
+    size_t changed = 0;
+    for (size_t w = 0; w < n; ++w)
+    {
+        uint64_t a[2], b[2];
+        memcpy(a, cur + w * DELTA_WORD, DELTA_WORD);
+        memcpy(b, key + w * DELTA_WORD, DELTA_WORD);
+        a[0] ^= b[0];
+        a[1] ^= b[1];
+        if (a[0] | a[1])
+        {
+            l1[w / 64] |= 1ull << (w % 64);
+            memcpy(lit + changed * DELTA_WORD, a, DELTA_WORD);
+            ++changed;
+        }
+    }
+    return changed;
+}
+
+#if defined(SSB_X86)
+
+__attribute__((target("sse4.1")))
+inline size_t scan_sse41(const uint8_t* cur, const uint8_t* key, size_t n, uint64_t* l1, uint8_t* lit)
+{
+    size_t changed = 0;
+    for (size_t w = 0; w < n; ++w)
+    {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(cur + w * DELTA_WORD)),
+            _mm_loadu_si128((const __m128i*)(key + w * DELTA_WORD)));
+        if (_mm_testz_si128(x, x)) continue;
+        l1[w / 64] |= 1ull << (w % 64);
+        _mm_storeu_si128((__m128i*)(lit + changed * DELTA_WORD), x);
+        ++changed;
+    }
+    return changed;
+}
+
+__attribute__((target("avx2")))
+inline size_t scan_avx2(const uint8_t* cur, const uint8_t* key, size_t n, uint64_t* l1, uint8_t* lit)
+{
+    size_t changed = 0;
+    size_t w = 0;
+    const __m256i zero = _mm256_setzero_si256();
+    for (; w + 2 <= n; w += 2)
+    {
+        __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(cur + w * DELTA_WORD)),
+            _mm256_loadu_si256((const __m256i*)(key + w * DELTA_WORD)));
+        if (_mm256_testz_si256(x, x)) continue; // the common case: both words unchanged
+
+        uint32_t eq = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, zero));
+        if ((eq & 0xFFFF) != 0xFFFF)
+        {
+            l1[w / 64] |= 1ull << (w % 64);
+            _mm_storeu_si128((__m128i*)(lit + changed * DELTA_WORD), _mm256_castsi256_si128(x));
+            ++changed;
+        }
+        if ((eq >> 16) != 0xFFFF)
+        {
+            l1[(w + 1) / 64] |= 1ull << ((w + 1) % 64);
+            _mm_storeu_si128((__m128i*)(lit + changed * DELTA_WORD), _mm256_extracti128_si256(x, 1));
+            ++changed;
+        }
+    }
+    if (w < n)
+    {
+        uint64_t tail = 0;
+        size_t c = scan_scalar(cur + w * DELTA_WORD, key + w * DELTA_WORD, n - w, &tail, lit + changed * DELTA_WORD);
+        if (tail) l1[w / 64] |= tail << (w % 64);
+        changed += c;
+    }
+    return changed;
+}
+
+#endif
+
+inline size_t scan(Isa isa, const uint8_t* cur, const uint8_t* key, size_t n, uint64_t* l1, uint8_t* lit)
+{
+#if defined(SSB_X86)
+    if (isa == Isa::Avx2) return scan_avx2(cur, key, n, l1, lit);
+    if (isa == Isa::Sse41) return scan_sse41(cur, key, n, l1, lit);
+#endif
+    (void)isa;
+    return scan_scalar(cur, key, n, l1, lit);
+}
+
+} // namespace delta_detail
+
+// Largest encoded delta for a `len`-byte payload (every word changed).
+inline size_t delta_max_encoded(size_t len)
+{
+    using namespace delta_detail;
+    return sizeof(DeltaHeader) + (l2_count(len) + l1_count(len)) * 8 + word_count(len) * DELTA_WORD;
+}
+
+// Stateless: XOR of `cur` against `key` (both `len` bytes) into `out`
+// (delta_max_encoded(len) bytes). Returns the encoded size.
+inline size_t delta_encode(Isa isa, const uint8_t* cur, const uint8_t* key, size_t len, uint64_t base_seq,
+    uint8_t* out, std::vector<uint64_t>& l1, std::vector<uint8_t>& lit)
+{
+    using namespace delta_detail;
+    const size_t words = word_count(len), whole = len / DELTA_WORD;
+    l1.assign(l1_count(len), 0);
+    if (lit.size() < words * DELTA_WORD) lit.resize(words * DELTA_WORD);
+
+    size_t changed = scan(isa, cur, key, whole, l1.data(), lit.data());
+    if (whole < words)
+    {
+        // partial last word, zero-padded on both sides
+        uint8_t a[DELTA_WORD] = {}, b[DELTA_WORD] = {};
+        memcpy(a, cur + whole * DELTA_WORD, len - whole * DELTA_WORD);
+        memcpy(b, key + whole * DELTA_WORD, len - whole * DELTA_WORD);
+        uint64_t tail = 0;
+        changed += scan_scalar(a, b, 1, &tail, lit.data() + changed * DELTA_WORD);
+        if (tail) l1[whole / 64] |= 1ull << (whole % 64);
+    }
+
+    DeltaHeader h{ base_seq, (uint32_t)len, (uint32_t)changed };
+    memcpy(out, &h, sizeof(h));
+    uint8_t* p = out + sizeof(h);
+
+    // l2 bitmap, then the non-zero l1 words (out is only byte-aligned)
+    size_t n2 = l2_count(len);
+    uint8_t* l1_out = p + n2 * 8;
+    size_t n1 = 0;
+    for (size_t i = 0; i < n2; ++i)
+    {
+        uint64_t b2 = 0;
+        for (size_t j = i * 64; j < l1.size() && j < (i + 1) * 64; ++j)
+        {
+            if (!l1[j]) continue;
+            b2 |= 1ull << (j % 64);
+            memcpy(l1_out + n1 * 8, &l1[j], 8);
+            ++n1;
+        }
+        memcpy(p + i * 8, &b2, 8);
+    }
+    uint8_t* w_out = l1_out + n1 * 8;
+    memcpy(w_out, lit.data(), changed * DELTA_WORD);
+    return (size_t)(w_out - out) + changed * DELTA_WORD;
+}
+
+// Applies an encoded delta to `key` into `out` (raw_len bytes). Returns
+// raw_len, or 0 if `p` is malformed or does not match `key_len`.
+inline size_t delta_decode(const uint8_t* p, size_t len, const uint8_t* key, size_t key_len, uint8_t* out, size_t cap)
+{
+    using namespace delta_detail;
+    DeltaHeader h;
+    if (len < sizeof(h)) return 0;
+    memcpy(&h, p, sizeof(h));
+    size_t raw = h.raw_len;
+    if (raw != key_len || raw > cap) return 0;
+
+    const size_t n2 = l2_count(raw), n1_max = l1_count(raw);
+    if (len < sizeof(h) + n2 * 8) return 0;
+    const uint8_t* l2p = p + sizeof(h);
+    const uint8_t* l1p = l2p + n2 * 8;
+
+    size_t n1 = 0;
+    for (size_t i = 0; i < n2; ++i)
+    {
+        uint64_t b;
+        memcpy(&b, l2p + i * 8, 8);
+        n1 += (size_t)__builtin_popcountll(b);
+    }
+    const uint8_t* wp = l1p + n1 * 8;
+    if (n1 > n1_max || len != (size_t)(wp - p) + (size_t)h.words * DELTA_WORD) return 0;
+
+    memcpy(out, key, raw);
+    size_t k1 = 0, k = 0;
+    for (size_t i = 0; i < n2; ++i)
+    {
+        uint64_t b2;
+        memcpy(&b2, l2p + i * 8, 8);
+        while (b2)
+        {
+            size_t li = i * 64 + (size_t)__builtin_ctzll(b2);
+            b2 &= b2 - 1;
+            uint64_t b1;
+            memcpy(&b1, l1p + (k1++) * 8, 8);
+            while (b1)
+            {
+                size_t w = li * 64 + (size_t)__builtin_ctzll(b1);
+                b1 &= b1 - 1;
+                if (k >= h.words || w * DELTA_WORD >= raw) return 0;
+                size_t n = raw - w * DELTA_WORD < DELTA_WORD ? raw - w * DELTA_WORD : DELTA_WORD;
+                const uint8_t* x = wp + (k++) * DELTA_WORD;
+                uint8_t* o = out + w * DELTA_WORD;
+                if (n == DELTA_WORD)
+                {
+                    uint64_t a[2], d[2];
+                    memcpy(a, o, DELTA_WORD);
+                    memcpy(d, x, DELTA_WORD);
+                    a[0] ^= d[0];
+                    a[1] ^= d[1];
+                    memcpy(o, a, DELTA_WORD);
+                }
+                else
+                {
+                    for (size_t j = 0; j < n; ++j) o[j] ^= x[j];
+                }
+            }
+        }
+    }
+    return k == h.words ? raw : 0;
+}
+
+// Sender side of one stream.
+class DeltaEncoder
+{
+public:
+    // key_interval: frames between keyframes (>= 1). wait_for_ack: deltas
+    // reference only keyframes passed to ack(); until the first ack every
+    // frame is a keyframe.
+    DeltaEncoder(uint32_t key_interval = 20, bool wait_for_ack = false)
+        : interval_(key_interval ? key_interval : 1), wait_ack_(wait_for_ack), isa_(best_isa())
+    {
+    }
+
+    // Forces the ISA (benchmarks); the default is the best the CPU has.
+    void set_isa(Isa isa) { isa_ = isa; }
+    Isa isa() const { return isa_; }
+
+    // Encodes the payload of frame `seq` into `out`, which must hold
+    // max(len, delta_max_encoded(len)) bytes. Returns the encoded size and
+    // the FRAME_FLAG_* to set on the frame.
+    size_t encode(const uint8_t* payload, size_t len, uint64_t seq, uint8_t* out, uint16_t& flags)
+    {
+        bool key = !have_base_ || base_.size() != len || since_key_ + 1 >= interval_ || force_;
+        if (!key)
+        {
+            size_t n = delta_encode(isa_, payload, base_.data(), len, base_seq_, out, l1_, lit_);
+            if (n < len)
+            {
+                flags = FRAME_FLAG_DELTA;
+                ++since_key_;
+                ++deltas_;
+                bytes_in_ += len;
+                bytes_out_ += n;
+                return n;
+            }
+        }
+
+        memcpy(out, payload, len);
+        flags = FRAME_FLAG_KEYFRAME;
+        since_key_ = 0;
+        force_ = false;
+        ++keyframes_;
+        bytes_in_ += len;
+        bytes_out_ += len;
+        if (wait_ack_)
+        {
+            pending_.assign(payload, payload + len);
+            pending_seq_ = seq;
+        }
+        else
+        {
+            base_.assign(payload, payload + len);
+            base_seq_ = seq;
+            have_base_ = true;
+        }
+        return len;
+    }
+
+    // The receiver holds keyframe `seq` (acks mode).
+    void ack(uint64_t seq)
+    {
+        if (!wait_ack_ || pending_.empty() || seq != pending_seq_) return;
+        base_.swap(pending_);
+        base_seq_ = pending_seq_;
+        have_base_ = true;
+        pending_.clear();
+    }
+
+    // Next frame goes out as a keyframe (e.g. on a receiver NACK).
+    void force_keyframe() { force_ = true; }
+
+    uint64_t keyframes() const { return keyframes_; }
+    uint64_t deltas() const { return deltas_; }
+    uint64_t bytes_in() const { return bytes_in_; }
+    uint64_t bytes_out() const { return bytes_out_; }
+
+private:
+    uint32_t interval_;
+    bool wait_ack_;
+    Isa isa_;
+
+    std::vector<uint8_t> base_;
+    uint64_t base_seq_ = 0;
+    bool have_base_ = false;
+    std::vector<uint8_t> pending_;
+    uint64_t pending_seq_ = 0;
+    uint32_t since_key_ = 0;
+    bool force_ = false;
+
+    std::vector<uint64_t> l1_;
+    std::vector<uint8_t> lit_;
+
+    uint64_t keyframes_ = 0;
+    uint64_t deltas_ = 0;
+    uint64_t bytes_in_ = 0;
+    uint64_t bytes_out_ = 0;
+};
+
+// Receiver side of one stream. Holds the keyframe deltas last decoded
+// against plus the two newest, so deltas still referencing an acked
+// keyframe decode while newer keyframes wait for their ack. If even that
+// misses (an ack got through but every delta on it was lost, then two more
+// keyframes arrived) missing_base() counts up: NACK and let the sender
+// force_keyframe().
+class DeltaDecoder
+{
+public:
+    // Decodes the payload of frame `seq` (with `flags`) into `out`.
+    // Returns the payload length, or -1 when the frame cannot be decoded:
+    // its keyframe was lost (counted in missing_base()) or it is malformed.
+    long decode(const uint8_t* p, size_t len, uint16_t flags, uint64_t seq, uint8_t* out, size_t cap)
+    {
+        if (flags & FRAME_FLAG_KEYFRAME)
+        {
+            if (len > cap) return -1;
+            Key& k = keys_[replace_slot()];
+            k.data.assign(p, p + len);
+            k.seq = seq;
+            k.valid = true;
+            last_key_ = seq;
+            memcpy(out, p, len);
+            return (long)len;
+        }
+        if (!(flags & FRAME_FLAG_DELTA))
+        {
+            if (len > cap) return -1;
+            memcpy(out, p, len);
+            return (long)len;
+        }
+
+        DeltaHeader h;
+        if (len < sizeof(h)) { ++malformed_; return -1; }
+        memcpy(&h, p, sizeof(h));
+        for (int i = 0; i < KEYS; ++i)
+        {
+            const Key& k = keys_[i];
+            if (!k.valid || k.seq != h.base_seq) continue;
+            size_t n = delta_decode(p, len, k.data.data(), k.data.size(), out, cap);
+            if (!n && h.raw_len) { ++malformed_; return -1; }
+            in_use_ = i;
+            return (long)n;
+        }
+        ++missing_base_;
+        return -1;
+    }
+
+    // Newest keyframe held: what to ack back to the encoder.
+    uint64_t last_keyframe() const { return last_key_; }
+    uint64_t missing_base() const { return missing_base_; }
+    uint64_t malformed() const { return malformed_; }
+
+private:
+    struct Key
+    {
+        std::vector<uint8_t> data;
+        uint64_t seq = 0;
+        bool valid = false;
+    };
+
+    static constexpr int KEYS = 3;
+
+    // A free slot, else the oldest one deltas are not using.
+    int replace_slot() const
+    {
+        int best = -1;
+        for (int i = 0; i < KEYS; ++i)
+        {
+            if (!keys_[i].valid) return i;
+            if (i != in_use_ && (best < 0 || keys_[i].seq < keys_[best].seq)) best = i;
+        }
+        return best;
+    }
+
+    Key keys_[KEYS];
+    int in_use_ = -1;
+    uint64_t last_key_ = 0;
+    uint64_t missing_base_ = 0;
+    uint64_t malformed_ = 0;
+};
+
+} // namespace ssb
@@ -0,0 +1,413 @@
+// ssb/fragment.h
+// SSB-level fragmentation for latest-only UDP. A frame larger than the
+// path MTU is sent as several datagrams, each carrying a copy of the frame
+// header (FRAME_FLAG_FRAGMENT set, same stream_id / seq / timestamp)
+// followed by a FragmentHeader and one chunk of the payload:
+//
+//   [FrameHeader 32][FragmentHeader 16][chunk]   payload_len = 16 + chunk
+//
+// Losing one fragment then costs that frame only, instead of the kernel
+// silently discarding an IP-fragmented datagram.
+//
+// The Reassembler keeps one fixed slot per agent and only ever assembles
+// the newest frame: a fragment with a higher seq drops the incomplete
+// frame in the slot at once, and anything at or below the last delivered
+// seq is discarded, so delivery never waits on (or regresses to) a stale
+// frame. A seq more than FRAGMENT_RESTART_WINDOW behind is taken as a
+// restarted sender and accepted.
+//
+// Optionally the Fragmenter batches one frame's fragments into a single
+// UDP_SEGMENT (GSO) message, and the Reassembler splits UDP_GRO-coalesced
+// receives back into fragments.
+#pragma once
+
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "frame.h"
+
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+namespace ssb
+{
+
+struct FragmentHeader
+{
+    uint32_t frame_len; // payload bytes of the whole frame
+    uint32_t offset;    // of this chunk within the frame payload
+    uint16_t index;
+    uint16_t count;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(FragmentHeader) == 16, "FragmentHeader must stay 16 bytes");
+
+constexpr size_t FRAGMENT_HEADER_SIZE = sizeof(FragmentHeader);
+constexpr size_t FRAGMENT_DEFAULT_MTU = 1472;  // 1500 - IPv4 - UDP
+constexpr size_t FRAGMENT_MIN_CHUNK = 256;     // bounds the per-slot bitmap
+constexpr size_t UDP_MAX_PAYLOAD = 65507;
+constexpr uint64_t FRAGMENT_RESTART_WINDOW = 1024; // frames
+constexpr unsigned GSO_MAX_SEGMENTS = 64;      // kernel UDP_MAX_SEGMENTS
+
+// True if the kernel accepts UDP_SEGMENT on this socket.
+inline bool gso_supported(int fd)
+{
+    int seg = (int)FRAGMENT_DEFAULT_MTU;
+    if (setsockopt(fd, SOL_UDP, UDP_SEGMENT, &seg, sizeof(seg)) != 0) return false;
+    seg = 0; // keep per-message control only
+    setsockopt(fd, SOL_UDP, UDP_SEGMENT, &seg, sizeof(seg));
+    return true;
+}
+
+inline bool enable_gro(int fd)
+{
+    int one = 1;
+    return setsockopt(fd, SOL_UDP, UDP_GRO, &one, sizeof(one)) == 0;
+}
+
+// Splits frames into datagrams of at most `mtu` bytes and lays them out as
+// mmsghdr entries for one sendmmsg(). Payloads are referenced, not copied:
+// they must stay valid until the messages are sent. Call reset() between
+// batches.
+class Fragmenter
+{
+public:
+    explicit Fragmenter(size_t mtu = FRAGMENT_DEFAULT_MTU)
+        : chunk_(mtu > FRAME_HEADER_SIZE + FRAGMENT_HEADER_SIZE + FRAGMENT_MIN_CHUNK
+                ? mtu - FRAME_HEADER_SIZE - FRAGMENT_HEADER_SIZE
+                : FRAGMENT_MIN_CHUNK)
+    {
+    }
+
+    size_t chunk() const { return chunk_; }
+    size_t datagram() const { return FRAME_HEADER_SIZE + FRAGMENT_HEADER_SIZE + chunk_; }
+
+    // Adds one frame (header followed by payload_len bytes). Frames that
+    // fit in one datagram go out unchanged. Returns the datagram count.
+    uint32_t add(const uint8_t* frame, size_t len)
+    {
+        FrameHeader h;
+        memcpy(&h, frame, FRAME_HEADER_SIZE);
+        if (len <= datagram())
+        {
+            Piece p{};
+            p.data = frame;
+            p.len = (uint32_t)len;
+            p.whole = true;
+            pieces_.push_back(p);
+            ++datagrams_;
+            return 1;
+        }
+
+        const uint8_t* payload = frame + FRAME_HEADER_SIZE;
+        uint32_t total = h.payload_len;
+        uint32_t count = (uint32_t)((total + chunk_ - 1) / chunk_);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint32_t off = (uint32_t)(i * chunk_);
+            uint32_t n = (uint32_t)std::min<size_t>(chunk_, total - off);
+
+            Piece p{};
+            p.h = h;
+            p.h.flags |= FRAME_FLAG_FRAGMENT;
+            p.h.payload_len = (uint32_t)FRAGMENT_HEADER_SIZE + n;
+            p.f = FragmentHeader{ total, off, (uint16_t)i, (uint16_t)count, 0 };
+            p.data = payload + off;
+            p.len = n;
+            p.first = (i == 0);
+            pieces_.push_back(p);
+        }
+        datagrams_ += count;
+        return count;
+    }
+
+    uint32_t datagrams() const { return datagrams_; }
+
+    // Appends the messages for everything added so far; call once per
+    // batch, before reset(). With `gso` the fragments of one frame share a
+    // UDP_SEGMENT message (up to the GSO segment and 64 KB limits); the
+    // receiver still sees ordinary datagrams.
+    void build(std::vector<mmsghdr>& msgs, sockaddr_in* to, bool gso)
+    {
+        // size everything first: msgs point into iov_ and cmsg_
+        size_t niov = 0;
+        for (size_t i = 0; i < pieces_.size(); ++i)
+            niov += pieces_[i].whole ? 1 : 3;
+        iov_.resize(niov);
+        cmsg_.resize(gso ? pieces_.size() / 2 : 0); // every GSO message takes >= 2 fragments
+
+        const size_t seg = datagram();
+        const unsigned per_msg = (unsigned)std::min<size_t>(GSO_MAX_SEGMENTS, UDP_MAX_PAYLOAD / seg);
+
+        size_t iv = 0, cm = 0;
+        for (size_t i = 0; i < pieces_.size();)
+        {
+            mmsghdr m{};
+            m.msg_hdr.msg_name = to;
+            m.msg_hdr.msg_namelen = sizeof(*to);
+            m.msg_hdr.msg_iov = &iov_[iv];
+
+            const Piece& p = pieces_[i];
+            if (p.whole)
+            {
+                iov_[iv++] = { (void*)p.data, p.len };
+                m.msg_hdr.msg_iovlen = 1;
+                msgs.push_back(m);
+                ++i;
+                continue;
+            }
+
+            // one fragment, or with GSO a run of the same frame's fragments
+            unsigned n = 0;
+            do
+            {
+                Piece& q = pieces_[i + n];
+                iov_[iv++] = { &q.h, FRAME_HEADER_SIZE };
+                iov_[iv++] = { &q.f, FRAGMENT_HEADER_SIZE };
+                iov_[iv++] = { (void*)q.data, q.len };
+                ++n;
+            } while (gso && n < per_msg && i + n < pieces_.size() &&
+                !pieces_[i + n].whole && !pieces_[i + n].first);
+            m.msg_hdr.msg_iovlen = n * 3;
+
+            if (n > 1)
+            {
+                Cmsg& c = cmsg_[cm++];
+                memset(&c, 0, sizeof(c));
+                cmsghdr* h = (cmsghdr*)c.buf;
+                h->cmsg_level = SOL_UDP;
+                h->cmsg_type = UDP_SEGMENT;
+                h->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                uint16_t s = (uint16_t)seg;
+                memcpy(CMSG_DATA(h), &s, sizeof(s));
+                m.msg_hdr.msg_control = c.buf;
+                m.msg_hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+            }
+            msgs.push_back(m);
+            i += n;
+        }
+    }
+
+    void reset()
+    {
+        pieces_.clear();
+        datagrams_ = 0;
+    }
+
+private:
+    struct Piece
+    {
+        FrameHeader h;
+        FragmentHeader f;
+        const uint8_t* data;
+        uint32_t len;
+        bool whole;  // unfragmented frame, data = header + payload
+        bool first;  // fragment 0 of its frame
+    };
+
+    struct Cmsg
+    {
+        alignas(cmsghdr) char buf[CMSG_SPACE(sizeof(uint16_t))];
+    };
+
+    size_t chunk_;
+    uint32_t datagrams_ = 0;
+    std::deque<Piece> pieces_; // stable addresses for the header iovecs
+    std::vector<iovec> iov_;
+    std::vector<Cmsg> cmsg_;
+};
+
+enum class FragResult { Complete, Incomplete, Stale, Invalid };
+
+// Per-agent reassembly into a fixed slot pool, latest-only. Completed
+// frames are handed out as ordinary contiguous SSB frames (fragment flag
+// cleared, payload_len = full frame). Single-threaded.
+class Reassembler
+{
+public:
+    // `max_frame` is the largest frame (header + payload) per agent.
+    Reassembler(uint32_t agents, size_t max_frame)
+        : agents_(agents),
+          cap_(max_frame > FRAME_HEADER_SIZE ? max_frame : FRAME_HEADER_SIZE),
+          max_frags_((uint32_t)std::min<size_t>(65535, (cap_ - FRAME_HEADER_SIZE + FRAGMENT_MIN_CHUNK - 1) / FRAGMENT_MIN_CHUNK)),
+          words_((max_frags_ + 63) / 64),
+          slots_(new Slot[agents]),
+          storage_(new uint8_t[(size_t)agents * cap_]),
+          bits_(new uint64_t[(size_t)agents * words_ + 1]())
+    {
+    }
+
+    Reassembler(const Reassembler&) = delete;
+    Reassembler& operator=(const Reassembler&) = delete;
+
+    // Feeds one received datagram. `gro_size` is the UDP_GRO segment size
+    // when the kernel coalesced several datagrams (0 = one datagram).
+    // Calls fn(agent, frame, len) for every frame that became deliverable;
+    // the pointer is valid until the next feed(). Returns the result for
+    // the last datagram.
+    template <typename Fn>
+    FragResult feed(const uint8_t* p, size_t len, Fn&& fn, size_t gro_size = 0)
+    {
+        if (gro_size == 0 || gro_size >= len) return feed_one(p, len, fn);
+
+        FragResult r = FragResult::Invalid;
+        for (size_t off = 0; off < len; off += gro_size)
+            r = feed_one(p + off, std::min(gro_size, len - off), fn);
+        return r;
+    }
+
+    uint64_t completed() const { return completed_; }
+    uint64_t abandoned() const { return abandoned_; } // incomplete, superseded by a newer seq
+    uint64_t stale() const { return stale_; }
+    uint64_t invalid() const { return invalid_; }
+    uint64_t fragments() const { return fragments_; }
+
+private:
+    struct Slot
+    {
+        uint64_t seq = 0;        // frame being assembled
+        uint64_t delivered = 0;  // last frame handed out
+        bool active = false;
+        bool any = false;        // delivered is valid
+        uint32_t frame_len = 0;
+        uint32_t bytes = 0;
+        uint16_t count = 0;
+        uint16_t got = 0;
+    };
+
+    template <typename Fn>
+    FragResult feed_one(const uint8_t* p, size_t len, Fn& fn)
+    {
+        FrameHeader h;
+        if (len < FRAME_HEADER_SIZE) return bad();
+        memcpy(&h, p, FRAME_HEADER_SIZE);
+        if (!header_valid(h) || FRAME_HEADER_SIZE + h.payload_len != len || h.stream_id >= agents_)
+            return bad();
+
+        Slot& s = slots_[h.stream_id];
+        if (s.any && h.seq <= s.delivered)
+        {
+            if (s.delivered - h.seq <= FRAGMENT_RESTART_WINDOW)
+            {
+                ++stale_;
+                return FragResult::Stale;
+            }
+            s.any = false; // sender restarted its sequence
+            s.active = false;
+        }
+
+        if (!(h.flags & FRAME_FLAG_FRAGMENT))
+        {
+            if (s.active)
+            {
+                if (h.seq < s.seq && s.seq - h.seq <= FRAGMENT_RESTART_WINDOW)
+                {
+                    ++stale_;
+                    return FragResult::Stale;
+                }
+                ++abandoned_;
+                s.active = false;
+            }
+            deliver(s, h.seq);
+            fn(h.stream_id, p, len);
+            return FragResult::Complete;
+        }
+
+        ++fragments_;
+        FragmentHeader f;
+        if (h.payload_len < FRAGMENT_HEADER_SIZE) return bad();
+        memcpy(&f, p + FRAME_HEADER_SIZE, FRAGMENT_HEADER_SIZE);
+        uint32_t n = h.payload_len - (uint32_t)FRAGMENT_HEADER_SIZE;
+        if (f.count == 0 || f.count > max_frags_ || f.index >= f.count ||
+            FRAME_HEADER_SIZE + (size_t)f.frame_len > cap_ ||
+            f.offset > f.frame_len || n > f.frame_len - f.offset)
+            return bad();
+
+        uint64_t* bits = bits_.get() + (size_t)h.stream_id * words_;
+        if (s.active && h.seq < s.seq && s.seq - h.seq <= FRAGMENT_RESTART_WINDOW)
+        {
+            ++stale_;
+            return FragResult::Stale;
+        }
+        if (!s.active || h.seq != s.seq)
+        {
+            if (s.active) ++abandoned_; // never wait on the older frame
+            s.active = true;
+            s.seq = h.seq;
+            s.frame_len = f.frame_len;
+            s.count = f.count;
+            s.got = 0;
+            s.bytes = 0;
+            memset(bits, 0, words_ * sizeof(uint64_t));
+
+            // the slot header is the frame header with the fragment bits undone
+            h.flags &= (uint16_t)~FRAME_FLAG_FRAGMENT;
+            h.payload_len = f.frame_len;
+            memcpy(buffer(h.stream_id), &h, FRAME_HEADER_SIZE);
+        }
+        else if (f.frame_len != s.frame_len || f.count != s.count)
+            return bad();
+
+        uint64_t bit = 1ull << (f.index & 63);
+        if (bits[f.index / 64] & bit) return FragResult::Incomplete; // duplicate
+        bits[f.index / 64] |= bit;
+
+        memcpy(buffer(h.stream_id) + FRAME_HEADER_SIZE + f.offset, p + FRAME_HEADER_SIZE + FRAGMENT_HEADER_SIZE, n);
+        s.got++;
+        s.bytes += n;
+        if (s.got < s.count) return FragResult::Incomplete;
+
+        s.active = false;
+        if (s.bytes != s.frame_len) return bad(); // overlapping or short chunks
+        deliver(s, s.seq);
+        fn(h.stream_id, (const uint8_t*)buffer(h.stream_id), FRAME_HEADER_SIZE + (size_t)s.frame_len);
+        return FragResult::Complete;
+    }
+
+    void deliver(Slot& s, uint64_t seq)
+    {
+        s.delivered = seq;
+        s.any = true;
+        ++completed_;
+    }
+
+    FragResult bad()
+    {
+        ++invalid_;
+        return FragResult::Invalid;
+    }
+
+    uint8_t* buffer(uint32_t agent) { return storage_.get() + (size_t)agent * cap_; }
+
+    uint32_t agents_;
+    size_t cap_;
+    uint32_t max_frags_;
+    size_t words_;
+    std::unique_ptr<Slot[]> slots_;
+    std::unique_ptr<uint8_t[]> storage_;
+    std::unique_ptr<uint64_t[]> bits_;
+
+    uint64_t completed_ = 0;
+    uint64_t abandoned_ = 0;
+    uint64_t stale_ = 0;
+    uint64_t invalid_ = 0;
+    uint64_t fragments_ = 0;
+};
+
+} // namespace ssb
@@ -0,0 +1,315 @@
+// ssb/frame.h
+// SSB wire frame: fixed 32-byte little-endian header followed by
+// payload_len bytes of payload. Header and payload are sent together with
+// one sendmsg() so callers never stage the payload into a bigger buffer.
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "clock.h"
+#include "frame_pool.h"
+
+namespace ssb
+{
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "SSB frames are little-endian on the wire");
+
+constexpr uint32_t FRAME_MAGIC = 0x31425353; // "SSB1"
+constexpr uint8_t FRAME_VERSION = 1;
+
+enum FrameType : uint8_t
+{
+    FRAME_DATA = 1,    // bulk / observation payload
+    FRAME_CONTROL = 2, // small control command
+    FRAME_PING = 3,
+    FRAME_PONG = 4,
+    FRAME_BATCH = 5,   // coalesced control commands of many agents, see coalescer.h
+    FRAME_RESUME = 6,  // session token + next seq at the start of a data connection, see resume.h
+    FRAME_PAD = 0xFF,  // shared-memory ring filler, never sent on a socket
+};
+
+struct FrameHeader
+{
+    uint32_t magic;
+    uint8_t version;
+    uint8_t type;
+    uint16_t flags;
+    uint32_t stream_id;
+    uint32_t payload_len;
+    uint64_t seq;
+    uint64_t timestamp_ns;
+};
+
+static_assert(sizeof(FrameHeader) == 32, "FrameHeader must stay 32 bytes");
+static_assert(offsetof(FrameHeader, seq) == 16 && offsetof(FrameHeader, timestamp_ns) == 24,
+    "FrameHeader fields must be naturally aligned");
+
+constexpr size_t FRAME_HEADER_SIZE = sizeof(FrameHeader);
+
+// FrameHeader::flags bits
+constexpr uint16_t FRAME_FLAG_FRAGMENT = 1u << 0; // one piece of a larger frame, see fragment.h
+
+constexpr uint32_t FRAME_MAX_PAYLOAD = 64u << 20;
+
+inline FrameHeader make_header(uint8_t type, uint32_t stream_id, uint64_t seq,
+    uint32_t payload_len, uint64_t timestamp_ns = mono_ns())
+{
+    FrameHeader h;
+    h.magic = FRAME_MAGIC;
+    h.version = FRAME_VERSION;
+    h.type = type;
+    h.flags = 0;
+    h.stream_id = stream_id;
+    h.payload_len = payload_len;
+    h.seq = seq;
+    h.timestamp_ns = timestamp_ns;
+    return h;
+}
+
+inline bool header_valid(const FrameHeader& h)
+{
+    return h.magic == FRAME_MAGIC && h.version == FRAME_VERSION && h.payload_len <= FRAME_MAX_PAYLOAD;
+}
+
+enum class WriteResult { Done, Blocked, Failed };
+
+// Scatter-gather writer for one frame at a time on a non-blocking socket.
+// The payload is referenced, not copied: it must stay valid until flush()
+// returns Done.
+class FrameWriter
+{
+public:
+    void begin(const FrameHeader& h, const void* payload)
+    {
+        header_ = h;
+        payload_ = (const uint8_t*)payload;
+        data_len_ = h.payload_len;
+        trailer_len_ = 0;
+        written_ = 0;
+        total_ = FRAME_HEADER_SIZE + h.payload_len;
+    }
+
+    // A frame whose last 4 payload bytes (counted in h.payload_len) are
+    // `trailer`, e.g. a checksum (checksum.h); `payload` holds the rest.
+    void begin(const FrameHeader& h, const void* payload, uint32_t trailer)
+    {
+        begin(h, payload);
+        trailer_ = trailer;
+        trailer_len_ = sizeof(trailer_);
+        data_len_ = h.payload_len - sizeof(trailer_);
+    }
+
+    bool busy() const { return written_ < total_; }
+    size_t frame_size() const { return total_; }
+    const FrameHeader& header() const { return header_; }
+    const void* trailer() const { return trailer_len_ ? &trailer_ : nullptr; }
+    size_t trailer_len() const { return trailer_len_; }
+
+    WriteResult flush(int fd)
+    {
+        while (written_ < total_)
+        {
+            // header, payload, trailer; skipping what is already out
+            iovec iov[3];
+            int n = 0;
+            size_t skip = written_;
+            auto add = [&](const void* p, size_t len)
+                {
+                    if (skip >= len)
+                    {
+                        skip -= len;
+                        return;
+                    }
+                    iov[n].iov_base = (uint8_t*)p + skip;
+                    iov[n].iov_len = len - skip;
+                    skip = 0;
+                    ++n;
+                };
+            add(&header_, FRAME_HEADER_SIZE);
+            add(payload_, data_len_);
+            add(&trailer_, trailer_len_);
+
+            msghdr msg{};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = n;
+
+            ssize_t r = sendmsg(fd, &msg, MSG_NOSIGNAL);
+            if (r < 0)
+            {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return WriteResult::Blocked;
+                return WriteResult::Failed;
+            }
+            written_ += (size_t)r;
+        }
+        return WriteResult::Done;
+    }
+
+private:
+    FrameHeader header_{};
+    const uint8_t* payload_ = nullptr;
+    size_t data_len_ = 0;
+    uint32_t trailer_ = 0;
+    size_t trailer_len_ = 0;
+    size_t written_ = 0;
+    size_t total_ = 0;
+};
+
+// Ring of pooled frames (header and payload built in place in one
+// FrameRef) on a non-blocking stream socket. Up to 64 frames leave per
+// sendmsg(), and each buffer goes back to its pool as soon as its last
+// byte is written. The ring is allocated once.
+class FrameSendQueue
+{
+public:
+    static constexpr size_t MAX_IOV = 64;
+
+    explicit FrameSendQueue(size_t depth = 64) : ring_(depth ? depth : 1) {}
+
+    bool empty() const { return count_ == 0; }
+    bool full() const { return count_ == ring_.size(); }
+    size_t size() const { return count_; }
+
+    // Takes the frame (FRAME_HEADER_SIZE + payload_len bytes, size() set);
+    // false if the queue is full.
+    bool push(FrameRef&& f)
+    {
+        if (full()) return false;
+        ring_[(head_ + count_) % ring_.size()] = std::move(f);
+        ++count_;
+        return true;
+    }
+
+    // Writes queued frames until the queue is empty or the socket is full.
+    // `frames_done` is increased by the number of frames fully written.
+    WriteResult flush(int fd, uint64_t* frames_done = nullptr)
+    {
+        while (count_)
+        {
+            iovec iov[MAX_IOV];
+            size_t n = 0;
+            for (; n < count_ && n < MAX_IOV; ++n)
+            {
+                const FrameRef& f = ring_[(head_ + n) % ring_.size()];
+                size_t skip = n == 0 ? sent_ : 0;
+                iov[n].iov_base = f.data() + skip;
+                iov[n].iov_len = f.size() - skip;
+            }
+
+            msghdr msg{};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = n;
+
+            ssize_t r = sendmsg(fd, &msg, MSG_NOSIGNAL);
+            if (r < 0)
+            {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return WriteResult::Blocked;
+                return WriteResult::Failed;
+            }
+
+            size_t left = (size_t)r;
+            while (left)
+            {
+                FrameRef& f = ring_[head_];
+                size_t rest = f.size() - sent_;
+                if (left < rest)
+                {
+                    sent_ += left;
+                    break;
+                }
+                left -= rest;
+                sent_ = 0;
+                f.reset(); // back to the pool
+                head_ = (head_ + 1) % ring_.size();
+                --count_;
+                if (frames_done) ++*frames_done;
+            }
+        }
+        return WriteResult::Done;
+    }
+
+private:
+    std::vector<FrameRef> ring_;
+    size_t head_ = 0;
+    size_t count_ = 0;
+    size_t sent_ = 0; // bytes of the head frame already written
+};
+
+// Incremental parser over a reusable receive buffer. Payloads are handed
+// out in place; the pointers stay valid until the next fill() or next().
+class FrameReader
+{
+public:
+    explicit FrameReader(size_t capacity = (1u << 20) + FRAME_HEADER_SIZE)
+        : buf_(capacity)
+    {
+    }
+
+    // Reads whatever the socket has: bytes read, 0 on EAGAIN, -1 on
+    // close/error. Compacts any partial frame to the front first.
+    ssize_t fill(int fd)
+    {
+        compact();
+        if (end_ == buf_.size()) return 0;
+        for (;;)
+        {
+            ssize_t r = ::recv(fd, buf_.data() + end_, buf_.size() - end_, 0);
+            if (r > 0) { end_ += (size_t)r; return r; }
+            if (r == 0) return -1;
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+    }
+
+    // Next complete frame, or false if more bytes are needed. Sets bad() on
+    // a corrupt header or a frame larger than the buffer.
+    bool next(const FrameHeader*& h, const uint8_t*& payload)
+    {
+        if (bad_ || end_ - begin_ < FRAME_HEADER_SIZE) return false;
+
+        // frames are packed back to back, so the header may be unaligned
+        memcpy(&cur_, buf_.data() + begin_, FRAME_HEADER_SIZE);
+        if (!header_valid(cur_) || FRAME_HEADER_SIZE + cur_.payload_len > buf_.size())
+        {
+            bad_ = true;
+            return false;
+        }
+
+        size_t need = FRAME_HEADER_SIZE + cur_.payload_len;
+        if (end_ - begin_ < need) return false;
+
+        h = &cur_;
+        payload = buf_.data() + begin_ + FRAME_HEADER_SIZE;
+        begin_ += need;
+        return true;
+    }
+
+    bool bad() const { return bad_; }
+    size_t buffered() const { return end_ - begin_; }
+
+private:
+    void compact()
+    {
+        if (begin_ == 0) return;
+        size_t left = end_ - begin_;
+        if (left) memmove(buf_.data(), buf_.data() + begin_, left);
+        begin_ = 0;
+        end_ = left;
+    }
+
+    std::vector<uint8_t> buf_;
+    FrameHeader cur_{};
+    size_t begin_ = 0;
+    size_t end_ = 0;
+    bool bad_ = false;
+};
+
+} // namespace ssb
@@ -0,0 +1,318 @@
+// ssb/frame_pool.h
+// Fixed-capacity pool of frame buffers in a few size classes, so steady
+// state sends and receives never touch the heap. Every class is one arena
+// carved up front; each buffer starts with a cache-line header holding an
+// intrusive refcount. Buffers are handed out as FrameRef, a move-only
+// handle; share() adds a reference (e.g. while the kernel still pins the
+// pages), and the last handle to go returns the buffer.
+//
+// Free buffers sit in a small per-thread cache first and spill to a
+// lock-free per-class stack (tagged head, no ABA). A producer thread that
+// recycles its own unshared frames does no atomic RMW at all: a handle that
+// finds itself the only one skips the decrement. share() and dropping a
+// shared handle cost one RMW each.
+//
+// A buffer may be released on any thread, and up to THREAD_CACHE buffers
+// per class can sit in each releasing thread's cache where no other thread
+// can acquire them. Size every class with THREAD_CACHE buffers of slack
+// per thread that releases into it.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace ssb
+{
+
+struct PoolClass
+{
+    size_t size;     // usable bytes per buffer
+    uint32_t count;  // buffers in the class
+};
+
+class FramePool;
+
+// Move-only handle to one pooled buffer.
+class FrameRef
+{
+public:
+    FrameRef() = default;
+    FrameRef(FrameRef&& o) noexcept : hdr_(o.hdr_) { o.hdr_ = nullptr; }
+    FrameRef& operator=(FrameRef&& o) noexcept
+    {
+        if (this != &o)
+        {
+            reset();
+            hdr_ = o.hdr_;
+            o.hdr_ = nullptr;
+        }
+        return *this;
+    }
+    FrameRef(const FrameRef&) = delete;
+    FrameRef& operator=(const FrameRef&) = delete;
+    ~FrameRef() { reset(); }
+
+    explicit operator bool() const { return hdr_ != nullptr; }
+
+    uint8_t* data() const { return (uint8_t*)hdr_ + HEADER; }
+    size_t capacity() const;
+    size_t size() const { return hdr_->size; }
+    void resize(size_t n) { hdr_->size = (uint32_t)n; } // n <= capacity()
+
+    // Another handle to the same buffer.
+    FrameRef share() const
+    {
+        hdr_->refs.fetch_add(1, std::memory_order_relaxed);
+        return FrameRef(hdr_);
+    }
+    uint32_t use_count() const { return hdr_ ? hdr_->refs.load(std::memory_order_relaxed) : 0; }
+
+    inline void reset();
+
+private:
+    friend class FramePool;
+
+    struct alignas(64) Header
+    {
+        std::atomic<uint32_t> refs;
+        std::atomic<uint32_t> next; // freelist link (index + 1)
+        uint32_t size;
+        uint32_t index;
+        uint16_t cls;
+        FramePool* pool;
+    };
+    static constexpr size_t HEADER = sizeof(Header);
+
+    explicit FrameRef(Header* h) : hdr_(h) {}
+
+    Header* hdr_ = nullptr;
+};
+
+class FramePool
+{
+public:
+    static constexpr size_t MAX_CLASSES = 8;
+    static constexpr uint32_t THREAD_CACHE = 32;  // buffers per class per thread
+
+    // Classes must be given smallest first.
+    FramePool(std::initializer_list<PoolClass> classes)
+        : id_(next_id().fetch_add(1) + 1)
+    {
+        for (const PoolClass& c : classes)
+        {
+            if (ncls_ == MAX_CLASSES) break;
+            Class& k = cls_[ncls_];
+            k.size = c.size;
+            k.count = c.count;
+            k.stride = (FrameRef::HEADER + c.size + 63) & ~(size_t)63;
+            k.arena.reset(new uint8_t[k.stride * c.count + 64]);
+            k.base = (uint8_t*)(((uintptr_t)k.arena.get() + 63) & ~(uintptr_t)63);
+            for (uint32_t i = c.count; i-- > 0;)
+            {
+                FrameRef::Header* h = new (k.base + (size_t)i * k.stride) FrameRef::Header;
+                h->refs.store(0, std::memory_order_relaxed);
+                h->size = 0;
+                h->index = i;
+                h->cls = (uint16_t)ncls_;
+                h->pool = this;
+                push_global(k, i);
+            }
+            ++ncls_;
+        }
+        std::lock_guard<std::mutex> lock(registry_mutex());
+        registry().push_back(this);
+    }
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    // All FrameRefs must be gone. Only the calling thread's cache is
+    // dropped here; other threads keep a slot for this pool until they
+    // exit, and their ~ThreadCache skips it once the pool is unregistered.
+    ~FramePool()
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex());
+        auto& r = registry();
+        for (size_t i = 0; i < r.size(); ++i)
+            if (r[i] == this) { r[i] = r.back(); r.pop_back(); break; }
+        ThreadCache& tc = thread_cache();
+        for (Slot& s : tc.slots)
+            if (s.pool == id_) s = Slot{};
+    }
+
+    // Smallest buffer of at least `bytes`, falling back to larger classes
+    // when a class is drained. Empty handle if nothing fits (counted in
+    // exhausted()); the pool never grows.
+    FrameRef acquire(size_t bytes)
+    {
+        for (size_t c = 0; c < ncls_; ++c)
+        {
+            if (cls_[c].size < bytes) continue;
+            FrameRef::Header* h = pop(c);
+            if (h)
+            {
+                h->refs.store(1, std::memory_order_relaxed);
+                h->size = (uint32_t)bytes;
+                return FrameRef(h);
+            }
+        }
+        exhausted_.fetch_add(1, std::memory_order_relaxed);
+        return FrameRef();
+    }
+
+    size_t classes() const { return ncls_; }
+    size_t class_size(size_t c) const { return cls_[c].size; }
+    uint64_t exhausted() const { return exhausted_.load(std::memory_order_relaxed); }
+
+private:
+    friend class FrameRef;
+
+    struct Class
+    {
+        size_t size = 0;
+        uint32_t count = 0;
+        size_t stride = 0;
+        std::unique_ptr<uint8_t[]> arena;
+        uint8_t* base = nullptr;
+        std::atomic<uint64_t> head{ 0 }; // tag << 32 | (index + 1), 0 = empty
+    };
+
+    struct Slot
+    {
+        uint64_t pool = 0; // pool id_, 0 = unused
+        uint32_t n[MAX_CLASSES] = {};
+        uint32_t items[MAX_CLASSES][THREAD_CACHE];
+    };
+
+    // Up to four pools cached per thread; more than that share the
+    // global stacks. Flushed back on thread exit if the pool still exists.
+    struct ThreadCache
+    {
+        Slot slots[4];
+
+        ~ThreadCache()
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex());
+            for (Slot& s : slots)
+            {
+                if (!s.pool) continue;
+                for (FramePool* p : registry())
+                {
+                    if (p->id_ != s.pool) continue;
+                    for (size_t c = 0; c < p->ncls_; ++c)
+                        for (uint32_t i = 0; i < s.n[c]; ++i)
+                            p->push_global(p->cls_[c], s.items[c][i]);
+                }
+            }
+        }
+    };
+
+    FrameRef::Header* header(size_t c, uint32_t i)
+    {
+        return (FrameRef::Header*)(cls_[c].base + (size_t)i * cls_[c].stride);
+    }
+
+    Slot* local()
+    {
+        ThreadCache& tc = thread_cache();
+        Slot* free_slot = nullptr;
+        for (Slot& s : tc.slots)
+        {
+            if (s.pool == id_) return &s;
+            if (!s.pool && !free_slot) free_slot = &s;
+        }
+        if (free_slot) free_slot->pool = id_;
+        return free_slot;
+    }
+
+    FrameRef::Header* pop(size_t c)
+    {
+        Slot* s = local();
+        if (s && s->n[c]) return header(c, s->items[c][--s->n[c]]);
+
+        Class& k = cls_[c];
+        uint64_t head = k.head.load(std::memory_order_acquire);
+        for (;;)
+        {
+            uint32_t top = (uint32_t)head;
+            if (top == 0) return nullptr;
+            FrameRef::Header* h = header(c, top - 1);
+            uint32_t next = h->next.load(std::memory_order_relaxed);
+            uint64_t want = ((head >> 32) + 1) << 32 | next;
+            if (k.head.compare_exchange_weak(head, want, std::memory_order_acquire, std::memory_order_acquire))
+                return h;
+        }
+    }
+
+    void release(FrameRef::Header* h)
+    {
+        Slot* s = local();
+        if (s && s->n[h->cls] < THREAD_CACHE)
+        {
+            s->items[h->cls][s->n[h->cls]++] = h->index;
+            return;
+        }
+        push_global(cls_[h->cls], h->index);
+    }
+
+    void push_global(Class& k, uint32_t index)
+    {
+        FrameRef::Header* h = (FrameRef::Header*)(k.base + (size_t)index * k.stride);
+        uint64_t head = k.head.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            h->next.store((uint32_t)head, std::memory_order_relaxed);
+            uint64_t want = ((head >> 32) + 1) << 32 | (uint64_t)(index + 1);
+            if (k.head.compare_exchange_weak(head, want, std::memory_order_release, std::memory_order_relaxed))
+                return;
+        }
+    }
+
+    static ThreadCache& thread_cache()
+    {
+        static thread_local ThreadCache tc;
+        return tc;
+    }
+    static std::atomic<uint64_t>& next_id()
+    {
+        static std::atomic<uint64_t> id{ 0 };
+        return id;
+    }
+    static std::mutex& registry_mutex()
+    {
+        static std::mutex m;
+        return m;
+    }
+    static std::vector<FramePool*>& registry()
+    {
+        static std::vector<FramePool*> r;
+        return r;
+    }
+
+    uint64_t id_;
+    Class cls_[MAX_CLASSES];
+    size_t ncls_ = 0;
+    std::atomic<uint64_t> exhausted_{ 0 };
+};
+
+inline size_t FrameRef::capacity() const { return hdr_->pool->cls_[hdr_->cls].size; }
+
+inline void FrameRef::reset()
+{
+    if (!hdr_) return;
+    // The only handle: nobody else can share() it any more, so it goes back
+    // without a fetch_sub. The acquire pairs with the release of whichever
+    // handle dropped it to 1.
+    if (hdr_->refs.load(std::memory_order_acquire) == 1 ||
+        hdr_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        hdr_->pool->release(hdr_);
+    hdr_ = nullptr;
+}
+
+} // namespace ssb
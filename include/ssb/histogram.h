@@ -0,0 +1,162 @@
+// ssb/histogram.h
+// HDR-style log-linear latency histogram. Values (ns) below 128 get exact
+// buckets; above that each power of two is split into 64 sub-buckets, so
+// the relative error stays under 1.6% from 1 ns to 2^64 ns in a fixed
+// ~30 KB array. Recording is a bit-scan, a shift and an increment with no
+// allocation.
+//
+// One thread records into a histogram; counters are relaxed atomics written
+// with plain load/store, so other threads may merge() or read percentiles
+// from it concurrently and get a consistent-enough snapshot. reset() belongs
+// to the recording thread.
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace ssb
+{
+
+class Histogram
+{
+public:
+    static constexpr int SUB_BITS = 6;
+    static constexpr uint64_t SUB_COUNT = 1ull << SUB_BITS;     // 64 per octave
+    static constexpr size_t BUCKETS = (64 - SUB_BITS) * SUB_COUNT + SUB_COUNT;
+
+    Histogram() { reset(); }
+
+    Histogram(const Histogram&) = delete;
+    Histogram& operator=(const Histogram&) = delete;
+
+    void record(uint64_t v) { record_n(v, 1); }
+
+    void record_n(uint64_t v, uint64_t n)
+    {
+        bump(counts_[index_of(v)], n);
+        bump(total_, n);
+        bump(sum_, v * n);
+        if (v < min_.load(std::memory_order_relaxed)) min_.store(v, std::memory_order_relaxed);
+        if (v > max_.load(std::memory_order_relaxed)) max_.store(v, std::memory_order_relaxed);
+    }
+
+    // Coordinated-omission correction for periodically scheduled samples:
+    // a sample that took longer than the schedule interval also stands for
+    // the samples that should have been issued while it was stalled, with
+    // latencies v - interval, v - 2*interval, ...
+    void record_corrected(uint64_t v, uint64_t expected_interval)
+    {
+        record(v);
+        if (expected_interval == 0 || v <= expected_interval) return;
+        for (uint64_t missing = v - expected_interval; missing >= expected_interval; missing -= expected_interval)
+            record(missing);
+    }
+
+    void merge(const Histogram& o)
+    {
+        for (size_t i = 0; i < BUCKETS; ++i)
+        {
+            uint64_t c = o.counts_[i].load(std::memory_order_relaxed);
+            if (c) bump(counts_[i], c);
+        }
+        bump(total_, o.total_.load(std::memory_order_relaxed));
+        bump(sum_, o.sum_.load(std::memory_order_relaxed));
+        uint64_t mn = o.min_.load(std::memory_order_relaxed);
+        uint64_t mx = o.max_.load(std::memory_order_relaxed);
+        if (mn < min_.load(std::memory_order_relaxed)) min_.store(mn, std::memory_order_relaxed);
+        if (mx > max_.load(std::memory_order_relaxed)) max_.store(mx, std::memory_order_relaxed);
+    }
+
+    void reset()
+    {
+        for (auto& c : counts_) c.store(0, std::memory_order_relaxed);
+        total_.store(0, std::memory_order_relaxed);
+        sum_.store(0, std::memory_order_relaxed);
+        min_.store(UINT64_MAX, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const { return total_.load(std::memory_order_relaxed); }
+    uint64_t min() const { return count() ? min_.load(std::memory_order_relaxed) : 0; }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+    double mean() const { return count() ? (double)sum_.load(std::memory_order_relaxed) / count() : 0.0; }
+
+    // Value at percentile p (0..100), reported as the highest value that
+    // falls into the same bucket, clamped to the recorded max.
+    uint64_t percentile(double p) const
+    {
+        uint64_t n = count();
+        if (n == 0) return 0;
+        uint64_t rank = (uint64_t)(p / 100.0 * (double)n + 0.5);
+        if (rank < 1) rank = 1;
+        if (rank > n) rank = n;
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i)
+        {
+            seen += counts_[i].load(std::memory_order_relaxed);
+            if (seen >= rank)
+            {
+                uint64_t v = highest_in(i);
+                return v < max() ? v : max();
+            }
+        }
+        return max();
+    }
+
+    // "p50 0.142 | p90 0.160 | p99 0.211 | p99.9 0.402 | p99.99 0.950 | max 1.204"
+    // with values divided by `unit` (1e6 for ms when recording ns).
+    int format(char* out, size_t len, double unit = 1e6) const
+    {
+        return snprintf(out, len,
+            "p50 %.3f | p90 %.3f | p99 %.3f | p99.9 %.3f | p99.99 %.3f | max %.3f",
+            percentile(50.0) / unit, percentile(90.0) / unit, percentile(99.0) / unit,
+            percentile(99.9) / unit, percentile(99.99) / unit, max() / unit);
+    }
+
+    static size_t index_of(uint64_t v)
+    {
+        if (v < 2 * SUB_COUNT) return (size_t)v;
+        int shift = msb(v) - SUB_BITS;
+        return (size_t)(shift + 1) * SUB_COUNT + (size_t)((v >> shift) - SUB_COUNT);
+    }
+
+    static uint64_t highest_in(size_t idx)
+    {
+        if (idx < 2 * SUB_COUNT) return idx;
+        int shift = (int)(idx / SUB_COUNT) - 1;
+        uint64_t sub = idx % SUB_COUNT + SUB_COUNT;
+        return ((sub + 1) << shift) - 1;
+    }
+
+private:
+    static int msb(uint64_t v)
+    {
+#if defined(_MSC_VER)
+        unsigned long i;
+        _BitScanReverse64(&i, v);
+        return (int)i;
+#else
+        return 63 - __builtin_clzll(v);
+#endif
+    }
+
+    // single writer: plain load + store, no locked RMW on the hot path
+    static void bump(std::atomic<uint64_t>& a, uint64_t n)
+    {
+        a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> counts_[BUCKETS];
+    std::atomic<uint64_t> total_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> min_;
+    std::atomic<uint64_t> max_;
+};
+
+} // namespace ssb
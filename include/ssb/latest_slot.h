@@ -0,0 +1,122 @@
+// ssb/latest_slot.h
+// Latest-only mailbox: a single-writer seqlock holding the most recent
+// value plus an eventfd the reader can sleep on. The writer never waits for
+// the reader; a reader that races a write simply retries its copy.
+#pragma once
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace ssb
+{
+
+template <typename T>
+class LatestSlot
+{
+    static_assert(std::is_trivially_copyable<T>::value, "LatestSlot needs a trivially copyable T");
+    static constexpr size_t WORDS = (sizeof(T) + 7) / 8;
+
+public:
+    LatestSlot()
+    {
+        efd_ = eventfd(0, EFD_CLOEXEC);
+        for (auto& w : data_) w.store(0, std::memory_order_relaxed);
+    }
+
+    ~LatestSlot()
+    {
+        if (efd_ >= 0) close(efd_);
+    }
+
+    LatestSlot(const LatestSlot&) = delete;
+    LatestSlot& operator=(const LatestSlot&) = delete;
+
+    bool ok() const { return efd_ >= 0; }
+
+    // Writer side (one thread). Overwrites whatever is there.
+    void publish(const T& v)
+    {
+        uint64_t words[WORDS] = {};
+        memcpy(words, &v, sizeof(T));
+
+        uint64_t s = seq_.load(std::memory_order_relaxed);
+        seq_.store(s + 1, std::memory_order_relaxed); // odd: write in progress
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORDS; ++i)
+            data_[i].store(words[i], std::memory_order_relaxed);
+        seq_.store(s + 2, std::memory_order_release);
+
+        // only pay for the eventfd write when the reader is asleep
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting_.load(std::memory_order_relaxed) && waiting_.exchange(false, std::memory_order_acq_rel))
+        {
+            uint64_t one = 1;
+            ssize_t r = write(efd_, &one, sizeof(one));
+            (void)r;
+        }
+    }
+
+    // Version of the latest publish; 0 means nothing published yet.
+    uint64_t version() const { return seq_.load(std::memory_order_acquire) / 2; }
+
+    // Copies the latest value; returns its version (0 if none yet).
+    uint64_t read(T& out) const
+    {
+        uint64_t words[WORDS];
+        for (;;)
+        {
+            uint64_t s0 = seq_.load(std::memory_order_acquire);
+            if (s0 & 1) continue;
+            for (size_t i = 0; i < WORDS; ++i)
+                words[i] = data_[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq_.load(std::memory_order_relaxed) == s0)
+            {
+                memcpy(&out, words, sizeof(T));
+                return s0 / 2;
+            }
+        }
+    }
+
+    // Sleeps until a publish newer than `seen` or a kick(). Returns true if
+    // a newer value is available; false means woken without one (kick,
+    // stale wake-up or eventfd error) and the caller should re-check.
+    bool wait_newer(uint64_t seen)
+    {
+        if (version() > seen) return true;
+
+        waiting_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (version() > seen)
+        {
+            waiting_.store(false, std::memory_order_relaxed);
+            return true;
+        }
+        uint64_t v;
+        ssize_t r = ::read(efd_, &v, sizeof(v));
+        (void)r;
+        return version() > seen;
+    }
+
+    // Wakes a reader blocked in wait_newer() without publishing (shutdown).
+    void kick()
+    {
+        waiting_.store(false, std::memory_order_relaxed);
+        uint64_t one = 1;
+        ssize_t r = write(efd_, &one, sizeof(one));
+        (void)r;
+    }
+
+private:
+    alignas(64) std::atomic<uint64_t> seq_{ 0 };
+    std::atomic<uint64_t> data_[WORDS];
+    alignas(64) std::atomic<bool> waiting_{ false };
+    int efd_ = -1;
+};
+
+} // namespace ssb
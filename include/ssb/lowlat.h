@@ -0,0 +1,213 @@
+// ssb/lowlat.h
+// Low-latency profile for the I/O threads and sockets. The default profile
+// changes nothing (TCP_NODELAY only, as session.h sets it); the low-latency
+// one trades CPU for tail latency:
+//
+//   - each I/O thread pinned to its own core, optionally SCHED_FIFO
+//   - SO_BUSY_POLL / SO_PREFER_BUSY_POLL: the kernel polls the NIC queue
+//     for up to N us on a blocking read instead of waiting for the IRQ
+//   - TCP_QUICKACK: ACK at once instead of delaying (not sticky; the spin
+//     receive below can re-arm it, see there)
+//   - fixed SO_SNDBUF / SO_RCVBUF (disables autotuning) and SO_PRIORITY
+//   - spin_recv(): non-blocking recv in a loop instead of epoll/recv
+//
+// Several of these need privileges (SCHED_FIFO, SO_PRIORITY > 6, busy poll
+// on some kernels) or a real NIC, so apply_* report what actually took
+// effect, read back from the kernel, and callers log it at startup.
+//
+// Profiles are picked by a short spec on the command line:
+//
+//   default
+//   lowlat[:cpu=2,fifo=50,busy_poll=50,sndbuf=262144,rcvbuf=262144,prio=6,nospin]
+#pragma once
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "affinity.h"
+#include "clock.h"
+
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46
+#endif
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+
+namespace ssb
+{
+
+struct LatencyProfile
+{
+    bool low_latency = false;
+    int first_cpu = -1;      // I/O thread i goes to nth_cpu(first_cpu + i); -1: the last cores
+    int fifo_priority = 0;   // > 0: SCHED_FIFO at this priority
+    int busy_poll_us = 50;
+    int sndbuf = 0;          // bytes; 0 keeps autotuning
+    int rcvbuf = 0;
+    int priority = 6;        // SO_PRIORITY; 0-6 need no privileges
+    bool spin = true;        // spin_recv() instead of blocking waits
+};
+
+// Parses "default" or "lowlat[:key=value,...]"; false on anything else.
+inline bool parse_profile(const char* spec, LatencyProfile& out)
+{
+    out = LatencyProfile();
+    if (!spec || !strcmp(spec, "default")) return true;
+    if (strncmp(spec, "lowlat", 6) != 0 || (spec[6] && spec[6] != ':')) return false;
+    out.low_latency = true;
+
+    const char* p = spec[6] ? spec + 7 : spec + 6;
+    while (*p)
+    {
+        const char* end = strchr(p, ',');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        char kv[64];
+        if (len >= sizeof(kv)) return false;
+        memcpy(kv, p, len);
+        kv[len] = '\0';
+
+        char* eq = strchr(kv, '=');
+        int v = eq ? atoi(eq + 1) : 0;
+        if (eq) *eq = '\0';
+        if (!strcmp(kv, "cpu") && eq) out.first_cpu = v;
+        else if (!strcmp(kv, "fifo") && eq) out.fifo_priority = v;
+        else if (!strcmp(kv, "busy_poll") && eq) out.busy_poll_us = v;
+        else if (!strcmp(kv, "sndbuf") && eq) out.sndbuf = v;
+        else if (!strcmp(kv, "rcvbuf") && eq) out.rcvbuf = v;
+        else if (!strcmp(kv, "prio") && eq) out.priority = v;
+        else if (!strcmp(kv, "nospin") && !eq) out.spin = false;
+        else return false;
+        p += len + (end ? 1 : 0);
+    }
+    return true;
+}
+
+// What the kernel accepted; -1 / false where a setting was refused or not
+// requested.
+struct ThreadTuning
+{
+    int cpu = -1;
+    int fifo_priority = -1;
+};
+
+struct SocketTuning
+{
+    int busy_poll_us = -1;
+    bool prefer_busy_poll = false;
+    bool quickack = false;
+    int sndbuf = -1;
+    int rcvbuf = -1;
+    int priority = -1;
+};
+
+// Pins (and optionally raises) the calling thread as I/O thread `index`.
+// Without an explicit first_cpu the threads take the last cores, away from
+// CPU 0 where most IRQs and housekeeping land.
+inline ThreadTuning apply_thread(const LatencyProfile& p, int index)
+{
+    ThreadTuning t;
+    if (!p.low_latency) return t;
+
+    int cpu = p.first_cpu >= 0 ? nth_cpu(p.first_cpu + index) : nth_cpu(online_cpus() - 1 - index);
+    if (pin_current_thread(cpu)) t.cpu = cpu;
+
+    if (p.fifo_priority > 0)
+    {
+        sched_param sp{};
+        sp.sched_priority = p.fifo_priority;
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp) == 0) t.fifo_priority = p.fifo_priority;
+    }
+    return t;
+}
+
+inline SocketTuning apply_socket(int fd, const LatencyProfile& p)
+{
+    SocketTuning t;
+    if (!p.low_latency) return t;
+
+    auto set = [fd](int level, int opt, int v) { return setsockopt(fd, level, opt, &v, sizeof(v)) == 0; };
+    auto get = [fd](int level, int opt)
+    {
+        int v = -1;
+        socklen_t len = sizeof(v);
+        return getsockopt(fd, level, opt, &v, &len) == 0 ? v : -1;
+    };
+
+    if (p.busy_poll_us > 0 && set(SOL_SOCKET, SO_BUSY_POLL, p.busy_poll_us))
+        t.busy_poll_us = get(SOL_SOCKET, SO_BUSY_POLL);
+    if (p.busy_poll_us > 0)
+        t.prefer_busy_poll = set(SOL_SOCKET, SO_PREFER_BUSY_POLL, 1);
+    t.quickack = set(IPPROTO_TCP, TCP_QUICKACK, 1);
+    // the kernel doubles the value for bookkeeping; report what it holds
+    if (p.sndbuf > 0 && set(SOL_SOCKET, SO_SNDBUF, p.sndbuf)) t.sndbuf = get(SOL_SOCKET, SO_SNDBUF);
+    if (p.rcvbuf > 0 && set(SOL_SOCKET, SO_RCVBUF, p.rcvbuf)) t.rcvbuf = get(SOL_SOCKET, SO_RCVBUF);
+    if (p.priority >= 0 && set(SOL_SOCKET, SO_PRIORITY, p.priority)) t.priority = get(SOL_SOCKET, SO_PRIORITY);
+    return t;
+}
+
+// One log line, e.g. "cpu 3 | fifo - | busy_poll 50us | prefer_busy_poll - | ...".
+inline void format_tuning(const ThreadTuning& th, const SocketTuning& so, char* buf, size_t n)
+{
+    char cpu[16] = "-", fifo[16] = "-", bp[16] = "-", snd[16] = "auto", rcv[16] = "auto", prio[16] = "-";
+    if (th.cpu >= 0) snprintf(cpu, sizeof(cpu), "%d", th.cpu);
+    if (th.fifo_priority > 0) snprintf(fifo, sizeof(fifo), "%d", th.fifo_priority);
+    if (so.busy_poll_us >= 0) snprintf(bp, sizeof(bp), "%dus", so.busy_poll_us);
+    if (so.sndbuf >= 0) snprintf(snd, sizeof(snd), "%d", so.sndbuf);
+    if (so.rcvbuf >= 0) snprintf(rcv, sizeof(rcv), "%d", so.rcvbuf);
+    if (so.priority >= 0) snprintf(prio, sizeof(prio), "%d", so.priority);
+    snprintf(buf, n, "cpu %s | fifo %s | busy_poll %s | prefer_busy_poll %s | quickack %s | sndbuf %s | rcvbuf %s | prio %s",
+        cpu, fifo, bp, so.prefer_busy_poll ? "on" : "-", so.quickack ? "on" : "-", snd, rcv, prio);
+}
+
+// Spins on a non-blocking recv until `len` bytes arrived, the peer closed
+// (returns what was read so far), an error (-1) or timeout_ns passed
+// (returns the partial count; 0 if nothing came).
+//
+// With `quickack` it re-arms TCP_QUICKACK, which the kernel drops again
+// once it sees a request/response pattern. That costs one setsockopt per
+// re-arm, so it is done only for data that arrives after the socket was
+// idle (the call found nothing waiting), not for every read of a burst.
+// Worth it for small ping/pong exchanges; off by default.
+inline ssize_t spin_recv(int fd, void* buf, size_t len, uint64_t timeout_ns, bool quickack = false)
+{
+    uint8_t* p = (uint8_t*)buf;
+    size_t got = 0;
+    const uint64_t deadline = mono_ns() + timeout_ns;
+    uint32_t spins = 0;
+    bool idle = false;
+    while (got < len)
+    {
+        ssize_t r = ::recv(fd, p + got, len - got, MSG_DONTWAIT);
+        if (r > 0)
+        {
+            got += (size_t)r;
+            if (quickack && idle)
+            {
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &one, sizeof(one));
+                idle = false;
+            }
+            continue;
+        }
+        if (r == 0) break;
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) return -1;
+        idle = true;
+        // the clock is read every 64 spins only
+        if ((++spins & 63) == 0 && mono_ns() >= deadline) break;
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+    return (ssize_t)got;
+}
+
+} // namespace ssb
@@ -0,0 +1,284 @@
+// ssb/metrics.h
+// Live counters and latency histograms, one cache-line-isolated block per
+// thread, kept in a shared-memory stats page that another process can map
+// read-only and poll (see examples/standalone_transport/ssb_stats.cpp).
+//
+// Each block has exactly one writer, its owning thread, which updates it
+// with a relaxed load + store like Histogram does: no locked RMW and no
+// line shared with any other writer. Readers only load, so polling never
+// stalls the hot path beyond the odd cache miss on the writer's side.
+//
+// The page is versioned: `magic`/`version` pin the layout, and
+// `generation` changes whenever a block is claimed or released, so a
+// reader knows to re-read names. Blocks of exited threads keep their
+// final values until the slot is reused.
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <new>
+
+#include "clock.h"
+#include "histogram.h"
+
+namespace ssb
+{
+
+enum Metric : uint32_t
+{
+    METRIC_BYTES_TX,
+    METRIC_BYTES_RX,
+    METRIC_FRAMES_TX,
+    METRIC_FRAMES_RX,
+    METRIC_SYSCALLS,
+    METRIC_EAGAIN,
+    METRIC_DROPS,       // lost or discarded frames
+    METRIC_STALE,       // latest-only overwrites
+    METRIC_RECONNECTS,
+    METRIC_CHECKSUM_BAD, // frames whose CRC32C did not match, see checksum.h
+    METRIC_COUNT,
+};
+
+inline const char* metric_name(uint32_t m)
+{
+    static const char* names[METRIC_COUNT] = {
+        "bytes_tx", "bytes_rx", "frames_tx", "frames_rx", "syscalls",
+        "eagain", "drops", "stale", "reconnects", "checksum_bad",
+    };
+    return m < METRIC_COUNT ? names[m] : "?";
+}
+
+struct alignas(64) ThreadMetrics
+{
+    enum State : uint32_t { FREE = 0, LIVE = 1, EXITED = 2 };
+
+    std::atomic<uint32_t> state;
+    uint32_t tid;
+    char name[32];
+
+    alignas(64) std::atomic<uint64_t> counters[METRIC_COUNT];
+    alignas(64) Histogram latency; // ns; meaning is up to the owner
+
+    // owner thread only
+    void add(Metric m, uint64_t n = 1)
+    {
+        std::atomic<uint64_t>& c = counters[m];
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    uint64_t get(Metric m) const { return counters[m].load(std::memory_order_relaxed); }
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "stats page needs address-free atomics");
+
+struct StatsPageHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_size;      // sizeof(ThreadMetrics) of the writer
+    uint32_t max_threads;
+    uint64_t pid;
+    uint64_t start_ns;       // CLOCK_MONOTONIC when the page was created
+    alignas(64) std::atomic<uint32_t> generation;
+};
+
+class StatsPage
+{
+public:
+    static constexpr uint32_t MAGIC = 0x53425353;  // "SSBS"
+    static constexpr uint32_t VERSION = 2;
+    static constexpr uint32_t MAX_THREADS = 16;
+
+    StatsPage() = default;
+    StatsPage(const StatsPage&) = delete;
+    StatsPage& operator=(const StatsPage&) = delete;
+    ~StatsPage() { close(); }
+
+    static size_t bytes() { return slots_offset() + MAX_THREADS * sizeof(ThreadMetrics); }
+
+    // "/ssb-stats.<tag>", i.e. /dev/shm/ssb-stats.<tag>
+    static void path_for(const char* tag, char* out, size_t len) { snprintf(out, len, "/ssb-stats.%s", tag); }
+
+    // Writer side: creates (or takes over) the named page and formats it.
+    // With tag == nullptr the page is private to the process, so code can
+    // always count even when nobody exports. The page is unlinked on close().
+    bool create(const char* tag)
+    {
+        close();
+        void* mem = MAP_FAILED;
+        if (tag)
+        {
+            path_for(tag, path_, sizeof(path_));
+            int fd = shm_open(path_, O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) return false;
+            if (ftruncate(fd, (off_t)bytes()) == 0)
+                mem = mmap(nullptr, bytes(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (mem == MAP_FAILED)
+            {
+                shm_unlink(path_);
+                path_[0] = 0;
+                return false;
+            }
+        }
+        else
+        {
+            mem = mmap(nullptr, bytes(), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+            if (mem == MAP_FAILED) return false;
+        }
+
+        base_ = (uint8_t*)mem;
+        owner_ = true;
+        StatsPageHeader* h = new (base_) StatsPageHeader;
+        h->version = VERSION;
+        h->slot_size = (uint32_t)sizeof(ThreadMetrics);
+        h->max_threads = MAX_THREADS;
+        h->pid = (uint64_t)getpid();
+        h->start_ns = mono_ns();
+        h->generation.store(0, std::memory_order_relaxed);
+        for (uint32_t i = 0; i < MAX_THREADS; ++i)
+        {
+            ThreadMetrics* m = new (base_ + slots_offset() + i * sizeof(ThreadMetrics)) ThreadMetrics;
+            m->state.store(ThreadMetrics::FREE, std::memory_order_relaxed);
+        }
+        // magic last: a reader that sees it sees a formatted page
+        std::atomic_thread_fence(std::memory_order_release);
+        h->magic = MAGIC;
+        return true;
+    }
+
+    // Reader side: maps an existing page read-only. False if it is missing
+    // or was written by a different layout.
+    bool open(const char* tag)
+    {
+        close();
+        path_for(tag, path_, sizeof(path_));
+        int fd = shm_open(path_, O_RDONLY, 0);
+        if (fd < 0) return false;
+        struct stat st;
+        void* mem = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && (size_t)st.st_size >= bytes())
+            mem = mmap(nullptr, bytes(), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mem == MAP_FAILED) return false;
+
+        base_ = (uint8_t*)mem;
+        const StatsPageHeader* h = header();
+        if (h->magic != MAGIC || h->version != VERSION || h->slot_size != sizeof(ThreadMetrics) ||
+            h->max_threads != MAX_THREADS)
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        if (!base_) return;
+        munmap(base_, bytes());
+        base_ = nullptr;
+        if (owner_ && path_[0]) shm_unlink(path_);
+        owner_ = false;
+        path_[0] = 0;
+    }
+
+    bool valid() const { return base_ != nullptr; }
+    const StatsPageHeader* header() const { return (const StatsPageHeader*)base_; }
+    uint32_t generation() const { return header()->generation.load(std::memory_order_acquire); }
+
+    // Claims a block for the calling thread; nullptr when all are live.
+    // Prefers a never-used slot so exited threads' totals stay visible.
+    ThreadMetrics* register_thread(const char* name)
+    {
+        if (!base_ || !owner_) return nullptr;
+        for (uint32_t want : { (uint32_t)ThreadMetrics::FREE, (uint32_t)ThreadMetrics::EXITED })
+        {
+            for (uint32_t i = 0; i < MAX_THREADS; ++i)
+            {
+                ThreadMetrics* m = slot(i);
+                uint32_t s = want;
+                if (!m->state.compare_exchange_strong(s, ThreadMetrics::LIVE, std::memory_order_acq_rel))
+                    continue;
+                m->tid = (uint32_t)gettid();
+                strncpy(m->name, name, sizeof(m->name) - 1);
+                m->name[sizeof(m->name) - 1] = 0;
+                for (auto& c : m->counters) c.store(0, std::memory_order_relaxed);
+                m->latency.reset();
+                bump_generation();
+                return m;
+            }
+        }
+        return nullptr;
+    }
+
+    // Marks the block exited; its values stay readable.
+    void release(ThreadMetrics* m)
+    {
+        if (!m) return;
+        m->state.store(ThreadMetrics::EXITED, std::memory_order_release);
+        bump_generation();
+    }
+
+    ThreadMetrics* slot(uint32_t i) { return (ThreadMetrics*)(base_ + slots_offset() + i * sizeof(ThreadMetrics)); }
+    const ThreadMetrics* slot(uint32_t i) const
+    {
+        return (const ThreadMetrics*)(base_ + slots_offset() + i * sizeof(ThreadMetrics));
+    }
+
+    // Sum of one counter over all blocks that were ever used.
+    uint64_t total(Metric m) const
+    {
+        uint64_t sum = 0;
+        for (uint32_t i = 0; i < MAX_THREADS; ++i)
+            if (slot(i)->state.load(std::memory_order_acquire) != ThreadMetrics::FREE)
+                sum += slot(i)->get(m);
+        return sum;
+    }
+
+private:
+    static size_t slots_offset() { return (sizeof(StatsPageHeader) + 63) & ~(size_t)63; }
+
+    void bump_generation()
+    {
+        StatsPageHeader* h = (StatsPageHeader*)base_;
+        h->generation.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    uint8_t* base_ = nullptr;
+    bool owner_ = false;
+    char path_[64] = {};
+};
+
+// Registers the calling thread for its lifetime (scope).
+class ScopedThreadMetrics
+{
+public:
+    ScopedThreadMetrics(StatsPage& page, const char* name) : page_(page), m_(page.register_thread(name))
+    {
+        if (!m_) m_ = &fallback_;
+    }
+    ~ScopedThreadMetrics()
+    {
+        if (m_ != &fallback_) page_.release(m_);
+    }
+    ScopedThreadMetrics(const ScopedThreadMetrics&) = delete;
+    ScopedThreadMetrics& operator=(const ScopedThreadMetrics&) = delete;
+
+    ThreadMetrics* operator->() { return m_; }
+    ThreadMetrics& operator*() { return *m_; }
+
+private:
+    StatsPage& page_;
+    ThreadMetrics* m_;
+    ThreadMetrics fallback_{}; // page full or absent: count privately
+};
+
+} // namespace ssb
@@ -0,0 +1,374 @@
+// ssb/multi_agent_core.h
+// Multi-agent latest-only forwarder. Every datagram is one SSB frame whose
+// stream_id is the agent id. Ingress drains the socket with recvmmsg() into
+// per-agent slots; egress wakes once per tick and flushes every agent that
+// changed with a single sendmmsg(), so syscalls per tick stay flat as the
+// agent count grows.
+//
+// Frames above the path MTU travel as SSB fragments (fragment.h): ingress
+// reassembles them latest-only per agent before publishing, and with
+// `mtu` set egress splits large frames again (optionally as UDP GSO).
+//
+// Ingress also accepts FRAME_BATCH frames (coalescer.h) and publishes each
+// command in them as the agent's own FRAME_CONTROL frame. With `coalesce`
+// set, egress does the reverse: every control command of the tick goes
+// out in as few batch frames as fit the MTU instead of one datagram each.
+//
+// With `capture` set, every datagram received goes to <capture>.rx and
+// every frame sent to <capture>.tx (capture.h), for ws_replay.
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "agent_table.h"
+#include "capture.h"
+#include "coalescer.h"
+#include "control_packet.h"
+#include "fragment.h"
+#include "frame.h"
+#include "udp.h"
+
+namespace ssb
+{
+
+struct MultiAgentConfig
+{
+    const char* host = "127.0.0.1";
+    int ingress_port = 5060;
+    const char* egress_host = "127.0.0.1";
+    int egress_port = 5061;
+    uint32_t agents = 128;
+    size_t max_datagram = 65507; // largest frame; above this only as fragments
+    double tick_hz = 20.0;
+    unsigned batch = 64;         // datagrams per recvmmsg
+    int socket_buffer = 64 << 20;
+    size_t mtu = 0;              // egress: fragment frames above this (0 = never)
+    bool gso = false;            // egress: one UDP_SEGMENT message per fragmented frame
+    bool gro = false;            // ingress: accept UDP_GRO-coalesced fragments
+    bool coalesce = false;       // egress: batch control commands per tick (FRAME_BATCH)
+    const char* capture = nullptr; // file prefix for capture.h logs; nullptr = off
+};
+
+struct MultiAgentStats
+{
+    std::atomic<uint64_t> datagrams{ 0 };
+    std::atomic<uint64_t> rejected{ 0 };     // bad frame or agent id
+    std::atomic<uint64_t> recv_calls{ 0 };
+    std::atomic<uint64_t> ticks{ 0 };
+    std::atomic<uint64_t> send_calls{ 0 };
+    std::atomic<uint64_t> forwarded{ 0 };   // datagrams (a GSO message counts once)
+    std::atomic<uint64_t> fragments{ 0 };   // fragment datagrams received
+    std::atomic<uint64_t> reassembled{ 0 };
+    std::atomic<uint64_t> abandoned{ 0 };   // incomplete frames dropped for a newer seq
+    std::atomic<uint64_t> stale{ 0 };       // at or below the agent's newest frame
+    std::atomic<uint64_t> unbatched{ 0 };   // commands received inside batch frames
+    std::atomic<uint64_t> coalesced{ 0 };   // commands sent inside batch frames
+    std::atomic<uint64_t> captured{ 0 };    // records written to the capture logs
+};
+
+class MultiAgentCore
+{
+public:
+    ~MultiAgentCore() { stop(); }
+
+    bool start(const MultiAgentConfig& cfg)
+    {
+        cfg_ = cfg;
+        if (!make_addr(cfg.egress_host, cfg.egress_port, egress_addr_) || cfg.tick_hz <= 0)
+            return false;
+
+        table_.reset(new AgentTable(cfg.agents, cfg.max_datagram));
+        reasm_.reset(new Reassembler(cfg.agents, cfg.max_datagram));
+
+        in_fd_ = bind_udp(cfg.host, cfg.ingress_port);
+        out_fd_ = udp_socket();
+        tick_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+        if (in_fd_ < 0 || out_fd_ < 0 || tick_fd_ < 0)
+        {
+            stop();
+            return false;
+        }
+        set_socket_buffers(in_fd_, cfg.socket_buffer, 0);
+        set_socket_buffers(out_fd_, 0, cfg.socket_buffer);
+        if (cfg.gro) cfg_.gro = enable_gro(in_fd_);
+        if (cfg.gso) cfg_.gso = cfg.mtu > 0 && gso_supported(out_fd_);
+        if (cfg.capture && (!rx_capture_.open((std::string(cfg.capture) + ".rx").c_str()) ||
+                               !tx_capture_.open((std::string(cfg.capture) + ".tx").c_str())))
+        {
+            stop();
+            return false;
+        }
+
+        uint64_t period = (uint64_t)(1e9 / cfg.tick_hz);
+        itimerspec its{};
+        its.it_value.tv_sec = its.it_interval.tv_sec = (time_t)(period / 1000000000ull);
+        its.it_value.tv_nsec = its.it_interval.tv_nsec = (long)(period % 1000000000ull);
+        timerfd_settime(tick_fd_, 0, &its, nullptr);
+
+        running_ = true;
+        ingress_ = std::thread([this]() { ingress_loop(); });
+        egress_ = std::thread([this]() { egress_loop(); });
+        return true;
+    }
+
+    void stop()
+    {
+        running_ = false;
+        if (in_fd_ >= 0) shutdown(in_fd_, SHUT_RDWR);
+        if (tick_fd_ >= 0)
+        {
+            // fire the timer once more so the egress thread sees !running_
+            itimerspec its{};
+            its.it_value.tv_nsec = 1;
+            timerfd_settime(tick_fd_, 0, &its, nullptr);
+        }
+        if (ingress_.joinable()) ingress_.join();
+        if (egress_.joinable()) egress_.join();
+        if (in_fd_ >= 0) { close(in_fd_); in_fd_ = -1; }
+        if (out_fd_ >= 0) { close(out_fd_); out_fd_ = -1; }
+        if (tick_fd_ >= 0) { close(tick_fd_); tick_fd_ = -1; }
+        rx_capture_.close();
+        tx_capture_.close();
+    }
+
+    int ingress_port() const { return bound_port(in_fd_); }
+    // what took effect; GSO/GRO are dropped when the kernel refuses them
+    const MultiAgentConfig& config() const { return cfg_; }
+    const MultiAgentStats& stats() const { return stats_; }
+
+private:
+    void ingress_loop()
+    {
+        const unsigned batch = cfg_.batch;
+        // a GRO receive can coalesce up to 64 KB of fragments
+        const size_t cap = cfg_.gro ? 65535 : std::min(cfg_.max_datagram, UDP_MAX_PAYLOAD);
+        std::vector<uint8_t> bufs((size_t)batch * cap);
+        std::vector<iovec> iov(batch);
+        std::vector<mmsghdr> msgs(batch);
+        struct Cmsg { alignas(cmsghdr) char buf[CMSG_SPACE(sizeof(int))]; };
+        std::vector<Cmsg> ctl(cfg_.gro ? batch : 0);
+
+        auto publish = [this](uint32_t agent, const uint8_t* frame, size_t len)
+        {
+            table_->publish(agent, frame, len);
+        };
+
+        for (unsigned i = 0; i < batch; ++i)
+        {
+            iov[i].iov_base = bufs.data() + (size_t)i * cap;
+            iov[i].iov_len = cap;
+        }
+
+        while (running_)
+        {
+            for (unsigned i = 0; i < batch; ++i)
+            {
+                msgs[i].msg_hdr = msghdr{};
+                msgs[i].msg_hdr.msg_iov = &iov[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+                if (cfg_.gro)
+                {
+                    msgs[i].msg_hdr.msg_control = ctl[i].buf;
+                    msgs[i].msg_hdr.msg_controllen = sizeof(ctl[i].buf);
+                }
+            }
+
+            // MSG_WAITFORONE: block for the first datagram, then take
+            // whatever else is already queued up to `batch`.
+            int n = recvmmsg(in_fd_, msgs.data(), batch, MSG_WAITFORONE, nullptr);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0 || !running_) break; // stop() wakes us with an empty read
+            stats_.recv_calls.fetch_add(1, std::memory_order_relaxed);
+            const uint64_t rx_ns = rx_capture_.is_open() ? mono_ns() : 0;
+
+            for (int i = 0; i < n; ++i)
+            {
+                const uint8_t* p = (const uint8_t*)iov[i].iov_base;
+                size_t len = msgs[i].msg_len;
+
+                size_t gro_size = 0;
+                if (cfg_.gro)
+                {
+                    for (cmsghdr* cm = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cm; cm = CMSG_NXTHDR(&msgs[i].msg_hdr, cm))
+                    {
+                        if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO)
+                        {
+                            int seg;
+                            memcpy(&seg, CMSG_DATA(cm), sizeof(seg));
+                            gro_size = (size_t)seg;
+                        }
+                    }
+                }
+
+                if (rx_ns) rx_capture_.append(CAPTURE_RX, p, len, rx_ns, (uint16_t)gro_size);
+
+                if (len >= FRAME_HEADER_SIZE && p[offsetof(FrameHeader, type)] == FRAME_BATCH)
+                {
+                    if (!unbatch(p, len))
+                        stats_.rejected.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+
+                // whole frames pass through in place; the reassembler only
+                // orders them against fragmented ones of the same agent
+                if (reasm_->feed(p, len, publish, gro_size) == FragResult::Invalid)
+                    stats_.rejected.fetch_add(1, std::memory_order_relaxed);
+            }
+            stats_.datagrams.fetch_add(n, std::memory_order_relaxed);
+            stats_.fragments.store(reasm_->fragments(), std::memory_order_relaxed);
+            stats_.reassembled.store(reasm_->completed(), std::memory_order_relaxed);
+            stats_.abandoned.store(reasm_->abandoned(), std::memory_order_relaxed);
+            stats_.stale.store(reasm_->stale(), std::memory_order_relaxed);
+            if (rx_ns) stats_.captured.fetch_add(n, std::memory_order_relaxed);
+        }
+    }
+
+    // Publishes every command of a batch frame as a FRAME_CONTROL frame of
+    // its agent, stamped with the batch's seq and timestamp.
+    bool unbatch(const uint8_t* p, size_t len)
+    {
+        FrameHeader h;
+        memcpy(&h, p, FRAME_HEADER_SIZE);
+        if (!header_valid(h) || FRAME_HEADER_SIZE + h.payload_len != len) return false;
+
+        uint8_t frame[FRAME_HEADER_SIZE + 256];
+        uint64_t n = 0;
+        bool ok = for_each_batched(p + FRAME_HEADER_SIZE, h.payload_len,
+            [&](uint32_t agent, const uint8_t* rec, size_t size)
+            {
+                if (size > sizeof(frame) - FRAME_HEADER_SIZE) return;
+                FrameHeader c = make_header(FRAME_CONTROL, agent, h.seq, (uint32_t)size, h.timestamp_ns);
+                memcpy(frame, &c, FRAME_HEADER_SIZE);
+                memcpy(frame + FRAME_HEADER_SIZE, rec, size);
+                if (table_->publish(agent, frame, FRAME_HEADER_SIZE + size)) ++n;
+            });
+        stats_.unbatched.fetch_add(n, std::memory_order_relaxed);
+        return ok;
+    }
+
+    // A lone control command that can ride in a batch frame.
+    static bool coalescible(const uint8_t* data, size_t len)
+    {
+        FrameHeader h;
+        if (len != FRAME_HEADER_SIZE + CONTROL_PACKET_SIZE) return false;
+        memcpy(&h, data, FRAME_HEADER_SIZE);
+        return h.type == FRAME_CONTROL && !(h.flags & FRAME_FLAG_FRAGMENT);
+    }
+
+    void egress_loop()
+    {
+        const uint32_t agents = cfg_.agents;
+        std::vector<iovec> iov(agents);
+        std::vector<mmsghdr> msgs(agents);
+        Fragmenter frag(cfg_.mtu ? cfg_.mtu : FRAGMENT_DEFAULT_MTU);
+
+        // Batch frames of one tick. Every batch holds at least one command,
+        // so this bound is never exceeded and the frames never move.
+        Coalescer co(agents, CONTROL_PACKET_SIZE, std::min(cfg_.mtu ? cfg_.mtu : COALESCE_MAX_BYTES, UDP_MAX_PAYLOAD));
+        std::vector<uint8_t> staged(cfg_.coalesce
+            ? (size_t)agents * (FRAME_HEADER_SIZE + BATCH_HEADER_SIZE + sizeof(uint16_t) + CONTROL_PACKET_SIZE) : 0);
+        size_t staged_len = 0;
+
+        while (running_)
+        {
+            uint64_t expirations;
+            if (read(tick_fd_, &expirations, sizeof(expirations)) != sizeof(expirations))
+            {
+                if (errno == EINTR) continue;
+                break;
+            }
+            if (!running_) break;
+
+            uint32_t n = 0;
+            const uint64_t now = mono_ns();
+            auto send_frame = [&](const uint8_t* data, size_t len)
+            {
+                // logical frames, before fragmentation, stamped with the tick
+                if (tx_capture_.is_open() && tx_capture_.append(CAPTURE_TX, data, len, now))
+                    stats_.captured.fetch_add(1, std::memory_order_relaxed);
+                if (cfg_.mtu)
+                {
+                    frag.add(data, len);
+                    return;
+                }
+                iov[n].iov_base = (void*)data;
+                iov[n].iov_len = len;
+                msgs[n].msg_hdr = msghdr{};
+                msgs[n].msg_hdr.msg_name = &egress_addr_;
+                msgs[n].msg_hdr.msg_namelen = sizeof(egress_addr_);
+                msgs[n].msg_hdr.msg_iov = &iov[n];
+                msgs[n].msg_hdr.msg_iovlen = 1;
+                ++n;
+            };
+            auto stage = [&](const uint8_t* frame, size_t len)
+            {
+                memcpy(staged.data() + staged_len, frame, len);
+                send_frame(staged.data() + staged_len, len);
+                staged_len += len;
+            };
+
+            if (cfg_.mtu)
+            {
+                frag.reset();
+                msgs.clear();
+            }
+            staged_len = 0;
+            uint64_t commands = co.commands();
+            table_->take_changed([&](uint32_t agent, const uint8_t* data, size_t len)
+                {
+                    if (cfg_.coalesce && coalescible(data, len))
+                        co.add(agent, data + FRAME_HEADER_SIZE, now, stage);
+                    else
+                        send_frame(data, len);
+                });
+            co.tick(stage);
+            stats_.coalesced.fetch_add(co.commands() - commands, std::memory_order_relaxed);
+
+            if (cfg_.mtu)
+            {
+                frag.build(msgs, &egress_addr_, cfg_.gso);
+                n = (uint32_t)msgs.size();
+            }
+
+            uint32_t done = 0;
+            while (done < n)
+            {
+                int r = sendmmsg(out_fd_, msgs.data() + done, n - done, 0);
+                stats_.send_calls.fetch_add(1, std::memory_order_relaxed);
+                if (r < 0)
+                {
+                    if (errno == EINTR) continue;
+                    break; // drop the rest of this tick; newer publishes supersede it
+                }
+                done += (uint32_t)r;
+            }
+
+            stats_.forwarded.fetch_add(done, std::memory_order_relaxed);
+            stats_.ticks.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    MultiAgentConfig cfg_;
+    std::unique_ptr<AgentTable> table_;
+    std::unique_ptr<Reassembler> reasm_; // ingress thread only
+    CaptureWriter rx_capture_;           // ingress thread only
+    CaptureWriter tx_capture_;           // egress thread only
+    sockaddr_in egress_addr_{};
+    int in_fd_ = -1;
+    int out_fd_ = -1;
+    int tick_fd_ = -1;
+    std::atomic<bool> running_{ false };
+    MultiAgentStats stats_;
+    std::thread ingress_;
+    std::thread egress_;
+};
+
+} // namespace ssb
@@ -0,0 +1,146 @@
+// ssb/probe.h
+// Pipelined latency probes. Each probe is 16 bytes, a sequence id and
+// its send time, which the reference servers echo back verbatim like the
+// old 8-byte ping. Up to `max_in_flight` probes may be outstanding at once,
+// and echoes are matched by id, so they may come back in any order.
+//
+// Every probe carries two latencies:
+//   - rtt: actual send -> echo
+//   - latency: intended send -> echo. A probe paced at a fixed rate is due
+//     at start + k/rate. When the window is full or the socket is
+//     backed up it leaves late, and that wait counts against it. This is
+//     what makes a latency-vs-offered-load curve honest
+//     (no coordinated omission).
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace ssb
+{
+
+struct Probe
+{
+    uint64_t seq;
+    uint64_t send_ns;
+};
+
+static_assert(sizeof(Probe) == 16, "Probe must stay 16 bytes");
+
+constexpr size_t PROBE_SIZE = sizeof(Probe);
+
+// In-flight bookkeeping for one probe stream.
+class ProbeWindow
+{
+public:
+    explicit ProbeWindow(uint32_t max_in_flight)
+        : limit_(max_in_flight ? max_in_flight : 1)
+    {
+        size_t cap = 1;
+        while (cap < limit_) cap <<= 1;
+        ring_.resize(cap);
+        mask_ = cap - 1;
+    }
+
+    // Full while the oldest unanswered probe is `max_in_flight` ids behind.
+    bool full() const { return next_ - oldest_ >= limit_; }
+    uint32_t in_flight() const { return live_; }
+    uint32_t limit() const { return limit_; }
+
+    // Stamps the next probe; call only when !full().
+    Probe issue(uint64_t intended_ns, uint64_t now_ns)
+    {
+        Entry& e = ring_[next_ & mask_];
+        e.intended = intended_ns;
+        e.sent = now_ns;
+        e.live = true;
+        ++live_;
+        ++issued_;
+        return Probe{ next_++, now_ns };
+    }
+
+    // Matches an echo in any order. False for ids that are unknown,
+    // already answered or expired, or whose timestamp does not match.
+    bool complete(const Probe& echo, uint64_t now_ns, uint64_t& latency_ns, uint64_t& rtt_ns)
+    {
+        if (echo.seq < oldest_ || echo.seq >= next_)
+        {
+            ++unmatched_;
+            return false;
+        }
+        Entry& e = ring_[echo.seq & mask_];
+        if (!e.live || e.sent != echo.send_ns)
+        {
+            ++unmatched_;
+            return false;
+        }
+        e.live = false;
+        --live_;
+        ++completed_;
+        rtt_ns = now_ns > e.sent ? now_ns - e.sent : 0;
+        latency_ns = now_ns > e.intended ? now_ns - e.intended : 0;
+        advance();
+        return true;
+    }
+
+    // Gives up on probes outstanding longer than `timeout_ns` (lossy
+    // transports). Returns how many were dropped.
+    uint32_t expire(uint64_t now_ns, uint64_t timeout_ns)
+    {
+        uint32_t n = 0;
+        for (uint64_t s = oldest_; s < next_; ++s)
+        {
+            Entry& e = ring_[s & mask_];
+            if (e.live && now_ns - e.sent > timeout_ns)
+            {
+                e.live = false;
+                --live_;
+                ++n;
+            }
+        }
+        expired_ += n;
+        advance();
+        return n;
+    }
+
+    // Forgets everything in flight (e.g. between load steps).
+    void clear()
+    {
+        for (Entry& e : ring_) e.live = false;
+        oldest_ = next_;
+        live_ = 0;
+    }
+
+    uint64_t issued() const { return issued_; }
+    uint64_t completed() const { return completed_; }
+    uint64_t expired() const { return expired_; }
+    uint64_t unmatched() const { return unmatched_; }
+
+private:
+    struct Entry
+    {
+        uint64_t intended = 0;
+        uint64_t sent = 0;
+        bool live = false;
+    };
+
+    void advance()
+    {
+        while (oldest_ < next_ && !ring_[oldest_ & mask_].live) ++oldest_;
+    }
+
+    uint32_t limit_;
+    std::vector<Entry> ring_;
+    uint64_t mask_ = 0;
+    uint64_t next_ = 0;
+    uint64_t oldest_ = 0;
+    uint32_t live_ = 0;
+
+    uint64_t issued_ = 0;
+    uint64_t completed_ = 0;
+    uint64_t expired_ = 0;
+    uint64_t unmatched_ = 0;
+};
+
+} // namespace ssb
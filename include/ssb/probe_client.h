@@ -0,0 +1,183 @@
+// ssb/probe_client.h
+// Open-loop probe driver on a Reactor. Probes go out on a fixed schedule
+// (`rate` per second, issued in batches on a short pacing timer), up to
+// ProbeWindow's in-flight limit, over a connected non-blocking stream
+// socket whose peer echoes bytes back unchanged. Echoes are parsed from
+// the byte stream and matched by id. Latencies land in two Histograms (ns):
+// latency() from the intended send time and rtt() from the actual one.
+// Waiting up to one pacing tick for the batch to leave is not counted;
+// any delay beyond that is.
+//
+// The client owns the socket's reactor registration (EPOLLIN | EPOLLOUT).
+// On a socket error it stops the reactor, like the other clients do.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "clock.h"
+#include "histogram.h"
+#include "probe.h"
+#include "reactor.h"
+
+namespace ssb
+{
+
+class ProbeClient
+{
+public:
+    static constexpr uint64_t DEFAULT_TICK_NS = 100000;   // pacing granularity
+    static constexpr uint32_t MAX_BATCH = 4096;           // probes per tick
+
+    ProbeClient(Reactor& reactor, int fd, uint32_t max_in_flight, uint64_t tick_ns = DEFAULT_TICK_NS)
+        : reactor_(reactor), fd_(fd), window_(max_in_flight), tick_ns_(tick_ns), in_(64 * 1024)
+    {
+    }
+
+    ProbeClient(const ProbeClient&) = delete;
+    ProbeClient& operator=(const ProbeClient&) = delete;
+
+    bool start()
+    {
+        return reactor_.add(fd_, EPOLLIN | EPOLLOUT, [this](uint32_t ev) { return on_ready(ev); }) &&
+            reactor_.add_timer(tick_ns_, tick_ns_, [this](uint64_t) { on_tick(); }) >= 0;
+    }
+
+    // Offered load in probes/s; 0 stops issuing (echoes are still
+    // matched). Restarts the schedule from now.
+    void set_rate(double hz)
+    {
+        rate_ = hz > 0 ? hz : 0;
+        t0_ = mono_ns();
+        scheduled_ = 0;
+    }
+
+    // Clears the histograms and per-step counters.
+    void reset_stats()
+    {
+        latency_.reset();
+        rtt_.reset();
+        backlog_ticks_ = 0;
+        max_in_flight_ = window_.in_flight();
+    }
+
+    double rate() const { return rate_; }
+    Histogram& latency() { return latency_; }
+    Histogram& rtt() { return rtt_; }
+    const ProbeWindow& window() const { return window_; }
+
+    uint32_t in_flight() const { return window_.in_flight(); }
+    uint32_t max_in_flight() const { return max_in_flight_; }
+    // ticks on which probes were due but the window or socket held them back
+    uint64_t backlog_ticks() const { return backlog_ticks_; }
+    bool failed() const { return failed_; }
+
+private:
+    bool on_ready(uint32_t ev)
+    {
+        if (!out_.empty() && flush() < 0) return fail();
+
+        for (;;)
+        {
+            ssize_t r = recv_nb(fd_, in_.data() + in_got_, in_.size() - in_got_);
+            if (r < 0) return fail();
+            if (r == 0) break;
+            in_got_ += (size_t)r;
+
+            uint64_t now = mono_ns();
+            size_t off = 0;
+            for (; in_got_ - off >= PROBE_SIZE; off += PROBE_SIZE)
+            {
+                Probe p;
+                memcpy(&p, in_.data() + off, PROBE_SIZE);
+                uint64_t lat, rtt;
+                if (window_.complete(p, now, lat, rtt))
+                {
+                    latency_.record(lat);
+                    rtt_.record(rtt);
+                }
+            }
+            if (off < in_got_) memmove(in_.data(), in_.data() + off, in_got_ - off);
+            in_got_ -= off;
+        }
+
+        if (ev & (EPOLLERR | EPOLLHUP)) return fail();
+        return false;
+    }
+
+    void on_tick()
+    {
+        if (failed_ || rate_ <= 0) return;
+        if (!out_.empty())
+        {
+            if (flush() < 0) { fail(); return; }
+            if (!out_.empty()) { ++backlog_ticks_; return; } // socket backed up
+        }
+
+        uint64_t now = mono_ns();
+        uint64_t due = (uint64_t)((double)(now - t0_) * rate_ / 1e9) + 1;
+        uint32_t n = 0;
+        while (scheduled_ < due && n < MAX_BATCH && !window_.full())
+        {
+            // waiting for the next pacing tick is not the transport's
+            // fault: forgive up to one tick, keep any delay beyond it
+            uint64_t intended = t0_ + (uint64_t)((double)scheduled_ * 1e9 / rate_);
+            intended += std::min(now > intended ? now - intended : 0, tick_ns_);
+            Probe p = window_.issue(intended, now);
+            size_t at = out_.size();
+            out_.resize(at + PROBE_SIZE);
+            memcpy(out_.data() + at, &p, PROBE_SIZE);
+            ++scheduled_;
+            ++n;
+        }
+        if (scheduled_ < due) ++backlog_ticks_;
+        if (window_.in_flight() > max_in_flight_) max_in_flight_ = window_.in_flight();
+
+        if (!out_.empty() && flush() < 0) fail();
+    }
+
+    // -1 on error; otherwise leaves whatever the socket did not take
+    int flush()
+    {
+        ssize_t r = send_nb(fd_, out_.data() + out_off_, out_.size() - out_off_);
+        if (r < 0) return -1;
+        out_off_ += (size_t)r;
+        if (out_off_ == out_.size())
+        {
+            out_.clear();
+            out_off_ = 0;
+        }
+        return 0;
+    }
+
+    bool fail()
+    {
+        failed_ = true;
+        reactor_.stop();
+        return false;
+    }
+
+    Reactor& reactor_;
+    int fd_;
+    ProbeWindow window_;
+    uint64_t tick_ns_;
+
+    double rate_ = 0;
+    uint64_t t0_ = 0;
+    uint64_t scheduled_ = 0;
+
+    std::vector<uint8_t> out_;
+    size_t out_off_ = 0;
+    std::vector<uint8_t> in_;
+    size_t in_got_ = 0;
+
+    Histogram latency_;
+    Histogram rtt_;
+    uint32_t max_in_flight_ = 0;
+    uint64_t backlog_ticks_ = 0;
+    bool failed_ = false;
+};
+
+} // namespace ssb
@@ -0,0 +1,253 @@
+// ssb/reactor.h
+// Edge-triggered epoll event loop. One Reactor per thread; it owns any
+// number of non-blocking sockets plus timerfd timers and an eventfd used to
+// wake it from other threads.
+#pragma once
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace ssb
+{
+
+// Called with the epoll event mask. Return true when the handler stopped
+// before draining the socket (EAGAIN) and wants to be called again on the
+// next loop iteration; with edge-triggered epoll no new edge would arrive.
+using Handler = std::function<bool(uint32_t events)>;
+
+inline bool set_nonblocking(int fd)
+{
+    int fl = fcntl(fd, F_GETFL, 0);
+    return fl >= 0 && fcntl(fd, F_SETFL, fl | O_NONBLOCK) == 0;
+}
+
+// Non-blocking send: bytes written, 0 if the socket would block,
+// -1 if the peer is gone or the socket failed.
+inline ssize_t send_nb(int fd, const void* buf, size_t len)
+{
+    for (;;)
+    {
+        ssize_t n = ::send(fd, buf, len, MSG_NOSIGNAL);
+        if (n >= 0) return n;
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+        return -1;
+    }
+}
+
+// Non-blocking recv: bytes read, 0 if nothing is pending,
+// -1 on orderly shutdown or error.
+inline ssize_t recv_nb(int fd, void* buf, size_t len)
+{
+    for (;;)
+    {
+        ssize_t n = ::recv(fd, buf, len, 0);
+        if (n > 0) return n;
+        if (n == 0) return -1;
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+        return -1;
+    }
+}
+
+class Reactor
+{
+public:
+    Reactor()
+    {
+        ep_ = epoll_create1(EPOLL_CLOEXEC);
+        wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (ep_ >= 0 && wake_fd_ >= 0)
+        {
+            add(wake_fd_, EPOLLIN, [this](uint32_t)
+                {
+                    uint64_t v;
+                    while (read(wake_fd_, &v, sizeof(v)) == sizeof(v)) {}
+                    return false;
+                });
+        }
+    }
+
+    ~Reactor()
+    {
+        for (size_t fd = 0; fd < entries_.size(); ++fd)
+            if (entries_[fd] && entries_[fd]->owned)
+                close((int)fd);
+        if (wake_fd_ >= 0) close(wake_fd_);
+        if (ep_ >= 0) close(ep_);
+    }
+
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+    bool ok() const { return ep_ >= 0 && wake_fd_ >= 0; }
+
+    // Registers fd edge-triggered for `events` (EPOLLIN / EPOLLOUT).
+    // The reactor does not close fd unless it created it (timers).
+    bool add(int fd, uint32_t events, Handler h)
+    {
+        if (fd < 0) return false;
+        if ((size_t)fd >= entries_.size()) entries_.resize(fd + 1);
+        entries_[fd].reset(new Entry{ std::move(h), false, false });
+
+        epoll_event ev{};
+        ev.events = events | EPOLLET | EPOLLRDHUP;
+        ev.data.fd = fd;
+        if (epoll_ctl(ep_, EPOLL_CTL_ADD, fd, &ev) != 0)
+        {
+            entries_[fd].reset();
+            return false;
+        }
+        return true;
+    }
+
+    void remove(int fd)
+    {
+        if (fd < 0 || (size_t)fd >= entries_.size() || !entries_[fd]) return;
+        epoll_ctl(ep_, EPOLL_CTL_DEL, fd, nullptr);
+        bool owned = entries_[fd]->owned;
+        // the handler may be the caller; free it after dispatch unwinds
+        retired_.push_back(std::move(entries_[fd]));
+        if (owned) close(fd);
+    }
+
+    // Periodic timer on CLOCK_MONOTONIC; period_ns == 0 makes it one-shot
+    // after first_ns. Returns the timerfd (owned by the reactor) or -1.
+    int add_timer(uint64_t first_ns, uint64_t period_ns, std::function<void(uint64_t expirations)> fn)
+    {
+        int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (tfd < 0) return -1;
+
+        itimerspec its{};
+        if (first_ns == 0) first_ns = 1;
+        its.it_value.tv_sec = (time_t)(first_ns / 1000000000ull);
+        its.it_value.tv_nsec = (long)(first_ns % 1000000000ull);
+        its.it_interval.tv_sec = (time_t)(period_ns / 1000000000ull);
+        its.it_interval.tv_nsec = (long)(period_ns % 1000000000ull);
+        timerfd_settime(tfd, 0, &its, nullptr);
+
+        bool added = add(tfd, EPOLLIN, [tfd, fn](uint32_t)
+            {
+                uint64_t n = 0;
+                if (read(tfd, &n, sizeof(n)) == sizeof(n) && n > 0)
+                    fn(n);
+                return false;
+            });
+        if (!added)
+        {
+            close(tfd);
+            return -1;
+        }
+        entries_[tfd]->owned = true;
+        return tfd;
+    }
+
+    // Runs one epoll_wait and dispatches. timeout_ms < 0 blocks; handlers
+    // that asked to be re-polled force a zero timeout.
+    int run_once(int timeout_ms)
+    {
+        if (!pending_.empty()) timeout_ms = 0;
+
+        epoll_event events[64];
+        int n = epoll_wait(ep_, events, 64, timeout_ms);
+        if (n < 0 && errno != EINTR) return -1;
+
+        for (int i = 0; i < n; ++i)
+            dispatch(events[i].data.fd, events[i].events);
+
+        // Handlers that yielded early get another turn with their last mask.
+        again_.clear();
+        again_.swap(pending_);
+        for (auto& p : again_)
+        {
+            Entry* e = entry(p.first);
+            if (e && e->queued)
+            {
+                e->queued = false;
+                dispatch(p.first, p.second);
+            }
+        }
+        retired_.clear();
+        return n < 0 ? 0 : n;
+    }
+
+    void run()
+    {
+        while (!stop_.load(std::memory_order_acquire))
+            if (run_once(-1) < 0) break;
+    }
+
+    // Like run(), but polls epoll without sleeping: the thread never
+    // blocks, so readiness is seen as soon as the kernel posts it. Burns
+    // its core; for the low-latency profile (lowlat.h) on a dedicated CPU.
+    void run_spin()
+    {
+        while (!stop_.load(std::memory_order_acquire))
+            if (run_once(0) < 0) break;
+    }
+
+    // Safe to call from any thread.
+    void stop()
+    {
+        stop_.store(true, std::memory_order_release);
+        wake();
+    }
+
+    void wake()
+    {
+        uint64_t one = 1;
+        ssize_t r = write(wake_fd_, &one, sizeof(one));
+        (void)r;
+    }
+
+    bool stopped() const { return stop_.load(std::memory_order_acquire); }
+
+private:
+    struct Entry
+    {
+        Handler fn;
+        bool owned;
+        bool queued;
+    };
+
+    Entry* entry(int fd)
+    {
+        return ((size_t)fd < entries_.size()) ? entries_[fd].get() : nullptr;
+    }
+
+    void dispatch(int fd, uint32_t events)
+    {
+        Entry* e = entry(fd);
+        if (!e) return;
+        if (e->fn(events))
+        {
+            // handler may have removed itself
+            e = entry(fd);
+            if (e && !e->queued)
+            {
+                e->queued = true;
+                pending_.emplace_back(fd, events);
+            }
+        }
+    }
+
+    int ep_ = -1;
+    int wake_fd_ = -1;
+    std::atomic<bool> stop_{ false };
+    std::vector<std::unique_ptr<Entry>> entries_;
+    std::vector<std::pair<int, uint32_t>> pending_;
+    std::vector<std::pair<int, uint32_t>> again_;
+    std::vector<std::unique_ptr<Entry>> retired_;
+};
+
+} // namespace ssb
@@ -0,0 +1,111 @@
+// ssb/resume.h
+// Fast reconnect with session resumption.
+//
+// A client picks a random 64-bit session token once and keeps it, with
+// its per-stream sequence numbers, across reconnects. Every data
+// connection it opens starts with one FRAME_RESUME frame per stream:
+//
+//   [FrameHeader type=FRAME_RESUME, stream_id, seq = next seq to send]
+//   [ResumeRecord token, reconnects]
+//
+// A receiver that sees it continues loss accounting at `seq` instead of
+// counting the jump as lost frames; one that remembers the token (a
+// ResumeTable kept across sessions) can also tell how many frames died
+// with the old connection. Both reference servers (ssb_server and
+// ssb_combined_server.py) handle it.
+//
+// Reconnect attempts are spaced by Backoff (backoff.h).
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "backoff.h"
+#include "clock.h"
+#include "frame.h"
+
+namespace ssb
+{
+
+struct ResumeRecord
+{
+    uint64_t token;
+    uint32_t reconnects;  // 0 on the first connection of the session
+    uint32_t reserved;
+};
+
+static_assert(sizeof(ResumeRecord) == 16, "ResumeRecord is 16 bytes on the wire");
+
+constexpr size_t RESUME_FRAME_SIZE = FRAME_HEADER_SIZE + sizeof(ResumeRecord);
+
+// Random enough to tell clients apart; not a secret.
+inline uint64_t make_session_token()
+{
+    uint64_t x = mono_ns() ^ ((uint64_t)(uintptr_t)&x << 17);
+    x ^= x >> 33; x *= 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33; x *= 0xC4CEB9FE1A85EC53ull;
+    x ^= x >> 33;
+    return x ? x : 1;
+}
+
+inline void make_resume_frame(uint8_t* out, uint32_t stream_id, uint64_t next_seq, uint64_t token, uint32_t reconnects)
+{
+    FrameHeader h = make_header(FRAME_RESUME, stream_id, next_seq, (uint32_t)sizeof(ResumeRecord));
+    ResumeRecord r{ token, reconnects, 0 };
+    memcpy(out, &h, FRAME_HEADER_SIZE);
+    memcpy(out + FRAME_HEADER_SIZE, &r, sizeof(r));
+}
+
+// Server side: last seq seen per (token, stream), kept across sessions so
+// a resumed stream's break can be sized. Small and linear; a reference
+// server has a handful of clients.
+class ResumeTable
+{
+public:
+    explicit ResumeTable(size_t max_entries = 256) : max_(max_entries) {}
+
+    // Last seq recorded for the stream, or -1 if unknown.
+    int64_t last_seq(uint64_t token, uint32_t stream) const
+    {
+        for (const Entry& e : entries_)
+            if (e.token == token && e.stream == stream) return e.last_seq;
+        return -1;
+    }
+
+    void store(uint64_t token, uint32_t stream, int64_t last_seq)
+    {
+        for (Entry& e : entries_)
+            if (e.token == token && e.stream == stream)
+            {
+                e.last_seq = last_seq;
+                e.stamp = ++clock_;
+                return;
+            }
+        if (entries_.size() < max_)
+        {
+            entries_.push_back(Entry{ token, stream, last_seq, ++clock_ });
+            return;
+        }
+        // forget the least recently stored
+        Entry* old = &entries_[0];
+        for (Entry& e : entries_)
+            if (e.stamp < old->stamp) old = &e;
+        *old = Entry{ token, stream, last_seq, ++clock_ };
+    }
+
+private:
+    struct Entry
+    {
+        uint64_t token;
+        uint32_t stream;
+        int64_t last_seq;
+        uint64_t stamp;
+    };
+
+    std::vector<Entry> entries_;
+    size_t max_;
+    uint64_t clock_ = 0;
+};
+
+} // namespace ssb
@@ -0,0 +1,299 @@
+// ssb/schema.h
+// Compile-time packet schemas. A schema is the ordered list of struct
+// members that go on the wire:
+//
+//   using ControlSchema = Schema<&ControlPacket::seq, &ControlPacket::throttle, ...>;
+//
+// From that list it derives the packed little-endian layout (offsets, size,
+// a Python struct format such as "<IfffQ") at compile time, and generates
+// encode/decode that copy field by field, so the C++ struct may have any
+// padding or member order it likes. Fields must be arithmetic types.
+//
+// SoaBatch<S> decodes N packed records into one column per field
+// (structure of arrays), so a controller can run a tick's commands through
+// one tight loop per column instead of hopping between 24-byte structs.
+// With AVX2 the 4- and 8-byte columns are filled with gathers, 8 or 4
+// records per instruction; everything else uses a portable loop.
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "cpu.h"
+
+namespace ssb
+{
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "schemas encode by memcpy on little-endian hosts");
+
+namespace schema_detail
+{
+
+template <typename M>
+struct member_traits;
+
+template <typename C, typename T>
+struct member_traits<T C::*>
+{
+    using owner = C;
+    using type = T;
+};
+
+// Python struct code of a field type.
+template <typename T>
+constexpr char format_code()
+{
+    if constexpr (std::is_same_v<T, float>) return 'f';
+    else if constexpr (std::is_same_v<T, double>) return 'd';
+    else if constexpr (std::is_same_v<T, bool>) return '?';
+    else if constexpr (std::is_signed_v<T>)
+        return sizeof(T) == 1 ? 'b' : sizeof(T) == 2 ? 'h' : sizeof(T) == 4 ? 'i' : 'q';
+    else
+        return sizeof(T) == 1 ? 'B' : sizeof(T) == 2 ? 'H' : sizeof(T) == 4 ? 'I' : 'Q';
+}
+
+} // namespace schema_detail
+
+template <auto... Members>
+struct Schema
+{
+    static_assert(sizeof...(Members) > 0, "a schema needs at least one field");
+
+    using Struct = typename schema_detail::member_traits<
+        std::tuple_element_t<0, std::tuple<decltype(Members)...>>>::owner;
+    static_assert((std::is_same_v<typename schema_detail::member_traits<decltype(Members)>::owner, Struct> && ...),
+        "all schema fields must belong to one struct");
+    static_assert((std::is_arithmetic_v<typename schema_detail::member_traits<decltype(Members)>::type> && ...),
+        "schema fields must be arithmetic");
+
+    template <size_t I>
+    using field_type = std::tuple_element_t<I, std::tuple<typename schema_detail::member_traits<decltype(Members)>::type...>>;
+
+    static constexpr size_t COUNT = sizeof...(Members);
+    static constexpr std::array<size_t, COUNT> SIZES = { sizeof(typename schema_detail::member_traits<decltype(Members)>::type)... };
+
+    static constexpr std::array<size_t, COUNT> offsets()
+    {
+        std::array<size_t, COUNT> o{};
+        size_t at = 0;
+        for (size_t i = 0; i < COUNT; ++i)
+        {
+            o[i] = at;
+            at += SIZES[i];
+        }
+        return o;
+    }
+
+    static constexpr std::array<size_t, COUNT> OFFSETS = offsets();
+    static constexpr size_t SIZE = OFFSETS[COUNT - 1] + SIZES[COUNT - 1];
+
+    // Every field sits at a multiple of its size, also in an array of
+    // records, so a receive buffer of records can be read with aligned loads.
+    static constexpr bool aligned()
+    {
+        size_t widest = 1;
+        for (size_t i = 0; i < COUNT; ++i)
+        {
+            if (OFFSETS[i] % SIZES[i]) return false;
+            if (SIZES[i] > widest) widest = SIZES[i];
+        }
+        return SIZE % widest == 0;
+    }
+
+    static constexpr bool ALIGNED = aligned();
+
+    // "<IfffQ" and a terminating NUL.
+    static constexpr std::array<char, COUNT + 2> FORMAT = {
+        '<', schema_detail::format_code<typename schema_detail::member_traits<decltype(Members)>::type>()..., '\0'
+    };
+
+    static constexpr bool format_is(const char* f)
+    {
+        for (size_t i = 0; i < COUNT + 1; ++i)
+            if (f[i] != FORMAT[i]) return false;
+        return f[COUNT + 1] == '\0';
+    }
+
+    static void encode(const Struct& s, void* buf)
+    {
+        encode_fields(s, (uint8_t*)buf, std::make_index_sequence<COUNT>{});
+    }
+
+    // False (and `out` untouched) unless `len` is exactly SIZE.
+    static bool decode(const void* buf, size_t len, Struct& out)
+    {
+        if (len != SIZE) return false;
+        decode_fields((const uint8_t*)buf, out, std::make_index_sequence<COUNT>{});
+        return true;
+    }
+
+    // One field of a packed record.
+    template <size_t I>
+    static field_type<I> get(const void* rec)
+    {
+        field_type<I> v;
+        memcpy(&v, (const uint8_t*)rec + OFFSETS[I], sizeof(v));
+        return v;
+    }
+
+    // Field I of the struct.
+    template <size_t I>
+    static void set(Struct& s, field_type<I> v) { s.*std::get<I>(std::make_tuple(Members...)) = v; }
+
+private:
+    template <size_t... I>
+    static void encode_fields(const Struct& s, uint8_t* p, std::index_sequence<I...>)
+    {
+        ((void)put(p + OFFSETS[I], s.*Members), ...);
+    }
+
+    template <size_t... I>
+    static void decode_fields(const uint8_t* p, Struct& s, std::index_sequence<I...>)
+    {
+        ((void)set<I>(s, get<I>(p)), ...);
+    }
+
+    template <typename T>
+    static void put(uint8_t* p, T v) { memcpy(p, &v, sizeof(v)); }
+};
+
+namespace schema_detail
+{
+
+// out[i] = the Size-byte field at rec + i * stride, i in [0, n).
+template <size_t Size>
+inline void gather_scalar(const uint8_t* rec, size_t stride, size_t n, uint8_t* out)
+{
+    for (size_t i = 0; i < n; ++i) memcpy(out + i * Size, rec + i * stride, Size);
+}
+
+#if defined(SSB_X86)
+
+template <size_t Size>
+__attribute__((target("avx2")))
+inline void gather_avx2(const uint8_t* rec, size_t stride, size_t n, uint8_t* out)
+{
+    size_t i = 0;
+    const int s = (int)stride;
+    if constexpr (Size == 4)
+    {
+        const __m256i idx = _mm256_setr_epi32(0, s, 2 * s, 3 * s, 4 * s, 5 * s, 6 * s, 7 * s);
+        for (; i + 8 <= n; i += 8)
+            _mm256_storeu_si256((__m256i*)(out + i * 4),
+                _mm256_i32gather_epi32((const int*)(rec + i * stride), idx, 1));
+    }
+    else if constexpr (Size == 8)
+    {
+        const __m128i idx = _mm_setr_epi32(0, s, 2 * s, 3 * s);
+        for (; i + 4 <= n; i += 4)
+            _mm256_storeu_si256((__m256i*)(out + i * 8),
+                _mm256_i32gather_epi64((const long long*)(rec + i * stride), idx, 1));
+    }
+    gather_scalar<Size>(rec + i * stride, stride, n - i, out + i * Size);
+}
+
+#endif
+
+template <size_t Size>
+inline void gather(Isa isa, const uint8_t* rec, size_t stride, size_t n, uint8_t* out)
+{
+#if defined(SSB_X86)
+    if (isa == Isa::Avx2 && stride <= 0x0FFFFFFF)
+    {
+        gather_avx2<Size>(rec, stride, n, out);
+        return;
+    }
+#endif
+    (void)isa;
+    gather_scalar<Size>(rec, stride, n, out);
+}
+
+} // namespace schema_detail
+
+// Structure-of-arrays view of up to `capacity` records of schema S.
+// Columns are preallocated; decode() appends, clear() starts a new tick.
+template <typename S>
+class SoaBatch
+{
+public:
+    explicit SoaBatch(size_t capacity) : cap_(capacity), isa_(best_isa())
+    {
+        resize_columns(std::make_index_sequence<S::COUNT>{});
+    }
+
+    // Forces the ISA (benchmarks); the default is the best the CPU has.
+    void set_isa(Isa isa) { isa_ = isa; }
+    Isa isa() const { return isa_; }
+
+    size_t size() const { return n_; }
+    size_t capacity() const { return cap_; }
+    void clear() { n_ = 0; }
+
+    template <size_t I>
+    typename S::template field_type<I>* col() { return std::get<I>(cols_).data(); }
+    template <size_t I>
+    const typename S::template field_type<I>* col() const { return std::get<I>(cols_).data(); }
+
+    // Appends `n` packed records laid out `stride` bytes apart (S::SIZE for
+    // a plain array). Returns how many fit.
+    size_t decode(const void* records, size_t stride, size_t n)
+    {
+        if (stride < S::SIZE) return 0;
+        if (n > cap_ - n_) n = cap_ - n_;
+        decode_columns((const uint8_t*)records, stride, n, std::make_index_sequence<S::COUNT>{});
+        n_ += n;
+        return n;
+    }
+
+    // Appends one record; false when full.
+    bool push(const void* record) { return decode(record, S::SIZE, 1) == 1; }
+
+    // Row i as the C++ struct.
+    typename S::Struct row(size_t i) const
+    {
+        typename S::Struct s{};
+        row_fields(i, s, std::make_index_sequence<S::COUNT>{});
+        return s;
+    }
+
+private:
+    template <size_t... I>
+    void resize_columns(std::index_sequence<I...>)
+    {
+        ((void)std::get<I>(cols_).resize(cap_), ...);
+    }
+
+    template <size_t... I>
+    void decode_columns(const uint8_t* rec, size_t stride, size_t n, std::index_sequence<I...>)
+    {
+        ((void)schema_detail::gather<S::SIZES[I]>(isa_, rec + S::OFFSETS[I], stride, n,
+             (uint8_t*)(std::get<I>(cols_).data() + n_)), ...);
+    }
+
+    template <size_t... I>
+    void row_fields(size_t i, typename S::Struct& s, std::index_sequence<I...>) const
+    {
+        ((void)S::template set<I>(s, std::get<I>(cols_)[i]), ...);
+    }
+
+    template <typename T>
+    struct ColumnsOf;
+    template <size_t... I>
+    struct ColumnsOf<std::index_sequence<I...>>
+    {
+        using type = std::tuple<std::vector<typename S::template field_type<I>>...>;
+    };
+
+    typename ColumnsOf<std::make_index_sequence<S::COUNT>>::type cols_;
+    size_t cap_;
+    size_t n_ = 0;
+    Isa isa_;
+};
+
+} // namespace ssb
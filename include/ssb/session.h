@@ -0,0 +1,220 @@
+// ssb/session.h
+// CMD/DATA socket pair and the one-byte test-code handshake used by the
+// reference servers ('L' latency, 'T' throughput, 'E' endurance, 'C' combined,
+// 'S' striped bulk, see stripe.h).
+#pragma once
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "clock.h"
+#include "reactor.h"
+#include "resume.h"
+
+namespace ssb
+{
+
+struct Endpoint
+{
+    const char* host = "127.0.0.1";
+    int cmd_port = 5050;
+    int data_port = 5051;
+};
+
+// Connect with TCP_NODELAY, giving up after timeout_ms (-1: the kernel's
+// own timeout). The connect itself is non-blocking, so a dead server costs
+// the timeout, not a SYN retry cycle; the socket stays non-blocking so it
+// can be handed to a Reactor.
+inline int connect_tcp(const char* host, int port, int timeout_ms = -1)
+{
+    int s = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, IPPROTO_TCP);
+    if (s < 0) return -1;
+
+    int flag = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1)
+    {
+        close(s);
+        return -1;
+    }
+    if (connect(s, (sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+        pollfd pfd{ s, POLLOUT, 0 };
+        int r = -1, err = 0;
+        socklen_t len = sizeof(err);
+        if (errno == EINPROGRESS)
+            do { r = poll(&pfd, 1, timeout_ms); } while (r < 0 && errno == EINTR);
+        if (r != 1 || getsockopt(s, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0)
+        {
+            close(s);
+            return -1;
+        }
+    }
+    return s;
+}
+
+inline int listen_tcp(const char* host, int port, int backlog = 16)
+{
+    int s = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+    if (s < 0) return -1;
+
+    int flag = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1 ||
+        bind(s, (sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(s, backlog) != 0)
+    {
+        close(s);
+        return -1;
+    }
+    return s;
+}
+
+inline bool needs_data_port(char code)
+{
+    return code == 'T' || code == 'E' || code == 'C' || code == 'S';
+}
+
+struct Session
+{
+    int cmd = -1;
+    int data = -1;
+    char code = 0;
+
+    Session() = default;
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+    ~Session() { close_all(); }
+
+    void close_all()
+    {
+        if (cmd >= 0) { close(cmd); cmd = -1; }
+        if (data >= 0) { close(data); data = -1; }
+    }
+};
+
+// Connects CMD, waits up to timeout_ms for the server's test code and, for
+// codes that use it, connects DATA. Both sockets end up non-blocking.
+inline bool open_session(const Endpoint& ep, Session& out, int timeout_ms = 5000)
+{
+    out.close_all();
+
+    out.cmd = connect_tcp(ep.host, ep.cmd_port, timeout_ms);
+    if (out.cmd < 0) return false;
+
+    pollfd pfd{ out.cmd, POLLIN, 0 };
+    int r;
+    do { r = poll(&pfd, 1, timeout_ms); } while (r < 0 && errno == EINTR);
+    if (r != 1 || recv_nb(out.cmd, &out.code, 1) != 1)
+    {
+        out.close_all();
+        return false;
+    }
+
+    if (needs_data_port(out.code))
+    {
+        out.data = connect_tcp(ep.host, ep.data_port, timeout_ms);
+        if (out.data < 0)
+        {
+            out.close_all();
+            return false;
+        }
+    }
+    return true;
+}
+
+// A Session that reopens itself after the server went away. connect()
+// retries with Backoff (1 ms, 2 ms, 4 ms ... max_ms) until the session is
+// up or give_up_ms passed, then starts the data connection with one
+// FRAME_RESUME per stream. Stream seqs and the token live here, so a
+// reconnected stream carries on where it stopped (see resume.h).
+class ResumableSession
+{
+public:
+    explicit ResumableSession(const Endpoint& ep = Endpoint(), uint32_t first_ms = 1, uint32_t max_ms = 500)
+        : ep_(ep), backoff_(first_ms, max_ms), token_(make_session_token())
+    {
+    }
+
+    bool connect(uint64_t give_up_ms = 30000, int attempt_timeout_ms = 1000)
+    {
+        const uint64_t deadline = mono_ns() + give_up_ms * 1000000ull;
+        backoff_.reset();
+        for (;;)
+        {
+            if (open_session(ep_, s_, attempt_timeout_ms) && send_resume())
+            {
+                if (connects_++) ++reconnects_;
+                return true;
+            }
+            s_.close_all();
+            ++failed_attempts_;
+            uint64_t wait_ns = backoff_.next() * 1000000ull;
+            if (mono_ns() + wait_ns >= deadline) return false;
+            std::this_thread::sleep_for(std::chrono::nanoseconds(wait_ns));
+        }
+    }
+
+    Session& session() { return s_; }
+    void close() { s_.close_all(); }
+
+    uint64_t token() const { return token_; }
+    uint32_t reconnects() const { return reconnects_; }
+    uint64_t failed_attempts() const { return failed_attempts_; }
+
+    // Seq for the next frame on `stream`; continues across reconnects.
+    uint64_t take_seq(uint32_t stream = 0) { return seq_for(stream)++; }
+
+private:
+    bool send_resume()
+    {
+        if (s_.data < 0) return true;
+        if (seqs_.empty()) seq_for(0);
+        for (const auto& st : seqs_)
+        {
+            uint8_t f[RESUME_FRAME_SIZE];
+            make_resume_frame(f, st.first, st.second, token_, reconnects_ + (connects_ ? 1 : 0));
+            if (send_nb(s_.data, f, sizeof(f)) != (ssize_t)sizeof(f)) return false;
+        }
+        return true;
+    }
+
+    uint64_t& seq_for(uint32_t stream)
+    {
+        for (auto& st : seqs_)
+            if (st.first == stream) return st.second;
+        seqs_.emplace_back(stream, 0);
+        return seqs_.back().second;
+    }
+
+    Endpoint ep_;
+    Session s_;
+    Backoff backoff_;
+    uint64_t token_;
+    uint32_t connects_ = 0;
+    uint32_t reconnects_ = 0;
+    uint64_t failed_attempts_ = 0;
+    std::vector<std::pair<uint32_t, uint64_t>> seqs_;
+};
+
+} // namespace ssb
@@ -0,0 +1,221 @@
+// ssb/shm_ring.h
+// Single-producer / single-consumer ring of SSB frames in shared memory.
+// Head and tail live on their own cache lines and each side caches the
+// other's index, so the steady state touches one shared line per frame.
+// Frames are stored contiguously (header + payload, 8-byte aligned) so the
+// consumer reads them in place; a FRAME_PAD record fills the gap at the end
+// of the buffer when a frame would wrap.
+//
+// Sleeping is opt-in per side through eventfds: a side that finds the ring
+// empty (consumer) or full (producer) arms its *_sleeping flag and waits on
+// its eventfd, typically from a Reactor; the other side only pays for the
+// eventfd write when that flag is set.
+#pragma once
+
+#include <unistd.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+#include "frame.h"
+
+namespace ssb
+{
+
+struct ShmRingHeader
+{
+    alignas(64) std::atomic<uint64_t> head;  // bytes produced, monotonic
+    alignas(64) std::atomic<uint64_t> tail;  // bytes consumed, monotonic
+    alignas(64) std::atomic<uint32_t> reader_sleeping;
+    alignas(64) std::atomic<uint32_t> writer_sleeping;
+    alignas(64) uint64_t capacity;           // power of two
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared-memory ring needs address-free atomics");
+
+class ShmRing
+{
+public:
+    static size_t bytes_for(size_t capacity) { return sizeof(ShmRingHeader) + capacity; }
+
+    // Creator side: formats the memory. capacity must be a power of two.
+    static void format(void* mem, size_t capacity)
+    {
+        ShmRingHeader* h = new (mem) ShmRingHeader;
+        h->head.store(0, std::memory_order_relaxed);
+        h->tail.store(0, std::memory_order_relaxed);
+        h->reader_sleeping.store(0, std::memory_order_relaxed);
+        h->writer_sleeping.store(0, std::memory_order_relaxed);
+        h->capacity = capacity;
+    }
+
+    // data_efd wakes the consumer, space_efd wakes the producer.
+    void attach(void* mem, int data_efd, int space_efd)
+    {
+        hdr_ = (ShmRingHeader*)mem;
+        buf_ = (uint8_t*)mem + sizeof(ShmRingHeader);
+        cap_ = hdr_->capacity;
+        data_efd_ = data_efd;
+        space_efd_ = space_efd;
+        cached_head_ = hdr_->head.load(std::memory_order_acquire);
+        cached_tail_ = hdr_->tail.load(std::memory_order_acquire);
+    }
+
+    int data_fd() const { return data_efd_; }
+    int space_fd() const { return space_efd_; }
+
+    // Largest payload a single frame may carry.
+    size_t max_payload() const { return cap_ / 2 - FRAME_HEADER_SIZE; }
+
+    // ---- producer ----
+
+    // Copies header + payload into the ring. False if there is not enough
+    // free space right now (call arm_writer() and wait on space_fd()).
+    bool try_write(const FrameHeader& h, const void* payload)
+    {
+        size_t rec = record_size(h.payload_len);
+        if (h.payload_len > max_payload()) return false;
+
+        uint64_t head = hdr_->head.load(std::memory_order_relaxed);
+        size_t off = head & (cap_ - 1);
+        size_t to_end = cap_ - off;
+        size_t need = (to_end < rec) ? to_end + rec : rec;
+
+        if (cap_ - (head - cached_tail_) < need)
+        {
+            cached_tail_ = hdr_->tail.load(std::memory_order_acquire);
+            if (cap_ - (head - cached_tail_) < need) return false;
+        }
+
+        if (to_end < rec)
+        {
+            if (to_end >= FRAME_HEADER_SIZE)
+            {
+                FrameHeader pad = make_header(FRAME_PAD, 0, 0, (uint32_t)(to_end - FRAME_HEADER_SIZE), 0);
+                memcpy(buf_ + off, &pad, FRAME_HEADER_SIZE);
+            }
+            head += to_end;
+            off = 0;
+        }
+
+        memcpy(buf_ + off, &h, FRAME_HEADER_SIZE);
+        if (h.payload_len) memcpy(buf_ + off + FRAME_HEADER_SIZE, payload, h.payload_len);
+
+        hdr_->head.store(head + rec, std::memory_order_release);
+        wake(hdr_->reader_sleeping, data_efd_);
+        return true;
+    }
+
+    // Producer is about to sleep on space_fd(). Returns false if space
+    // appeared meanwhile (retry instead of sleeping).
+    bool arm_writer(uint32_t payload_len)
+    {
+        hdr_->writer_sleeping.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t head = hdr_->head.load(std::memory_order_relaxed);
+        cached_tail_ = hdr_->tail.load(std::memory_order_acquire);
+        if (cap_ - (head - cached_tail_) >= 2 * record_size(payload_len))
+        {
+            hdr_->writer_sleeping.store(0, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    // ---- consumer ----
+
+    // Next frame in place, or false if the ring is empty. The frame stays
+    // valid until release().
+    bool peek(FrameHeader& h, const uint8_t*& payload)
+    {
+        for (;;)
+        {
+            uint64_t tail = hdr_->tail.load(std::memory_order_relaxed);
+            if (cached_head_ == tail)
+            {
+                cached_head_ = hdr_->head.load(std::memory_order_acquire);
+                if (cached_head_ == tail) return false;
+            }
+
+            size_t off = tail & (cap_ - 1);
+            size_t to_end = cap_ - off;
+            if (to_end < FRAME_HEADER_SIZE)
+            {
+                hdr_->tail.store(tail + to_end, std::memory_order_release);
+                continue;
+            }
+
+            memcpy(&h, buf_ + off, FRAME_HEADER_SIZE);
+            if (h.type == FRAME_PAD)
+            {
+                hdr_->tail.store(tail + to_end, std::memory_order_release);
+                continue;
+            }
+
+            payload = buf_ + off + FRAME_HEADER_SIZE;
+            pending_ = record_size(h.payload_len);
+            return true;
+        }
+    }
+
+    void release()
+    {
+        uint64_t tail = hdr_->tail.load(std::memory_order_relaxed);
+        hdr_->tail.store(tail + pending_, std::memory_order_release);
+        pending_ = 0;
+        wake(hdr_->writer_sleeping, space_efd_);
+    }
+
+    // Consumer is about to sleep on data_fd(). Returns false if a frame
+    // arrived meanwhile.
+    bool arm_reader()
+    {
+        hdr_->reader_sleeping.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cached_head_ = hdr_->head.load(std::memory_order_acquire);
+        if (cached_head_ != hdr_->tail.load(std::memory_order_relaxed))
+        {
+            hdr_->reader_sleeping.store(0, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    // Drains an eventfd after waking.
+    static void clear(int efd)
+    {
+        uint64_t v;
+        ssize_t r = ::read(efd, &v, sizeof(v));
+        (void)r;
+    }
+
+private:
+    static size_t record_size(uint32_t payload_len)
+    {
+        return (FRAME_HEADER_SIZE + payload_len + 7) & ~(size_t)7;
+    }
+
+    static void wake(std::atomic<uint32_t>& sleeping, int efd)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed) && sleeping.exchange(0, std::memory_order_acq_rel))
+        {
+            uint64_t one = 1;
+            ssize_t r = ::write(efd, &one, sizeof(one));
+            (void)r;
+        }
+    }
+
+    ShmRingHeader* hdr_ = nullptr;
+    uint8_t* buf_ = nullptr;
+    size_t cap_ = 0;
+    int data_efd_ = -1;
+    int space_efd_ = -1;
+    uint64_t cached_head_ = 0; // consumer's view of head
+    uint64_t cached_tail_ = 0; // producer's view of tail
+    size_t pending_ = 0;
+};
+
+} // namespace ssb
@@ -0,0 +1,232 @@
+// ssb/shm_transport.h
+// Same-host transport: the CMD/DATA sockets are replaced by three SPSC
+// rings (cmd up, cmd down, data up) in one memfd mapping. The server
+// listens on an abstract Unix socket; on accept it creates the memfd and the
+// ring eventfds and passes them to the client with SCM_RIGHTS together with
+// the usual one-byte test code ('L', 'T', 'C'). The Unix socket stays open
+// afterwards only so either side notices when the peer goes away.
+#pragma once
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "shm_ring.h"
+
+namespace ssb
+{
+
+constexpr const char* SHM_DEFAULT_NAME = "ssb-shm";
+constexpr size_t SHM_CMD_RING = 1u << 16;
+constexpr size_t SHM_DATA_RING = 64u << 20;
+
+enum ShmRingIndex { SHM_CMD_UP = 0, SHM_CMD_DOWN = 1, SHM_DATA_UP = 2, SHM_RINGS = 3 };
+
+struct ShmHello
+{
+    char code;
+    uint8_t reserved[7];
+    uint64_t ring_bytes[SHM_RINGS];
+};
+
+// One end of a shared-memory session. The client produces on cmd_up and
+// data_up and consumes cmd_down; the server does the opposite.
+struct ShmSession
+{
+    int sock = -1;
+    int memfd = -1;
+    int efd[SHM_RINGS * 2] = { -1, -1, -1, -1, -1, -1 }; // data, space per ring
+    void* base = nullptr;
+    size_t size = 0;
+    char code = 0;
+    ShmRing ring[SHM_RINGS];
+
+    ShmSession() = default;
+    ShmSession(const ShmSession&) = delete;
+    ShmSession& operator=(const ShmSession&) = delete;
+    ~ShmSession() { close_all(); }
+
+    void close_all()
+    {
+        if (base) { munmap(base, size); base = nullptr; }
+        for (int& fd : efd)
+            if (fd >= 0) { close(fd); fd = -1; }
+        if (memfd >= 0) { close(memfd); memfd = -1; }
+        if (sock >= 0) { close(sock); sock = -1; }
+    }
+
+    bool map(const ShmHello& hello)
+    {
+        size = 0;
+        for (int i = 0; i < SHM_RINGS; ++i) size += ShmRing::bytes_for(hello.ring_bytes[i]);
+        base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, memfd, 0);
+        if (base == MAP_FAILED) { base = nullptr; return false; }
+        return true;
+    }
+
+    void attach(const ShmHello& hello)
+    {
+        uint8_t* p = (uint8_t*)base;
+        for (int i = 0; i < SHM_RINGS; ++i)
+        {
+            ring[i].attach(p, efd[i * 2], efd[i * 2 + 1]);
+            p += ShmRing::bytes_for(hello.ring_bytes[i]);
+        }
+    }
+};
+
+inline sockaddr_un shm_address(const char* name, socklen_t& len)
+{
+    // abstract namespace: no file to clean up after a crash
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    size_t n = strnlen(name, sizeof(addr.sun_path) - 2);
+    memcpy(addr.sun_path + 1, name, n);
+    len = (socklen_t)(offsetof(sockaddr_un, sun_path) + 1 + n);
+    return addr;
+}
+
+inline int shm_listen(const char* name = SHM_DEFAULT_NAME)
+{
+    int s = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (s < 0) return -1;
+
+    socklen_t len;
+    sockaddr_un addr = shm_address(name, len);
+    if (bind(s, (sockaddr*)&addr, len) != 0 || listen(s, 1) != 0)
+    {
+        close(s);
+        return -1;
+    }
+    return s;
+}
+
+// Server side: accepts one client, builds the rings and sends the code.
+inline bool shm_accept(int listen_fd, char code, ShmSession& out,
+    size_t cmd_ring = SHM_CMD_RING, size_t data_ring = SHM_DATA_RING)
+{
+    out.close_all();
+    out.code = code;
+
+    out.sock = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (out.sock < 0) return false;
+
+    ShmHello hello{};
+    hello.code = code;
+    hello.ring_bytes[SHM_CMD_UP] = cmd_ring;
+    hello.ring_bytes[SHM_CMD_DOWN] = cmd_ring;
+    hello.ring_bytes[SHM_DATA_UP] = data_ring;
+
+    out.memfd = memfd_create("ssb-shm", MFD_CLOEXEC);
+    size_t total = 0;
+    for (int i = 0; i < SHM_RINGS; ++i) total += ShmRing::bytes_for(hello.ring_bytes[i]);
+    if (out.memfd < 0 || ftruncate(out.memfd, (off_t)total) != 0 || !out.map(hello))
+    {
+        out.close_all();
+        return false;
+    }
+
+    uint8_t* p = (uint8_t*)out.base;
+    for (int i = 0; i < SHM_RINGS; ++i)
+    {
+        ShmRing::format(p, hello.ring_bytes[i]);
+        p += ShmRing::bytes_for(hello.ring_bytes[i]);
+    }
+    for (int& fd : out.efd)
+    {
+        fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (fd < 0) { out.close_all(); return false; }
+    }
+    out.attach(hello);
+
+    int fds[1 + SHM_RINGS * 2];
+    fds[0] = out.memfd;
+    memcpy(fds + 1, out.efd, sizeof(out.efd));
+
+    alignas(cmsghdr) char ctrl[CMSG_SPACE(sizeof(fds))] = {};
+    iovec iov{ &hello, sizeof(hello) };
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+    cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cm), fds, sizeof(fds));
+
+    if (sendmsg(out.sock, &msg, MSG_NOSIGNAL) != (ssize_t)sizeof(hello))
+    {
+        out.close_all();
+        return false;
+    }
+    return true;
+}
+
+// Client side: connects, waits up to timeout_ms for the code and the fds,
+// and maps the rings.
+inline bool shm_connect(ShmSession& out, const char* name = SHM_DEFAULT_NAME, int timeout_ms = 5000)
+{
+    out.close_all();
+
+    out.sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (out.sock < 0) return false;
+
+    socklen_t len;
+    sockaddr_un addr = shm_address(name, len);
+    if (connect(out.sock, (sockaddr*)&addr, len) != 0)
+    {
+        out.close_all();
+        return false;
+    }
+
+    pollfd pfd{ out.sock, POLLIN, 0 };
+    int r;
+    do { r = poll(&pfd, 1, timeout_ms); } while (r < 0 && errno == EINTR);
+    if (r != 1)
+    {
+        out.close_all();
+        return false;
+    }
+
+    ShmHello hello{};
+    int fds[1 + SHM_RINGS * 2];
+    alignas(cmsghdr) char ctrl[CMSG_SPACE(sizeof(fds))] = {};
+    iovec iov{ &hello, sizeof(hello) };
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+
+    ssize_t n = recvmsg(out.sock, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+    cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+    if (n != (ssize_t)sizeof(hello) || !cm || cm->cmsg_type != SCM_RIGHTS ||
+        cm->cmsg_len != CMSG_LEN(sizeof(fds)))
+    {
+        out.close_all();
+        return false;
+    }
+    memcpy(fds, CMSG_DATA(cm), sizeof(fds));
+    out.memfd = fds[0];
+    memcpy(out.efd, fds + 1, sizeof(out.efd));
+    out.code = hello.code;
+
+    if (!out.map(hello))
+    {
+        out.close_all();
+        return false;
+    }
+    out.attach(hello);
+    return true;
+}
+
+} // namespace ssb
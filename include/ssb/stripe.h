@@ -0,0 +1,657 @@
+// ssb/stripe.h
+// Striped bulk mode: one logical stream of large messages spread over K
+// TCP data connections, each driven by its own (optionally pinned) thread,
+// so throughput is no longer capped by what one socket and one core move.
+//
+// Handshake (test code 'S'): after the server's code byte the client sends
+// the number of connections it wants (1 byte); the server answers with a
+// StripeAccept carrying the count it grants and a session token. The
+// client then opens that many connections to the data port and starts
+// each with a StripeHello naming its index, so accept order is irrelevant
+// and stray connections are refused.
+//
+// A message is cut into chunks that go out round-robin over the lanes,
+// each as one frame with the layout fragment.h uses:
+//
+//   [FrameHeader 32, FRAME_FLAG_FRAGMENT][FragmentHeader 16][chunk]
+//
+// stream_id and seq name the message, FragmentHeader the chunk's offset.
+// The receiver reads every chunk straight into the message buffer at its
+// offset (no staging copy) and delivers whole messages in seq order. It
+// keeps `window` messages in flight; a lane that runs ahead waits, which
+// backs up into TCP flow control. Within one lane chunks are in message
+// order, so a waiting lane never holds up the message it waits for.
+#pragma once
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "affinity.h"
+#include "clock.h"
+#include "fragment.h"
+#include "frame.h"
+#include "frame_pool.h"
+#include "metrics.h"
+#include "session.h"
+
+namespace ssb
+{
+
+constexpr uint32_t STRIPE_MAGIC = 0x4B425353; // "SSBK"
+constexpr uint32_t STRIPE_MAX = 8;
+constexpr size_t STRIPE_CHUNK = 256u << 10;
+constexpr size_t STRIPE_CHUNK_HEADER = FRAME_HEADER_SIZE + FRAGMENT_HEADER_SIZE;
+
+struct StripeAccept
+{
+    uint32_t magic;
+    uint16_t count;     // connections granted, 1..STRIPE_MAX
+    uint16_t reserved;
+    uint64_t token;
+};
+
+struct StripeHello
+{
+    uint32_t magic;
+    uint16_t index;
+    uint16_t count;
+    uint64_t token;
+};
+
+static_assert(sizeof(StripeAccept) == 16 && sizeof(StripeHello) == 16, "stripe handshake records are 16 bytes");
+
+struct StripeConfig
+{
+    size_t chunk = STRIPE_CHUNK;
+    int first_cpu = -1;          // >= 0: lane i is pinned to nth_cpu(first_cpu + i)
+    uint32_t queue_depth = 16;   // sender: chunks queued per lane
+    uint32_t window = 8;         // receiver: messages being reassembled at once
+    StatsPage* stats = nullptr;  // lanes register as "stripe<i>" when set
+};
+
+namespace stripe_detail
+{
+
+// Full read/write on a socket in either mode, waiting up to timeout_ms
+// per step (-1: forever).
+inline bool read_exact(int fd, void* buf, size_t len, int timeout_ms)
+{
+    uint8_t* p = (uint8_t*)buf;
+    while (len)
+    {
+        ssize_t r = ::recv(fd, p, len, 0);
+        if (r > 0) { p += r; len -= (size_t)r; continue; }
+        if (r == 0) return false;
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+        pollfd pfd{ fd, POLLIN, 0 };
+        if (poll(&pfd, 1, timeout_ms) <= 0) return false;
+    }
+    return true;
+}
+
+inline bool write_exact(int fd, const void* buf, size_t len, int timeout_ms)
+{
+    const uint8_t* p = (const uint8_t*)buf;
+    while (len)
+    {
+        ssize_t r = ::send(fd, p, len, MSG_NOSIGNAL);
+        if (r > 0) { p += r; len -= (size_t)r; continue; }
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0 && errno != EAGAIN && errno != EWOULDBLOCK) return false;
+        pollfd pfd{ fd, POLLOUT, 0 };
+        if (poll(&pfd, 1, timeout_ms) <= 0) return false;
+    }
+    return true;
+}
+
+inline bool set_blocking(int fd)
+{
+    int fl = fcntl(fd, F_GETFL, 0);
+    return fl >= 0 && fcntl(fd, F_SETFL, fl & ~O_NONBLOCK) == 0;
+}
+
+inline ThreadMetrics* register_lane(StatsPage* page, uint32_t i)
+{
+    if (!page) return nullptr;
+    char name[16];
+    snprintf(name, sizeof(name), "stripe%u", i);
+    return page->register_thread(name);
+}
+
+} // namespace stripe_detail
+
+struct StripedSession
+{
+    int cmd = -1;
+    int data[STRIPE_MAX];
+    uint32_t count = 0;
+    char code = 0;
+    uint64_t token = 0;
+
+    StripedSession() { for (int& d : data) d = -1; }
+    StripedSession(const StripedSession&) = delete;
+    StripedSession& operator=(const StripedSession&) = delete;
+    ~StripedSession() { close_all(); }
+
+    void close_all()
+    {
+        if (cmd >= 0) { close(cmd); cmd = -1; }
+        for (int& d : data)
+            if (d >= 0) { close(d); d = -1; }
+        count = 0;
+    }
+};
+
+// Client side of the 'S' handshake: asks for `want` data connections and
+// opens as many as the server grants. False if the server does not offer
+// 'S' (out.code tells what it offered instead) or any step fails.
+inline bool open_striped_session(const Endpoint& ep, uint32_t want, StripedSession& out, int timeout_ms = 5000)
+{
+    using namespace stripe_detail;
+    out.close_all();
+    out.cmd = connect_tcp(ep.host, ep.cmd_port);
+    if (out.cmd < 0) return false;
+    if (!read_exact(out.cmd, &out.code, 1, timeout_ms) || out.code != 'S')
+        return false;
+
+    uint8_t k = (uint8_t)(want < 1 ? 1 : want > STRIPE_MAX ? STRIPE_MAX : want);
+    StripeAccept acc;
+    if (!write_exact(out.cmd, &k, 1, timeout_ms) || !read_exact(out.cmd, &acc, sizeof(acc), timeout_ms) ||
+        acc.magic != STRIPE_MAGIC || acc.count < 1 || acc.count > STRIPE_MAX)
+    {
+        out.close_all();
+        return false;
+    }
+    out.token = acc.token;
+    for (uint16_t i = 0; i < acc.count; ++i)
+    {
+        int fd = connect_tcp(ep.host, ep.data_port);
+        StripeHello hello{ STRIPE_MAGIC, i, acc.count, acc.token };
+        if (fd < 0 || !write_exact(fd, &hello, sizeof(hello), timeout_ms))
+        {
+            if (fd >= 0) close(fd);
+            out.close_all();
+            return false;
+        }
+        out.data[i] = fd;
+    }
+    out.count = acc.count;
+    return true;
+}
+
+// Server side, after 'S' went out on `cmd`: reads the request, grants up
+// to `max_count` connections and accepts them from `listen_fd` into
+// fds[index]. Returns the count, or 0 on failure (nothing left open).
+inline uint32_t accept_stripes(int cmd, int listen_fd, int* fds, uint32_t max_count = STRIPE_MAX,
+    int timeout_ms = 5000)
+{
+    using namespace stripe_detail;
+    uint8_t want = 0;
+    if (!read_exact(cmd, &want, 1, timeout_ms)) return 0;
+    uint32_t k = want < 1 ? 1 : want;
+    if (k > max_count) k = max_count;
+    if (k > STRIPE_MAX) k = STRIPE_MAX;
+
+    StripeAccept acc{ STRIPE_MAGIC, (uint16_t)k, 0, mono_ns() * 0x9E3779B97F4A7C15ull ^ (uint64_t)getpid() };
+    if (!write_exact(cmd, &acc, sizeof(acc), timeout_ms)) return 0;
+
+    for (uint32_t i = 0; i < k; ++i) fds[i] = -1;
+    uint32_t got = 0;
+    while (got < k)
+    {
+        pollfd pfd{ listen_fd, POLLIN, 0 };
+        int fd = poll(&pfd, 1, timeout_ms) == 1 ? accept(listen_fd, nullptr, nullptr) : -1;
+        StripeHello hello;
+        if (fd < 0) break;
+        if (!read_exact(fd, &hello, sizeof(hello), timeout_ms) || hello.magic != STRIPE_MAGIC ||
+            hello.token != acc.token || hello.count != k || hello.index >= k || fds[hello.index] >= 0)
+        {
+            close(fd); // not ours: keep waiting for the real ones
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        fds[hello.index] = fd;
+        ++got;
+    }
+    if (got == k) return k;
+    for (uint32_t i = 0; i < k; ++i)
+        if (fds[i] >= 0) { close(fds[i]); fds[i] = -1; }
+    return 0;
+}
+
+// Sends messages over the lanes. The sockets stay owned by the caller;
+// the lane threads switch them to blocking mode.
+class StripeSender
+{
+public:
+    StripeSender(const int* fds, uint32_t count, const StripeConfig& cfg = StripeConfig())
+        : cfg_(cfg), chunk_(cfg.chunk ? cfg.chunk : STRIPE_CHUNK)
+    {
+        if (count > STRIPE_MAX) count = STRIPE_MAX;
+        for (uint32_t i = 0; i < count; ++i)
+            lanes_.emplace_back(new Lane(fds[i], cfg_.queue_depth ? cfg_.queue_depth : 1));
+        for (uint32_t i = 0; i < count; ++i)
+            lanes_[i]->thread = std::thread([this, i]() { lane_loop(i); });
+    }
+
+    ~StripeSender() { stop(); }
+
+    StripeSender(const StripeSender&) = delete;
+    StripeSender& operator=(const StripeSender&) = delete;
+
+    uint32_t lanes() const { return (uint32_t)lanes_.size(); }
+
+    // Queues msg.size() bytes as one message on `stream`. The buffer is
+    // shared by its chunks and returns to its pool after the last one is
+    // written. Blocks while lane queues are full; false once a lane failed.
+    bool send(uint32_t stream, FrameRef msg)
+    {
+        if (lanes_.empty() || failed_.load(std::memory_order_relaxed)) return false;
+        const uint32_t total = (uint32_t)msg.size();
+        const uint32_t n = total ? (uint32_t)((total + chunk_ - 1) / chunk_) : 1;
+        const uint64_t seq = seq_++;
+        const uint64_t ts = mono_ns();
+
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            uint32_t off = (uint32_t)(i * chunk_);
+            uint32_t len = (uint32_t)std::min<size_t>(chunk_, total - off);
+
+            Chunk c;
+            c.h = make_header(FRAME_DATA, stream, seq, (uint32_t)FRAGMENT_HEADER_SIZE + len, ts);
+            c.h.flags |= FRAME_FLAG_FRAGMENT;
+            c.f = FragmentHeader{ total, off, (uint16_t)std::min<uint32_t>(i, 0xFFFF), (uint16_t)std::min<uint32_t>(n, 0xFFFF), 0 };
+            c.len = len;
+            c.msg = (i + 1 == n) ? std::move(msg) : msg.share();
+            if (!push(*lanes_[next_lane_++ % lanes_.size()], std::move(c))) return false;
+        }
+        ++messages_;
+        return true;
+    }
+
+    // Waits until every queued chunk is written (or a lane failed).
+    bool flush()
+    {
+        for (auto& l : lanes_)
+        {
+            std::unique_lock<std::mutex> lock(l->m);
+            l->cv.wait(lock, [&]() { return (l->head == l->tail && !l->busy) || l->dead; });
+        }
+        return !failed_.load();
+    }
+
+    // Stops the lanes after what is queued has gone out.
+    void stop()
+    {
+        for (auto& l : lanes_)
+        {
+            std::lock_guard<std::mutex> lock(l->m);
+            l->stop = true;
+            l->cv.notify_all();
+        }
+        for (auto& l : lanes_)
+            if (l->thread.joinable()) l->thread.join();
+    }
+
+    bool failed() const { return failed_.load(); }
+    uint64_t messages() const { return messages_; }
+    uint64_t bytes() const
+    {
+        uint64_t b = 0;
+        for (auto& l : lanes_) b += l->bytes.load(std::memory_order_relaxed);
+        return b;
+    }
+    uint64_t syscalls() const
+    {
+        uint64_t n = 0;
+        for (auto& l : lanes_) n += l->syscalls.load(std::memory_order_relaxed);
+        return n;
+    }
+
+private:
+    struct Chunk
+    {
+        FrameHeader h;
+        FragmentHeader f;
+        FrameRef msg;
+        uint32_t len = 0;
+    };
+
+    struct Lane
+    {
+        Lane(int f, uint32_t depth) : fd(f), ring(depth) {}
+        int fd;
+        std::thread thread;
+        std::mutex m;
+        std::condition_variable cv;
+        std::vector<Chunk> ring;
+        size_t head = 0, tail = 0;   // monotonically increasing
+        bool busy = false;           // a popped chunk is being written
+        bool stop = false;
+        bool dead = false;
+        std::atomic<uint64_t> bytes{ 0 };
+        std::atomic<uint64_t> syscalls{ 0 };
+    };
+
+    bool push(Lane& l, Chunk&& c)
+    {
+        std::unique_lock<std::mutex> lock(l.m);
+        l.cv.wait(lock, [&]() { return l.tail - l.head < l.ring.size() || l.dead; });
+        if (l.dead) return false;
+        l.ring[l.tail++ % l.ring.size()] = std::move(c);
+        l.cv.notify_all();
+        return true;
+    }
+
+    void lane_loop(uint32_t i)
+    {
+        Lane& l = *lanes_[i];
+        if (cfg_.first_cpu >= 0) pin_current_thread(nth_cpu(cfg_.first_cpu + (int)i));
+        ThreadMetrics* m = stripe_detail::register_lane(cfg_.stats, i);
+        stripe_detail::set_blocking(l.fd);
+
+        for (;;)
+        {
+            Chunk c;
+            {
+                std::unique_lock<std::mutex> lock(l.m);
+                l.busy = false;
+                l.cv.notify_all();
+                l.cv.wait(lock, [&]() { return l.head != l.tail || l.stop; });
+                if (l.head == l.tail) break;
+                c = std::move(l.ring[l.head++ % l.ring.size()]);
+                l.busy = true;
+                l.cv.notify_all();
+            }
+
+            iovec iov[3] = {
+                { &c.h, FRAME_HEADER_SIZE },
+                { &c.f, FRAGMENT_HEADER_SIZE },
+                { c.msg.data() + c.f.offset, c.len },
+            };
+            size_t left = STRIPE_CHUNK_HEADER + c.len;
+            int idx = 0;
+            while (left)
+            {
+                msghdr mh{};
+                mh.msg_iov = iov + idx;
+                mh.msg_iovlen = 3 - idx;
+                ssize_t r = sendmsg(l.fd, &mh, MSG_NOSIGNAL);
+                l.syscalls.fetch_add(1, std::memory_order_relaxed);
+                if (m) m->add(METRIC_SYSCALLS);
+                if (r < 0 && errno == EINTR) continue;
+                if (r <= 0)
+                {
+                    fail(l);
+                    break;
+                }
+                left -= (size_t)r;
+                while (r > 0 && idx < 3)
+                {
+                    if ((size_t)r >= iov[idx].iov_len) { r -= (ssize_t)iov[idx].iov_len; ++idx; }
+                    else
+                    {
+                        iov[idx].iov_base = (uint8_t*)iov[idx].iov_base + r;
+                        iov[idx].iov_len -= (size_t)r;
+                        r = 0;
+                    }
+                }
+            }
+            if (!left)
+            {
+                l.bytes.fetch_add(STRIPE_CHUNK_HEADER + c.len, std::memory_order_relaxed);
+                if (m)
+                {
+                    m->add(METRIC_BYTES_TX, STRIPE_CHUNK_HEADER + c.len);
+                    m->add(METRIC_FRAMES_TX);
+                }
+            }
+            if (l.dead) break;
+        }
+
+        {
+            // drop whatever is left so the buffers go back to their pools
+            std::lock_guard<std::mutex> lock(l.m);
+            while (l.head != l.tail) l.ring[l.head++ % l.ring.size()] = Chunk();
+            l.busy = false;
+            l.dead = true;
+            l.cv.notify_all();
+        }
+        if (m) cfg_.stats->release(m);
+    }
+
+    void fail(Lane& l)
+    {
+        failed_ = true;
+        std::lock_guard<std::mutex> lock(l.m);
+        l.dead = true;
+        l.cv.notify_all();
+    }
+
+    StripeConfig cfg_;
+    size_t chunk_;
+    std::vector<std::unique_ptr<Lane>> lanes_;
+    uint64_t seq_ = 0;
+    uint64_t next_lane_ = 0;
+    uint64_t messages_ = 0;
+    std::atomic<bool> failed_{ false };
+};
+
+// Receives striped messages and hands them over whole and in seq order:
+// deliver(stream, seq, data, len) runs on a lane thread with the message
+// table locked, so keep it short; `data` is only valid during the call.
+class StripeReceiver
+{
+public:
+    using Deliver = std::function<void(uint32_t stream, uint64_t seq, const uint8_t* data, size_t len)>;
+
+    StripeReceiver(const int* fds, uint32_t count, size_t max_message, Deliver deliver,
+        const StripeConfig& cfg = StripeConfig())
+        : cfg_(cfg), max_message_(max_message), deliver_(std::move(deliver)),
+          slots_(cfg.window ? cfg.window : 1)
+    {
+        if (count > STRIPE_MAX) count = STRIPE_MAX;
+        for (uint32_t i = 0; i < count; ++i) fds_.push_back(fds[i]);
+        live_ = count;
+        for (uint32_t i = 0; i < count; ++i) threads_.emplace_back([this, i]() { lane_loop(i); });
+    }
+
+    ~StripeReceiver()
+    {
+        stop();
+        join();
+    }
+
+    StripeReceiver(const StripeReceiver&) = delete;
+    StripeReceiver& operator=(const StripeReceiver&) = delete;
+
+    // Returns once every lane has hit end of stream, an error, or stop().
+    // A lane that fails mid-stream fails the whole stream: the others stop
+    // at their next chunk instead of waiting on messages that cannot finish.
+    void join()
+    {
+        for (auto& t : threads_)
+            if (t.joinable()) t.join();
+    }
+
+    // Wakes lanes waiting for a free slot; shut the sockets down as well
+    // to unblock lanes sitting in recv().
+    void stop()
+    {
+        std::lock_guard<std::mutex> lock(m_);
+        stop_ = true;
+        cv_.notify_all();
+    }
+
+    uint64_t messages() const { return messages_.load(); }
+    uint64_t bytes() const { return bytes_.load(); }
+    uint64_t errors() const { return errors_.load(); }  // malformed or cut-off chunks, or a stuck window
+    bool failed() const
+    {
+        std::lock_guard<std::mutex> lock(m_);
+        return failed_;
+    }
+
+private:
+    enum class State { Free, Filling };
+
+    struct Slot
+    {
+        State state = State::Free;
+        uint64_t seq = 0;
+        uint32_t stream = 0;
+        size_t total = 0;
+        size_t got = 0;
+        std::vector<uint8_t> buf;
+    };
+
+    // The slot for `seq`, waiting while the window is full. Null after
+    // stop() or a failure; a chunk that cannot be placed fails the stream,
+    // and so does waiting when every running lane is already waiting here.
+    Slot* claim(const FrameHeader& h, const FragmentHeader& f)
+    {
+        std::unique_lock<std::mutex> lock(m_);
+        for (;;)
+        {
+            if (stop_ || failed_) return nullptr;
+            if (h.seq < next_) return fail_locked();
+            Slot& s = slots_[h.seq % slots_.size()];
+            if (h.seq < next_ + slots_.size())
+            {
+                if (s.state == State::Filling && s.seq == h.seq)
+                    return s.total == f.frame_len ? &s : fail_locked();
+                if (s.state == State::Free)
+                {
+                    s.state = State::Filling;
+                    s.seq = h.seq;
+                    s.stream = h.stream_id;
+                    s.total = f.frame_len;
+                    s.got = 0;
+                    if (s.buf.size() < s.total) s.buf.resize(s.total);
+                    return &s;
+                }
+            }
+            if (waiting_ + 1 >= live_) return fail_locked();  // nobody left to free a slot
+            ++waiting_;
+            cv_.wait(lock);
+            --waiting_;
+        }
+    }
+
+    Slot* fail_locked()
+    {
+        ++errors_;
+        failed_ = true;
+        cv_.notify_all();
+        return nullptr;
+    }
+
+    // Every lane leaves through here; `failed` when it gave up mid-stream.
+    void lane_done(bool failed)
+    {
+        std::lock_guard<std::mutex> lock(m_);
+        --live_;
+        if (failed && !stop_ && !failed_) fail_locked();
+        cv_.notify_all();
+    }
+
+    // Counts `n` bytes into `s` and delivers every message that is now
+    // complete and next in line.
+    void received(Slot& s, size_t n)
+    {
+        std::lock_guard<std::mutex> lock(m_);
+        s.got += n;
+        bool freed = false;
+        for (;;)
+        {
+            Slot& head = slots_[next_ % slots_.size()];
+            if (head.state != State::Filling || head.seq != next_ || head.got < head.total) break;
+            deliver_(head.stream, head.seq, head.buf.data(), head.total);
+            messages_.fetch_add(1, std::memory_order_relaxed);
+            bytes_.fetch_add(head.total, std::memory_order_relaxed);
+            head.state = State::Free;
+            ++next_;
+            freed = true;
+        }
+        if (freed) cv_.notify_all();
+    }
+
+    void lane_loop(uint32_t i)
+    {
+        using namespace stripe_detail;
+        const int fd = fds_[i];
+        if (cfg_.first_cpu >= 0) pin_current_thread(nth_cpu(cfg_.first_cpu + (int)i));
+        ThreadMetrics* m = register_lane(cfg_.stats, i);
+        set_blocking(fd);
+
+        uint8_t hdr[STRIPE_CHUNK_HEADER];
+        bool failed = false;
+        for (;;)
+        {
+            if (!read_exact(fd, hdr, sizeof(hdr), -1)) break;
+            FrameHeader h;
+            FragmentHeader f;
+            memcpy(&h, hdr, FRAME_HEADER_SIZE);
+            memcpy(&f, hdr + FRAME_HEADER_SIZE, FRAGMENT_HEADER_SIZE);
+            size_t len = h.payload_len >= FRAGMENT_HEADER_SIZE ? h.payload_len - FRAGMENT_HEADER_SIZE : 0;
+            if (!header_valid(h) || !(h.flags & FRAME_FLAG_FRAGMENT) || h.payload_len < FRAGMENT_HEADER_SIZE ||
+                f.frame_len > max_message_ || (uint64_t)f.offset + len > f.frame_len)
+            {
+                failed = true;
+                break;
+            }
+
+            Slot* s = claim(h, f);
+            if (!s) break;
+            if (len && !read_exact(fd, s->buf.data() + f.offset, len, -1)) // in place
+            {
+                failed = true;
+                break;
+            }
+            if (m)
+            {
+                m->add(METRIC_BYTES_RX, STRIPE_CHUNK_HEADER + len);
+                m->add(METRIC_FRAMES_RX);
+                m->add(METRIC_SYSCALLS, 2);
+            }
+            received(*s, len);
+        }
+        lane_done(failed);
+        if (m) cfg_.stats->release(m);
+    }
+
+    StripeConfig cfg_;
+    size_t max_message_;
+    Deliver deliver_;
+    std::vector<int> fds_;
+    std::vector<std::thread> threads_;
+
+    mutable std::mutex m_;
+    std::condition_variable cv_;
+    std::vector<Slot> slots_;
+    uint64_t next_ = 0;
+    uint32_t live_ = 0;     // lanes still running
+    uint32_t waiting_ = 0;  // of those, waiting in claim()
+    bool stop_ = false;
+    bool failed_ = false;
+
+    std::atomic<uint64_t> messages_{ 0 };
+    std::atomic<uint64_t> bytes_{ 0 };
+    std::atomic<uint64_t> errors_{ 0 };
+};
+
+} // namespace ssb
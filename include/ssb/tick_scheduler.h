@@ -0,0 +1,165 @@
+// ssb/tick_scheduler.h
+// Fixed-rate send pacing on absolute deadlines (20 Hz - 10 kHz). Each
+// wait() sleeps with the OS until `spin` ns before the tick, then
+// busy-spins the rest, so the caller wakes within a few µs of the tick
+// instead of at scheduler granularity. How late every wake-up was is
+// recorded in a Histogram (ns); ticks that are already a full period
+// behind are skipped rather than bursted.
+//
+// Linux uses clock_nanosleep(TIMER_ABSTIME) on CLOCK_MONOTONIC. Other
+// platforms fall back to std::this_thread::sleep_for on steady_clock, or
+// to a sleeper the caller installs with set_sleeper(); the Unreal example
+// installs a high-resolution waitable timer on Windows, so no OS headers
+// come in through here. calibrate() never lets the spin exceed half a
+// period, so a coarse sleep costs precision, not a core spinning through
+// every tick.
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <time.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "ssb/histogram.h"
+
+namespace ssb
+{
+
+class TickScheduler
+{
+public:
+    static constexpr uint64_t DEFAULT_SPIN_NS = 50000;
+
+    // Sleeps until `t_ns` (now() timebase); may wake early, never needs to
+    // be exact, the spin covers the rest.
+    using Sleeper = void (*)(void* ctx, uint64_t t_ns);
+
+    explicit TickScheduler(uint64_t period_ns, uint64_t spin_ns = DEFAULT_SPIN_NS)
+        : period_(period_ns ? period_ns : 1), spin_(spin_ns)
+    {
+    }
+
+    TickScheduler(const TickScheduler&) = delete;
+    TickScheduler& operator=(const TickScheduler&) = delete;
+
+    static uint64_t now()
+    {
+#if defined(__linux__)
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#else
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    // First tick at `first_ns` (now() timebase), default one period from now.
+    void start(uint64_t first_ns = 0)
+    {
+        next_ = first_ns ? first_ns : now() + period_;
+    }
+
+    // Blocks until the next tick and returns its intended time. The
+    // difference to now() at return is the send miss.
+    uint64_t wait()
+    {
+        if (next_ == 0) start();
+        uint64_t target = next_;
+
+        sleep_until(target > spin_ ? target - spin_ : 0);
+        uint64_t t = now();
+        while (t < target)
+        {
+            cpu_relax();
+            t = now();
+        }
+        misses_.record(t - target);
+
+        next_ = target + period_;
+        if (t >= next_)
+        {
+            // a full period late: drop the missed ticks, stay on the grid
+            uint64_t behind = (t - target) / period_;
+            skipped_ += behind;
+            next_ = target + (behind + 1) * period_;
+        }
+        return target;
+    }
+
+    // Measures how late the OS sleep wakes up over `samples` short sleeps
+    // and sets the spin to the p99 overshoot plus margin, at most half a
+    // period. Returns the spin.
+    uint64_t calibrate(int samples = 200, uint64_t sleep_ns = 200000)
+    {
+        Histogram over;
+        for (int i = 0; i < samples; ++i)
+        {
+            uint64_t target = now() + sleep_ns;
+            sleep_until(target);
+            uint64_t t = now();
+            over.record(t > target ? t - target : 0);
+        }
+        spin_ = std::max<uint64_t>(over.percentile(99.0) + over.percentile(99.0) / 2, 5000);
+        spin_ = std::min<uint64_t>(spin_, period_ / 2);
+        return spin_;
+    }
+
+    // Replaces the OS sleep; nullptr restores it. Call calibrate() after.
+    void set_sleeper(Sleeper fn, void* ctx)
+    {
+        sleeper_ = fn;
+        sleeper_ctx_ = ctx;
+    }
+
+    uint64_t period() const { return period_; }
+    uint64_t spin() const { return spin_; }
+    uint64_t skipped() const { return skipped_; }
+    Histogram& misses() { return misses_; }
+
+private:
+    void sleep_until(uint64_t t)
+    {
+        if (sleeper_)
+        {
+            sleeper_(sleeper_ctx_, t);
+            return;
+        }
+#if defined(__linux__)
+        timespec ts{ (time_t)(t / 1000000000ull), (long)(t % 1000000000ull) };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+#else
+        uint64_t n = now();
+        if (t > n) std::this_thread::sleep_for(std::chrono::nanoseconds(t - n));
+#endif
+    }
+
+    static void cpu_relax()
+    {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+    uint64_t period_;
+    uint64_t spin_;
+    uint64_t next_ = 0;
+    uint64_t skipped_ = 0;
+    Histogram misses_;
+    Sleeper sleeper_ = nullptr;
+    void* sleeper_ctx_ = nullptr;
+};
+
+} // namespace ssb
@@ -0,0 +1,65 @@
+// ssb/udp.h
+// UDP socket helpers for the latest-only control path.
+#pragma once
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+namespace ssb
+{
+
+inline bool make_addr(const char* host, int port, sockaddr_in& out)
+{
+    out = sockaddr_in{};
+    out.sin_family = AF_INET;
+    out.sin_port = htons(port);
+    return inet_pton(AF_INET, host, &out.sin_addr) == 1;
+}
+
+// port 0 binds an ephemeral port; see bound_port().
+inline int bind_udp(const char* host, int port)
+{
+    int s = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP);
+    if (s < 0) return -1;
+
+    sockaddr_in addr;
+    if (!make_addr(host, port, addr) || bind(s, (sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+        close(s);
+        return -1;
+    }
+    return s;
+}
+
+inline int udp_socket()
+{
+    return socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP);
+}
+
+// Grows SO_RCVBUF/SO_SNDBUF (0 = leave alone). Tries the *FORCE variants
+// first so root can exceed net.core.rmem_max/wmem_max. Returns the
+// effective receive buffer size.
+inline int set_socket_buffers(int fd, int rcvbuf, int sndbuf)
+{
+    if (rcvbuf > 0 && setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) != 0)
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    if (sndbuf > 0 && setsockopt(fd, SOL_SOCKET, SO_SNDBUFFORCE, &sndbuf, sizeof(sndbuf)) != 0)
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+    int eff = 0;
+    socklen_t len = sizeof(eff);
+    getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &eff, &len);
+    return eff;
+}
+
+inline int bound_port(int fd)
+{
+    sockaddr_in addr{};
+    socklen_t len = sizeof(addr);
+    if (getsockname(fd, (sockaddr*)&addr, &len) != 0) return -1;
+    return ntohs(addr.sin_port);
+}
+
+} // namespace ssb
@@ -0,0 +1,345 @@
+// ssb/uring.h
+// Minimal io_uring wrapper on the raw syscalls (no liburing dependency):
+// ring setup with optional SQPOLL, fixed (registered) buffers and files,
+// batched submission, and provided buffers (ring-mapped, with a legacy
+// fallback) for multishot receive.
+// Every io_uring_enter() goes through enter() and is counted, so callers
+// can report syscalls per GB next to the plain socket path.
+#pragma once
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace ssb
+{
+
+class Uring
+{
+public:
+    Uring() = default;
+    Uring(const Uring&) = delete;
+    Uring& operator=(const Uring&) = delete;
+    ~Uring() { destroy(); }
+
+    // entries: SQ size (power of two). sqpoll: kernel thread polls the SQ,
+    // so submissions need no syscall while it is awake.
+    bool init(unsigned entries, bool sqpoll = false, unsigned sqpoll_idle_ms = 1000)
+    {
+        io_uring_params p{};
+        if (sqpoll)
+        {
+            p.flags |= IORING_SETUP_SQPOLL;
+            p.sq_thread_idle = sqpoll_idle_ms;
+        }
+        fd_ = (int)syscall(__NR_io_uring_setup, entries, &p);
+        if (fd_ < 0) return false;
+        sqpoll_ = sqpoll;
+
+        sq_len_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_len_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        single_mmap_ = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap_)
+            sq_len_ = cq_len_ = (sq_len_ > cq_len_) ? sq_len_ : cq_len_;
+
+        sq_ptr_ = mmap(nullptr, sq_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        if (sq_ptr_ == MAP_FAILED) { sq_ptr_ = nullptr; destroy(); return false; }
+        cq_ptr_ = single_mmap_ ? sq_ptr_
+            : mmap(nullptr, cq_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+        if (cq_ptr_ == MAP_FAILED) { cq_ptr_ = nullptr; destroy(); return false; }
+
+        sqes_len_ = p.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = (io_uring_sqe*)mmap(nullptr, sqes_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+        if (sqes_ == MAP_FAILED) { sqes_ = nullptr; destroy(); return false; }
+
+        uint8_t* sq = (uint8_t*)sq_ptr_;
+        sq_head_ = (unsigned*)(sq + p.sq_off.head);
+        sq_tail_ = (unsigned*)(sq + p.sq_off.tail);
+        sq_mask_ = *(unsigned*)(sq + p.sq_off.ring_mask);
+        sq_entries_ = p.sq_entries;
+        sq_flags_ = (unsigned*)(sq + p.sq_off.flags);
+        sq_array_ = (unsigned*)(sq + p.sq_off.array);
+
+        uint8_t* cq = (uint8_t*)cq_ptr_;
+        cq_head_ = (unsigned*)(cq + p.cq_off.head);
+        cq_tail_ = (unsigned*)(cq + p.cq_off.tail);
+        cq_mask_ = *(unsigned*)(cq + p.cq_off.ring_mask);
+        cqes_ = (io_uring_cqe*)(cq + p.cq_off.cqes);
+
+        local_tail_ = *sq_tail_;
+        return true;
+    }
+
+    void destroy()
+    {
+        teardown_buf_ring();
+        if (sqes_) { munmap(sqes_, sqes_len_); sqes_ = nullptr; }
+        if (cq_ptr_ && cq_ptr_ != sq_ptr_) munmap(cq_ptr_, cq_len_);
+        cq_ptr_ = nullptr;
+        if (sq_ptr_) { munmap(sq_ptr_, sq_len_); sq_ptr_ = nullptr; }
+        if (fd_ >= 0) { close(fd_); fd_ = -1; }
+    }
+
+    bool ok() const { return fd_ >= 0; }
+    bool sqpoll() const { return sqpoll_; }
+    uint64_t enters() const { return enters_; }
+
+    // ---- registration ----
+
+    bool register_buffers(const iovec* iov, unsigned n)
+    {
+        return syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS, iov, n) == 0;
+    }
+
+    bool register_files(const int* fds, unsigned n)
+    {
+        return syscall(__NR_io_uring_register, fd_, IORING_REGISTER_FILES, fds, n) == 0;
+    }
+
+    // Provided buffers for IOSQE_BUFFER_SELECT receives: `count` buffers
+    // of `size` bytes carved out of `base`, group id `bgid`. Prefers a
+    // registered buffer ring (recycling is a store to shared memory) and
+    // self-tests it with a one-byte pipe read, since some kernels accept
+    // the registration but never hand buffers out; otherwise falls back
+    // to IORING_OP_PROVIDE_BUFFERS, where recycling rides along with the
+    // next submit(). Call before other requests are in flight.
+    bool provide_buffers(uint16_t bgid, unsigned count, uint8_t* base, unsigned size)
+    {
+        buf_group_ = bgid;
+        buf_base_ = base;
+        buf_size_ = size;
+        if (setup_buf_ring(count) && buf_ring_selects())
+            return true;
+        teardown_buf_ring();
+
+        io_uring_sqe* sqe = get_sqe();
+        if (!sqe) return false;
+        sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+        sqe->fd = (int)count;
+        sqe->addr = (uint64_t)(uintptr_t)base;
+        sqe->len = size;
+        sqe->off = 0;
+        sqe->buf_group = bgid;
+        sqe->user_data = UINT64_MAX;
+        int res = -1;
+        if (submit(1) < 0) return false;
+        drain([&](const io_uring_cqe& c) { res = c.res; });
+        return res >= 0;
+    }
+
+    bool buffer_ring() const { return buf_ring_ != nullptr; }
+
+    uint8_t* provided_buf(uint16_t bid) const { return buf_base_ + (size_t)bid * buf_size_; }
+
+    // Hands a consumed provided buffer back to the kernel. In fallback mode
+    // this queues an SQE (user_data UINT64_MAX) and returns false if the SQ
+    // is full.
+    bool recycle_buf(uint16_t bid)
+    {
+        if (buf_ring_)
+        {
+            add_buf(bid);
+            publish_bufs();
+            return true;
+        }
+        io_uring_sqe* sqe = get_sqe();
+        if (!sqe) return false;
+        sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+        sqe->fd = 1;
+        sqe->addr = (uint64_t)(uintptr_t)provided_buf(bid);
+        sqe->len = buf_size_;
+        sqe->off = bid;
+        sqe->buf_group = buf_group_;
+        sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+        sqe->user_data = UINT64_MAX;
+        return true;
+    }
+
+    // ---- submission ----
+
+    // Next free SQE (zeroed), or nullptr if the SQ is full.
+    io_uring_sqe* get_sqe()
+    {
+        unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        if (local_tail_ - head >= sq_entries_) return nullptr;
+        unsigned idx = local_tail_ & sq_mask_;
+        io_uring_sqe* sqe = &sqes_[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        sq_array_[idx] = idx;
+        ++local_tail_;
+        return sqe;
+    }
+
+    // Publishes queued SQEs and optionally waits for `wait_nr` completions,
+    // using one io_uring_enter() at most. With SQPOLL the syscall is skipped
+    // unless the poller is asleep or we need to block.
+    int submit(unsigned wait_nr = 0)
+    {
+        unsigned to_submit = local_tail_ - *sq_tail_;
+        __atomic_store_n(sq_tail_, local_tail_, __ATOMIC_RELEASE);
+
+        unsigned flags = 0;
+        if (sqpoll_)
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (__atomic_load_n(sq_flags_, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP)
+                flags |= IORING_ENTER_SQ_WAKEUP;
+            to_submit = 0;
+        }
+        if (wait_nr)
+        {
+            if (ready() >= wait_nr && !(flags & IORING_ENTER_SQ_WAKEUP) && (sqpoll_ || to_submit == 0))
+                return 0;
+            flags |= IORING_ENTER_GETEVENTS;
+        }
+        if (!flags && !to_submit) return 0;
+        return enter(to_submit, wait_nr, flags);
+    }
+
+    // ---- completion ----
+
+    unsigned ready() const
+    {
+        return __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE) - *cq_head_;
+    }
+
+    // Calls fn(const io_uring_cqe&) for every pending completion.
+    template <typename Fn>
+    unsigned drain(Fn&& fn)
+    {
+        unsigned head = *cq_head_;
+        unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        unsigned n = 0;
+        for (; head != tail; ++head, ++n)
+            fn(cqes_[head & cq_mask_]);
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        return n;
+    }
+
+private:
+    int enter(unsigned to_submit, unsigned min_complete, unsigned flags)
+    {
+        ++enters_;
+        for (;;)
+        {
+            int r = (int)syscall(__NR_io_uring_enter, fd_, to_submit, min_complete, flags, nullptr, 0);
+            if (r >= 0 || errno != EINTR) return r;
+        }
+    }
+
+    bool setup_buf_ring(unsigned count)
+    {
+        buf_ring_len_ = count * sizeof(io_uring_buf);
+        void* mem = mmap(nullptr, buf_ring_len_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if (mem == MAP_FAILED) return false;
+        buf_ring_ = (io_uring_buf_ring*)mem;
+
+        io_uring_buf_reg reg{};
+        reg.ring_addr = (uint64_t)(uintptr_t)mem;
+        reg.ring_entries = count;
+        reg.bgid = buf_group_;
+        if (syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PBUF_RING, &reg, 1) != 0)
+        {
+            munmap(mem, buf_ring_len_);
+            buf_ring_ = nullptr;
+            return false;
+        }
+        buf_registered_ = true;
+        buf_mask_ = (uint16_t)(count - 1);
+        for (unsigned i = 0; i < count; ++i) add_buf((uint16_t)i);
+        publish_bufs();
+        return true;
+    }
+
+    void teardown_buf_ring()
+    {
+        if (buf_registered_)
+        {
+            io_uring_buf_reg reg{};
+            reg.bgid = buf_group_;
+            syscall(__NR_io_uring_register, fd_, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+            buf_registered_ = false;
+        }
+        if (buf_ring_) { munmap(buf_ring_, buf_ring_len_); buf_ring_ = nullptr; }
+    }
+
+    bool buf_ring_selects()
+    {
+        int p[2];
+        if (pipe(p) != 0) return false;
+        bool ok = false;
+        io_uring_sqe* sqe = get_sqe();
+        if (sqe && write(p[1], "x", 1) == 1)
+        {
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = p[0];
+            sqe->off = (uint64_t)-1;
+            sqe->flags = IOSQE_BUFFER_SELECT;
+            sqe->buf_group = buf_group_;
+            sqe->user_data = UINT64_MAX;
+            if (submit(1) >= 0)
+                drain([&](const io_uring_cqe& c)
+                    {
+                        ok = c.res == 1 && (c.flags & IORING_CQE_F_BUFFER);
+                        if (ok) recycle_buf((uint16_t)(c.flags >> IORING_CQE_BUFFER_SHIFT));
+                    });
+        }
+        close(p[0]);
+        close(p[1]);
+        return ok;
+    }
+
+    void add_buf(uint16_t bid)
+    {
+        io_uring_buf* b = &buf_ring_->bufs[buf_tail_ & buf_mask_];
+        b->addr = (uint64_t)(uintptr_t)provided_buf(bid);
+        b->len = buf_size_;
+        b->bid = bid;
+        ++buf_tail_;
+    }
+
+    void publish_bufs()
+    {
+        __atomic_store_n(&buf_ring_->tail, buf_tail_, __ATOMIC_RELEASE);
+    }
+
+    int fd_ = -1;
+    bool sqpoll_ = false;
+    bool single_mmap_ = false;
+    uint64_t enters_ = 0;
+
+    void* sq_ptr_ = nullptr;
+    void* cq_ptr_ = nullptr;
+    size_t sq_len_ = 0, cq_len_ = 0, sqes_len_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_flags_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned sq_mask_ = 0, sq_entries_ = 0;
+    unsigned local_tail_ = 0;
+
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+
+    io_uring_buf_ring* buf_ring_ = nullptr;
+    size_t buf_ring_len_ = 0;
+    bool buf_registered_ = false;
+    uint16_t buf_group_ = 0;
+    uint8_t* buf_base_ = nullptr;
+    unsigned buf_size_ = 0;
+    uint16_t buf_mask_ = 0;
+    uint16_t buf_tail_ = 0;
+};
+
+} // namespace ssb
@@ -0,0 +1,251 @@
+// ssb/zerocopy.h
+// Bulk frame sender for large observation payloads using MSG_ZEROCOPY.
+// Frames are built in place in a fixed pool of buffers (header followed
+// by payload); sends at or above `threshold` bytes pin the pages instead of
+// copying them, and a buffer only returns to the pool once the kernel has
+// reported every zero-copy send that referenced it on the socket error
+// queue. Smaller sends, or sockets without SO_ZEROCOPY, take the normal
+// copying path and recycle immediately.
+//
+// Loopback and other paths that cannot transmit from user pages still
+// copy (deferred, at completion time); completions flagged that way are
+// counted in copied().
+#pragma once
+
+#include <time.h>  // struct timespec, which linux/errqueue.h uses
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#include "ssb/frame.h"
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
+namespace ssb
+{
+
+// Below ~10 KB the page pinning and completion handling cost more than
+// the copy they avoid.
+constexpr size_t ZC_DEFAULT_THRESHOLD = 16 * 1024;
+
+// Use one sender per socket for its lifetime: the kernel numbers zero-copy
+// completions per socket.
+class ZeroCopySender
+{
+public:
+    // `buffers` frames of up to `max_payload` bytes each.
+    ZeroCopySender(size_t buffers, size_t max_payload, size_t threshold = ZC_DEFAULT_THRESHOLD)
+        : stride_(align(FRAME_HEADER_SIZE + max_payload)),
+          max_payload_(max_payload),
+          threshold_(threshold),
+          pool_(buffers * stride_),
+          bufs_(buffers)
+    {
+        for (size_t i = buffers; i-- > 0;) free_.push_back((int)i);
+    }
+
+    ZeroCopySender(const ZeroCopySender&) = delete;
+    ZeroCopySender& operator=(const ZeroCopySender&) = delete;
+
+    // Enables SO_ZEROCOPY on a connected TCP socket. On failure (old
+    // kernel, unsupported socket) every send takes the copying path.
+    bool attach(int fd)
+    {
+        int one = 1;
+        zc_ = setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+        return zc_;
+    }
+
+    bool enabled() const { return zc_; }
+    size_t max_payload() const { return max_payload_; }
+    size_t threshold() const { return threshold_; }
+    void set_threshold(size_t t) { threshold_ = t; }
+
+    // A free buffer, or -1 if all are queued or awaiting completions
+    // (wait for EPOLLERR / POLLERR and reap()).
+    int acquire()
+    {
+        if (free_.empty()) return -1;
+        int b = free_.back();
+        free_.pop_back();
+        return b;
+    }
+
+    uint8_t* payload(int b) { return pool_.data() + (size_t)b * stride_ + FRAME_HEADER_SIZE; }
+
+    // Stamps the header in front of the payload and queues the frame.
+    void commit(int b, const FrameHeader& h)
+    {
+        memcpy(pool_.data() + (size_t)b * stride_, &h, FRAME_HEADER_SIZE);
+        Buf& buf = bufs_[b];
+        buf.len = FRAME_HEADER_SIZE + h.payload_len;
+        buf.sent = 0;
+        buf.queued = true;
+        queue_.push_back(b);
+    }
+
+    bool busy() const { return !queue_.empty(); }
+
+    // Sends queued frames in order until done or the socket is full.
+    WriteResult flush(int fd)
+    {
+        while (!queue_.empty())
+        {
+            int b = queue_.front();
+            Buf& buf = bufs_[b];
+            size_t left = buf.len - buf.sent;
+            bool zc = zc_ && left >= threshold_;
+
+            iovec iov{ pool_.data() + (size_t)b * stride_ + buf.sent, left };
+            msghdr msg{};
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+
+            ssize_t r = sendmsg(fd, &msg, MSG_NOSIGNAL | (zc ? MSG_ZEROCOPY : 0));
+            if (r < 0)
+            {
+                if (errno == EINTR) continue;
+                // ENOBUFS: too many zero-copy sends outstanding (optmem)
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) return WriteResult::Blocked;
+                return WriteResult::Failed;
+            }
+
+            if (zc)
+            {
+                // every successful MSG_ZEROCOPY call consumes one notification id
+                pending_.push_back(b);
+                buf.refs++;
+                zc_sends_++;
+            }
+            else
+                copy_sends_++;
+
+            buf.sent += (size_t)r;
+            if (buf.sent == buf.len)
+            {
+                queue_.pop_front();
+                buf.queued = false;
+                if (buf.refs == 0) free_.push_back(b);
+            }
+        }
+        return WriteResult::Done;
+    }
+
+    // Drains zero-copy completions from the error queue and returns the
+    // number of buffers released back to the pool.
+    size_t reap(int fd)
+    {
+        size_t released = 0;
+        for (;;)
+        {
+            char control[128];
+            msghdr msg{};
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+
+            if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+            {
+                if (errno == EINTR) continue;
+                break;
+            }
+
+            for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+            {
+                bool recverr = (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                    (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR);
+                if (!recverr) continue;
+
+                sock_extended_err err;
+                memcpy(&err, CMSG_DATA(cm), sizeof(err));
+                if (err.ee_errno != 0 || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+
+                // ids [ee_info, ee_data] inclusive, wrapping u32
+                uint32_t n = err.ee_data - err.ee_info + 1;
+                if (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) copied_ += n;
+                for (uint32_t i = 0; i < n; ++i)
+                    released += complete(err.ee_info + i);
+            }
+        }
+        return released;
+    }
+
+    // buffers pinned by the kernel (sent, completion not yet reaped)
+    size_t in_flight() const { return pending_.size() - done_in_pending_; }
+
+    uint64_t zc_sends() const { return zc_sends_; }
+    uint64_t copy_sends() const { return copy_sends_; }
+    uint64_t copied() const { return copied_; }
+
+private:
+    struct Buf
+    {
+        size_t len = 0;
+        size_t sent = 0;
+        uint32_t refs = 0;      // outstanding zero-copy sends
+        bool queued = false;
+    };
+
+    static size_t align(size_t n) { return (n + 4095) & ~(size_t)4095; }
+
+    size_t complete(uint32_t id)
+    {
+        uint32_t idx = id - first_id_;
+        if (idx >= pending_.size() || pending_[idx] < 0) return 0;
+
+        int b = pending_[idx];
+        pending_[idx] = -1;
+        done_in_pending_++;
+        while (!pending_.empty() && pending_.front() < 0)
+        {
+            pending_.pop_front();
+            done_in_pending_--;
+            first_id_++;
+        }
+
+        Buf& buf = bufs_[b];
+        if (--buf.refs == 0 && !buf.queued)
+        {
+            free_.push_back(b);
+            return 1;
+        }
+        return 0;
+    }
+
+    size_t stride_;
+    size_t max_payload_;
+    size_t threshold_;
+    bool zc_ = false;
+
+    std::vector<uint8_t> pool_;
+    std::vector<Buf> bufs_;
+    std::vector<int> free_;
+    std::deque<int> queue_;
+
+    // buffer index per notification id, starting at first_id_; -1 = done
+    std::deque<int> pending_;
+    uint32_t first_id_ = 0;
+    size_t done_in_pending_ = 0;
+
+    uint64_t zc_sends_ = 0;
+    uint64_t copy_sends_ = 0;
+    uint64_t copied_ = 0;
+};
+
+} // namespace ssb